@@ -26,11 +26,17 @@
 #include <api_atom.h>
 #include <api_forge.h>
 #include <api_stash.h>
+#include <api_sched.h>
 #include <api_midi.h>
 #include <api_osc.h>
 #include <api_time.h>
 #include <api_state.h>
 #include <api_parameter.h>
+#include <api_fold.h>
+#include <api_capture.h>
+#include <api_profile.h>
+#include <api_worker.h>
+#include <api_tuning.h>
 
 #if defined(BUILD_INLINE_DISP)
 #	include <canvas.lv2/idisp.h>
@@ -90,13 +96,46 @@ _hash_sort(const void *itm1, const void *itm2)
 	return 0;
 }
 
-__realtime static int // map is not really realtime in most hosts
+// cache URID resolved in realtime thread for subsequent lookups and VMs
+__realtime static void
+_moony_urid_cache_request(moony_t *moony, const char *uri, LV2_URID urid)
+{
+	const size_t sz = sizeof(moony_job_t) + strlen(uri) + 1;
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sz)))
+	{
+		req->type = MOONY_JOB_URID_CACHE;
+		req->urid.urid = urid;
+		strcpy(req->urid.uri, uri);
+
+		varchunk_write_advance(moony->from_dsp, sz);
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+}
+
+__realtime static int
 _lmap__index(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(2));
 
 	const char *uri = luaL_checkstring(L, 2);
-	LV2_URID urid = moony->map->map(moony->map->handle, uri); // non-rt
+	LV2_URID urid = moony_urid_cache_map(&moony->urid_cache, uri);
+	if(!urid)
+	{
+		if(vm->nrt)
+		{
+			urid = moony_urid_cache_resolve(&moony->urid_cache, uri);
+		}
+		else
+		{
+			urid = moony->map->map(moony->map->handle, uri); // non-rt
+			if(urid && !moony_urid_cache_saturated(&moony->urid_cache))
+				_moony_urid_cache_request(moony, uri, urid);
+		}
+	}
+
 	if(urid)
 	{
 		lua_pushinteger(L, urid);
@@ -118,13 +157,28 @@ static const luaL_Reg lmap_mt [] = {
 	{NULL, NULL}
 };
 
-__realtime static int // unmap is not really realtime in most hosts
+__realtime static int
 _lunmap__index(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(2));
 
 	LV2_URID urid = luaL_checkinteger(L, 2);
-	const char *uri = moony->unmap->unmap(moony->unmap->handle, urid); // non-rt
+	const char *uri = moony_urid_cache_unmap(&moony->urid_cache, urid);
+	if(!uri)
+	{
+		if(vm->nrt)
+		{
+			uri = moony_urid_cache_resolve_uri(&moony->urid_cache, urid);
+		}
+		else
+		{
+			uri = moony->unmap->unmap(moony->unmap->handle, urid); // non-rt
+			if(uri && !moony_urid_cache_saturated(&moony->urid_cache))
+				_moony_urid_cache_request(moony, uri, urid);
+		}
+	}
+
 	if(uri)
 	{
 		lua_pushstring(L, uri);
@@ -213,7 +267,21 @@ _lvoice_map(lua_State *L)
 __realtime static int
 _lmidi2cps(lua_State *L)
 {
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+
 	const lua_Number note = luaL_checknumber(L, 1);
+
+	if(lua_gettop(L) == 1) // look up integral notes with default tuning
+	{
+		const int idx = note;
+
+		if( (idx == note) && (idx >= 0) && (idx < 0x80) )
+		{
+			lua_pushnumber(L, moony->midi2cps[idx]);
+			return 1;
+		}
+	}
+
 	const lua_Number base = luaL_optnumber(L, 2, 69.0);
 	const lua_Number noct = luaL_optnumber(L, 3, 12.0);
 	const lua_Number fref = luaL_optnumber(L, 4, 440.0);
@@ -248,30 +316,27 @@ static const char *note_keys [12] = {
 	"B"
 };
 
+__non_realtime static void
+_note_name(char *name, size_t len, int note)
+{
+	const int8_t octave = note / 12 - 1;
+	const uint8_t key = note % 12;
+
+	snprintf(name, len, "%s%+"PRIi8, note_keys[key], octave);
+}
+
+// canonical names and numbers are interned at moony_open
 __realtime static int
 _lnote__index(lua_State *L)
 {
-	//moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
-
 	lua_settop(L, 2); // ignore superfluous arguments
 
-	const int type = lua_type(L, 2);
-	if(type == LUA_TNUMBER)
-	{
-		const int note = lua_tointeger(L, 2);
-
-		if( (note >= 0) && (note < 0x80) )
-		{
-			char name [16];
-			const int8_t octave = note / 12 - 1;
-			const uint8_t key = note % 12;
-			snprintf(name, 16, "%s%+"PRIi8, note_keys[key], octave);
+	lua_pushvalue(L, 2);
+	if(lua_rawget(L, 1) != LUA_TNIL)
+		return 1;
 
-			lua_pushstring(L, name);
-			return 1;
-		}
-	}
-	else if(type == LUA_TSTRING)
+	// parse alternative spellings, e.g. 'C-0'
+	if(lua_type(L, 2) == LUA_TSTRING)
 	{
 		size_t str_len;
 		const char *str = lua_tolstring(L, 2, &str_len);
@@ -462,6 +527,125 @@ _log(lua_State *L)
 	return 0;
 }
 
+// hand current profile over to worker to write folded stacks
+__realtime static void
+_moony_profile_stop(moony_t *moony)
+{
+	if(!moony->profile)
+		return;
+
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sizeof(moony_job_t))))
+	{
+		req->type = MOONY_JOB_PROFILE_CLOSE;
+		req->ptr = moony->profile;
+
+		varchunk_write_advance(moony->from_dsp, sizeof(moony_job_t));
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+
+	moony->profile = NULL;
+}
+
+// let worker open profile, it's handed back via _work_response
+__realtime static void
+_moony_profile_start(moony_t *moony, const char *path, size_t len, int count)
+{
+	const size_t sz = sizeof(moony_job_t) + len + 1;
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sz)))
+	{
+		req->type = MOONY_JOB_PROFILE_OPEN;
+		req->profile.count = count;
+		memcpy(req->profile.path, path, len);
+		req->profile.path[len] = '\0';
+
+		varchunk_write_advance(moony->from_dsp, sz);
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+}
+
+// Moony.profile(path, count) starts, Moony.profile() stops sampling
+__realtime static int
+_lprofile(lua_State *L)
+{
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(2));
+
+	if(vm->nrt) // jobs may only be queued from rt-thread
+		return luaL_error(L, "Moony.profile: not callable from non-realtime context");
+
+	size_t len = 0;
+	const char *path = lua_isstring(L, 1) ? lua_tolstring(L, 1, &len) : NULL;
+	const lua_Integer count = luaL_optinteger(L, 2, MOONY_PROFILE_COUNT);
+
+	luaL_argcheck(L, (count > 0) && (count <= INT_MAX), 2, "invalid instruction count");
+
+	_moony_profile_stop(moony);
+
+	if(len)
+		_moony_profile_start(moony, path, len, count);
+
+	return 0;
+}
+
+// Moony.allocs(true) reports allocation sites of each period
+__realtime static int
+_lallocs(lua_State *L)
+{
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(1));
+
+	vm->allocs.report = lua_toboolean(L, 1);
+
+	return 0;
+}
+
+// Moony.strict(warmup) raises error upon allocation after warm-up periods
+__realtime static int
+_lstrict(lua_State *L)
+{
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(1));
+
+	if(lua_isnoneornil(L, 1) || (lua_isboolean(L, 1) && !lua_toboolean(L, 1)) )
+	{
+		vm->allocs.strict = false;
+		return 0;
+	}
+
+	const lua_Integer warmup = lua_isboolean(L, 1) ? 0 : luaL_checkinteger(L, 1);
+
+	luaL_argcheck(L, (warmup >= 0) && (warmup <= UINT32_MAX), 1, "invalid warm-up periods");
+
+	vm->allocs.strict = true;
+	vm->allocs.warmup = warmup;
+	vm->allocs.violated = false;
+
+	return 0;
+}
+
+// Moony.displayRate(hz) limits refresh rate of inline display
+__realtime static int
+_ldisplay_rate(lua_State *L)
+{
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(1));
+
+	if(lua_isnoneornil(L, 1))
+	{
+		vm->display_rate = 0.0; // default
+		return 0;
+	}
+
+	const lua_Number rate = luaL_checknumber(L, 1);
+
+	luaL_argcheck(L, rate > 0.0, 1, "invalid refresh rate");
+
+	vm->display_rate = rate;
+
+	return 0;
+}
+
 __realtime LV2_Atom_Forge_Ref
 _sink_rt(LV2_Atom_Forge_Sink_Handle handle, const void *buf, uint32_t size)
 {
@@ -529,6 +713,7 @@ __realtime static int
 _stash(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, 1); // VM to stash into
 
 	lua_getglobal(L, "stash");
 	if(lua_isfunction(L, -1))
@@ -538,11 +723,23 @@ _stash(lua_State *L)
 		lframe->last.frames = 0;
 		lframe->forge = &moony->stash_forge;
 
-		atom_ser_t *ser = &moony->vm->ser;
-		ser->data = moony->vm;
-		ser->size = 1024;
+		atom_ser_t *ser = &vm->ser;
+		ser->data = vm;
 		ser->offset = 0;
-		ser->buf = moony_rt_alloc(moony->vm, ser->size);
+
+		if(vm->stash_buf) // use buffer preallocated by worker
+		{
+			ser->size = vm->stash_size;
+			ser->buf = vm->stash_buf;
+
+			vm->stash_buf = NULL;
+			vm->stash_size = 0;
+		}
+		else
+		{
+			ser->size = 1024;
+			ser->buf = moony_rt_alloc(vm, ser->size);
+		}
 
 		if(ser->buf)
 		{
@@ -555,6 +752,9 @@ _stash(lua_State *L)
 			moony->stash_atom = atom;
 			moony->stash_size = ser->size;
 
+			// remember size for preallocation upon next swap
+			atomic_store_explicit(&moony->stash_hint, ser->offset, memory_order_relaxed);
+
 			// invalidate ser_atom
 			ser->size = 0;
 			ser->buf = NULL;
@@ -566,21 +766,87 @@ _stash(lua_State *L)
 	return 0;
 }
 
+__realtime static void
+_moony_stash_free(moony_t *moony)
+{
+	lua_State *L = moony_current(moony);
+
+	// unanchor pending apply coroutine, if any
+	lua_pushnil(L);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &moony->stash_atom);
+
+	moony_rt_free(moony->vm, moony->stash_atom, moony->stash_size);
+	moony->stash_atom = NULL;
+	moony->stash_size = 0;
+}
+
 __realtime static int
 _apply(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	lua_State *co;
+	int nargs = 0;
 
-	lua_getglobal(L, "apply");
-	if(lua_isfunction(L, -1))
+	// resume pending apply or start a new one
+	if(lua_rawgetp(L, LUA_REGISTRYINDEX, &moony->stash_atom) == LUA_TTHREAD)
 	{
-		_latom_new(L, moony->stash_atom, true);
-		lua_call(L, 1, 0);
+		co = lua_tothread(L, -1);
 	}
 	else
+	{
 		lua_pop(L, 1);
 
-	return 0;
+		if(lua_getglobal(L, "apply") != LUA_TFUNCTION)
+		{
+			lua_pop(L, 1);
+			lua_pushboolean(L, 1); // done
+			return 1;
+		}
+
+		co = lua_newthread(L);
+		lua_insert(L, -2);
+		_latom_new(L, moony->stash_atom, false); // may outlive current period
+		lua_xmove(L, co, 2);
+		nargs = 1;
+
+		// anchor coroutine while apply is in progress
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, LUA_REGISTRYINDEX, &moony->stash_atom);
+	}
+
+	int nres = 0;
+	const int status = lua_resume(co, L, nargs, &nres);
+
+	if(status == LUA_YIELD)
+	{
+		// forward yielded values to optional progress callback
+		if(lua_getglobal(L, "progress") == LUA_TFUNCTION)
+		{
+			lua_xmove(co, L, nres);
+			lua_call(L, nres, 0);
+		}
+		else
+		{
+			lua_pop(L, 1);
+			lua_pop(co, nres);
+		}
+
+		lua_pushboolean(L, 0); // not done, yet
+		return 1;
+	}
+
+	lua_pushnil(L);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &moony->stash_atom);
+
+	if(status != LUA_OK)
+	{
+		lua_xmove(co, L, 1); // error message
+		return lua_error(L);
+	}
+
+	lua_pop(co, nres);
+	lua_pushboolean(L, 1); // done
+	return 1;
 }
 
 __non_realtime static int
@@ -606,15 +872,35 @@ _restore(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
 
+	// optional atom header and body, e.g. pointing into host-provided memory
+	const LV2_Atom *atom = lua_touserdata(L, 1);
+	const void *body = lua_touserdata(L, 2);
+
+	if(!atom || !body)
+	{
+		atom = moony->state_atom;
+		body = LV2_ATOM_BODY_CONST(atom);
+	}
+
 	if(lua_getglobal(L, "restore") == LUA_TFUNCTION)
 	{
-		_latom_new(L, moony->state_atom, false);
+		_latom_body_new(L, atom, body, false);
 		lua_call(L, 1, 0);
 	}
 
 	return 0;
 }
 
+__non_realtime static void
+_state_stats_log(moony_t *moony, const char *dir, const moony_stats_t *stats)
+{
+	if(moony->log)
+	{
+		lv2_log_note(&moony->logger, "state %s: %"PRIu32" bytes in %.3f ms\n",
+			dir, stats->size, stats->nanos * 1e-6);
+	}
+}
+
 __non_realtime static LV2_State_Status
 _state_save(LV2_Handle instance,
 	LV2_State_Store_Function store, LV2_State_Handle state,
@@ -736,9 +1022,12 @@ _state_save(LV2_Handle instance,
 		LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 	(void)status; //TODO check status
 
+	// size initial buffer from previous save to prevent repeated reallocation
+	const uint32_t size_hint = moony->save_stats.size + sizeof(LV2_Atom);
+
 	atom_ser_t ser = {
 		.data = NULL,
-		.size = 1024,
+		.size = size_hint > 1024 ? size_hint : 1024,
 		.offset = 0
 	};
 	ser.buf = malloc(ser.size);
@@ -749,6 +1038,8 @@ _state_save(LV2_Handle instance,
 
 		lv2_atom_forge_set_sink(&moony->state_forge, _sink_non_rt, _deref, &ser);
 
+		const uint64_t t0 = moony_nanos();
+
 		// lock Lua state, so it cannot be accessed by realtime thread
 		_spin_lock(&moony->state_lock);
 		{
@@ -767,6 +1058,11 @@ _state_save(LV2_Handle instance,
 		_unlock(&moony->state_lock);
 
 		LV2_Atom *state_atom_new = (LV2_Atom *)ser.buf;
+
+		moony->save_stats.size = state_atom_new->size;
+		moony->save_stats.nanos = moony_nanos() - t0;
+		_state_stats_log(moony, "saved", &moony->save_stats);
+
 		if( (state_atom_new->type) && (state_atom_new->size) )
 		{
 			status = store(
@@ -786,6 +1082,49 @@ _state_save(LV2_Handle instance,
 	return status;
 }
 
+// new VM in non-realtime mode with given chunk run in it
+__non_realtime static moony_vm_t *
+_compile_vm(moony_t *moony, const char *chunk)
+{
+	moony_vm_t *vm = moony_vm_new(moony->mem_size, moony->testing, moony);
+	if(!vm)
+	{
+		moony_err_async(moony, "moony_vm_new failed");
+		return NULL;
+	}
+
+	moony_vm_nrt_enter(vm);
+	moony_open(moony, vm, vm->L);
+
+#if defined(USE_CONSTANT_FOLDING)
+	// resolve constant lookups into URID tables ahead of compilation
+	lua_pushcfunction(vm->L, moony_fold);
+	lua_pushstring(vm->L, chunk);
+	if(lua_pcall(vm->L, 1, 1, 0))
+	{
+		lua_pop(vm->L, 1); // fall back to original chunk
+		lua_pushstring(vm->L, chunk);
+	}
+#else
+	lua_pushstring(vm->L, chunk);
+#endif
+
+	size_t len;
+	const char *code = lua_tolstring(vm->L, -1, &len);
+	const int status = luaL_loadbuffer(vm->L, code, len, chunk);
+	lua_remove(vm->L, -2); // code
+	if(status || lua_pcall(vm->L, 0, LUA_MULTRET, 0))
+	{
+		moony_err_async(moony, lua_tostring(vm->L, -1));
+		lua_pop(vm->L, 1);
+
+		moony_vm_free(vm);
+		return NULL;
+	}
+
+	return vm;
+}
+
 __non_realtime static moony_vm_t *
 _compile(moony_t *moony, const char *chunk)
 {
@@ -805,28 +1144,73 @@ _compile(moony_t *moony, const char *chunk)
 	if(chunk_old)
 		free(chunk_old);
 
-	moony_vm_t *vm = moony_vm_new(moony->mem_size, moony->testing, moony);
+	// map URIs used by script code ahead of its compilation
+	moony_urid_cache_prefetch(&moony->urid_cache, chunk);
+
+	moony_vm_t *vm = _compile_vm(moony, chunk);
 	if(!vm)
-	{
-		moony_err_async(moony, "moony_vm_new failed");
 		return NULL;
+
+	// sandboxed worker VM runs same code, but only ever its 'work' callback
+	if(lua_getglobal(vm->L, "work") != LUA_TNIL)
+	{
+		vm->worker = _compile_vm(moony, chunk);
+		if(!vm->worker)
+		{
+			lua_pop(vm->L, 1);
+
+			moony_vm_free(vm);
+			return NULL;
+		}
 	}
+	lua_pop(vm->L, 1);
 
-	moony_vm_nrt_enter(vm);
-	moony_open(moony, vm, vm->L);
-	if(luaL_dostring(vm->L, chunk))
+	// preallocate stash buffer with size of previous stash
+	const uint32_t stash_hint = atomic_load_explicit(&moony->stash_hint, memory_order_relaxed);
+	if(stash_hint)
 	{
-		moony_err_async(moony, lua_tostring(vm->L, -1));
-		lua_pop(vm->L, 1);
+		vm->stash_size = 1024;
+		while(vm->stash_size < stash_hint)
+			vm->stash_size <<= 1;
 
-		moony_vm_free(vm);
-		return NULL;
+		vm->stash_buf = moony_rt_alloc(vm, vm->stash_size);
+		if(!vm->stash_buf)
+			vm->stash_size = 0;
 	}
 	moony_vm_nrt_leave(vm);
 
 	return vm;
 }
 
+__non_realtime static void
+_state_restore_vm(moony_t *moony, moony_vm_t *vm, const LV2_Atom *atom,
+	const void *body)
+{
+	lua_State *L = vm->L;
+
+	const uint64_t t0 = moony_nanos();
+
+	moony_vm_nrt_enter(vm);
+	lua_rawgetp(L, LUA_REGISTRYINDEX, _restore);
+	lua_pushlightuserdata(L, (void *)atom);
+	lua_pushlightuserdata(L, (void *)body);
+	if(lua_pcall(L, 2, 0, 0))
+	{
+		moony_err_async(moony, lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+#ifdef USE_MANUAL_GC
+	lua_gc(L, LUA_GCSTEP, 0);
+#endif
+	moony_vm_nrt_leave(vm);
+
+	vm->restored = true;
+
+	moony->restore_stats.size = atom->size;
+	moony->restore_stats.nanos = moony_nanos() - t0;
+	_state_stats_log(moony, "restored", &moony->restore_stats);
+}
+
 __non_realtime static LV2_State_Status
 _state_restore(LV2_Handle instance,
 	LV2_State_Retrieve_Function retrieve, LV2_State_Handle state,
@@ -974,9 +1358,15 @@ _state_restore(LV2_Handle instance,
 		&flags2
 	);
 
+	const LV2_Atom state_atom = {
+		.size = size,
+		.type = type
+	};
+	const void *state_body = NULL;
+
 	if(body && size && type)
 	{
-		// allocate new state_atom
+		// allocate new state_atom, needed to restore state after later recompiles
 		LV2_Atom *state_atom_new = malloc(sizeof(LV2_Atom) + size);
 		if(state_atom_new)
 		{
@@ -984,6 +1374,11 @@ _state_restore(LV2_Handle instance,
 			state_atom_new->type = type;
 			memcpy(LV2_ATOM_BODY(state_atom_new), body, size);
 
+			// POD data may be referenced directly until we return
+			state_body = (flags2 & LV2_STATE_IS_POD)
+				? body
+				: LV2_ATOM_BODY_CONST(state_atom_new);
+
 			LV2_Atom *state_atom_old = (LV2_Atom *)atomic_exchange_explicit(&moony->state_atom_new, (uintptr_t)state_atom_new, memory_order_relaxed);
 			if(state_atom_old)
 				free(state_atom_old);
@@ -1005,6 +1400,12 @@ _state_restore(LV2_Handle instance,
 			moony_vm_t *vm_new = _compile(moony, chunk);
 			if(vm_new)
 			{
+				if(state_body)
+				{
+					// deserialize state here instead of in the realtime thread
+					_state_restore_vm(moony, vm_new, &state_atom, state_body);
+				}
+
 				moony_vm_t *vm_old = (moony_vm_t *)atomic_exchange_explicit(&moony->vm_new, (uintptr_t)vm_new, memory_order_relaxed);
 				if(vm_old)
 					moony_vm_free(vm_old);
@@ -1028,6 +1429,27 @@ static const LV2_State_Interface state_iface = {
 	.restore = _state_restore
 };
 
+// hand current capture over to worker to close file
+__realtime static void
+_moony_capture_stop(moony_t *moony)
+{
+	if(!moony->capture)
+		return;
+
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sizeof(moony_job_t))))
+	{
+		req->type = MOONY_JOB_CAPTURE_CLOSE;
+		req->ptr = moony->capture;
+
+		varchunk_write_advance(moony->from_dsp, sizeof(moony_job_t));
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+
+	moony->capture = NULL;
+}
+
 __non_realtime static LV2_Worker_Status
 _work_job(moony_t *moony,
 	LV2_Worker_Respond_Function respond,
@@ -1074,6 +1496,64 @@ _work_job(moony_t *moony,
 		{
 			free(job->ptr);
 		} break;
+		case MOONY_JOB_URID_CACHE:
+		{
+			moony_urid_cache_insert(&moony->urid_cache, job->urid.uri, job->urid.urid);
+		} break;
+		case MOONY_JOB_CAPTURE_OPEN:
+		{
+			const moony_job_t req = {
+				.type = MOONY_JOB_CAPTURE_OPEN,
+				.ptr = moony_capture_new(moony, job->chunk)
+			};
+
+			if(!req.ptr)
+			{
+				if(moony->log)
+					lv2_log_error(&moony->logger, "opening capture file '%s' failed\n", job->chunk);
+
+				return LV2_WORKER_ERR_UNKNOWN;
+			}
+
+			return respond(target, sizeof(moony_job_t), &req); // signal to _work_response
+		} break;
+		case MOONY_JOB_CAPTURE_DRAIN:
+		{
+			moony_capture_drain(moony, job->ptr);
+		} break;
+		case MOONY_JOB_CAPTURE_CLOSE:
+		{
+			moony_capture_free(moony, job->ptr);
+		} break;
+		case MOONY_JOB_PROFILE_OPEN:
+		{
+			const moony_job_t req = {
+				.type = MOONY_JOB_PROFILE_OPEN,
+				.ptr = moony_profile_new(moony, job->profile.path, job->profile.count)
+			};
+
+			if(!req.ptr)
+			{
+				if(moony->log)
+					lv2_log_error(&moony->logger, "opening profile file '%s' failed\n", job->profile.path);
+
+				return LV2_WORKER_ERR_UNKNOWN;
+			}
+
+			return respond(target, sizeof(moony_job_t), &req); // signal to _work_response
+		} break;
+		case MOONY_JOB_PROFILE_DRAIN:
+		{
+			moony_profile_drain(moony, job->ptr);
+		} break;
+		case MOONY_JOB_PROFILE_CLOSE:
+		{
+			moony_profile_free(moony, job->ptr);
+		} break;
+		case MOONY_JOB_WORK:
+		{
+			moony_worker_work(moony, job);
+		} break;
 	}
 
 	return LV2_WORKER_SUCCESS;
@@ -1164,10 +1644,29 @@ _work_response(LV2_Handle instance, uint32_t size, const void *body)
 			//printf("mem extended to %zu KB\n", moony->vm->space / 1024);
 		} break;
 
+		case MOONY_JOB_CAPTURE_OPEN:
+		{
+			_moony_capture_stop(moony);
+
+			moony->capture = job->ptr;
+		} break;
+		case MOONY_JOB_PROFILE_OPEN:
+		{
+			_moony_profile_stop(moony);
+
+			moony->profile = job->ptr;
+		} break;
+
 		case MOONY_JOB_VM_ALLOC:
 		case MOONY_JOB_MEM_FREE:
 		case MOONY_JOB_VM_FREE:
 		case MOONY_JOB_PTR_FREE:
+		case MOONY_JOB_URID_CACHE:
+		case MOONY_JOB_CAPTURE_DRAIN:
+		case MOONY_JOB_CAPTURE_CLOSE:
+		case MOONY_JOB_PROFILE_DRAIN:
+		case MOONY_JOB_PROFILE_CLOSE:
+		case MOONY_JOB_WORK:
 			break; // never reached
 	}
 
@@ -1197,31 +1696,18 @@ _idisp_render(LV2_Handle instance, uint32_t w, uint32_t h)
 	LV2_Inline_Display_Image_Surface *surf = 
 		lv2_canvas_idisp_surf_configure(moony->canvas_idisp, w, h, aspect_ratio);
 
+	// apply graph and layer updates in order straight from the ring buffer
 	const LV2_Atom *value = NULL;
 	size_t tot_size = 0;
 	while( (value = varchunk_read_request(moony->to_idisp, &tot_size)) )
 	{
-		moony->canvas_graph = realloc(moony->canvas_graph, tot_size);
-
-		memcpy(moony->canvas_graph, value, tot_size);
+		lv2_canvas_idisp_update_body(moony->canvas_idisp, value->type, value->size,
+			LV2_ATOM_BODY_CONST(value));
 
 		varchunk_read_advance(moony->to_idisp);
 	}
 
-	value = moony->canvas_graph;
-
-	const LV2_Atom fake = {
-		.size = 0,
-		.type = moony->forge.Tuple
-	};
-
-	if(!value)
-	{
-		value = &fake;
-	}
-
-	lv2_canvas_idisp_render_body(moony->canvas_idisp, value->type, value->size,
-		LV2_ATOM_BODY_CONST(value));
+	lv2_canvas_idisp_render_layers(moony->canvas_idisp);
 
 	return surf;
 }
@@ -1252,6 +1738,7 @@ moony_init(moony_t *moony, const char *subject, double sample_rate,
 {
 	atomic_init(&moony->state_atom_new, 0);
 	atomic_init(&moony->vm_new, 0);
+	atomic_init(&moony->stash_hint, 0);
 	atomic_init(&moony->err_new, 0);
 	atomic_init(&moony->chunk_new, 0);
 	moony->state_lock = (atomic_flag)ATOMIC_FLAG_INIT;
@@ -1263,6 +1750,13 @@ moony_init(moony_t *moony, const char *subject, double sample_rate,
 		return -1;
 	}
 
+	moony->to_dsp = varchunk_new(MOONY_MAX_CHUNK_LEN * 2, true);
+	if(!moony->to_dsp)
+	{
+		fprintf(stderr, "varchunk_new failed\n");
+		return -1;
+	}
+
 	moony->mem_size = mem_size;
 	moony->testing = testing;
 	moony->vm = moony_vm_new(moony->mem_size, testing, moony);
@@ -1331,83 +1825,91 @@ moony_init(moony_t *moony, const char *subject, double sample_rate,
 			"end");
 		moony->chunk_nrt = strdup(moony->chunk);
 	}
+	moony->chunk_hash = moony_hash(moony->chunk, strlen(moony->chunk));
 
 	xpress_init(&moony->xpress, 0, moony->map, voice_map, XPRESS_EVENT_NONE,
 		NULL, NULL, NULL);
 
-	moony->uris.moony_code = moony->map->map(moony->map->handle, MOONY_CODE_URI);
-	moony->uris.moony_error = moony->map->map(moony->map->handle, MOONY_ERROR_URI);
-	moony->uris.moony_trace = moony->map->map(moony->map->handle, MOONY_TRACE_URI);
-	moony->uris.moony_panic = moony->map->map(moony->map->handle, MOONY_PANIC_URI);
-	moony->uris.moony_state = moony->map->map(moony->map->handle, MOONY_STATE_URI);
-	moony->uris.moony_editorHidden = moony->map->map(moony->map->handle, MOONY_GRAPH_HIDDEN_URI);
-	moony->uris.moony_graphHidden = moony->map->map(moony->map->handle, MOONY_EDITOR_HIDDEN_URI);
-	moony->uris.moony_logHidden = moony->map->map(moony->map->handle, MOONY_LOG_HIDDEN_URI);
-	moony->uris.moony_logFollow = moony->map->map(moony->map->handle, MOONY_LOG_FOLLOW_URI);
-	moony->uris.moony_logReset = moony->map->map(moony->map->handle, MOONY_LOG_RESET_URI);
-	moony->uris.moony_paramHidden = moony->map->map(moony->map->handle, MOONY_PARAM_HIDDEN_URI);
-	moony->uris.moony_paramCols = moony->map->map(moony->map->handle, MOONY_PARAM_COLS_URI);
-	moony->uris.moony_paramRows = moony->map->map(moony->map->handle, MOONY_PARAM_ROWS_URI);
-	moony->uris.moony_color = moony->map->map(moony->map->handle, MOONY__color);
-	moony->uris.moony_syntax = moony->map->map(moony->map->handle, MOONY__syntax);
-
-	moony->uris.midi_event = moony->map->map(moony->map->handle, LV2_MIDI__MidiEvent);
-
-	moony->uris.patch.self = moony->map->map(moony->map->handle, subject);
-
-	moony->uris.patch.get = moony->map->map(moony->map->handle, LV2_PATCH__Get);
-	moony->uris.patch.set = moony->map->map(moony->map->handle, LV2_PATCH__Set);
-	moony->uris.patch.put = moony->map->map(moony->map->handle, LV2_PATCH__Put);
-	moony->uris.patch.patch = moony->map->map(moony->map->handle, LV2_PATCH__Patch);
-	moony->uris.patch.body = moony->map->map(moony->map->handle, LV2_PATCH__body);
-	moony->uris.patch.subject = moony->map->map(moony->map->handle, LV2_PATCH__subject);
-	moony->uris.patch.property = moony->map->map(moony->map->handle, LV2_PATCH__property);
-	moony->uris.patch.value = moony->map->map(moony->map->handle, LV2_PATCH__value);
-	moony->uris.patch.add = moony->map->map(moony->map->handle, LV2_PATCH__add);
-	moony->uris.patch.remove = moony->map->map(moony->map->handle, LV2_PATCH__remove);
-	moony->uris.patch.wildcard = moony->map->map(moony->map->handle, LV2_PATCH__wildcard);
-	moony->uris.patch.writable = moony->map->map(moony->map->handle, LV2_PATCH__writable);
-	moony->uris.patch.readable = moony->map->map(moony->map->handle, LV2_PATCH__readable);
-	moony->uris.patch.destination = moony->map->map(moony->map->handle, LV2_PATCH__destination);
-	moony->uris.patch.sequence = moony->map->map(moony->map->handle, LV2_PATCH__sequenceNumber);
-	moony->uris.patch.error = moony->map->map(moony->map->handle, LV2_PATCH__Error);
-	moony->uris.patch.ack = moony->map->map(moony->map->handle, LV2_PATCH__Ack);
-	moony->uris.patch.delete = moony->map->map(moony->map->handle, LV2_PATCH__Delete);
-	moony->uris.patch.copy = moony->map->map(moony->map->handle, LV2_PATCH__Copy);
-	moony->uris.patch.move = moony->map->map(moony->map->handle, LV2_PATCH__Move);
-	moony->uris.patch.insert = moony->map->map(moony->map->handle, LV2_PATCH__Insert);
-
-	moony->uris.rdfs_label = moony->map->map(moony->map->handle, RDFS__label);
-	moony->uris.rdfs_range = moony->map->map(moony->map->handle, RDFS__range);
-	moony->uris.rdfs_comment = moony->map->map(moony->map->handle, RDFS__comment);
-
-	moony->uris.rdf_value = moony->map->map(moony->map->handle, RDF__value);
-
-	moony->uris.lv2_minimum = moony->map->map(moony->map->handle, LV2_CORE__minimum);
-	moony->uris.lv2_maximum = moony->map->map(moony->map->handle, LV2_CORE__maximum);
-	moony->uris.lv2_scale_point = moony->map->map(moony->map->handle, LV2_CORE__scalePoint);
-	moony->uris.lv2_minor_version= moony->map->map(moony->map->handle, LV2_CORE__minorVersion);
-	moony->uris.lv2_micro_version= moony->map->map(moony->map->handle, LV2_CORE__microVersion);
-
-	moony->uris.units_unit = moony->map->map(moony->map->handle, LV2_UNITS__unit);
-	moony->uris.units_symbol = moony->map->map(moony->map->handle, LV2_UNITS__symbol);
-
-	moony->uris.atom_frame_time = moony->map->map(moony->map->handle, LV2_ATOM__frameTime);
-	moony->uris.atom_beat_time = moony->map->map(moony->map->handle, LV2_ATOM__beatTime);
-	moony->uris.atom_child_type = moony->map->map(moony->map->handle, LV2_ATOM__childType);
-
-	moony->uris.xpress_Token = moony->map->map(moony->map->handle, XPRESS__Token);
-	moony->uris.xpress_Alive = moony->map->map(moony->map->handle, XPRESS__Alive);
-	moony->uris.xpress_source = moony->map->map(moony->map->handle, XPRESS__source);
-	moony->uris.xpress_uuid = moony->map->map(moony->map->handle, XPRESS__uuid);
-	moony->uris.xpress_zone = moony->map->map(moony->map->handle, XPRESS__zone);
-	moony->uris.xpress_body = moony->map->map(moony->map->handle, XPRESS__body);
-	moony->uris.xpress_pitch = moony->map->map(moony->map->handle, XPRESS__pitch);
-	moony->uris.xpress_pressure = moony->map->map(moony->map->handle, XPRESS__pressure);
-	moony->uris.xpress_timbre = moony->map->map(moony->map->handle, XPRESS__timbre);
-	moony->uris.xpress_dPitch = moony->map->map(moony->map->handle, XPRESS__dPitch);
-	moony->uris.xpress_dPressure = moony->map->map(moony->map->handle, XPRESS__dPressure);
-	moony->uris.xpress_dTimbre = moony->map->map(moony->map->handle, XPRESS__dTimbre);
+	// pre-populate URID cache with vocabularies used by ourselves
+	moony_urid_cache_init(&moony->urid_cache, moony->map, moony->unmap,
+		&moony->logger);
+
+	moony->uris.moony_code = moony_urid_cache_resolve(&moony->urid_cache, MOONY_CODE_URI);
+	moony->uris.moony_codeHash = moony_urid_cache_resolve(&moony->urid_cache, MOONY_CODE_HASH_URI);
+	moony->uris.moony_error = moony_urid_cache_resolve(&moony->urid_cache, MOONY_ERROR_URI);
+	moony->uris.moony_trace = moony_urid_cache_resolve(&moony->urid_cache, MOONY_TRACE_URI);
+	moony->uris.moony_panic = moony_urid_cache_resolve(&moony->urid_cache, MOONY_PANIC_URI);
+	moony->uris.moony_capture = moony_urid_cache_resolve(&moony->urid_cache, MOONY_CAPTURE_URI);
+	moony->uris.moony_profile = moony_urid_cache_resolve(&moony->urid_cache, MOONY_PROFILE_URI);
+	moony->uris.moony_state = moony_urid_cache_resolve(&moony->urid_cache, MOONY_STATE_URI);
+	moony->uris.moony_editorHidden = moony_urid_cache_resolve(&moony->urid_cache, MOONY_GRAPH_HIDDEN_URI);
+	moony->uris.moony_graphHidden = moony_urid_cache_resolve(&moony->urid_cache, MOONY_EDITOR_HIDDEN_URI);
+	moony->uris.moony_logHidden = moony_urid_cache_resolve(&moony->urid_cache, MOONY_LOG_HIDDEN_URI);
+	moony->uris.moony_logFollow = moony_urid_cache_resolve(&moony->urid_cache, MOONY_LOG_FOLLOW_URI);
+	moony->uris.moony_logReset = moony_urid_cache_resolve(&moony->urid_cache, MOONY_LOG_RESET_URI);
+	moony->uris.moony_paramHidden = moony_urid_cache_resolve(&moony->urid_cache, MOONY_PARAM_HIDDEN_URI);
+	moony->uris.moony_paramCols = moony_urid_cache_resolve(&moony->urid_cache, MOONY_PARAM_COLS_URI);
+	moony->uris.moony_paramRows = moony_urid_cache_resolve(&moony->urid_cache, MOONY_PARAM_ROWS_URI);
+	moony->uris.moony_color = moony_urid_cache_resolve(&moony->urid_cache, MOONY__color);
+	moony->uris.moony_syntax = moony_urid_cache_resolve(&moony->urid_cache, MOONY__syntax);
+
+	moony->uris.midi_event = moony_urid_cache_resolve(&moony->urid_cache, LV2_MIDI__MidiEvent);
+
+	moony->uris.patch.self = moony_urid_cache_resolve(&moony->urid_cache, subject);
+
+	moony->uris.patch.get = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Get);
+	moony->uris.patch.set = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Set);
+	moony->uris.patch.put = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Put);
+	moony->uris.patch.patch = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Patch);
+	moony->uris.patch.body = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__body);
+	moony->uris.patch.subject = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__subject);
+	moony->uris.patch.property = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__property);
+	moony->uris.patch.value = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__value);
+	moony->uris.patch.add = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__add);
+	moony->uris.patch.remove = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__remove);
+	moony->uris.patch.wildcard = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__wildcard);
+	moony->uris.patch.writable = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__writable);
+	moony->uris.patch.readable = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__readable);
+	moony->uris.patch.destination = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__destination);
+	moony->uris.patch.sequence = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__sequenceNumber);
+	moony->uris.patch.error = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Error);
+	moony->uris.patch.ack = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Ack);
+	moony->uris.patch.delete = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Delete);
+	moony->uris.patch.copy = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Copy);
+	moony->uris.patch.move = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Move);
+	moony->uris.patch.insert = moony_urid_cache_resolve(&moony->urid_cache, LV2_PATCH__Insert);
+
+	moony->uris.rdfs_label = moony_urid_cache_resolve(&moony->urid_cache, RDFS__label);
+	moony->uris.rdfs_range = moony_urid_cache_resolve(&moony->urid_cache, RDFS__range);
+	moony->uris.rdfs_comment = moony_urid_cache_resolve(&moony->urid_cache, RDFS__comment);
+
+	moony->uris.rdf_value = moony_urid_cache_resolve(&moony->urid_cache, RDF__value);
+
+	moony->uris.lv2_minimum = moony_urid_cache_resolve(&moony->urid_cache, LV2_CORE__minimum);
+	moony->uris.lv2_maximum = moony_urid_cache_resolve(&moony->urid_cache, LV2_CORE__maximum);
+	moony->uris.lv2_scale_point = moony_urid_cache_resolve(&moony->urid_cache, LV2_CORE__scalePoint);
+	moony->uris.lv2_minor_version= moony_urid_cache_resolve(&moony->urid_cache, LV2_CORE__minorVersion);
+	moony->uris.lv2_micro_version= moony_urid_cache_resolve(&moony->urid_cache, LV2_CORE__microVersion);
+
+	moony->uris.units_unit = moony_urid_cache_resolve(&moony->urid_cache, LV2_UNITS__unit);
+	moony->uris.units_symbol = moony_urid_cache_resolve(&moony->urid_cache, LV2_UNITS__symbol);
+
+	moony->uris.atom_frame_time = moony_urid_cache_resolve(&moony->urid_cache, LV2_ATOM__frameTime);
+	moony->uris.atom_beat_time = moony_urid_cache_resolve(&moony->urid_cache, LV2_ATOM__beatTime);
+	moony->uris.atom_child_type = moony_urid_cache_resolve(&moony->urid_cache, LV2_ATOM__childType);
+
+	moony->uris.xpress_Token = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__Token);
+	moony->uris.xpress_Alive = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__Alive);
+	moony->uris.xpress_source = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__source);
+	moony->uris.xpress_uuid = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__uuid);
+	moony->uris.xpress_zone = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__zone);
+	moony->uris.xpress_body = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__body);
+	moony->uris.xpress_pitch = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__pitch);
+	moony->uris.xpress_pressure = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__pressure);
+	moony->uris.xpress_timbre = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__timbre);
+	moony->uris.xpress_dPitch = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__dPitch);
+	moony->uris.xpress_dPressure = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__dPressure);
+	moony->uris.xpress_dTimbre = moony_urid_cache_resolve(&moony->urid_cache, XPRESS__dTimbre);
 
 	lv2_canvas_urid_init(&moony->canvas_urid, moony->map);
 
@@ -1416,6 +1918,11 @@ moony_init(moony_t *moony, const char *subject, double sample_rate,
 	lv2_atom_forge_init(&moony->state_forge, moony->map);
 	lv2_atom_forge_init(&moony->stash_forge, moony->map);
 	lv2_atom_forge_init(&moony->notify_forge, moony->map);
+	lv2_atom_forge_init(&moony->worker_forge, moony->map);
+
+	// precompute midi2cps for integral notes with default tuning
+	for(unsigned note=0; note<0x80; note++)
+		moony->midi2cps[note] = exp2( (note - 69.0) / 12.0) * 440.0;
 	if(moony->log)
 		lv2_log_logger_init(&moony->logger, moony->map, moony->log);
 
@@ -1499,12 +2006,16 @@ moony_deinit(moony_t *moony)
 #if defined(BUILD_INLINE_DISP)
 	if(moony->to_idisp)
 		varchunk_free(moony->to_idisp);
-	free(moony->canvas_graph);
 	lv2_canvas_idisp_deinit(moony->canvas_idisp);
 	free(moony->canvas_idisp);
 	moony->canvas_idisp = NULL;
 #endif
 
+	if(moony->capture)
+		moony_capture_free(moony, moony->capture);
+	if(moony->profile)
+		moony_profile_free(moony, moony->profile);
+
 	LV2_Atom *state_atom_old = (LV2_Atom *)atomic_load_explicit(&moony->state_atom_new, memory_order_relaxed);
 	if(state_atom_old)
 		free(state_atom_old);
@@ -1532,6 +2043,10 @@ moony_deinit(moony_t *moony)
 
 	if(moony->from_dsp)
 		varchunk_free(moony->from_dsp);
+	if(moony->to_dsp)
+		varchunk_free(moony->to_dsp);
+
+	moony_urid_cache_deinit(&moony->urid_cache);
 }
 
 #define _protect_metatable(L, idx) \
@@ -1569,7 +2084,8 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 	lua_newtable(L);
 	lua_newtable(L);
 	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
-	luaL_setfuncs(L, lmap_mt, 1);
+	lua_pushlightuserdata(L, vm); // @ upvalueindex 2
+	luaL_setfuncs(L, lmap_mt, 2);
 	_protect_metatable(L, -1);
 	lua_setmetatable(L, -2);
 	lua_setglobal(L, "Map");
@@ -1578,13 +2094,25 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 	lua_newtable(L);
 	lua_newtable(L);
 	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
-	luaL_setfuncs(L, lunmap_mt, 1);
+	lua_pushlightuserdata(L, vm); // @ upvalueindex 2
+	luaL_setfuncs(L, lunmap_mt, 2);
 	_protect_metatable(L, -1);
 	lua_setmetatable(L, -2);
 	lua_setglobal(L, "Unmap");
 
 	// Note
 	lua_newtable(L);
+	for(int note=0; note<0x80; note++)
+	{
+		char name [16];
+		_note_name(name, sizeof(name), note);
+
+		lua_pushstring(L, name);
+		lua_pushvalue(L, -1);
+		lua_rawseti(L, -3, note); // number -> name
+		lua_pushinteger(L, note);
+		lua_rawset(L, -3); // name -> number
+	}
 	lua_newtable(L);
 	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
 	luaL_setfuncs(L, lnote_mt, 1);
@@ -1620,7 +2148,8 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 	lua_setglobal(L, "Blank");
 
 	// lv2.midi2cps
-	lua_pushcclosure(L, _lmidi2cps, 0);
+	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+	lua_pushcclosure(L, _lmidi2cps, 1);
 	lua_setglobal(L, "midi2cps");
 
 	// lv2cps2midi.
@@ -1829,6 +2358,7 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 		SET_MAP(L, CANVAS__, graph);
 		SET_MAP(L, CANVAS__, aspectRatio);
 		SET_MAP(L, CANVAS__, body);
+		SET_MAP(L, CANVAS__, layer);
 		SET_MAP(L, CANVAS__, BeginPath);
 		SET_MAP(L, CANVAS__, ClosePath);
 		SET_MAP(L, CANVAS__, Arc);
@@ -1855,6 +2385,7 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 		SET_MAP(L, CANVAS__, Reset);
 		SET_MAP(L, CANVAS__, FontSize);
 		SET_MAP(L, CANVAS__, FillText);
+		SET_MAP(L, CANVAS__, Layer);
 		SET_MAP(L, CANVAS__, lineCapButt);
 		SET_MAP(L, CANVAS__, lineCapRound);
 		SET_MAP(L, CANVAS__, lineCapSquare);
@@ -1894,9 +2425,35 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 		SET_MAP(L, MOONY__, color);
 		SET_MAP(L, MOONY__, syntax);
 		//TODO more
+
+		lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+		lua_pushlightuserdata(L, vm); // @ upvalueindex 2
+		lua_pushcclosure(L, _lprofile, 2);
+		lua_setfield(L, -2, "profile");
+
+		lua_pushlightuserdata(L, vm); // @ upvalueindex 1
+		lua_pushcclosure(L, _lallocs, 1);
+		lua_setfield(L, -2, "allocs");
+
+		lua_pushlightuserdata(L, vm); // @ upvalueindex 1
+		lua_pushcclosure(L, _lstrict, 1);
+		lua_setfield(L, -2, "strict");
+
+		lua_pushlightuserdata(L, vm); // @ upvalueindex 1
+		lua_pushcclosure(L, _ldisplay_rate, 1);
+		lua_setfield(L, -2, "displayRate");
 	}
 	lua_setglobal(L, "Moony");
 
+	lua_newtable(L);
+	{
+		lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+		lua_pushlightuserdata(L, vm); // @ upvalueindex 2
+		lua_pushcclosure(L, _lworker_post, 2);
+		lua_setfield(L, -2, "post");
+	}
+	lua_setglobal(L, "Worker");
+
 	lua_newtable(L);
 	{
 		moony->uris.param_sampleRate = SET_MAP(L, LV2_PARAMETERS__, sampleRate);
@@ -1960,6 +2517,32 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 	lua_pushcclosure(L, _ltimeresponder, 1);
 	lua_setglobal(L, "TimeResponder");
 
+	// Scheduler metatable
+	luaL_newmetatable(L, "lsched");
+	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+	luaL_setfuncs (L, lsched_mt, 1);
+	_protect_metatable(L, -1);
+	_index_metatable(L, -1);
+	lua_pop(L, 1);
+
+	// Scheduler factory
+	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+	lua_pushlightuserdata(L, vm); // @ upvalueindex 2
+	lua_pushcclosure(L, _lsched, 2);
+	lua_setglobal(L, "Scheduler");
+
+	// Tuning metatable
+	luaL_newmetatable(L, "ltuning");
+	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
+	luaL_setfuncs (L, ltuning_mt, 1);
+	_protect_metatable(L, -1);
+	_index_metatable(L, -1);
+	lua_pop(L, 1);
+
+	// Tuning factory
+	lua_pushcclosure(L, _ltuning, 0);
+	lua_setglobal(L, "Tuning");
+
 	// StateResponder metatable
 	luaL_newmetatable(L, "lstateresponder");
 	lua_pushlightuserdata(L, moony); // @ upvalueindex 1
@@ -2009,6 +2592,14 @@ moony_open(moony_t *moony, moony_vm_t *vm, lua_State *L)
 	lua_pushcclosure(L, _apply, 1);
 	lua_rawsetp(L, LUA_REGISTRYINDEX, _apply);
 
+	// registered StateResponders, mapped to whether they are pending
+	lua_newtable(L);
+	lua_newtable(L);
+	lua_pushstring(L, "k");
+	lua_setfield(L, -2, "__mode");
+	lua_setmetatable(L, -2);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, _lstateresponder_cont);
+
 	lua_pushlightuserdata(L, moony);
 	lua_pushcclosure(L, _ltimeresponder_stash, 1);
 	lua_rawsetp(L, LUA_REGISTRYINDEX, _ltimeresponder_stash);
@@ -2088,7 +2679,7 @@ moony_newuserdata(lua_State *L, moony_t *moony, moony_udata_t type, bool cache)
 {
 	assert( (type >= MOONY_UDATA_ATOM) && (type < MOONY_UDATA_COUNT) );
 
-	int *itr = &moony->itr[type];
+	int *itr = &moony_vm_get(L)->itr[type];
 	void *data = NULL;
 
 	if(cache) // do cash this!
@@ -2165,8 +2756,40 @@ _patch_set(patch_t *patch, LV2_Atom_Forge *forge, LV2_URID property, uint32_t si
 	return ref;
 }
 
+// forges next fragment of chunk or announces it only
 __realtime static inline LV2_Atom_Forge_Ref
-_moony_chunk_out(moony_t *moony, uint32_t frames, LV2_Atom_Forge *forge)
+_moony_chunk_out(moony_t *moony, uint32_t frames, LV2_Atom_Forge *forge, bool announce)
+{
+	patch_t *patch = &moony->uris.patch;
+	LV2_Atom_Forge_Frame frame;
+
+	LV2_Atom_Forge_Ref ref = lv2_atom_forge_frame_time(forge, frames)
+		&& lv2_atom_forge_object(forge, &frame, 0, patch->set)
+		&& lv2_atom_forge_key(forge, patch->subject)
+		&& lv2_atom_forge_urid(forge, patch->self)
+		&& lv2_atom_forge_key(forge, patch->property)
+		&& lv2_atom_forge_urid(forge, moony->uris.moony_code)
+		&& lv2_atom_forge_key(forge, patch->value);
+
+	if(ref)
+	{
+		ref = announce
+			? _moony_xfer_announce(forge, moony->chunk_hash, strlen(moony->chunk))
+			: _moony_xfer_forge(forge, &moony->code_out, moony->chunk);
+	}
+
+	if(ref)
+	{
+		lv2_atom_forge_pop(forge, &frame);
+		return 1; // success
+	}
+
+	return 0; // overflow
+}
+
+// sends whole chunk as single string, for hosts unaware of fragments
+__realtime static inline LV2_Atom_Forge_Ref
+_moony_chunk_whole(moony_t *moony, uint32_t frames, LV2_Atom_Forge *forge)
 {
 	const uint32_t len = strlen(moony->chunk);
 
@@ -2177,9 +2800,54 @@ _moony_chunk_out(moony_t *moony, uint32_t frames, LV2_Atom_Forge *forge)
 	return ref;
 }
 
+// sends pending fragments of chunk, leaving at least half of the notify
+// buffer to the script, unless it is empty and the fragment fits
+__realtime static inline LV2_Atom_Forge_Ref
+_moony_chunk_flush(moony_t *moony, LV2_Atom_Forge *forge, LV2_Atom_Forge_Ref ref)
+{
+	const uint32_t max_size = sizeof(LV2_Atom_Event) + 0x100 // patch:Set overhead
+		+ MOONY_MAX_FRAGMENT_LEN;
+
+	while(ref && _moony_xfer_busy(&moony->code_out))
+	{
+		const uint32_t offset = forge->offset + max_size;
+		const bool empty = forge->offset <= sizeof(LV2_Atom_Sequence);
+
+		if( (offset > forge->size / 2) && !(empty && (offset <= forge->size)) )
+			break; // continue in next period
+
+		ref = _moony_chunk_out(moony, 0, forge, false);
+	}
+
+	return ref;
+}
+
+// sends code to worker thread to be compiled
+__realtime static inline void
+_moony_chunk_compile(moony_t *moony, const char *code, uint32_t size)
+{
+	const size_t sz = sizeof(moony_job_t) + size;
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sz)))
+	{
+		req->type = MOONY_JOB_VM_ALLOC;
+		memcpy(req->chunk, code, size);
+
+		varchunk_write_advance(moony->from_dsp, sz);
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+}
+
 __realtime static inline LV2_Atom_Forge_Ref
 _moony_props_out(moony_t *moony, uint32_t frames, LV2_Atom_Forge *forge)
 {
+	// forget about properties registered to UI
+	memset(moony->props, 0x0, sizeof(moony->props));
+	moony->nprops = 0;
+	moony->props_stale = false;
+	moony->props_synced = false;
+
 	// clear all properties in UI
 	LV2_Atom_Forge_Frame obj_frame, add_frame, rem_frame;
 	LV2_Atom_Forge_Ref ref = lv2_atom_forge_frame_time(forge, frames);
@@ -2236,8 +2904,27 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 	if(chunk_new)
 	{
 		snprintf(moony->chunk, MOONY_MAX_CHUNK_LEN, "%s", chunk_new);
-		if(ref)
-			ref = _moony_chunk_out(moony, 0, forge);
+
+		const uint32_t len = strlen(moony->chunk);
+		moony->chunk_hash = moony_hash(moony->chunk, len);
+
+		if(!moony->code_fragments)
+		{
+			// no UI has asked for fragments, yet
+			if(ref)
+				ref = _moony_chunk_whole(moony, 0, forge);
+		}
+		else if(moony->chunk_hash == moony->code_in.hash)
+		{
+			// UI has sent this very code, announcing it is enough
+			moony->code_out.nseqs = 0;
+			if(ref)
+				ref = _moony_chunk_out(moony, 0, forge, true);
+		}
+		else
+		{
+			_moony_xfer_start(&moony->code_out, len, moony->chunk_hash);
+		}
 
 		moony_job_t *req;
 		if((req = varchunk_write_request(moony->from_dsp, sizeof(moony_job_t))))
@@ -2291,6 +2978,27 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 		}
 	}
 
+	// continue pending property registrations
+	if(moony->props_pending)
+	{
+		lua_State *L = moony_current(moony);
+
+		lua_pushcfunction(L, _lstateresponder_cont);
+		lua_pushlightuserdata(L, moony);
+		if(lua_pcall(L, 1, 0, 0))
+			moony_error(moony);
+	}
+
+	if(moony->props_stale)
+	{
+		// code reload has not been followed by a property registration
+		if(!moony->props_synced && ref)
+			ref = _moony_props_out(moony, 0, forge);
+
+		moony->props_stale = false;
+		moony->props_synced = false;
+	}
+
 	moony_vm_t *vm_new = (moony_vm_t *)atomic_exchange_explicit(&moony->vm_new, 0, memory_order_relaxed);
 	if(vm_new)
 	{
@@ -2299,9 +3007,13 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 		moony->error[0] = 0x0; // clear error message
 		moony->error_out = true;
 
-		// stash
+		if(moony->stash_atom) // abort pending apply
+			_moony_stash_free(moony);
+
+		// stash into new VM
 		lua_rawgetp(L, LUA_REGISTRYINDEX, _stash);
-		if(lua_pcall(L, 0, 0, 0))
+		lua_pushlightuserdata(L, vm_new);
+		if(lua_pcall(L, 1, 0, 0))
 			moony_error(moony);
 #ifdef USE_MANUAL_GC
 		lua_gc(L, LUA_GCSTEP, 0);
@@ -2312,7 +3024,7 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 		moony->vm = vm_new;
 		L = moony_current(moony);
 
-		if(moony->state_atom)
+		if(moony->state_atom && !moony->vm->restored)
 		{
 			// restore Lua defined properties
 			lua_rawgetp(L, LUA_REGISTRYINDEX, _restore);
@@ -2323,19 +3035,11 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 #endif
 		}
 
-		// apply stash
-		if(moony->stash_atom) // something has been stashed previously
+		if(vm_new->stash_buf) // preallocated stash buffer not needed
 		{
-			lua_rawgetp(L, LUA_REGISTRYINDEX, _apply);
-			if(lua_pcall(L, 0, 0, 0))
-				moony_error(moony);
-#ifdef USE_MANUAL_GC
-			lua_gc(L, LUA_GCSTEP, 0);
-#endif
-
-			moony_rt_free(vm_old, moony->stash_atom, moony->stash_size);
-			moony->stash_atom = NULL;
-			moony->stash_size = 0;
+			moony_rt_free(vm_new, vm_new->stash_buf, vm_new->stash_size);
+			vm_new->stash_buf = NULL;
+			vm_new->stash_size = 0;
 		}
 
 		{
@@ -2353,7 +3057,18 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 
 		moony->once = true;
 
-		if(ref)
+		// pending property registrations are gone with old VM
+		moony->props_pending = false;
+
+		if(moony->nprops) // only send changed properties upon next registration
+		{
+			// properties of previous code are orphaned until synced again
+			for(uint32_t i = 0; i < MOONY_MAX_PROPS; i++)
+				moony->props[i].gen = 0;
+
+			moony->props_stale = true;
+		}
+		else if(ref)
 			ref = _moony_props_out(moony, 0, forge);
 
 #if defined(BUILD_INLINE_DISP)
@@ -2370,11 +3085,33 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 			memcpy(dst, &fake, tot_size);
 			varchunk_write_advance(moony->to_idisp, tot_size);
 
-			lv2_canvas_idisp_queue_draw(moony->canvas_idisp);
+			moony->idisp_pending = true;
 		}
 #endif
 	}
 
+	// apply stash, potentially spread over multiple periods
+	if(moony->stash_atom) // something has been stashed previously
+	{
+		lua_State *L = moony_current(moony);
+		bool done = true;
+
+		lua_rawgetp(L, LUA_REGISTRYINDEX, _apply);
+		if(lua_pcall(L, 0, 1, 0))
+			moony_error(moony);
+		else
+		{
+			done = lua_toboolean(L, -1);
+			lua_pop(L, 1);
+		}
+#ifdef USE_MANUAL_GC
+		lua_gc(L, LUA_GCSTEP, 0);
+#endif
+
+		if(done)
+			_moony_stash_free(moony);
+	}
+
 	// read control sequence
 	LV2_ATOM_SEQUENCE_FOREACH(control, ev)
 	{
@@ -2388,11 +3125,13 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 			const LV2_Atom_URID *subject = NULL;
 			const LV2_Atom_URID *property = NULL;
 			const LV2_Atom_Int *sequence= NULL;
+			const LV2_Atom_Long *code_hash = NULL;
 
 			lv2_atom_object_get(obj,
 				moony->uris.patch.subject, &subject,
 				moony->uris.patch.property, &property,
 				moony->uris.patch.sequence, &sequence,
+				moony->uris.moony_codeHash, &code_hash,
 				0);
 
 			int32_t sequence_num = 0;
@@ -2409,8 +3148,28 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 			{
 				if(property->body == moony->uris.moony_code)
 				{
-					if(ref)
-						ref = _moony_chunk_out(moony, 0, forge);
+					if(!code_hash || (code_hash->atom.type != moony->forge.Long) )
+					{
+						// plain request, e.g. by host, answer with whole string
+						if(ref)
+							ref = _moony_chunk_whole(moony, 0, forge);
+					}
+					else
+					{
+						moony->code_fragments = true; // UI assembles fragments
+
+						if((uint64_t)code_hash->body == moony->chunk_hash)
+						{
+							// UI already holds chunk, no need to retransmit it
+							if(ref)
+								ref = _moony_chunk_out(moony, 0, forge, true);
+						}
+						else
+						{
+							const uint32_t len = strlen(moony->chunk);
+							_moony_xfer_start(&moony->code_out, len, moony->chunk_hash);
+						}
+					}
 				}
 				else if(property->body == moony->uris.moony_error)
 				{
@@ -2517,17 +3276,17 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 			{
 				if( (property->body == moony->uris.moony_code) && (value->type == forge->String) )
 				{
-					// send code to worker thread
-					const size_t sz = sizeof(moony_job_t) + value->size;
-					moony_job_t *req;
-					if((req = varchunk_write_request(moony->from_dsp, sz)))
-					{
-						req->type = MOONY_JOB_VM_ALLOC;
-						memcpy(req->chunk, LV2_ATOM_BODY_CONST(value), value->size);
+					_moony_chunk_compile(moony, LV2_ATOM_BODY_CONST(value), value->size);
+				}
+				else if( (property->body == moony->uris.moony_code) && (value->type == forge->Tuple) )
+				{
+					moony->code_fragments = true; // UI sends fragments, thus assembles them
 
-						varchunk_write_advance(moony->from_dsp, sz);
-						if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
-							moony_trace(moony, "waking worker failed");
+					// assemble fragments of code
+					if(_moony_xfer_parse(&moony->code_in, moony->code_in_buf, forge,
+						(const LV2_Atom_Tuple *)value) == MOONY_XFER_COMPLETE)
+					{
+						_moony_chunk_compile(moony, moony->code_in_buf, moony->code_in.size + 1);
 					}
 				}
 				else if( (property->body == moony->uris.moony_editorHidden) && (value->type == forge->Bool) )
@@ -2568,11 +3327,45 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 					if(i32->body)
 						moony_err(moony, "user called panic");
 				}
+				else if( (property->body == moony->uris.moony_capture)
+					&& ( (value->type == forge->Path) || (value->type == forge->String) ) )
+				{
+					_moony_capture_stop(moony);
+
+					if(value->size > 1) // start capturing to non-empty path
+					{
+						const size_t sz = sizeof(moony_job_t) + value->size;
+						moony_job_t *req;
+						if((req = varchunk_write_request(moony->from_dsp, sz)))
+						{
+							req->type = MOONY_JOB_CAPTURE_OPEN;
+							memcpy(req->chunk, LV2_ATOM_BODY_CONST(value), value->size);
+
+							varchunk_write_advance(moony->from_dsp, sz);
+							if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+								moony_trace(moony, "waking worker failed");
+						}
+					}
+				}
+				else if( (property->body == moony->uris.moony_profile)
+					&& ( (value->type == forge->Path) || (value->type == forge->String) ) )
+				{
+					_moony_profile_stop(moony);
+
+					if(value->size > 1) // start profiling to non-empty path
+						_moony_profile_start(moony, LV2_ATOM_BODY_CONST(value), value->size - 1, 0);
+				}
 			}
 		}
 	}
 
-	if(moony->error_out)
+	// dispatch responses of worker VM
+	moony_worker_drain(moony);
+
+	ref = _moony_chunk_flush(moony, forge, ref);
+
+	// moony:error is always sent after the whole of moony:code
+	if(moony->error_out && !_moony_xfer_busy(&moony->code_out))
 	{
 		const uint32_t len = strlen(moony->error);
 		if(ref)
@@ -2589,6 +3382,49 @@ moony_in(moony_t *moony, const LV2_Atom_Sequence *control, LV2_Atom_Sequence *no
 	return moony->once;
 }
 
+#if defined(BUILD_INLINE_DISP)
+__realtime static void
+_moony_idisp_flush(moony_t *moony, const LV2_Atom **graphs, unsigned ngraphs)
+{
+	for(unsigned i = 0; i < ngraphs; i++)
+	{
+		const LV2_Atom *value = graphs[i];
+		const uint32_t tot_size = lv2_atom_total_size(value);
+		void *dst;
+
+		if( (dst = varchunk_write_request(moony->to_idisp, tot_size)) )
+		{
+			memcpy(dst, value, tot_size);
+			varchunk_write_advance(moony->to_idisp, tot_size);
+
+			moony->idisp_pending = true;
+		}
+	}
+}
+
+// layer deltas need to be applied in order, but a full graph supersedes all
+// graphs and deltas before it within the same period
+__realtime static unsigned
+_moony_idisp_collect(moony_t *moony, const LV2_Atom **graphs, unsigned ngraphs,
+	const LV2_Atom *value)
+{
+	if(!lv2_canvas_layers_is_delta(&moony->canvas_urid, value->type, value->size,
+		LV2_ATOM_BODY_CONST(value)))
+	{
+		ngraphs = 0;
+	}
+	else if(ngraphs == MOONY_MAX_GRAPHS)
+	{
+		_moony_idisp_flush(moony, graphs, ngraphs);
+		ngraphs = 0;
+	}
+
+	graphs[ngraphs++] = value;
+
+	return ngraphs;
+}
+#endif
+
 __realtime void
 moony_out(moony_t *moony, LV2_Atom_Sequence *notify, uint32_t frames)
 {
@@ -2596,6 +3432,8 @@ moony_out(moony_t *moony, LV2_Atom_Sequence *notify, uint32_t frames)
 	LV2_Atom_Forge_Ref ref = moony->notify_ref;
 	moony_vm_t *vm = moony->vm;
 
+	moony_profile(moony);
+
 	if(moony_bypass(moony)) // discard any written atoms on notify port since moony_in
 	{
 		*forge = moony->notify_snapshot;
@@ -2630,7 +3468,12 @@ moony_out(moony_t *moony, LV2_Atom_Sequence *notify, uint32_t frames)
 	else
 		lv2_atom_sequence_clear(notify);
 
+	moony_sort(moony);
+
 #if defined(BUILD_INLINE_DISP)
+	const LV2_Atom *graphs [MOONY_MAX_GRAPHS];
+	unsigned ngraphs = 0;
+
 	LV2_ATOM_SEQUENCE_FOREACH(notify, ev)
 	{
 		const LV2_Atom_Object *obj = (const LV2_Atom_Object *)&ev->body;
@@ -2664,15 +3507,7 @@ moony_out(moony_t *moony, LV2_Atom_Sequence *notify, uint32_t frames)
 				&& value
 				&& (value->type == forge->Tuple) )
 			{
-				const uint32_t tot_size = lv2_atom_total_size(value);
-				void *dst;
-				if( (dst = varchunk_write_request(moony->to_idisp, tot_size)) )
-				{
-					memcpy(dst, value, tot_size);
-					varchunk_write_advance(moony->to_idisp, tot_size);
-
-					lv2_canvas_idisp_queue_draw(moony->canvas_idisp);
-				}
+				ngraphs = _moony_idisp_collect(moony, graphs, ngraphs, value);
 			}
 		}
 		else if(obj->body.otype == moony->uris.patch.put)
@@ -2703,19 +3538,30 @@ moony_out(moony_t *moony, LV2_Atom_Sequence *notify, uint32_t frames)
 						continue;
 					}
 
-					const uint32_t tot_size = lv2_atom_total_size(value);
-					void *dst;
-					if( (dst = varchunk_write_request(moony->to_idisp, tot_size)) )
-					{
-						memcpy(dst, value, tot_size);
-						varchunk_write_advance(moony->to_idisp, tot_size);
-
-						lv2_canvas_idisp_queue_draw(moony->canvas_idisp);
-					}
+					ngraphs = _moony_idisp_collect(moony, graphs, ngraphs, value);
 				}
 			}
 		}
 	}
+
+	_moony_idisp_flush(moony, graphs, ngraphs);
+
+	// rate limit redraws, the last graph of a period is shown upon next redraw
+	if(moony->idisp_pending)
+	{
+		const double rate = (vm->display_rate > 0.0)
+			? vm->display_rate
+			: MOONY_DISPLAY_RATE;
+		const uint64_t now = moony_nanos();
+
+		if( (now - moony->idisp_last) >= 1e9 / rate)
+		{
+			lv2_canvas_idisp_queue_draw(moony->canvas_idisp);
+
+			moony->idisp_last = now;
+			moony->idisp_pending = false;
+		}
+	}
 #endif
 
 	moony->once = false;
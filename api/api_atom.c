@@ -35,7 +35,7 @@ const lua_CFunction upclosures [MOONY_UPCLOSURE_COUNT] = {
 __realtime static inline void
 _pushupclosure(lua_State *L, moony_t *moony, moony_upclosure_t type, bool cache)
 {
-	int *upc = &moony->upc[type];
+	int *upc = &moony_vm_get(L)->upc[type];
 
 	lua_rawgetp(L, LUA_REGISTRYINDEX, &upclosures[type]); // ref
 	if(lua_rawgeti(L, -1, *upc) == LUA_TNIL) // no cached udata, create one!
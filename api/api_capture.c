@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <api_capture.h>
+
+typedef struct _capture_ctx_t capture_ctx_t;
+
+struct _capture_ctx_t {
+	moony_t *moony;
+	moony_capture_t *capture;
+};
+
+static const uint8_t pad [8] = { 0 };
+
+__non_realtime void
+moony_capture_walk(LV2_Atom *atom, LV2_Atom_Forge *forge,
+	moony_capture_urid_cb_t cb, void *data)
+{
+	cb(data, &atom->type); // may get remapped
+
+	if(atom->type == forge->Object)
+	{
+		LV2_Atom_Object *obj = (LV2_Atom_Object *)atom;
+
+		cb(data, &obj->body.id);
+		cb(data, &obj->body.otype);
+
+		LV2_ATOM_OBJECT_FOREACH(obj, prop)
+		{
+			cb(data, &prop->key);
+			cb(data, &prop->context);
+			moony_capture_walk(&prop->value, forge, cb, data);
+		}
+	}
+	else if(atom->type == forge->Tuple)
+	{
+		LV2_Atom_Tuple *tup = (LV2_Atom_Tuple *)atom;
+
+		LV2_ATOM_TUPLE_FOREACH(tup, item)
+		{
+			moony_capture_walk(item, forge, cb, data);
+		}
+	}
+	else if(atom->type == forge->Sequence)
+	{
+		LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)atom;
+
+		cb(data, &seq->body.unit);
+
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+		{
+			moony_capture_walk(&ev->body, forge, cb, data);
+		}
+	}
+	else if(atom->type == forge->Vector)
+	{
+		LV2_Atom_Vector *vec = (LV2_Atom_Vector *)atom;
+
+		cb(data, &vec->body.child_type);
+
+		if( (vec->body.child_type == forge->URID)
+			&& (vec->body.child_size == sizeof(LV2_URID)) )
+		{
+			LV2_URID *urids = LV2_ATOM_CONTENTS(LV2_Atom_Vector, vec);
+			const uint32_t n = (vec->atom.size - sizeof(LV2_Atom_Vector_Body)) / sizeof(LV2_URID);
+
+			for(uint32_t i = 0; i < n; i++)
+				cb(data, &urids[i]);
+		}
+	}
+	else if(atom->type == forge->URID)
+	{
+		cb(data, &((LV2_Atom_URID *)atom)->body);
+	}
+	else if(atom->type == forge->Literal)
+	{
+		LV2_Atom_Literal *lit = (LV2_Atom_Literal *)atom;
+
+		cb(data, &lit->body.datatype);
+		cb(data, &lit->body.lang);
+	}
+}
+
+__non_realtime static void
+_capture_write(moony_capture_t *capture, moony_capture_type_t type,
+	const void *a, size_t asz, const void *b, size_t bsz)
+{
+	const moony_capture_rec_t rec = {
+		.type = type,
+		.size = asz + bsz
+	};
+
+	fwrite(&rec, sizeof(rec), 1, capture->file);
+	if(asz)
+		fwrite(a, asz, 1, capture->file);
+	if(bsz)
+		fwrite(b, bsz, 1, capture->file);
+	fwrite(pad, lv2_atom_pad_size(rec.size) - rec.size, 1, capture->file);
+}
+
+// write URI of each URID once, ahead of the first record referencing it
+__non_realtime static void
+_capture_urid(void *data, LV2_URID *urid)
+{
+	capture_ctx_t *ctx = data;
+	moony_capture_t *capture = ctx->capture;
+
+	if(*urid == 0)
+		return;
+
+	if(*urid >= capture->nwritten)
+	{
+		size_t nwritten = capture->nwritten ? capture->nwritten : 0x100;
+
+		while(*urid >= nwritten)
+			nwritten <<= 1;
+
+		uint8_t *written = realloc(capture->written, nwritten);
+		if(!written)
+			return;
+
+		memset(&written[capture->nwritten], 0x0, nwritten - capture->nwritten);
+		capture->written = written;
+		capture->nwritten = nwritten;
+	}
+
+	if(capture->written[*urid])
+		return;
+
+	const char *uri = moony_urid_cache_resolve_uri(&ctx->moony->urid_cache, *urid);
+	if(!uri)
+		return;
+
+	_capture_write(capture, MOONY_CAPTURE_URID, urid, sizeof(LV2_URID),
+		uri, strlen(uri) + 1);
+	capture->written[*urid] = 1;
+}
+
+__non_realtime moony_capture_t *
+moony_capture_new(moony_t *moony, const char *path)
+{
+	moony_capture_t *capture = calloc(1, sizeof(moony_capture_t));
+	if(!capture)
+		return NULL;
+
+	capture->rb = varchunk_new(MOONY_CAPTURE_LEN, true);
+	capture->file = fopen(path, "wb");
+	if(!capture->rb || !capture->file)
+	{
+		if(capture->rb)
+			varchunk_free(capture->rb);
+		if(capture->file)
+			fclose(capture->file);
+		free(capture);
+
+		return NULL;
+	}
+
+	fwrite(MOONY_CAPTURE_MAGIC, strlen(MOONY_CAPTURE_MAGIC), 1, capture->file);
+
+	const moony_capture_header_t header = {
+		.version = MOONY_CAPTURE_VERSION,
+		.sample_rate = moony->sample_rate.body
+	};
+	const char *uri = moony_urid_cache_resolve_uri(&moony->urid_cache, moony->uris.patch.self);
+	if(!uri)
+		uri = "";
+
+	_capture_write(capture, MOONY_CAPTURE_HEADER, &header, sizeof(header),
+		uri, strlen(uri) + 1);
+
+	if(moony->chunk_nrt)
+	{
+		_capture_write(capture, MOONY_CAPTURE_CODE, moony->chunk_nrt,
+			strlen(moony->chunk_nrt) + 1, NULL, 0);
+	}
+
+	return capture;
+}
+
+__non_realtime void
+moony_capture_drain(moony_t *moony, moony_capture_t *capture)
+{
+	capture_ctx_t ctx = {
+		.moony = moony,
+		.capture = capture
+	};
+	const moony_capture_rec_t *rec;
+	size_t sz;
+
+	while( (rec = varchunk_read_request(capture->rb, &sz)) )
+	{
+		const moony_capture_period_t *period = (const moony_capture_period_t *)&rec[1];
+		uint8_t *ptr = (uint8_t *)&period[1]
+			+ lv2_atom_pad_size(period->nvals * sizeof(float));
+
+		// control sequence and event input sequences
+		for(unsigned i = 0; i <= period->nseqs; i++)
+		{
+			LV2_Atom *atom = (LV2_Atom *)ptr;
+
+			moony_capture_walk(atom, &moony->forge, _capture_urid, &ctx);
+			ptr += lv2_atom_pad_size(lv2_atom_total_size(atom));
+		}
+
+		fwrite(rec, sz, 1, capture->file);
+
+		varchunk_read_advance(capture->rb);
+	}
+
+	fflush(capture->file);
+}
+
+__non_realtime void
+moony_capture_free(moony_t *moony, moony_capture_t *capture)
+{
+	moony_capture_drain(moony, capture);
+
+	fclose(capture->file);
+	varchunk_free(capture->rb);
+	free(capture->written);
+	free(capture);
+}
+
+__realtime void
+moony_capture(moony_t *moony, uint32_t nsamples, const LV2_Atom_Sequence *control,
+	const float *const *vals, unsigned nvals,
+	const LV2_Atom_Sequence *const *seqs, unsigned nseqs)
+{
+	moony_capture_t *capture = moony->capture;
+
+	if(!capture)
+		return;
+
+	const size_t vals_sz = lv2_atom_pad_size(nvals * sizeof(float));
+	size_t sz = sizeof(moony_capture_rec_t) + sizeof(moony_capture_period_t) + vals_sz
+		+ lv2_atom_pad_size(lv2_atom_total_size(&control->atom));
+
+	for(unsigned i = 0; i < nseqs; i++)
+		sz += lv2_atom_pad_size(lv2_atom_total_size(&seqs[i]->atom));
+
+	uint8_t *buf = varchunk_write_request(capture->rb, sz);
+	if(!buf)
+	{
+		moony_trace(moony, "capture buffer overflow");
+		return;
+	}
+
+	moony_capture_rec_t *rec = (moony_capture_rec_t *)buf;
+	moony_capture_period_t *period = (moony_capture_period_t *)&rec[1];
+	uint8_t *ptr = (uint8_t *)&period[1];
+
+	rec->type = MOONY_CAPTURE_PERIOD;
+	rec->size = sz - sizeof(moony_capture_rec_t);
+	period->nsamples = nsamples;
+	period->nvals = nvals;
+	period->nseqs = nseqs;
+
+	for(unsigned i = 0; i < nvals; i++, ptr += sizeof(float))
+		memcpy(ptr, vals[i], sizeof(float));
+	memset(ptr, 0x0, vals_sz - nvals*sizeof(float));
+	ptr += vals_sz - nvals*sizeof(float);
+
+	for(unsigned i = 0; i <= nseqs; i++)
+	{
+		const LV2_Atom *atom = i == 0
+			? &control->atom
+			: &seqs[i - 1]->atom;
+		const uint32_t atom_sz = lv2_atom_total_size(atom);
+		const uint32_t atom_pad = lv2_atom_pad_size(atom_sz);
+
+		memcpy(ptr, atom, atom_sz);
+		memset(ptr + atom_sz, 0x0, atom_pad - atom_sz);
+		ptr += atom_pad;
+	}
+
+	varchunk_write_advance(capture->rb, sz);
+
+	// let worker write period to file
+	moony_job_t *req;
+	if( (req = varchunk_write_request(moony->from_dsp, sizeof(moony_job_t))) )
+	{
+		req->type = MOONY_JOB_CAPTURE_DRAIN;
+		req->ptr = capture;
+
+		varchunk_write_advance(moony->from_dsp, sizeof(moony_job_t));
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+	}
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_CAPTURE_H
+#define _MOONY_API_CAPTURE_H
+
+#include <moony.h>
+
+/*
+ * capture file layout, all in host byte order:
+ *
+ * MOONY_CAPTURE_MAGIC, followed by records of moony_capture_rec_t headers
+ * with bodies padded to 8 bytes:
+ *
+ * HEADER: moony_capture_header_t, plugin URI
+ * URID:   LV2_URID, URI, written before the first period referencing it
+ * CODE:   script chunk at start of capture
+ * PERIOD: moony_capture_period_t, float values (padded to 8 bytes),
+ *         control sequence, event input sequences
+ *
+ * event files (as read and written by moony_run) share the record layout,
+ * but start with MOONY_SEQUENCE_MAGIC and consist of URID and EVENT
+ * records only:
+ *
+ * EVENT:  moony_capture_event_t, atom
+ */
+
+#define MOONY_CAPTURE_MAGIC "MOONYCAP"
+#define MOONY_SEQUENCE_MAGIC "MOONYSEQ"
+#define MOONY_CAPTURE_VERSION 1
+#define MOONY_CAPTURE_LEN 0x100000 // 1M
+
+typedef enum _moony_capture_type_t moony_capture_type_t;
+typedef struct _moony_capture_rec_t moony_capture_rec_t;
+typedef struct _moony_capture_header_t moony_capture_header_t;
+typedef struct _moony_capture_period_t moony_capture_period_t;
+typedef struct _moony_capture_event_t moony_capture_event_t;
+
+typedef void (*moony_capture_urid_cb_t)(void *data, LV2_URID *urid);
+
+enum _moony_capture_type_t {
+	MOONY_CAPTURE_HEADER = 1,
+	MOONY_CAPTURE_URID,
+	MOONY_CAPTURE_CODE,
+	MOONY_CAPTURE_PERIOD,
+	MOONY_CAPTURE_EVENT
+};
+
+struct _moony_capture_rec_t {
+	uint32_t type;
+	uint32_t size; // of body, unpadded
+};
+
+struct _moony_capture_header_t {
+	uint32_t version;
+	uint32_t pad;
+	double sample_rate;
+	char uri [0];
+};
+
+struct _moony_capture_period_t {
+	uint32_t nsamples;
+	uint16_t nvals;
+	uint16_t nseqs; // without control sequence
+};
+
+struct _moony_capture_event_t {
+	int64_t frames; // absolute
+	uint32_t port; // 0: control/notify, 1..n: event input/output
+	uint32_t pad;
+};
+
+struct _moony_capture_t {
+	varchunk_t *rb; // period records from realtime thread
+
+	FILE *file;
+	uint8_t *written; // URIDs already written to file
+	size_t nwritten;
+};
+
+moony_capture_t *
+moony_capture_new(moony_t *moony, const char *path);
+
+void
+moony_capture_drain(moony_t *moony, moony_capture_t *capture);
+
+void
+moony_capture_free(moony_t *moony, moony_capture_t *capture);
+
+void
+moony_capture_walk(LV2_Atom *atom, LV2_Atom_Forge *forge,
+	moony_capture_urid_cb_t cb, void *data);
+
+#endif
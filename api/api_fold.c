@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <ctype.h>
+
+#include <api_fold.h>
+
+#include <lauxlib.h>
+
+typedef enum _fold_tok_type_t fold_tok_type_t;
+typedef enum _fold_class_t fold_class_t;
+typedef struct _fold_tok_t fold_tok_t;
+typedef struct _fold_lex_t fold_lex_t;
+
+enum _fold_tok_type_t {
+	FOLD_TOK_EOS = 0,
+	FOLD_TOK_NAME,
+	FOLD_TOK_STRING,
+	FOLD_TOK_NUMBER,
+	FOLD_TOK_OP
+};
+
+enum _fold_class_t {
+	FOLD_IGNORE = 0, // not a reference to the global table
+	FOLD_NEUTRAL, // read-only use that cannot be folded
+	FOLD_TAINT, // table may be rebound, aliased or written to
+	FOLD_CONST // constant lookup
+};
+
+struct _fold_tok_t {
+	fold_tok_type_t type;
+	const char *start; // source span
+	const char *stop;
+	const char *str; // name or string contents
+	size_t len;
+	bool plain; // short string without escape sequences
+};
+
+struct _fold_lex_t {
+	const char *ptr;
+	const char *end;
+};
+
+// global tables whose contents are fixed by moony_open
+static const char *fold_tables [] = {
+	"Map",
+	"Atom",
+	"MIDI",
+	"Time",
+	"OSC",
+	"LV2",
+	"Buf_Size",
+	"Patch",
+	"Ui",
+	"RDF",
+	"RDFS",
+	"Units",
+	"Canvas",
+	"Xpress",
+	"Moony",
+	"Param",
+	"Lua",
+	NULL
+};
+
+// globals through which code may rebind the tables behind our back
+static const char *fold_blockers [] = {
+	"_ENV",
+	"_G",
+	"load",
+	"loadstring",
+	"dofile",
+	"require",
+	"debug",
+	NULL
+};
+
+static const char *fold_keywords [] = {
+	"and", "break", "do", "else", "elseif", "end", "false", "for", "function",
+	"goto", "if", "in", "local", "nil", "not", "or", "repeat", "return", "then",
+	"true", "until", "while",
+	NULL
+};
+
+static inline bool
+_fold_is_op(const fold_tok_t *tok, const char *op)
+{
+	const size_t len = strlen(op);
+
+	return (tok->type == FOLD_TOK_OP)
+		&& (tok->len == len)
+		&& !strncmp(tok->str, op, len);
+}
+
+static inline int
+_fold_find(const fold_tok_t *tok, const char **names)
+{
+	if(tok->type != FOLD_TOK_NAME)
+		return -1;
+
+	for(int i = 0; names[i]; i++)
+	{
+		if( (strlen(names[i]) == tok->len) && !strncmp(tok->str, names[i], tok->len) )
+			return i;
+	}
+
+	return -1;
+}
+
+static inline bool
+_fold_is_name(const fold_tok_t *tok, const char *name)
+{
+	return (tok->type == FOLD_TOK_NAME)
+		&& (strlen(name) == tok->len)
+		&& !strncmp(tok->str, name, tok->len);
+}
+
+static inline bool
+_fold_is_open(const fold_tok_t *tok)
+{
+	return _fold_is_op(tok, "(") || _fold_is_op(tok, "[") || _fold_is_op(tok, "{");
+}
+
+static inline bool
+_fold_is_close(const fold_tok_t *tok)
+{
+	return _fold_is_op(tok, ")") || _fold_is_op(tok, "]") || _fold_is_op(tok, "}");
+}
+
+// level of long bracket at ptr, -1 if none
+static int
+_fold_long_level(const char *ptr, const char *end)
+{
+	int level = 0;
+
+	for(ptr++; (ptr < end) && (*ptr == '='); ptr++)
+		level++;
+
+	return ( (ptr < end) && (*ptr == '[') ) ? level : -1;
+}
+
+static const char *
+_fold_long_skip(const char *ptr, const char *end, int level)
+{
+	for( ; ptr < end; ptr++)
+	{
+		if(*ptr != ']')
+			continue;
+
+		const char *close = ptr + 1;
+		int lvl = 0;
+
+		for( ; (close < end) && (*close == '='); close++)
+			lvl++;
+
+		if( (lvl == level) && (close < end) && (*close == ']') )
+			return close + 1;
+	}
+
+	return end;
+}
+
+static void
+_fold_lex_next(fold_lex_t *lex, fold_tok_t *tok)
+{
+	const char *ptr = lex->ptr;
+	const char *end = lex->end;
+
+	// skip white space and comments
+	while(ptr < end)
+	{
+		if(isspace((unsigned char)*ptr))
+		{
+			ptr++;
+		}
+		else if( (ptr[0] == '-') && (ptr + 1 < end) && (ptr[1] == '-') )
+		{
+			int level;
+
+			ptr += 2;
+			if( (ptr < end) && (*ptr == '[') && ((level = _fold_long_level(ptr, end)) >= 0) )
+			{
+				ptr = _fold_long_skip(ptr + level + 2, end, level);
+			}
+			else
+			{
+				while( (ptr < end) && (*ptr != '\n') )
+					ptr++;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	const char *start = ptr;
+	int level;
+
+	tok->start = start;
+	tok->str = start;
+	tok->plain = false;
+
+	if(ptr >= end)
+	{
+		tok->type = FOLD_TOK_EOS;
+		ptr = end;
+	}
+	else if(isalpha((unsigned char)*ptr) || (*ptr == '_'))
+	{
+		while( (ptr < end) && (isalnum((unsigned char)*ptr) || (*ptr == '_')) )
+			ptr++;
+
+		tok->type = FOLD_TOK_NAME;
+	}
+	else if(isdigit((unsigned char)*ptr)
+		|| ( (*ptr == '.') && (ptr + 1 < end) && isdigit((unsigned char)ptr[1]) ) )
+	{
+		const bool hex = (ptr[0] == '0') && (ptr + 1 < end)
+			&& ( (ptr[1] == 'x') || (ptr[1] == 'X') );
+		const char e1 = hex ? 'p' : 'e';
+		const char e2 = hex ? 'P' : 'E';
+
+		for(ptr++; ptr < end; ptr++)
+		{
+			if( ( (*ptr == e1) || (*ptr == e2) )
+				&& (ptr + 1 < end) && ( (ptr[1] == '+') || (ptr[1] == '-') ) )
+			{
+				ptr++;
+			}
+			else if(!isalnum((unsigned char)*ptr) && (*ptr != '.'))
+			{
+				break;
+			}
+		}
+
+		tok->type = FOLD_TOK_NUMBER;
+	}
+	else if( (*ptr == '"') || (*ptr == '\'') )
+	{
+		const char quote = *ptr;
+		bool plain = true;
+
+		for(ptr++; (ptr < end) && (*ptr != quote); ptr++)
+		{
+			if(*ptr == '\\')
+			{
+				plain = false;
+				ptr++;
+			}
+			else if(*ptr == '\n')
+			{
+				break; // unfinished string
+			}
+		}
+
+		if(ptr > end)
+			ptr = end;
+
+		tok->type = FOLD_TOK_STRING;
+		tok->str = start + 1;
+		tok->len = ptr - tok->str;
+		tok->plain = plain && (ptr < end) && (*ptr == quote);
+
+		if( (ptr < end) && (*ptr == quote) )
+			ptr++;
+	}
+	else if( (*ptr == '[') && ((level = _fold_long_level(ptr, end)) >= 0) )
+	{
+		ptr = _fold_long_skip(ptr + level + 2, end, level);
+
+		tok->type = FOLD_TOK_STRING;
+	}
+	else
+	{
+		static const char *ops [] = {
+			"...", "==", "~=", "<=", ">=", "//", "::", "<<", ">>", "..", NULL
+		};
+
+		tok->type = FOLD_TOK_OP;
+
+		size_t len = 1;
+		for(const char **op = ops; *op; op++)
+		{
+			const size_t sz = strlen(*op);
+
+			if( (ptr + sz <= end) && !strncmp(ptr, *op, sz) )
+			{
+				len = sz;
+				break;
+			}
+		}
+
+		ptr += len;
+	}
+
+	tok->stop = ptr;
+	if(tok->type != FOLD_TOK_STRING)
+		tok->len = ptr - start;
+
+	lex->ptr = ptr;
+}
+
+// whether the expression ending before tok is an assignment target
+static bool
+_fold_is_target(fold_lex_t lex, const fold_tok_t *tok)
+{
+	if(_fold_is_op(tok, "="))
+		return true;
+
+	if(!_fold_is_op(tok, ","))
+		return false;
+
+	// walk a potential target list up to its '='
+	fold_tok_t prev = *tok;
+	fold_tok_t nxt;
+	unsigned depth = 0;
+
+	for(_fold_lex_next(&lex, &nxt); nxt.type != FOLD_TOK_EOS; prev = nxt, _fold_lex_next(&lex, &nxt))
+	{
+		if(_fold_is_open(&nxt))
+		{
+			depth++;
+		}
+		else if(_fold_is_close(&nxt))
+		{
+			if(depth == 0)
+				return false;
+
+			depth--;
+		}
+		else if(depth > 0)
+		{
+			continue;
+		}
+		else if(_fold_is_op(&nxt, "="))
+		{
+			return true;
+		}
+		else if(_fold_is_op(&nxt, ",") || _fold_is_op(&nxt, ".") || _fold_is_op(&nxt, ":")
+			|| (nxt.type == FOLD_TOK_STRING) )
+		{
+			continue;
+		}
+		else if( (nxt.type == FOLD_TOK_NAME) && (_fold_find(&nxt, fold_keywords) == -1)
+			&& ( _fold_is_op(&prev, ",") || _fold_is_op(&prev, ".") || _fold_is_op(&prev, ":") ) )
+		{
+			continue;
+		}
+		else
+		{
+			return false; // cannot be part of a target list
+		}
+	}
+
+	return false;
+}
+
+// classifies use of global table name preceded by prev, lex points past name
+static fold_class_t
+_fold_classify(const fold_lex_t *lex, const fold_tok_t *prev, fold_tok_t *key,
+	const char **stop)
+{
+	if(_fold_is_op(prev, ".") || _fold_is_op(prev, ":") || _fold_is_op(prev, "::")
+		|| _fold_is_name(prev, "goto") )
+	{
+		return FOLD_IGNORE;
+	}
+
+	if(_fold_is_name(prev, "local") || _fold_is_name(prev, "function")
+		|| _fold_is_name(prev, "for") )
+	{
+		return FOLD_TAINT;
+	}
+
+	fold_lex_t lx = *lex;
+	fold_tok_t tok;
+	fold_tok_t tail;
+
+	_fold_lex_next(&lx, &tok);
+	if(_fold_is_op(&tok, "."))
+	{
+		_fold_lex_next(&lx, key);
+		if(key->type != FOLD_TOK_NAME)
+			return FOLD_TAINT;
+
+		*stop = key->stop;
+	}
+	else if(_fold_is_op(&tok, "["))
+	{
+		const fold_lex_t bracket = lx;
+
+		_fold_lex_next(&lx, key);
+		_fold_lex_next(&lx, &tok);
+		if( (key->type == FOLD_TOK_STRING) && key->plain && _fold_is_op(&tok, "]") )
+		{
+			*stop = tok.stop;
+		}
+		else
+		{
+			// skip dynamic key
+			unsigned depth = 1;
+
+			lx = bracket;
+			for(_fold_lex_next(&lx, &tok); tok.type != FOLD_TOK_EOS; _fold_lex_next(&lx, &tok))
+			{
+				if(_fold_is_open(&tok))
+					depth++;
+				else if(_fold_is_close(&tok) && (--depth == 0) )
+					break;
+			}
+
+			_fold_lex_next(&lx, &tail);
+			return _fold_is_target(lx, &tail) ? FOLD_TAINT : FOLD_NEUTRAL;
+		}
+	}
+	else if(_fold_is_op(&tok, "(") || _fold_is_op(&tok, "{") || (tok.type == FOLD_TOK_STRING) )
+	{
+		return FOLD_NEUTRAL; // call
+	}
+	else
+	{
+		return FOLD_TAINT;
+	}
+
+	_fold_lex_next(&lx, &tail);
+	if(_fold_is_target(lx, &tail))
+		return FOLD_TAINT;
+
+	// leave calls and indexing of the looked-up value to the runtime
+	if(_fold_is_open(&tail) || (tail.type == FOLD_TOK_STRING)
+		|| _fold_is_op(&tail, ":") || _fold_is_op(&tail, ".") )
+	{
+		return FOLD_NEUTRAL;
+	}
+
+	return FOLD_CONST;
+}
+
+__non_realtime int
+moony_fold(lua_State *L)
+{
+	size_t len;
+	const char *chunk = luaL_checklstring(L, 1, &len);
+	const char *end = chunk + len;
+	const fold_lex_t init = {
+		.ptr = chunk,
+		.end = end
+	};
+	uint32_t tainted = 0;
+	fold_lex_t lex;
+	fold_tok_t prev;
+	fold_tok_t tok;
+	fold_tok_t key;
+	const char *stop;
+
+	for(unsigned i = 0; fold_tables[i]; i++)
+	{
+		const int type = lua_getglobal(L, fold_tables[i]);
+
+		if( (type != LUA_TTABLE) && (type != LUA_TUSERDATA) )
+			tainted |= 1 << i;
+
+		lua_pop(L, 1);
+	}
+
+	// first pass, find tables which are safe to fold
+	lex = init;
+	prev.type = FOLD_TOK_EOS;
+	for(_fold_lex_next(&lex, &tok); tok.type != FOLD_TOK_EOS; prev = tok, _fold_lex_next(&lex, &tok))
+	{
+		if( (_fold_find(&tok, fold_blockers) != -1)
+			&& !_fold_is_op(&prev, ".") && !_fold_is_op(&prev, ":") )
+		{
+			lua_settop(L, 1);
+			lua_pushinteger(L, 0);
+			return 2;
+		}
+
+		const int idx = _fold_find(&tok, fold_tables);
+
+		if( (idx != -1) && (_fold_classify(&lex, &prev, &key, &stop) == FOLD_TAINT) )
+			tainted |= 1 << idx;
+	}
+
+	// second pass, substitute constant lookups
+	luaL_Buffer buf;
+	const char *last = chunk;
+	lua_Integer nfolds = 0;
+
+	luaL_buffinit(L, &buf);
+
+	lex = init;
+	prev.type = FOLD_TOK_EOS;
+	for(_fold_lex_next(&lex, &tok); tok.type != FOLD_TOK_EOS; prev = tok, _fold_lex_next(&lex, &tok))
+	{
+		const int idx = _fold_find(&tok, fold_tables);
+
+		if( (idx == -1) || (tainted & (1 << idx))
+			|| (_fold_classify(&lex, &prev, &key, &stop) != FOLD_CONST) )
+		{
+			continue;
+		}
+
+		lua_getglobal(L, fold_tables[idx]);
+		lua_pushlstring(L, key.str, key.len);
+		lua_gettable(L, -2);
+		const bool isint = lua_isinteger(L, -1);
+		const lua_Integer val = lua_tointeger(L, -1);
+		lua_pop(L, 2);
+
+		if(!isint || (val < 0) )
+			continue;
+
+		// keep following token from merging into the numeral
+		const bool pad = (stop < end)
+			&& (isalnum((unsigned char)*stop) || (*stop == '_') || (*stop == '.'));
+		char num [32];
+
+		snprintf(num, sizeof(num), LUA_INTEGER_FMT"%s", val, pad ? " " : "");
+
+		luaL_addlstring(&buf, last, tok.start - last);
+		luaL_addstring(&buf, num);
+		last = stop;
+		nfolds++;
+
+		// continue after folded expression
+		lex.ptr = stop;
+		tok.type = FOLD_TOK_NUMBER;
+		tok.str = tok.start;
+		tok.stop = stop;
+	}
+
+	luaL_addlstring(&buf, last, end - last);
+	luaL_pushresult(&buf);
+	lua_pushinteger(L, nfolds);
+
+	return 2;
+}
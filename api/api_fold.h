@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_FOLD_H
+#define _MOONY_API_FOLD_H
+
+#include <moony.h>
+
+// replaces constant lookups into the URID tables of a freshly opened VM
+// (e.g. Atom.Int, Map['http://...']) with integer literals,
+// expects source at stack index 1, returns folded source and number of folds
+int
+moony_fold(lua_State *L);
+
+#endif
@@ -36,10 +36,30 @@ _lforge_pop_inlined(lua_State *L, lforge_t *lforge)
 	lforge->depth = 0; // reset depth
 }
 
+// whether current sequence of forge has been flagged to be sorted at the
+// end of the period
+__realtime bool
+_lforge_unsorted(moony_vm_t *vm, lforge_t *lforge)
+{
+	LV2_Atom_Forge *forge = lforge->forge;
+
+	if(!vm->nunsorted || !forge->stack)
+		return false;
+
+	for(unsigned i = 0; i < vm->nunsorted; i++)
+	{
+		if(  (vm->unsorted[i].forge == forge)
+			&& (vm->unsorted[i].ref == forge->stack->ref) )
+			return true;
+	}
+
+	return false;
+}
+
 __realtime static inline int
 _lforge_frame_time_inlined(lua_State *L, lforge_t *lforge, int64_t frames)
 {
-	if(frames >= lforge->last.frames)
+	if( (frames >= lforge->last.frames) || _lforge_unsorted(moony_vm_get(L), lforge) )
 	{
 		if(!lv2_atom_forge_frame_time(lforge->forge, frames))
 			luaL_error(L, forge_buffer_overflow);
@@ -64,7 +84,7 @@ _lforge_frame_time(lua_State *L)
 __realtime static inline int
 _lforge_beat_time_inlined(lua_State *L, lforge_t *lforge, double beats)
 {
-	if(beats >= lforge->last.beats)
+	if( (beats >= lforge->last.beats) || _lforge_unsorted(moony_vm_get(L), lforge) )
 	{
 		if(!lv2_atom_forge_beat_time(lforge->forge, beats))
 			luaL_error(L, forge_buffer_overflow);
@@ -107,6 +127,40 @@ _lforge_time(lua_State *L)
 	return luaL_error(L, "integer or number expected");
 }
 
+// flag current sequence to be sorted at the end of the period, e.g. for
+// events of multiple voices to be written out of order
+__realtime static int
+_lforge_unsorted_(lua_State *L)
+{
+	moony_vm_t *vm = moony_vm_get(L);
+	lforge_t *lforge = lua_touserdata(L, 1);
+	LV2_Atom_Forge *forge = lforge->forge;
+
+	// port buffers and stashes keep their sequences until sorted
+	if(!forge->buf && !_lstash_forge(forge))
+		return luaL_error(L, "unsorted: neither writing to a port nor a stash");
+
+	const LV2_Atom *seq = forge->stack
+		? lv2_atom_forge_deref(forge, forge->stack->ref)
+		: NULL;
+
+	if(!seq || (seq->type != forge->Sequence) )
+		return luaL_error(L, "unsorted: not writing to a sequence");
+
+	if(!_lforge_unsorted(vm, lforge))
+	{
+		if(vm->nunsorted >= MOONY_MAX_UNSORTED)
+			return luaL_error(L, "unsorted: too many sequences");
+
+		vm->unsorted[vm->nunsorted].forge = forge;
+		vm->unsorted[vm->nunsorted].ref = forge->stack->ref;
+		vm->nunsorted++;
+	}
+
+	lua_settop(L, 1);
+	return 1;
+}
+
 __realtime static int
 _lforge_atom(lua_State *L)
 {
@@ -1583,6 +1637,30 @@ _lforge_canvas_poly_line(lua_State *L)
 {
 	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
 	lforge_t *lforge = lua_touserdata(L, 1);
+	LV2_Atom_Forge *forge = lforge->forge;
+
+	if( (lua_gettop(L) == 2) && luaL_testudata(L, 2, "latom") ) // float vector
+	{
+		latom_t *latom = lua_touserdata(L, 2);
+
+		if( (latom->atom->type != forge->Vector)
+			|| (latom->body.vec->child_type != forge->Float)
+			|| (latom->body.vec->child_size != sizeof(float)) )
+		{
+			luaL_error(L, "polyLine: expected Atom:Vector of Atom:Float");
+		}
+
+		// forge coordinates in one go, without conversion to Lua numbers
+		const uint32_t nvec = (latom->atom->size - sizeof(LV2_Atom_Vector_Body))
+			/ sizeof(float);
+		const float *vec = (const float *)(latom->body.vec + 1);
+
+		if(!lv2_canvas_forge_polyLine(forge, &moony->canvas_urid, nvec, vec) )
+			luaL_error(L, forge_buffer_overflow);
+
+		lua_settop(L, 1);
+		return 1;
+	}
 
 	const uint32_t nvec = lua_gettop(L) - 1;
 	float *vec = alloca(sizeof(float) * nvec); //FIXME add floats one at a time
@@ -1593,7 +1671,7 @@ _lforge_canvas_poly_line(lua_State *L)
 		vec[pos] = luaL_checknumber(L, 2 + pos);
 	}
 
-	if(!lv2_canvas_forge_polyLine(lforge->forge, &moony->canvas_urid, nvec, vec) )
+	if(!lv2_canvas_forge_polyLine(forge, &moony->canvas_urid, nvec, vec) )
 		luaL_error(L, forge_buffer_overflow);
 
 	lua_settop(L, 1);
@@ -1854,6 +1932,26 @@ _lforge_canvas_fill_text(lua_State *L)
 	return 1;
 }
 
+__realtime static int
+_lforge_canvas_layer(lua_State *L)
+{
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	lforge_t *lforge = lua_touserdata(L, 1);
+	const int32_t key = luaL_checkinteger(L, 2);
+	lforge_t *lframe = moony_newuserdata(L, moony, MOONY_UDATA_FORGE, lforge->lheader.cache);
+	lframe->depth = 2;
+	lframe->last.frames = lforge->last.frames;
+	lframe->forge = lforge->forge;
+
+	lua_pushvalue(L, 1); // lforge
+	lua_setuservalue(L, -2); // store parent as uservalue
+
+	if(!lv2_canvas_forge_layer_head(lforge->forge, &moony->canvas_urid, lframe->frame, key))
+		luaL_error(L, forge_buffer_overflow);
+
+	return 1; // derived forge
+}
+
 __realtime static int
 _lforge_xpress_token(lua_State *L)
 {
@@ -2080,6 +2178,7 @@ const luaL_Reg lforge_mt [] = {
 	{"frameTime", _lforge_frame_time},
 	{"beatTime", _lforge_beat_time},
 	{"time", _lforge_time},
+	{"unsorted", _lforge_unsorted_},
 
 	// OSC
 	{"bundle", _lforge_osc_bundle},
@@ -2130,6 +2229,7 @@ const luaL_Reg lforge_mt [] = {
 	{"reset", _lforge_canvas_reset},
 	{"fontSize", _lforge_canvas_font_size},
 	{"fillText", _lforge_canvas_fill_text},
+	{"layer", _lforge_canvas_layer},
 
 	// xpress
 	{"token", _lforge_xpress_token},
@@ -2148,4 +2248,144 @@ const luaL_Reg lforge_mt [] = {
 	{NULL, NULL}
 };
 
+typedef struct _lforge_event_t lforge_event_t;
+
+struct _lforge_event_t {
+	union {
+		int64_t frames;
+		double beats;
+	};
+	uint32_t offset;
+	uint32_t size;
+};
+
+__realtime static inline bool
+_lforge_event_less(const lforge_event_t *a, const lforge_event_t *b, bool beats)
+{
+	return beats
+		? a->beats < b->beats
+		: a->frames < b->frames;
+}
+
+// stable sort of sequence events by time via bottom-up merge sort
+__realtime static void
+_lforge_sort(moony_t *moony, moony_vm_t *vm, LV2_Atom_Sequence *seq)
+{
+	const bool beats = seq->body.unit == moony->uris.atom_beat_time;
+	const uint32_t body_size = seq->atom.size - sizeof(LV2_Atom_Sequence_Body);
+	uint32_t nevents = 0;
+	bool sorted = true;
+	const LV2_Atom_Event *prev = NULL;
+
+	LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+	{
+		if(prev && (beats
+				? ev->time.beats < prev->time.beats
+				: ev->time.frames < prev->time.frames) )
+			sorted = false;
+
+		prev = ev;
+		nevents++;
+	}
+
+	if(sorted)
+		return;
+
+	const size_t sz = 2*nevents*sizeof(lforge_event_t) + body_size;
+	void *mem = moony_rt_alloc(vm, sz);
+	if(!mem)
+	{
+		moony_trace(moony, "unsorted: sorting failed");
+		return;
+	}
+	lforge_event_t *events = mem;
+	lforge_event_t *tmp = &events[nevents];
+	uint8_t *body = (uint8_t *)&tmp[nevents];
+	uint8_t *base = (uint8_t *)LV2_ATOM_CONTENTS(LV2_Atom_Sequence, seq);
+
+	lforge_event_t *itm = events;
+	LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+	{
+		const uint32_t offset = (const uint8_t *)ev - base;
+		const uint32_t size = lv2_atom_pad_size(sizeof(LV2_Atom_Event) + ev->body.size);
+
+		if(beats)
+			itm->beats = ev->time.beats;
+		else
+			itm->frames = ev->time.frames;
+		itm->offset = offset;
+		itm->size = offset + size <= body_size ? size : body_size - offset;
+		itm++;
+	}
+
+	for(uint32_t width = 1; width < nevents; width <<= 1)
+	{
+		for(uint32_t lo = 0; lo < nevents; lo += 2*width)
+		{
+			const uint32_t mid = lo + width < nevents ? lo + width : nevents;
+			const uint32_t hi = lo + 2*width < nevents ? lo + 2*width : nevents;
+			uint32_t i = lo;
+			uint32_t j = mid;
+
+			for(uint32_t k = lo; k < hi; k++)
+			{
+				// take from right run only if strictly earlier to keep order stable
+				if( (j < hi) && ( (i >= mid) || _lforge_event_less(&events[j], &events[i], beats) ) )
+					tmp[k] = events[j++];
+				else
+					tmp[k] = events[i++];
+			}
+		}
+
+		lforge_event_t *swap = events;
+		events = tmp;
+		tmp = swap;
+	}
+
+	uint32_t offset = 0;
+	for(uint32_t i = 0; i < nevents; i++)
+	{
+		memcpy(&body[offset], &base[events[i].offset], events[i].size);
+		offset += events[i].size;
+	}
+	memcpy(base, body, offset);
+	seq->atom.size = sizeof(LV2_Atom_Sequence_Body) + offset;
+
+	moony_rt_free(vm, mem, sz);
+}
+
+// sort and/or forget flagged sequences of VM of given forge or of all forges
+__realtime void
+_lforge_unsorted_flush(moony_t *moony, moony_vm_t *vm, LV2_Atom_Forge *forge,
+	bool sort)
+{
+	unsigned j = 0;
+
+	for(unsigned i = 0; i < vm->nunsorted; i++)
+	{
+		if(forge && (vm->unsorted[i].forge != forge) )
+		{
+			vm->unsorted[j++] = vm->unsorted[i];
+			continue;
+		}
+
+		if(sort)
+		{
+			LV2_Atom_Forge *src = vm->unsorted[i].forge;
+
+			_lforge_sort(moony, vm, (LV2_Atom_Sequence *)lv2_atom_forge_deref(src,
+				vm->unsorted[i].ref));
+		}
+	}
+
+	vm->nunsorted = j;
+}
+
+// sort sequences flagged as unsorted during this period
+__realtime void
+moony_sort(moony_t *moony)
+{
+	_lforge_unsorted_flush(moony, moony->vm, NULL, true);
+}
+
 const char *forge_buffer_overflow = "forge buffer overflow";
@@ -48,6 +48,13 @@ _lforge_basic(lua_State *L, int pos, LV2_Atom_Forge *forge,
 int
 _lforge_autopop_itr(lua_State *L);
 
+bool
+_lforge_unsorted(moony_vm_t *vm, lforge_t *lforge);
+
+void
+_lforge_unsorted_flush(moony_t *moony, moony_vm_t *vm, LV2_Atom_Forge *forge,
+	bool sort);
+
 extern const char *forge_buffer_overflow;
 
 extern const luaL_Reg lforge_mt [];
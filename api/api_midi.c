@@ -71,7 +71,7 @@ _lmidiresponder__call(lua_State *L)
 		const int64_t frames = luaL_checkinteger(L, 2);
 		lforge_t *lforge = luaL_checkudata(L, 3, "lforge");
 
-		if(frames < lforge->last.frames)
+		if( (frames < lforge->last.frames) && !_lforge_unsorted(moony_vm_get(L), lforge) )
 			luaL_error(L, "invalid frame time, must not decrease");
 		lforge->last.frames = frames;
 
@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <inttypes.h>
+#include <limits.h>
+
+#include <api_profile.h>
+#include <api_vm.h>
+
+// append single frame as 'name:line', sources other than the script chunk
+// itself are prepended and the frame separator ';' is masked in them
+__realtime static size_t
+_profile_frame(char *dst, size_t len, const lua_Debug *ar)
+{
+	int n;
+
+	if(*ar->what == 'C')
+		n = snprintf(dst, len, "%s", ar->name ? ar->name : "[C]");
+	else if(*ar->what == 'm')
+		n = snprintf(dst, len, "main");
+	else if( (*ar->source == '=') || (*ar->source == '@') )
+		n = snprintf(dst, len, "%s:%s:%d", ar->short_src, ar->name ? ar->name : "function", ar->linedefined);
+	else
+		n = snprintf(dst, len, "%s:%d", ar->name ? ar->name : "function", ar->linedefined);
+
+	if(n < 0)
+		return 0;
+
+	const size_t sz = (size_t)n < len ? (size_t)n : len - 1;
+	for(size_t i = 0; i < sz; i++)
+	{
+		if(dst[i] == ';')
+			dst[i] = ',';
+	}
+
+	return sz;
+}
+
+// sample call stack of running VM every profile->count instructions
+__realtime static void
+_profile_hook(lua_State *L, lua_Debug *ar __attribute__((unused)))
+{
+	void *data;
+	lua_getallocf(L, &data);
+	moony_vm_t *vm = data;
+	moony_t *moony = vm->data;
+	moony_profile_t *profile = moony->profile;
+
+	// raise pending strict mode violation at next instruction
+	if(vm->allocs.violated)
+	{
+		const moony_vm_site_t *site = &vm->allocs.violation;
+
+		vm->allocs.violated = false;
+		vm->allocs.strict = false; // report first violation only
+		lua_sethook(L, NULL, 0, 0);
+
+		if(site->line < 0)
+			lua_pushfstring(L, "%s: strict: %d bytes allocated after warm-up",
+				site->src, (int)site->bytes);
+		else
+			lua_pushfstring(L, "%s%s%d: strict: %d bytes allocated after warm-up",
+				site->src, *site->src ? ":" : "", site->line, (int)site->bytes);
+		lua_error(L);
+	}
+
+	if(!profile || !profile->armed)
+		return;
+
+	lua_Debug frames [MOONY_PROFILE_DEPTH];
+	int depth;
+
+	for(depth = 0; depth < MOONY_PROFILE_DEPTH; depth++)
+	{
+		if(!lua_getstack(L, depth, &frames[depth]))
+			break;
+
+		lua_getinfo(L, "Sn", &frames[depth]);
+	}
+
+	if(depth == 0)
+		return;
+
+	char stack [MOONY_PROFILE_STACK_LEN];
+	size_t len = 0;
+
+	// mark stacks deeper than we sample
+	lua_Debug probe;
+	if( (depth == MOONY_PROFILE_DEPTH) && lua_getstack(L, depth, &probe) )
+		len = snprintf(stack, sizeof(stack), "[truncated]");
+
+	// fold from outermost to innermost frame
+	for(int i = depth - 1; i >= 0; i--)
+	{
+		if(len + 2 >= sizeof(stack))
+			break;
+
+		if(len)
+			stack[len++] = ';';
+		len += _profile_frame(&stack[len], sizeof(stack) - len, &frames[i]);
+	}
+
+	char *dst;
+	if( (dst = varchunk_write_request(profile->rb, len + 1)) )
+	{
+		memcpy(dst, stack, len);
+		dst[len] = '\0';
+
+		varchunk_write_advance(profile->rb, len + 1);
+		profile->pending = true;
+	}
+	else
+	{
+		profile->ndropped++;
+	}
+}
+
+// FNV-1a
+__non_realtime static uint32_t
+_profile_hash(const char *str)
+{
+	uint32_t hash = 0x811c9dc5;
+
+	for( ; *str; str++)
+		hash = (hash ^ (uint8_t)*str) * 0x01000193;
+
+	return hash;
+}
+
+__non_realtime static moony_profile_stack_t *
+_profile_lookup(moony_profile_stack_t *stacks, size_t mstacks, const char *stack)
+{
+	for(size_t i = _profile_hash(stack) & (mstacks - 1); ; i = (i + 1) & (mstacks - 1))
+	{
+		moony_profile_stack_t *itm = &stacks[i];
+
+		if(!itm->stack || !strcmp(itm->stack, stack))
+			return itm;
+	}
+}
+
+__non_realtime static int
+_profile_grow(moony_profile_t *profile)
+{
+	const size_t mstacks = profile->mstacks ? profile->mstacks << 1 : 0x100;
+	moony_profile_stack_t *stacks = calloc(mstacks, sizeof(moony_profile_stack_t));
+	if(!stacks)
+		return -1;
+
+	for(size_t i = 0; i < profile->mstacks; i++)
+	{
+		const moony_profile_stack_t *src = &profile->stacks[i];
+
+		if(src->stack)
+			*_profile_lookup(stacks, mstacks, src->stack) = *src;
+	}
+
+	free(profile->stacks);
+	profile->stacks = stacks;
+	profile->mstacks = mstacks;
+
+	return 0;
+}
+
+__non_realtime moony_profile_t *
+moony_profile_new(moony_t *moony __attribute__((unused)), const char *path, int count)
+{
+	moony_profile_t *profile = calloc(1, sizeof(moony_profile_t));
+	if(!profile)
+		return NULL;
+
+	profile->count = count > 0 ? count : MOONY_PROFILE_COUNT;
+	profile->seed = 0x9e3779b9;
+	profile->rb = varchunk_new(MOONY_PROFILE_LEN, true);
+	profile->file = fopen(path, "w");
+	profile->path = strdup(path);
+	if(!profile->rb || !profile->file || !profile->path || _profile_grow(profile))
+	{
+		if(profile->rb)
+			varchunk_free(profile->rb);
+		if(profile->file)
+			fclose(profile->file);
+		free(profile->path);
+		free(profile->stacks);
+		free(profile);
+
+		return NULL;
+	}
+
+	return profile;
+}
+
+// aggregate samples of realtime thread
+__non_realtime void
+moony_profile_drain(moony_t *moony __attribute__((unused)), moony_profile_t *profile)
+{
+	const char *stack;
+	size_t sz;
+
+	while( (stack = varchunk_read_request(profile->rb, &sz)) )
+	{
+		// keep load factor below 1/2
+		if( (2*(profile->nstacks + 1) > profile->mstacks) && _profile_grow(profile) )
+			break;
+
+		moony_profile_stack_t *itm = _profile_lookup(profile->stacks, profile->mstacks, stack);
+
+		if(!itm->stack)
+		{
+			itm->stack = strdup(stack);
+			if(!itm->stack)
+				break;
+
+			profile->nstacks++;
+		}
+
+		itm->count++;
+		profile->nsamples++;
+
+		varchunk_read_advance(profile->rb);
+	}
+}
+
+// write folded stacks as understood by flame graph tools and free
+__non_realtime void
+moony_profile_free(moony_t *moony, moony_profile_t *profile)
+{
+	moony_profile_drain(moony, profile);
+
+	for(size_t i = 0; i < profile->mstacks; i++)
+	{
+		moony_profile_stack_t *itm = &profile->stacks[i];
+
+		if(!itm->stack)
+			continue;
+
+		fprintf(profile->file, "%s %"PRIu64"\n", itm->stack, itm->count);
+		free(itm->stack);
+	}
+
+	fclose(profile->file);
+
+	if(moony->log)
+	{
+		lv2_log_note(&moony->logger, "profile: %"PRIu64" samples in %zu stacks written to '%s' (%"PRIu64" dropped)\n",
+			profile->nsamples, profile->nstacks, profile->path, profile->ndropped);
+	}
+
+	varchunk_free(profile->rb);
+	free(profile->stacks);
+	free(profile->path);
+	free(profile);
+}
+
+// xorshift32
+__realtime static uint32_t
+_profile_rand(moony_profile_t *profile)
+{
+	uint32_t x = profile->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	return profile->seed = x;
+}
+
+// attribute allocation to the innermost Lua line of the running VM,
+// allocations in coroutines are attributed to their resume call site
+__realtime void
+moony_profile_alloc(moony_vm_t *vm, size_t size)
+{
+	lua_State *L = vm->L;
+
+	if(!L || vm->nrt) // only account for allocations in rt-thread
+		return;
+
+	moony_vm_site_t site = {
+		.src = "[C]",
+		.line = -1,
+		.count = 1,
+		.bytes = size
+	};
+
+	lua_Debug ar;
+	for(int level = 0; lua_getstack(L, level, &ar); level++)
+	{
+		lua_getinfo(L, "Sl", &ar);
+
+		if(ar.currentline < 0)
+			continue;
+
+		// omit script chunk name, it's always the same
+		if( (*ar.source == '=') || (*ar.source == '@') )
+			snprintf(site.src, sizeof(site.src), "%s", ar.short_src);
+		else
+			site.src[0] = '\0';
+		site.line = ar.currentline;
+		break;
+	}
+
+	vm->allocs.count++;
+	vm->allocs.bytes += size;
+
+	if(vm->allocs.report)
+	{
+		moony_vm_site_t *itm = NULL;
+
+		for(unsigned i = 0; i < vm->allocs.nsites; i++)
+		{
+			if( (vm->allocs.sites[i].line == site.line)
+				&& !strcmp(vm->allocs.sites[i].src, site.src) )
+			{
+				itm = &vm->allocs.sites[i];
+				break;
+			}
+		}
+
+		if(!itm && (vm->allocs.nsites < MOONY_MAX_SITES - 1) )
+		{
+			itm = &vm->allocs.sites[vm->allocs.nsites++];
+			*itm = site;
+			itm->count = 0;
+			itm->bytes = 0;
+		}
+		else if(!itm) // last slot collects all remaining sites
+		{
+			itm = &vm->allocs.sites[MOONY_MAX_SITES - 1];
+			if(vm->allocs.nsites < MOONY_MAX_SITES)
+			{
+				vm->allocs.nsites = MOONY_MAX_SITES;
+				snprintf(itm->src, sizeof(itm->src), "[other]");
+				itm->line = -1;
+				itm->count = 0;
+				itm->bytes = 0;
+			}
+		}
+
+		itm->count++;
+		itm->bytes += size;
+	}
+
+	// raise error via hook, as we must not longjmp out of the allocator
+	if(vm->allocs.strict && (vm->allocs.warmup == 0) && !vm->allocs.violated)
+	{
+		vm->allocs.violation = site;
+		vm->allocs.violated = true;
+		lua_sethook(L, _profile_hook, LUA_MASKCOUNT, 1);
+	}
+}
+
+// log and trace top allocation sites of this period
+__realtime static void
+_profile_allocs_report(moony_t *moony, moony_vm_t *vm)
+{
+	char msg [MOONY_MAX_SITE_LEN*8];
+	int len = snprintf(msg, sizeof(msg), "allocs: %"PRIu64" (%zu bytes)",
+		vm->allocs.count, vm->allocs.bytes);
+
+	for(unsigned i = 0; (i < vm->allocs.nsites) && (i < 3); i++)
+	{
+		// partial selection sort, descending by count
+		for(unsigned j = i + 1; j < vm->allocs.nsites; j++)
+		{
+			if(vm->allocs.sites[j].count > vm->allocs.sites[i].count)
+			{
+				const moony_vm_site_t tmp = vm->allocs.sites[i];
+				vm->allocs.sites[i] = vm->allocs.sites[j];
+				vm->allocs.sites[j] = tmp;
+			}
+		}
+
+		const moony_vm_site_t *site = &vm->allocs.sites[i];
+
+		if( (len < 0) || ((size_t)len >= sizeof(msg)) )
+			break;
+
+		if(site->line < 0) // C or other sites
+			len += snprintf(&msg[len], sizeof(msg) - len, "%s %s x%"PRIu32" (%zu bytes)",
+				i == 0 ? ":" : ",", site->src, site->count, site->bytes);
+		else
+			len += snprintf(&msg[len], sizeof(msg) - len, "%s %s%s%d x%"PRIu32" (%zu bytes)",
+				i == 0 ? ":" : ",", site->src, *site->src ? ":" : "",
+				site->line, site->count, site->bytes);
+	}
+
+	if( (len < 0) || ((size_t)len >= sizeof(msg)) )
+		len = sizeof(msg) - 1;
+
+	if(moony->log)
+		lv2_log_trace(&moony->logger, "%s\n", msg);
+
+	// feedback to UI
+	if(!vm->trace_overflow)
+	{
+		const size_t sz = strlen(vm->trace);
+		if(sz + len + 2 < MOONY_MAX_TRACE_LEN)
+		{
+			char *end = vm->trace + sz; // end of string
+			snprintf(end, len + 2, "%s\n", msg);
+			vm->trace_out = true; // set flag
+		}
+		else
+			vm->trace_overflow = true;
+	}
+}
+
+// (un)hook current VM for next period and let worker aggregate samples of
+// this period. As long as a count hook is set, the VM traps on every
+// instruction, so only randomly chosen periods are sampled to keep
+// overhead low without aliasing with periodic script behaviour.
+// Allocation tracking keeps a dormant hook for the VM to save the program
+// counter on every instruction, it needs accurate line information.
+__realtime void
+moony_profile(moony_t *moony)
+{
+	moony_profile_t *profile = moony->profile;
+	moony_vm_t *vm = moony->vm;
+	lua_State *L = moony_current(moony);
+	const bool hooked = lua_gethook(L) == _profile_hook;
+	const bool tracking = vm->allocs.report || vm->allocs.strict;
+
+	if(profile)
+		profile->armed = _profile_rand(profile) % MOONY_PROFILE_DUTY == 0;
+
+	const int count = (profile && profile->armed)
+		? profile->count
+		: (tracking ? INT_MAX : 0);
+
+	if(vm->allocs.violated)
+		; // keep trapping until violation is raised
+	else if(count && (!hooked || (lua_gethookcount(L) != count)) )
+		lua_sethook(L, _profile_hook, LUA_MASKCOUNT, count);
+	else if(!count && hooked)
+		lua_sethook(L, NULL, 0, 0);
+
+	if(vm->allocs.report && vm->allocs.count)
+		_profile_allocs_report(moony, vm);
+
+	if(vm->allocs.warmup)
+		vm->allocs.warmup--;
+	vm->allocs.count = 0;
+	vm->allocs.bytes = 0;
+	vm->allocs.nsites = 0;
+
+	if(!profile || !profile->pending)
+		return;
+
+	moony_job_t *req;
+	if( (req = varchunk_write_request(moony->from_dsp, sizeof(moony_job_t))) )
+	{
+		req->type = MOONY_JOB_PROFILE_DRAIN;
+		req->ptr = profile;
+
+		varchunk_write_advance(moony->from_dsp, sizeof(moony_job_t));
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+
+		profile->pending = false;
+	}
+}
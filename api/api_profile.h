@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_PROFILE_H
+#define _MOONY_API_PROFILE_H
+
+#include <moony.h>
+
+#define MOONY_PROFILE_LEN 0x40000 // 256K
+#define MOONY_PROFILE_COUNT 1000 // default VM instructions between samples
+#define MOONY_PROFILE_DUTY 16 // on average, every n-th period is sampled
+#define MOONY_PROFILE_DEPTH 32 // max stack frames per sample
+#define MOONY_PROFILE_STACK_LEN 0x800 // 2K, max folded stack length
+
+typedef struct _moony_profile_stack_t moony_profile_stack_t;
+
+struct _moony_profile_stack_t {
+	char *stack;
+	uint64_t count;
+};
+
+struct _moony_profile_t {
+	varchunk_t *rb; // folded stacks from realtime thread
+	int count;
+	uint32_t seed;
+	bool armed; // sample current period
+	bool pending; // samples written since last drain request
+	uint64_t ndropped;
+
+	FILE *file;
+	char *path;
+	moony_profile_stack_t *stacks; // open addressing
+	size_t nstacks;
+	size_t mstacks;
+	uint64_t nsamples;
+};
+
+moony_profile_t *
+moony_profile_new(moony_t *moony, const char *path, int count);
+
+void
+moony_profile_drain(moony_t *moony, moony_profile_t *profile);
+
+void
+moony_profile_free(moony_t *moony, moony_profile_t *profile);
+
+void
+moony_profile_alloc(moony_vm_t *vm, size_t size);
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <math.h>
+
+#include <api_sched.h>
+#include <api_forge.h>
+
+__realtime static inline LV2_Atom *
+_lsched_atom(lsched_t *lsched, uint32_t slot)
+{
+	return (LV2_Atom *)&lsched->body[(size_t)slot * lsched->size];
+}
+
+__realtime static inline bool
+_lsched_less(lsched_t *lsched, lsched_heap_t *heap, uint32_t a, uint32_t b)
+{
+	const lsched_slot_t *slot_a = &lsched->slots[a];
+	const lsched_slot_t *slot_b = &lsched->slots[b];
+
+	if(heap == &lsched->frames_heap)
+	{
+		if(slot_a->frames != slot_b->frames)
+			return slot_a->frames < slot_b->frames;
+	}
+	else if(slot_a->beats != slot_b->beats)
+	{
+		return slot_a->beats < slot_b->beats;
+	}
+
+	return (int32_t)(slot_a->seq - slot_b->seq) < 0; // wrap-around safe
+}
+
+__realtime static void
+_lsched_heap_push(lsched_t *lsched, lsched_heap_t *heap, uint32_t slot)
+{
+	uint32_t i = heap->n++;
+
+	// sift up
+	while(i > 0)
+	{
+		const uint32_t parent = (i - 1) / 2;
+
+		if(!_lsched_less(lsched, heap, slot, heap->slots[parent]))
+			break;
+
+		heap->slots[i] = heap->slots[parent];
+		i = parent;
+	}
+
+	heap->slots[i] = slot;
+}
+
+__realtime static void
+_lsched_heap_pop(lsched_t *lsched, lsched_heap_t *heap)
+{
+	const uint32_t slot = heap->slots[--heap->n];
+	uint32_t i = 0;
+
+	// sift down
+	while(true)
+	{
+		uint32_t child = 2*i + 1;
+
+		if(child >= heap->n)
+			break;
+
+		if( (child + 1 < heap->n)
+				&& _lsched_less(lsched, heap, heap->slots[child + 1], heap->slots[child]) )
+			child += 1;
+
+		if(!_lsched_less(lsched, heap, heap->slots[child], slot))
+			break;
+
+		heap->slots[i] = heap->slots[child];
+		i = child;
+	}
+
+	if(heap->n)
+		heap->slots[i] = slot;
+}
+
+// queue event written via forge since last staging, if any
+__realtime static void
+_lsched_commit(lsched_t *lsched)
+{
+	if(lsched->staged < 0)
+		return;
+
+	const uint32_t slot = lsched->staged;
+	const LV2_Atom *atom = _lsched_atom(lsched, slot);
+
+	lsched->staged = -1;
+
+	if(atom->type && (lv2_atom_total_size(atom) <= lsched->forge.offset) )
+	{
+		_lsched_heap_push(lsched,
+			lsched->staged_beats ? &lsched->beats_heap : &lsched->frames_heap, slot);
+	}
+	else // nothing or an incomplete atom has been written
+	{
+		lsched->free[lsched->nfree++] = slot;
+	}
+}
+
+__realtime static int
+_lsched_stage(lua_State *L, lsched_t *lsched, bool beats, int64_t frames,
+	double beat_time)
+{
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+
+	_lsched_commit(lsched);
+
+	if(beats && !lsched->timely)
+		return luaL_error(L, "beat time needs a TimeResponder");
+
+	if(lsched->nfree == 0)
+		return luaL_error(L, "scheduler full");
+
+	const uint32_t slot = lsched->free[--lsched->nfree];
+	lsched_slot_t *itm = &lsched->slots[slot];
+
+	if(beats)
+		itm->beats = beat_time;
+	else
+		itm->frames = frames;
+	itm->seq = lsched->seq++;
+
+	LV2_Atom *atom = _lsched_atom(lsched, slot);
+	atom->type = 0;
+	atom->size = 0;
+
+	lsched->staged = slot;
+	lsched->staged_beats = beats;
+	lv2_atom_forge_set_buffer(&lsched->forge, (uint8_t *)atom, lsched->size);
+
+	// single event is written via a plain forge
+	lforge_t *lforge = moony_newuserdata(L, moony, MOONY_UDATA_FORGE, true);
+	lforge->depth = 0;
+	lforge->last.frames = 0;
+	lforge->forge = &lsched->forge;
+
+	return 1;
+}
+
+__realtime static int
+_lsched_frame_time(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+	const int64_t frames = luaL_checkinteger(L, 2);
+
+	return _lsched_stage(L, lsched, false, frames, 0.0);
+}
+
+__realtime static int
+_lsched_beat_time(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+	const double beats = luaL_checknumber(L, 2);
+
+	return _lsched_stage(L, lsched, true, 0, beats);
+}
+
+__realtime static int
+_lsched_time(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+
+	if(lua_isinteger(L, 2))
+		return _lsched_stage(L, lsched, false, lua_tointeger(L, 2), 0.0);
+	else if(lua_isnumber(L, 2))
+		return _lsched_stage(L, lsched, true, 0, lua_tonumber(L, 2));
+
+	return luaL_error(L, "integer or number expected");
+}
+
+// write events due in this period to sequence forge and advance clock
+__realtime static int
+_lsched_flush(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+	const int64_t n = luaL_checkinteger(L, 2);
+	lforge_t *lforge = luaL_checkudata(L, 3, "lforge");
+
+	_lsched_commit(lsched);
+
+	// beat times are converted relative to the TimeResponder, which must have
+	// been advanced to the end of the period, beat events are held while the
+	// transport is stopped
+	timely_t *timely = lsched->timely;
+	const bool rolling = timely
+		&& (TIMELY_SPEED(timely) != 0.f)
+		&& (TIMELY_FRAMES_PER_BEAT(timely) > 0.0);
+	const double beats_end = rolling
+		? TIMELY_BAR(timely) * TIMELY_BEATS_PER_BAR(timely) + TIMELY_BAR_BEAT(timely)
+		: 0.0;
+
+	while(true)
+	{
+		lsched_heap_t *heap = NULL;
+		int64_t frames = n;
+
+		if(lsched->frames_heap.n)
+		{
+			const lsched_slot_t *itm = &lsched->slots[lsched->frames_heap.slots[0]];
+			const int64_t due = itm->frames - lsched->frames;
+
+			if(due < frames)
+			{
+				frames = due;
+				heap = &lsched->frames_heap;
+			}
+		}
+
+		if(rolling && lsched->beats_heap.n)
+		{
+			const lsched_slot_t *itm = &lsched->slots[lsched->beats_heap.slots[0]];
+			const int64_t due = n
+				+ floor( (itm->beats - beats_end) * TIMELY_FRAMES_PER_BEAT(timely) );
+
+			if(due < frames)
+			{
+				frames = due;
+				heap = &lsched->beats_heap;
+			}
+		}
+
+		if(!heap) // nothing due in this period
+			break;
+
+		// late events are sent as soon as possible
+		if(frames < 0)
+			frames = 0;
+		if( (frames < lforge->last.frames) && !_lforge_unsorted(moony_vm_get(L), lforge) )
+			frames = lforge->last.frames;
+
+		const uint32_t slot = heap->slots[0];
+		const LV2_Atom *atom = _lsched_atom(lsched, slot);
+
+		if(  !lv2_atom_forge_frame_time(lforge->forge, frames)
+			|| !lv2_atom_forge_write(lforge->forge, atom, lv2_atom_total_size(atom)) )
+			luaL_error(L, forge_buffer_overflow);
+		lforge->last.frames = frames;
+
+		_lsched_heap_pop(lsched, heap);
+		lsched->free[lsched->nfree++] = slot;
+	}
+
+	lsched->frames += n;
+
+	lua_settop(L, 3);
+	return 1; // forge
+}
+
+__realtime static void
+_lsched_reset(lsched_t *lsched)
+{
+	lsched->staged = -1;
+	lsched->frames_heap.n = 0;
+	lsched->beats_heap.n = 0;
+
+	lsched->nfree = lsched->capacity;
+	for(uint32_t i = 0; i < lsched->capacity; i++)
+		lsched->free[i] = lsched->capacity - 1 - i;
+}
+
+__realtime static int
+_lsched_clear(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+
+	_lsched_reset(lsched);
+
+	lua_settop(L, 1);
+	return 1;
+}
+
+__realtime static int
+_lsched_now(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+
+	lua_pushinteger(L, lsched->frames);
+	return 1;
+}
+
+__realtime static int
+_lsched__len(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+
+	_lsched_commit(lsched);
+
+	lua_pushinteger(L, lsched->frames_heap.n + lsched->beats_heap.n);
+	return 1;
+}
+
+__realtime static int
+_lsched__gc(lua_State *L)
+{
+	lsched_t *lsched = lua_touserdata(L, 1);
+
+	if(lsched->mem)
+		moony_rt_free(lsched->vm, lsched->mem, lsched->mem_size);
+
+	return 0;
+}
+
+__realtime int
+_lsched(lua_State *L)
+{
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(2));
+
+	lua_settop(L, 3); // discard superfluous arguments
+	// 1: capacity
+	// 2: size
+	// 3: TimeResponder || nil
+
+	const lua_Integer capacity = luaL_optinteger(L, 1, MOONY_SCHED_CAPACITY);
+	const lua_Integer size = luaL_optinteger(L, 2, MOONY_SCHED_SIZE);
+	timely_t *timely = lua_isnil(L, 3)
+		? NULL
+		: luaL_checkudata(L, 3, "ltimeresponder");
+
+	luaL_argcheck(L, (capacity > 0) && (capacity <= UINT16_MAX), 1, "invalid capacity");
+	luaL_argcheck(L, (size >= (lua_Integer)sizeof(LV2_Atom)) && (size <= UINT16_MAX), 2, "invalid event size");
+
+	lsched_t *lsched = lua_newuserdatauv(L, sizeof(lsched_t), 1);
+	memset(lsched, 0x0, sizeof(lsched_t));
+
+	lsched->vm = vm;
+	lsched->timely = timely;
+	lsched->capacity = capacity;
+	lsched->size = lv2_atom_pad_size(size);
+	lsched->staged = -1;
+
+	// initialize forge (URIDs)
+	memcpy(&lsched->forge, &moony->forge, sizeof(LV2_Atom_Forge));
+
+	// preallocate everything in one go, slots and atoms are 8-byte aligned
+	lsched->mem_size = capacity * (sizeof(lsched_slot_t) + lsched->size
+		+ 3*sizeof(uint32_t));
+	lsched->mem = moony_rt_alloc(vm, lsched->mem_size);
+	if(!lsched->mem)
+		return luaL_error(L, "memory allocation failed");
+
+	uint8_t *ptr = lsched->mem;
+	lsched->slots = (lsched_slot_t *)ptr;
+	ptr += capacity * sizeof(lsched_slot_t);
+	lsched->body = ptr;
+	ptr += capacity * lsched->size;
+	lsched->free = (uint32_t *)ptr;
+	ptr += capacity * sizeof(uint32_t);
+	lsched->frames_heap.slots = (uint32_t *)ptr;
+	ptr += capacity * sizeof(uint32_t);
+	lsched->beats_heap.slots = (uint32_t *)ptr;
+
+	// keep TimeResponder alive
+	lua_pushvalue(L, 3);
+	lua_setiuservalue(L, -2, 1);
+
+	_lsched_reset(lsched);
+
+	luaL_getmetatable(L, "lsched");
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+const luaL_Reg lsched_mt [] = {
+	{"frameTime", _lsched_frame_time},
+	{"beatTime", _lsched_beat_time},
+	{"time", _lsched_time},
+	{"flush", _lsched_flush},
+	{"clear", _lsched_clear},
+	{"now", _lsched_now},
+	{"__len", _lsched__len},
+	{"__gc", _lsched__gc},
+	{NULL, NULL}
+};
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_SCHED_H
+#define _MOONY_API_SCHED_H
+
+#include <moony.h>
+
+#include <timely.h>
+
+#define MOONY_SCHED_CAPACITY 128 // default number of pending events
+#define MOONY_SCHED_SIZE 64 // default max size of single event
+
+typedef struct _lsched_slot_t lsched_slot_t;
+typedef struct _lsched_heap_t lsched_heap_t;
+typedef struct _lsched_t lsched_t;
+
+struct _lsched_slot_t {
+	union {
+		int64_t frames; // absolute time in audio frames
+		double beats; // absolute time in beats
+	};
+	uint32_t seq; // keeps scheduling order of simultaneous events
+};
+
+struct _lsched_heap_t {
+	uint32_t n;
+	uint32_t *slots; // binary min-heap of slot indices
+};
+
+struct _lsched_t {
+	moony_vm_t *vm;
+	timely_t *timely; // optional TimeResponder for beat times
+
+	uint32_t capacity;
+	uint32_t size;
+	int64_t frames; // absolute frames at start of current period
+	uint32_t seq;
+
+	uint32_t nfree;
+	uint32_t *free; // stack of unused slot indices
+	lsched_heap_t frames_heap;
+	lsched_heap_t beats_heap;
+	lsched_slot_t *slots;
+	uint8_t *body; // capacity * size bytes of atom storage
+
+	int64_t staged; // slot currently written to via forge, -1 if none
+	bool staged_beats;
+	LV2_Atom_Forge forge;
+
+	void *mem;
+	size_t mem_size;
+};
+
+int
+_lsched(lua_State *L);
+
+extern const luaL_Reg lsched_mt [];
+
+#endif
@@ -17,12 +17,28 @@
 
 #include <api_stash.h>
 
+// whether forge belongs to a stash
+__realtime bool
+_lstash_forge(LV2_Atom_Forge *forge)
+{
+	if(forge->sink != _sink_rt)
+		return false;
+
+	const atom_ser_t *ser = forge->handle;
+	const lstash_t *lstash = (const lstash_t *)((const uint8_t *)ser - offsetof(lstash_t, ser));
+
+	return &lstash->forge == forge;
+}
+
 __realtime int
 _lstash__gc(lua_State *L)
 {
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
 	lstash_t *lstash = lua_touserdata(L, 1);
 	atom_ser_t *ser = &lstash->ser;
 
+	_lforge_unsorted_flush(moony, moony_vm_get(L), &lstash->forge, false);
+
 	if(ser->buf)
 		moony_rt_free(ser->data, ser->buf, ser->size);
 
@@ -32,6 +48,7 @@ _lstash__gc(lua_State *L)
 __realtime int
 _lstash_write(lua_State *L)
 {
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
 	lstash_t *lstash = lua_touserdata(L, 1);
 	atom_ser_t *ser = &lstash->ser;
 	lforge_t *lforge = &lstash->lforge;
@@ -39,6 +56,8 @@ _lstash_write(lua_State *L)
 	lforge->depth = 0;
 	lforge->last.frames = 0;
 	lforge->forge = &lstash->forge;
+
+	_lforge_unsorted_flush(moony, moony_vm_get(L), &lstash->forge, false);
 	
 	ser->offset = 0; // reset stash pointer
 	lv2_atom_forge_set_sink(&lstash->forge, _sink_rt, _deref, ser);
@@ -56,10 +75,13 @@ _lstash_write(lua_State *L)
 __realtime int
 _lstash_read(lua_State *L)
 {
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
 	lstash_t *lstash = lua_touserdata(L, 1);
 	atom_ser_t *ser = &lstash->ser;
 	latom_t *latom = &lstash->latom;
 
+	_lforge_unsorted_flush(moony, moony_vm_get(L), &lstash->forge, true);
+
 	latom->atom = (const LV2_Atom *)ser->buf;
 	latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
 
@@ -43,6 +43,8 @@ int
 _lstash_write(lua_State *L);
 int
 _lstash_read(lua_State *L);
+bool
+_lstash_forge(LV2_Atom_Forge *forge);
 
 extern const luaL_Reg lstash_mt [];
 
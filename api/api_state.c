@@ -21,286 +21,501 @@
 #include <api_atom.h>
 #include <api_forge.h>
 
-__realtime static inline void
-_lstateresponder_register_access(lua_State *L, moony_t *moony, int64_t frames,
-	lforge_t *lforge, const LV2_Atom_URID *subject, LV2_URID access, int32_t sequence_num)
+typedef struct _lstateresponder_t lstateresponder_t;
+
+struct _lstateresponder_t {
+	LV2_URID access; // property access currently being synced, 0 if idle
+	LV2_URID cursor; // last synced property, 0 to start anew
+	LV2_URID subject; // 0 if none
+	int32_t sequence_num;
+	uint32_t gen; // current registration, properties synced by it carry it
+};
+
+__realtime static inline uint32_t
+_lstateresponder_fnv1a(uint32_t hash, const void *data, size_t size)
 {
-	LV2_Atom_Forge_Frame obj_frame;
-	LV2_Atom_Forge_Frame add_frame;
-	LV2_Atom_Forge_Frame rem_frame;
+	const uint8_t *ptr = data;
 
-	// iterate over properties
-	lua_pushnil(L);  // first key 
-	while(lua_next(L, -2))
+	for(size_t i = 0; i < size; i++)
 	{
-		// uses 'key' (at index -2) and 'value' (at index -1)
-		const LV2_URID key = luaL_checkinteger(L, -2);
-
-		const char *label = ""; // fallback
-		LV2_URID range = 0; // fallback
-		LV2_URID child_type = 0; // fallback
+		hash ^= ptr[i];
+		hash *= 0x01000193;
+	}
 
-		if(lua_geti(L, -1, moony->uris.rdfs_label) == LUA_TSTRING)
-			label = lua_tostring(L, -1);
-		lua_pop(L, 1); // label
+	return hash;
+}
 
-		if(lua_geti(L, -1, moony->uris.rdfs_range) == LUA_TNUMBER)
-			range = lua_tointeger(L, -1);
-		lua_pop(L, 1); // range
+__realtime static uint32_t
+_lstateresponder_hash_value(lua_State *L, int idx, uint32_t hash)
+{
+	const int type = lua_type(L, idx);
 
-		if(lua_geti(L, -1, moony->uris.atom_child_type) == LUA_TNUMBER)
-			child_type= lua_tointeger(L, -1);
-		lua_pop(L, 1); // child_type
+	hash = _lstateresponder_fnv1a(hash, &type, sizeof(type));
 
-		if(  !lv2_atom_forge_frame_time(lforge->forge, frames)
-		  || !lv2_atom_forge_object(lforge->forge, &obj_frame, 0, moony->uris.patch.patch) )
-			luaL_error(L, forge_buffer_overflow);
+	switch(type)
+	{
+		case LUA_TNUMBER:
 		{
-			if(subject)
+			if(lua_isinteger(L, idx))
 			{
-				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.subject)
-					|| !lv2_atom_forge_urid(lforge->forge, subject->body) )
-					luaL_error(L, forge_buffer_overflow);
+				const lua_Integer i = lua_tointeger(L, idx);
+				hash = _lstateresponder_fnv1a(hash, &i, sizeof(i));
 			}
-
-			if(sequence_num)
+			else
 			{
-				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.sequence)
-					|| !lv2_atom_forge_int(lforge->forge, sequence_num) )
-					luaL_error(L, forge_buffer_overflow);
+				const lua_Number n = lua_tonumber(L, idx);
+				hash = _lstateresponder_fnv1a(hash, &n, sizeof(n));
 			}
+		} break;
+		case LUA_TSTRING:
+		{
+			size_t len;
+			const char *str = lua_tolstring(L, idx, &len);
+			hash = _lstateresponder_fnv1a(hash, str, len);
+		} break;
+		case LUA_TBOOLEAN:
+		{
+			const int b = lua_toboolean(L, idx);
+			hash = _lstateresponder_fnv1a(hash, &b, sizeof(b));
+		} break;
+	}
+
+	return hash;
+}
 
-			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.remove)
-				|| !lv2_atom_forge_object(lforge->forge, &rem_frame, 0, 0)
+// hash of all metadata of property table at top of stack
+__realtime static uint32_t
+_lstateresponder_hash(lua_State *L, moony_t *moony)
+{
+	const LV2_URID keys [] = {
+		moony->uris.rdfs_label,
+		moony->uris.rdfs_range,
+		moony->uris.atom_child_type,
+		moony->uris.rdfs_comment,
+		moony->uris.lv2_minimum,
+		moony->uris.lv2_maximum,
+		moony->uris.units_unit,
+		moony->uris.units_symbol,
+		moony->uris.moony_color,
+		moony->uris.moony_syntax
+	};
+	uint32_t hash = 0x811c9dc5;
 
-				|| !lv2_atom_forge_key(lforge->forge, access)
-				|| !lv2_atom_forge_urid(lforge->forge, key) )
-				luaL_error(L, forge_buffer_overflow);
-			lv2_atom_forge_pop(lforge->forge, &rem_frame); // patch:remove
+	for(unsigned i = 0; i < sizeof(keys) / sizeof(LV2_URID); i++)
+	{
+		lua_geti(L, -1, keys[i]);
+		hash = _lstateresponder_hash_value(L, -1, hash);
+		lua_pop(L, 1);
+	}
 
-			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.add)
-				|| !lv2_atom_forge_object(lforge->forge, &add_frame, 0, 0)
+	if(lua_geti(L, -1, moony->uris.lv2_scale_point) == LUA_TTABLE)
+	{
+		uint32_t points = 0;
 
-				|| !lv2_atom_forge_key(lforge->forge, access)
-				|| !lv2_atom_forge_urid(lforge->forge, key) )
-				luaL_error(L, forge_buffer_overflow);
-			lv2_atom_forge_pop(lforge->forge, &add_frame); // patch:add
+		// table traversal order is arbitrary, thus combine commutatively
+		lua_pushnil(L);
+		while(lua_next(L, -2))
+		{
+			points += _lstateresponder_hash_value(L, -1,
+				_lstateresponder_hash_value(L, -2, 0x811c9dc5));
+
+			lua_pop(L, 1);
 		}
-		lv2_atom_forge_pop(lforge->forge, &obj_frame); // patch:patch
 
-		if(  !lv2_atom_forge_frame_time(lforge->forge, frames)
-			|| !lv2_atom_forge_object(lforge->forge, &obj_frame, 0, moony->uris.patch.patch) )
-			luaL_error(L, forge_buffer_overflow);
+		hash = _lstateresponder_fnv1a(hash, &points, sizeof(points));
+	}
+	lua_pop(L, 1); // scale_points
+
+	return hash;
+}
+
+// lookup property registered to UI, optionally add it if not found and table
+// is not full
+__realtime static moony_prop_t *
+_lstateresponder_prop(moony_t *moony, LV2_URID key, bool add)
+{
+	const uint32_t mask = MOONY_MAX_PROPS - 1;
+
+	for(uint32_t i = 0, idx = key & mask; i < MOONY_MAX_PROPS; i++, idx = (idx + 1) & mask)
+	{
+		moony_prop_t *prop = &moony->props[idx];
+
+		if(prop->key == key)
+			return prop;
+
+		if(prop->key == 0)
+		{
+			if(!add)
+				return NULL; // not registered
+
+			prop->key = key;
+			moony->nprops++;
+			return prop;
+		}
+	}
+
+	return NULL; // table is full
+}
+
+__realtime static void
+_lstateresponder_access_out(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, LV2_URID subject, LV2_URID access, LV2_URID key, int32_t sequence_num)
+{
+	LV2_Atom_Forge_Frame obj_frame;
+	LV2_Atom_Forge_Frame add_frame;
+	LV2_Atom_Forge_Frame rem_frame;
+
+	if(  !lv2_atom_forge_frame_time(lforge->forge, frames)
+	  || !lv2_atom_forge_object(lforge->forge, &obj_frame, 0, moony->uris.patch.patch) )
+		luaL_error(L, forge_buffer_overflow);
+	{
+		if(subject)
 		{
 			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.subject)
-				|| !lv2_atom_forge_urid(lforge->forge, key) )
+				|| !lv2_atom_forge_urid(lforge->forge, subject) )
 				luaL_error(L, forge_buffer_overflow);
+		}
 
-			if(sequence_num)
-			{
-				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.sequence)
-					|| !lv2_atom_forge_int(lforge->forge, sequence_num) )
-					luaL_error(L, forge_buffer_overflow);
-			}
+		if(sequence_num)
+		{
+			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.sequence)
+				|| !lv2_atom_forge_int(lforge->forge, sequence_num) )
+				luaL_error(L, forge_buffer_overflow);
+		}
+
+		if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.remove)
+			|| !lv2_atom_forge_object(lforge->forge, &rem_frame, 0, 0)
+
+			|| !lv2_atom_forge_key(lforge->forge, access)
+			|| !lv2_atom_forge_urid(lforge->forge, key) )
+			luaL_error(L, forge_buffer_overflow);
+		lv2_atom_forge_pop(lforge->forge, &rem_frame); // patch:remove
+
+		if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.add)
+			|| !lv2_atom_forge_object(lforge->forge, &add_frame, 0, 0)
+
+			|| !lv2_atom_forge_key(lforge->forge, access)
+			|| !lv2_atom_forge_urid(lforge->forge, key) )
+			luaL_error(L, forge_buffer_overflow);
+		lv2_atom_forge_pop(lforge->forge, &add_frame); // patch:add
+	}
+	lv2_atom_forge_pop(lforge->forge, &obj_frame); // patch:patch
+}
 
-			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.remove)
-				|| !lv2_atom_forge_object(lforge->forge, &rem_frame, 0, 0) )
+// send metadata of property table at top of stack
+__realtime static void
+_lstateresponder_meta_out(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, LV2_URID key, int32_t sequence_num)
+{
+	LV2_Atom_Forge_Frame obj_frame;
+	LV2_Atom_Forge_Frame add_frame;
+	LV2_Atom_Forge_Frame rem_frame;
+
+	const char *label = ""; // fallback
+	LV2_URID range = 0; // fallback
+	LV2_URID child_type = 0; // fallback
+
+	if(lua_geti(L, -1, moony->uris.rdfs_label) == LUA_TSTRING)
+		label = lua_tostring(L, -1);
+	lua_pop(L, 1); // label
+
+	if(lua_geti(L, -1, moony->uris.rdfs_range) == LUA_TNUMBER)
+		range = lua_tointeger(L, -1);
+	lua_pop(L, 1); // range
+
+	if(lua_geti(L, -1, moony->uris.atom_child_type) == LUA_TNUMBER)
+		child_type= lua_tointeger(L, -1);
+	lua_pop(L, 1); // child_type
+
+	if(  !lv2_atom_forge_frame_time(lforge->forge, frames)
+		|| !lv2_atom_forge_object(lforge->forge, &obj_frame, 0, moony->uris.patch.patch) )
+		luaL_error(L, forge_buffer_overflow);
+	{
+		if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.subject)
+			|| !lv2_atom_forge_urid(lforge->forge, key) )
+			luaL_error(L, forge_buffer_overflow);
+
+		if(sequence_num)
+		{
+			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.sequence)
+				|| !lv2_atom_forge_int(lforge->forge, sequence_num) )
 				luaL_error(L, forge_buffer_overflow);
-			{
-				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+		}
+
+		if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.remove)
+			|| !lv2_atom_forge_object(lforge->forge, &rem_frame, 0, 0) )
+			luaL_error(L, forge_buffer_overflow);
+		{
+			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_range)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_range)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_comment)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_comment)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_minimum)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_minimum)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_maximum)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_maximum)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.units_unit)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.units_unit)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.units_symbol)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.units_symbol)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.moony_color)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.moony_color)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.moony_syntax)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_scale_point)
+				|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard) )
+				luaL_error(L, forge_buffer_overflow);
+		}
+		lv2_atom_forge_pop(lforge->forge, &rem_frame); // patch:remove
+
+		if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.add)
+			|| !lv2_atom_forge_object(lforge->forge, &add_frame, 0, 0) )
+			luaL_error(L, forge_buffer_overflow);
+		{
+			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
+				|| !lv2_atom_forge_string(lforge->forge, label, strlen(label))
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.moony_syntax)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard)
+				|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_range)
+				|| !lv2_atom_forge_urid(lforge->forge, range) )
+				luaL_error(L, forge_buffer_overflow);
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_scale_point)
-					|| !lv2_atom_forge_urid(lforge->forge, moony->uris.patch.wildcard) )
+			if(lua_geti(L, -1, moony->uris.rdfs_comment) == LUA_TSTRING)
+			{
+				size_t comment_size;
+				const char *comment = lua_tolstring(L, -1, &comment_size);
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_comment)
+					|| !lv2_atom_forge_string(lforge->forge, comment, comment_size) )
 					luaL_error(L, forge_buffer_overflow);
 			}
-			lv2_atom_forge_pop(lforge->forge, &rem_frame); // patch:remove
+			lua_pop(L, 1); // comment
 
-			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.add)
-				|| !lv2_atom_forge_object(lforge->forge, &add_frame, 0, 0) )
-				luaL_error(L, forge_buffer_overflow);
+			const LV2_URID range2 = (range == lforge->forge->Vector)
+				? child_type
+				: range;
+
+			if(lua_geti(L, -1, moony->uris.lv2_minimum) != LUA_TNIL)
 			{
-				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
-					|| !lv2_atom_forge_string(lforge->forge, label, strlen(label))
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_minimum)
+					|| !_lforge_basic(L, -1, lforge->forge, range2, 0) )
+					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // minimum
 
-					|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_range)
-					|| !lv2_atom_forge_urid(lforge->forge, range) )
+			if(lua_geti(L, -1, moony->uris.lv2_maximum) != LUA_TNIL)
+			{
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_maximum)
+					|| !_lforge_basic(L, -1, lforge->forge, range2, 0) )
 					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // maximum
 
-				if(lua_geti(L, -1, moony->uris.rdfs_comment) == LUA_TSTRING)
-				{
-					size_t comment_size;
-					const char *comment = lua_tolstring(L, -1, &comment_size);
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_comment)
-						|| !lv2_atom_forge_string(lforge->forge, comment, comment_size) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // comment
+			if(lua_geti(L, -1, moony->uris.units_unit) == LUA_TNUMBER)
+			{
+				const LV2_URID unit = lua_tointeger(L, -1);
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.units_unit)
+					|| !lv2_atom_forge_urid(lforge->forge, unit) )
+					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // unit
 
-				const LV2_URID range2 = (range == lforge->forge->Vector)
-					? child_type
-					: range;
+			if(lua_geti(L, -1, moony->uris.units_symbol) == LUA_TSTRING)
+			{
+				size_t len;
+				const char *symbol = lua_tolstring(L, -1, &len);
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.units_symbol)
+					|| !lv2_atom_forge_string(lforge->forge, symbol, len) )
+					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // symbol
 
-				if(lua_geti(L, -1, moony->uris.lv2_minimum) != LUA_TNIL)
-				{
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_minimum)
-						|| !_lforge_basic(L, -1, lforge->forge, range2, 0) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // minimum
+			if(lua_geti(L, -1, moony->uris.moony_color) == LUA_TNUMBER)
+			{
+				const uint32_t col = lua_tointeger(L, -1);
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.moony_color)
+					|| !lv2_atom_forge_long(lforge->forge, col) )
+					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // symbol
 
-				if(lua_geti(L, -1, moony->uris.lv2_maximum) != LUA_TNIL)
-				{
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_maximum)
-						|| !_lforge_basic(L, -1, lforge->forge, range2, 0) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // maximum
+			if(lua_geti(L, -1, moony->uris.moony_syntax) == LUA_TNUMBER)
+			{
+				const LV2_URID syntax = lua_tointeger(L, -1);
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.moony_syntax)
+					|| !lv2_atom_forge_urid(lforge->forge, syntax) )
+					luaL_error(L, forge_buffer_overflow);
+			}
+			lua_pop(L, 1); // symbol
 
-				if(lua_geti(L, -1, moony->uris.units_unit) == LUA_TNUMBER)
-				{
-					const LV2_URID unit = lua_tointeger(L, -1);
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.units_unit)
-						|| !lv2_atom_forge_urid(lforge->forge, unit) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // unit
+			if(lua_geti(L, -1, moony->uris.lv2_scale_point) != LUA_TNIL)
+			{
+				LV2_Atom_Forge_Frame tuple_frame;
+				if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_scale_point)
+					|| !lv2_atom_forge_tuple(lforge->forge, &tuple_frame) )
+					luaL_error(L, forge_buffer_overflow);
 
-				if(lua_geti(L, -1, moony->uris.units_symbol) == LUA_TSTRING)
-				{
-					size_t len;
-					const char *symbol = lua_tolstring(L, -1, &len);
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.units_symbol)
-						|| !lv2_atom_forge_string(lforge->forge, symbol, len) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // symbol
+				double last = -HUGE_VAL;
 
-				if(lua_geti(L, -1, moony->uris.moony_color) == LUA_TNUMBER)
+				while(true)
 				{
-					const uint32_t col = lua_tointeger(L, -1);
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.moony_color)
-						|| !lv2_atom_forge_long(lforge->forge, col) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // symbol
+					double next = HUGE_VAL;
 
-				if(lua_geti(L, -1, moony->uris.moony_syntax) == LUA_TNUMBER)
-				{
-					const LV2_URID syntax = lua_tointeger(L, -1);
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.moony_syntax)
-						|| !lv2_atom_forge_urid(lforge->forge, syntax) )
-						luaL_error(L, forge_buffer_overflow);
-				}
-				lua_pop(L, 1); // symbol
+					// iterate over properties
+					lua_pushnil(L);  // first key
+					while(lua_next(L, -2))
+					{
+						const double val = luaL_checknumber(L, -1);
 
-				if(lua_geti(L, -1, moony->uris.lv2_scale_point) != LUA_TNIL)
-				{
-					LV2_Atom_Forge_Frame tuple_frame;
-					if(  !lv2_atom_forge_key(lforge->forge, moony->uris.lv2_scale_point)
-						|| !lv2_atom_forge_tuple(lforge->forge, &tuple_frame) )
-						luaL_error(L, forge_buffer_overflow);
+						if( (val > last) && (val < next) )
+						{
+							next = val;
+						}
+
+						// removes 'value'; keeps 'key' for next iteration
+						lua_pop(L, 1);
+					}
+
+					if(next == HUGE_VAL)
+					{
+						break;
+					}
 
-					double last = -HUGE_VAL;
+					last = next;
 
-					while(true)
+					// iterate over properties
+					lua_pushnil(L);  // first key
+					while(lua_next(L, -2))
 					{
-						double next = HUGE_VAL;
+						const double val = luaL_checknumber(L, -1);
 
-						// iterate over properties
-						lua_pushnil(L);  // first key
-						while(lua_next(L, -2))
+						if(val == next)
 						{
-							const double val = luaL_checknumber(L, -1);
+							// uses 'key' (at index -2) and 'value' (at index -1)
+							size_t point_size;
+							const char *point = luaL_checklstring(L, -2, &point_size);
+							LV2_Atom_Forge_Frame scale_point_frame;
 
-							if( (val > last) && (val < next) )
-							{
-								next = val;
-							}
+							if(  !lv2_atom_forge_object(lforge->forge, &scale_point_frame, 0, 0)
 
-							// removes 'value'; keeps 'key' for next iteration
-							lua_pop(L, 1);
-						}
+								|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
+								|| !lv2_atom_forge_string(lforge->forge, point, point_size)
 
-						if(next == HUGE_VAL)
-						{
-							break;
+								|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdf_value)
+								|| !_lforge_basic(L, -1, lforge->forge, range, 0) )
+								luaL_error(L, forge_buffer_overflow);
+
+							lv2_atom_forge_pop(lforge->forge, &scale_point_frame); // core:scalePoint
 						}
 
-						last = next;
+						// removes 'value'; keeps 'key' for next iteration
+						lua_pop(L, 1);
+					}
+				}
 
-						// iterate over properties
-						lua_pushnil(L);  // first key
-						while(lua_next(L, -2))
-						{
-							const double val = luaL_checknumber(L, -1);
+				lv2_atom_forge_pop(lforge->forge, &tuple_frame);
+			}
+			lua_pop(L, 1); // scale_points
+		}
+		lv2_atom_forge_pop(lforge->forge, &add_frame); // patch:add
+	}
+	lv2_atom_forge_pop(lforge->forge, &obj_frame); // patch:patch
 
-							if(val == next)
-							{
-								// uses 'key' (at index -2) and 'value' (at index -1)
-								size_t point_size;
-								const char *point = luaL_checklstring(L, -2, &point_size);
-								LV2_Atom_Forge_Frame scale_point_frame;
+}
 
-								if(  !lv2_atom_forge_object(lforge->forge, &scale_point_frame, 0, 0)
+// sync a chunk of properties of responder, returns true when done
+__realtime static bool
+_lstateresponder_step(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, lstateresponder_t *lresp, int idx)
+{
+	unsigned budget = MOONY_PROPS_PER_PERIOD;
 
-									|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdfs_label)
-									|| !lv2_atom_forge_string(lforge->forge, point, point_size)
+	while(lresp->access)
+	{
+		if(lua_geti(L, idx, lresp->access) == LUA_TTABLE)
+		{
+			// restart if cursor has been removed from table in the meantime
+			if(lresp->cursor)
+			{
+				if(lua_geti(L, -1, lresp->cursor) == LUA_TNIL)
+					lresp->cursor = 0;
+				lua_pop(L, 1); // nil || cursor
+			}
 
-									|| !lv2_atom_forge_key(lforge->forge, moony->uris.rdf_value)
-									|| !_lforge_basic(L, -1, lforge->forge, range, 0) )
-									luaL_error(L, forge_buffer_overflow);
+			if(lresp->cursor)
+				lua_pushinteger(L, lresp->cursor);
+			else
+				lua_pushnil(L);
 
-								lv2_atom_forge_pop(lforge->forge, &scale_point_frame); // core:scalePoint
-							}
+			while(lua_next(L, -2))
+			{
+				// uses 'key' (at index -2) and 'value' (at index -1)
+				const LV2_URID key = luaL_checkinteger(L, -2);
+				const uint32_t hash = _lstateresponder_hash(L, moony);
+				moony_prop_t *prop = _lstateresponder_prop(moony, key, false);
 
-							// removes 'value'; keeps 'key' for next iteration
-							lua_pop(L, 1);
-						}
+				// only send new or changed properties
+				if(!prop || (prop->access != lresp->access) || (prop->hash != hash) )
+				{
+					if(!prop || (prop->access != lresp->access) )
+					{
+						_lstateresponder_access_out(L, moony, frames, lforge, lresp->subject,
+							lresp->access, key, lresp->sequence_num);
 					}
 
-					lv2_atom_forge_pop(lforge->forge, &tuple_frame);
+					// values are not sent, UIs request them with patch:Get once they
+					// know about the range of a property
+					_lstateresponder_meta_out(L, moony, frames, lforge, key, lresp->sequence_num);
+					budget--;
+				}
+
+				// register property and advance cursor only once it has been sent, as
+				// forging may have failed with an error above
+				if(!prop)
+					prop = _lstateresponder_prop(moony, key, true);
+
+				if(prop)
+				{
+					prop->access = lresp->access;
+					prop->hash = hash;
+					prop->gen = lresp->gen;
+				}
+
+				lresp->cursor = key;
+
+				// removes 'value'; keeps 'key' for next iteration
+				lua_pop(L, 1);
+
+				if(budget == 0)
+				{
+					lua_pop(L, 2); // key, table
+					return false; // continue in next period
 				}
-				lua_pop(L, 1); // scale_points
 			}
-			lv2_atom_forge_pop(lforge->forge, &add_frame); // patch:add
 		}
-		lv2_atom_forge_pop(lforge->forge, &obj_frame); // patch:patch
-
-		//FIXME also send patch:set ?
+		lua_pop(L, 1); // nil || table
 
-		// removes 'value'; keeps 'key' for next iteration
-		lua_pop(L, 1);
+		lresp->cursor = 0;
+		lresp->access = (lresp->access == moony->uris.patch.writable)
+			? moony->uris.patch.readable
+			: 0;
 	}
+
+	return true;
 }
 
-__realtime static inline void
-_lstateresponder_reg(lua_State *L, moony_t *moony, int64_t frames,
-	lforge_t *lforge, const LV2_Atom_URID *subject, int32_t sequence_num)
+__realtime static void
+_lstateresponder_clear(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, LV2_URID subject, int32_t sequence_num)
 {
 	LV2_Atom_Forge_Frame obj_frame;
 	LV2_Atom_Forge_Frame add_frame;
@@ -314,7 +529,7 @@ _lstateresponder_reg(lua_State *L, moony_t *moony, int64_t frames,
 		if(subject)
 		{
 			if(  !lv2_atom_forge_key(lforge->forge, moony->uris.patch.subject)
-				|| !lv2_atom_forge_urid(lforge->forge, subject->body) )
+				|| !lv2_atom_forge_urid(lforge->forge, subject) )
 				luaL_error(L, forge_buffer_overflow);
 		}
 
@@ -343,19 +558,188 @@ _lstateresponder_reg(lua_State *L, moony_t *moony, int64_t frames,
 	}
 	lv2_atom_forge_pop(lforge->forge, &obj_frame); // patch:patch
 
-	if(lua_geti(L, 1, moony->uris.patch.writable) != LUA_TNIL)
+	memset(moony->props, 0x0, sizeof(moony->props));
+	moony->nprops = 0;
+}
+
+// whether orphaned properties still are known to UI, this is only decided by
+// the last pending responder, as others may still sync them
+__realtime static bool
+_lstateresponder_stale(lua_State *L, moony_t *moony, int idx)
+{
+	bool others_pending = false;
+
+	lua_rawgetp(L, LUA_REGISTRYINDEX, _lstateresponder_cont); // registered
+	lua_pushnil(L);
+	while(lua_next(L, -2))
+	{
+		if(lua_toboolean(L, -1) && !lua_rawequal(L, -2, idx))
+			others_pending = true;
+		lua_pop(L, 1); // pending
+	}
+	lua_pop(L, 1); // registered
+
+	if(others_pending)
+		return false;
+
+	for(uint32_t i = 0; i < MOONY_MAX_PROPS; i++)
+	{
+		const moony_prop_t *prop = &moony->props[i];
+
+		if(prop->key && !prop->gen)
+			return true;
+	}
+
+	return false;
+}
+
+__realtime static void
+_lstateresponder_pending(lua_State *L, moony_t *moony, int idx, bool pending)
+{
+	// registry[_lstateresponder_cont][responder] = pending
+	lua_rawgetp(L, LUA_REGISTRYINDEX, _lstateresponder_cont);
+	lua_pushvalue(L, idx);
+	lua_pushboolean(L, pending);
+	lua_rawset(L, -3);
+	lua_pop(L, 1); // registered
+
+	if(pending)
+		moony->props_pending = true;
+}
+
+// restart registration of all other responders, as clearing all properties
+// in UI has wiped theirs, too
+__realtime static void
+_lstateresponder_restart(lua_State *L, moony_t *moony, int idx)
+{
+	lua_rawgetp(L, LUA_REGISTRYINDEX, _lstateresponder_cont); // registered
+	lua_pushnil(L);
+	while(lua_next(L, -2))
+	{
+		lua_pop(L, 1); // pending
+
+		if(!lua_rawequal(L, -1, idx))
+		{
+			lstateresponder_t *other = lua_touserdata(L, -1);
+
+			other->access = moony->uris.patch.writable;
+			other->cursor = 0;
+			other->sequence_num = 0; // not requested anymore
+			other->gen = ++moony->props_gen;
+
+			// only changes value of existing key, which is safe while traversing
+			lua_pushvalue(L, -1);
+			lua_pushboolean(L, 1);
+			lua_rawset(L, -4);
+			moony->props_pending = true;
+		}
+	}
+	lua_pop(L, 1); // registered
+}
+
+// continue registration of responder at idx with its uservalue table at idx + 1
+__realtime static void
+_lstateresponder_continue(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, int idx)
+{
+	lstateresponder_t *lresp = lua_touserdata(L, idx);
+
+	if(!_lstateresponder_step(L, moony, frames, lforge, lresp, idx + 1))
+		return; // not done, yet
+
+	if(_lstateresponder_stale(L, moony, idx))
+	{
+		// properties have been removed, fall back to clearing all properties
+		_lstateresponder_clear(L, moony, frames, lforge, lresp->subject, lresp->sequence_num);
+		_lstateresponder_restart(L, moony, idx);
+
+		lresp->access = moony->uris.patch.writable;
+		lresp->cursor = 0;
+
+		if(!_lstateresponder_step(L, moony, frames, lforge, lresp, idx + 1))
+			return; // not done, yet
+	}
+
+	_lstateresponder_pending(L, moony, idx, false);
+}
+
+// start registration of responder at idx with its uservalue table at idx + 1
+__realtime static void
+_lstateresponder_reg(lua_State *L, moony_t *moony, int64_t frames,
+	lforge_t *lforge, int idx, LV2_URID subject, int32_t sequence_num)
+{
+	lstateresponder_t *lresp = lua_touserdata(L, idx);
+
+	_lstateresponder_pending(L, moony, idx, true);
+
+	lresp->access = moony->uris.patch.writable;
+	lresp->cursor = 0;
+	lresp->subject = subject;
+	lresp->sequence_num = sequence_num;
+
+	if(moony->props_stale) // registration in period after code reload
 	{
-		_lstateresponder_register_access(L, moony, frames, lforge, subject,
-			moony->uris.patch.writable, sequence_num);
+		// UI still knows properties from previous code, only send changes, those
+		// synced by previous registration of responder are orphaned until synced
+		// again
+		if(lresp->gen)
+		{
+			for(uint32_t i = 0; i < MOONY_MAX_PROPS; i++)
+			{
+				moony_prop_t *prop = &moony->props[i];
+
+				if(prop->key && (prop->gen == lresp->gen) )
+					prop->gen = 0;
+			}
+		}
+
+		moony->props_synced = true;
+	}
+	else
+	{
+		_lstateresponder_clear(L, moony, frames, lforge, subject, sequence_num);
+		_lstateresponder_restart(L, moony, idx);
 	}
-	lua_pop(L, 1); // nil || table
 
-	if(lua_geti(L, 1, moony->uris.patch.readable) != LUA_TNIL)
+	lresp->gen = ++moony->props_gen;
+
+	_lstateresponder_continue(L, moony, frames, lforge, idx);
+}
+
+__realtime int
+_lstateresponder_cont(lua_State *L)
+{
+	moony_t *moony = lua_touserdata(L, 1);
+	lforge_t lforge = {
+		.forge = &moony->notify_forge
+	};
+
+	lua_settop(L, 1);
+
+	moony->props_pending = false; // set again by pending responders
+
+	// iterate over pending responders
+	lua_rawgetp(L, LUA_REGISTRYINDEX, _lstateresponder_cont); // 2: registered
+	lua_pushnil(L);
+	while(lua_next(L, 2))
 	{
-		_lstateresponder_register_access(L, moony, frames, lforge, subject,
-			moony->uris.patch.readable, sequence_num);
+		const bool pending = lua_toboolean(L, -1);
+		lua_pop(L, 1); // pending
+		// 3: responder
+
+		if(!pending)
+			continue;
+
+		lua_getuservalue(L, 3); // 4: uservalue
+		_lstateresponder_continue(L, moony, 0, &lforge, 3);
+		lua_pop(L, 1); // uservalue
+
+		const lstateresponder_t *lresp = lua_touserdata(L, 3);
+		if(lresp->access) // not done, yet
+			moony->props_pending = true;
 	}
-	lua_pop(L, 1); // nil || table
+
+	return 0;
 }
 
 __realtime static void
@@ -411,6 +795,7 @@ _lstateresponder__call(lua_State *L)
 	lforge_t *lforge = luaL_checkudata(L, 3, "lforge");
 	latom_t *latom = luaL_checkudata(L, 4, "latom");
 	lua_pop(L, 1); // atom
+	lua_pushvalue(L, 1); // 4: self
 
 	// replace self with its uservalue
 	lua_getuservalue(L, 1);
@@ -439,7 +824,11 @@ _lstateresponder__call(lua_State *L)
 				if(!property)
 				{
 					// register state
-					_lstateresponder_reg(L, moony, frames, lforge, subject, sequence_num);
+					lua_pushvalue(L, 4); // self
+					lua_pushvalue(L, 1); // uservalue
+					_lstateresponder_reg(L, moony, frames, lforge, lua_gettop(L) - 1,
+						subject ? subject->body : 0, sequence_num);
+					lua_pop(L, 2); // self, uservalue
 
 					lua_pushboolean(L, 1); // handled
 					return 1;
@@ -624,25 +1013,18 @@ _lstateresponder_register(lua_State *L)
 	// 2: frames
 	// 3: forge
 
-	// replace self with its uservalue
-	lua_getuservalue(L, 1);
-	lua_replace(L, 1);
-
+	luaL_checkudata(L, 1, "lstateresponder");
 	int64_t frames = luaL_checkinteger(L, 2);
 	lforge_t *lforge = luaL_checkudata(L, 3, "lforge");
 
-	// fake subject
-	const LV2_Atom_URID subject = {
-		.atom = {
-			.size = sizeof(uint32_t),
-			.type = lforge->forge->URID
-		},
-		.body = moony->uris.patch.self
-	};
+	lua_pushvalue(L, 1); // 4: self
+	lua_getuservalue(L, 1); // 5: uservalue
 
 	// register state
-	_lstateresponder_reg(L, moony, frames, lforge, &subject, 0); //TODO use patch:sequenceNumber
+	_lstateresponder_reg(L, moony, frames, lforge, 4,
+		moony->uris.patch.self, 0); //TODO use patch:sequenceNumber
 
+	lua_settop(L, 3);
 	return 1; // forge
 }
 
@@ -858,8 +1240,8 @@ _lstateresponder(lua_State *L)
 	lua_settop(L, 1); // discard superfluous arguments
 
 	// o = new 
-	int32_t *dummy = lua_newuserdata(L, sizeof(int32_t));
-	(void)dummy;
+	lstateresponder_t *lresp = lua_newuserdata(L, sizeof(lstateresponder_t));
+	memset(lresp, 0x0, sizeof(lstateresponder_t));
 
 	// o.uservalue = uservalue
 	lua_insert(L, 1);
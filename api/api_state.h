@@ -23,6 +23,9 @@
 int
 _lstateresponder(lua_State *L);
 
+int
+_lstateresponder_cont(lua_State *L);
+
 extern const luaL_Reg lstateresponder_mt [];
 
 #endif
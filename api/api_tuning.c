@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <math.h>
+
+#include <api_tuning.h>
+
+// offset of integral note relative to reference frequency in cents
+__realtime static inline double
+_ltuning_note_cents(const ltuning_t *ltuning, lua_Integer note)
+{
+	const lua_Integer rel = note - ltuning->base;
+	lua_Integer period = rel / ltuning->ndegrees;
+	lua_Integer degree = rel % ltuning->ndegrees;
+
+	if(degree < 0)
+	{
+		degree += ltuning->ndegrees;
+		period -= 1;
+	}
+
+	return period * ltuning->cents[ltuning->ndegrees] + ltuning->cents[degree];
+}
+
+__realtime static inline lua_Number
+_ltuning_midi2cps(const ltuning_t *ltuning, lua_Number note)
+{
+	const lua_Number floored = floor(note);
+	const lua_Integer idx = floored;
+	const lua_Number frac = note - floored;
+
+	if(frac == 0.0)
+	{
+		if( (idx >= 0) && (idx < MOONY_TUNING_NOTES) )
+			return ltuning->cps[idx];
+
+		return ltuning->fref * exp2(_ltuning_note_cents(ltuning, idx) / 1200.0);
+	}
+
+	// interpolate fractional notes between neighbouring scale degrees
+	const double lo = _ltuning_note_cents(ltuning, idx);
+	const double hi = _ltuning_note_cents(ltuning, idx + 1);
+
+	return ltuning->fref * exp2( (lo + frac*(hi - lo)) / 1200.0);
+}
+
+__realtime static inline lua_Number
+_ltuning_cps2midi(const ltuning_t *ltuning, lua_Number cps)
+{
+	const double cents = 1200.0 * log2(cps / ltuning->fref);
+	const double period = ltuning->cents[ltuning->ndegrees];
+	const double floored = floor(cents / period);
+	const double rem = cents - floored*period;
+
+	// binary search for scale degree below remainder
+	unsigned lo = 0;
+	unsigned hi = ltuning->ndegrees;
+	while(hi - lo > 1)
+	{
+		const unsigned mid = (lo + hi) / 2;
+
+		if(ltuning->cents[mid] <= rem)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	const double frac = (rem - ltuning->cents[lo]) / (ltuning->cents[lo + 1] - ltuning->cents[lo]);
+
+	return ltuning->base + floored*ltuning->ndegrees + lo + frac;
+}
+
+// convert a single number or a whole table of numbers in-place
+__realtime static int
+_ltuning_convert(lua_State *L, lua_Number (*convert)(const ltuning_t *, lua_Number))
+{
+	ltuning_t *ltuning = lua_touserdata(L, 1);
+
+	if(lua_istable(L, 2))
+	{
+		const lua_Integer n = luaL_len(L, 2);
+
+		for(lua_Integer i = 1; i <= n; i++)
+		{
+			lua_geti(L, 2, i);
+			const lua_Number val = luaL_checknumber(L, -1);
+			lua_pop(L, 1);
+
+			lua_pushnumber(L, convert(ltuning, val));
+			lua_seti(L, 2, i);
+		}
+
+		lua_settop(L, 2);
+		return 1;
+	}
+
+	lua_pushnumber(L, convert(ltuning, luaL_checknumber(L, 2)));
+	return 1;
+}
+
+__realtime static int
+_ltuning_midi2cps_(lua_State *L)
+{
+	return _ltuning_convert(L, _ltuning_midi2cps);
+}
+
+__realtime static int
+_ltuning_cps2midi_(lua_State *L)
+{
+	return _ltuning_convert(L, _ltuning_cps2midi);
+}
+
+__realtime static int
+_ltuning__len(lua_State *L)
+{
+	ltuning_t *ltuning = lua_touserdata(L, 1);
+
+	lua_pushinteger(L, ltuning->ndegrees);
+	return 1;
+}
+
+__realtime int
+_ltuning(lua_State *L)
+{
+	lua_settop(L, 3); // discard superfluous arguments
+	// 1: scale degrees || cents table
+	// 2: base note
+	// 3: reference frequency
+
+	const lua_Integer base = luaL_optinteger(L, 2, 69);
+	const lua_Number fref = luaL_optnumber(L, 3, 440.0);
+
+	luaL_argcheck(L, (base >= 0) && (base < MOONY_TUNING_NOTES), 2, "invalid base note");
+	luaL_argcheck(L, fref > 0.0, 3, "invalid reference frequency");
+
+	ltuning_t *ltuning = lua_newuserdata(L, sizeof(ltuning_t));
+	memset(ltuning, 0x0, sizeof(ltuning_t));
+
+	ltuning->base = base;
+	ltuning->fref = fref;
+
+	if(lua_istable(L, 1)) // cents of scale degrees, last one being the period
+	{
+		const lua_Integer n = luaL_len(L, 1);
+
+		luaL_argcheck(L, (n > 0) && (n <= MOONY_TUNING_DEGREES), 1, "invalid number of scale degrees");
+
+		ltuning->ndegrees = n;
+		for(lua_Integer i = 1; i <= n; i++)
+		{
+			lua_geti(L, 1, i);
+			ltuning->cents[i] = luaL_checknumber(L, -1);
+			lua_pop(L, 1);
+
+			luaL_argcheck(L, ltuning->cents[i] > ltuning->cents[i - 1], 1, "scale degrees not ascending");
+		}
+	}
+	else // equal temperament with given number of notes per octave
+	{
+		const lua_Integer n = luaL_optinteger(L, 1, 12);
+
+		luaL_argcheck(L, (n > 0) && (n <= MOONY_TUNING_DEGREES), 1, "invalid number of scale degrees");
+
+		ltuning->ndegrees = n;
+		for(lua_Integer i = 1; i <= n; i++)
+			ltuning->cents[i] = 1200.0 * i / n;
+	}
+
+	// precompute all integral MIDI notes
+	for(lua_Integer note = 0; note < MOONY_TUNING_NOTES; note++)
+		ltuning->cps[note] = fref * exp2(_ltuning_note_cents(ltuning, note) / 1200.0);
+
+	luaL_getmetatable(L, "ltuning");
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+const luaL_Reg ltuning_mt [] = {
+	{"midi2cps", _ltuning_midi2cps_},
+	{"cps2midi", _ltuning_cps2midi_},
+	{"__len", _ltuning__len},
+	{NULL, NULL}
+};
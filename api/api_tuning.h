@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_TUNING_H
+#define _MOONY_API_TUNING_H
+
+#include <moony.h>
+
+#define MOONY_TUNING_NOTES 0x80 // precomputed MIDI notes
+#define MOONY_TUNING_DEGREES 0x80 // max scale degrees per period
+
+typedef struct _ltuning_t ltuning_t;
+
+struct _ltuning_t {
+	lua_Integer base; // MIDI note corresponding to reference frequency
+	double fref; // reference frequency
+	unsigned ndegrees;
+	double cents [MOONY_TUNING_DEGREES + 1]; // ascending, [0] = 0, [ndegrees] = period
+	double cps [MOONY_TUNING_NOTES]; // frequencies of all integral MIDI notes
+};
+
+int
+_ltuning(lua_State *L);
+
+extern const luaL_Reg ltuning_mt [];
+
+#endif
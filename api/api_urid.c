@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <inttypes.h>
+
+#include <moony.h>
+
+#define MOONY_MAX_URI_LEN 0x400 // 1KB
+
+__non_realtime void
+moony_urid_cache_init(moony_urid_cache_t *cache, LV2_URID_Map *map,
+	LV2_URID_Unmap *unmap, LV2_Log_Logger *logger)
+{
+	memset(cache->items, 0x0, sizeof(cache->items));
+	memset(cache->idx, 0x0, sizeof(cache->idx));
+	cache->lock = (atomic_flag)ATOMIC_FLAG_INIT;
+	cache->nitems = 0;
+	atomic_init(&cache->saturated, false);
+
+	cache->map = map;
+	cache->unmap = unmap;
+	cache->logger = logger;
+}
+
+__non_realtime void
+moony_urid_cache_deinit(moony_urid_cache_t *cache)
+{
+	for(uint32_t i = 0; i < MOONY_URID_CACHE_LEN; i++)
+	{
+		moony_urid_item_t *item = &cache->items[i];
+		char *uri = (char *)atomic_load_explicit(&item->uri, memory_order_relaxed);
+
+		if(uri)
+			free(uri);
+	}
+}
+
+__non_realtime void
+moony_urid_cache_insert(moony_urid_cache_t *cache, const char *uri,
+	LV2_URID urid)
+{
+	const uint32_t mask = MOONY_URID_CACHE_LEN - 1;
+	const uint32_t hash = moony_urid_hash(uri);
+
+	_spin_lock(&cache->lock);
+
+	// skip already cached URIs
+	if(moony_urid_cache_map(cache, uri))
+	{
+		_unlock(&cache->lock);
+		return;
+	}
+
+	// keep load factor below 3/4, complain only once
+	if(cache->nitems >= MOONY_URID_CACHE_LEN*3/4)
+	{
+		const bool saturated = atomic_exchange_explicit(&cache->saturated, true,
+			memory_order_relaxed);
+
+		_unlock(&cache->lock);
+
+		if(!saturated && cache->logger && cache->logger->log)
+			lv2_log_warning(cache->logger, "URID cache saturated at %"PRIu32" URIs\n",
+				cache->nitems);
+		return;
+	}
+
+	char *dup = strdup(uri);
+	if(!dup)
+	{
+		_unlock(&cache->lock);
+		return;
+	}
+
+	uint32_t pos = hash & mask;
+	while(atomic_load_explicit(&cache->items[pos].uri, memory_order_relaxed))
+		pos = (pos + 1) & mask;
+
+	moony_urid_item_t *item = &cache->items[pos];
+	item->hash = hash;
+	item->urid = urid;
+	atomic_store_explicit(&item->uri, (uintptr_t)dup, memory_order_release);
+
+	uint32_t ipos = urid & mask;
+	while(atomic_load_explicit(&cache->idx[ipos], memory_order_relaxed))
+		ipos = (ipos + 1) & mask;
+
+	atomic_store_explicit(&cache->idx[ipos], pos + 1, memory_order_release);
+
+	cache->nitems++;
+
+	_unlock(&cache->lock);
+}
+
+__non_realtime LV2_URID
+moony_urid_cache_resolve(moony_urid_cache_t *cache, const char *uri)
+{
+	LV2_URID urid = moony_urid_cache_map(cache, uri);
+
+	if(!urid)
+	{
+		urid = cache->map->map(cache->map->handle, uri);
+
+		if(urid)
+			moony_urid_cache_insert(cache, uri, urid);
+	}
+
+	return urid;
+}
+
+__non_realtime const char *
+moony_urid_cache_resolve_uri(moony_urid_cache_t *cache, LV2_URID urid)
+{
+	const char *uri = moony_urid_cache_unmap(cache, urid);
+
+	if(!uri && cache->unmap)
+	{
+		uri = cache->unmap->unmap(cache->unmap->handle, urid);
+
+		if(uri)
+			moony_urid_cache_insert(cache, uri, urid);
+	}
+
+	return uri;
+}
+
+// map URIs in string literals of script code ahead of time
+__non_realtime void
+moony_urid_cache_prefetch(moony_urid_cache_t *cache, const char *chunk)
+{
+	char uri [MOONY_MAX_URI_LEN];
+
+	for(const char *ptr = chunk; *ptr; ptr++)
+	{
+		if( (*ptr != '\'') && (*ptr != '"') )
+			continue;
+
+		const char delim = *ptr;
+		const char *start = ptr + 1;
+		const char *end = start;
+
+		while(*end && (*end != delim) && (*end != '\n') && (*end != '\\') )
+			end++;
+
+		if(*end != delim)
+		{
+			ptr = *end ? end : end - 1;
+			continue; // unterminated or escaped string literal
+		}
+
+		const size_t len = end - start;
+		ptr = end;
+
+		if( (len == 0) || (len >= MOONY_MAX_URI_LEN) )
+			continue;
+
+		memcpy(uri, start, len);
+		uri[len] = '\0';
+
+		// only prefetch absolute URIs, but not prefixes thereof, e.g. for Mapper
+		if(  (!strstr(uri, "://") && strncmp(uri, "urn:", 4))
+			|| (uri[len-1] == '#') || (uri[len-1] == '/') || (uri[len-1] == ':') )
+			continue;
+
+		moony_urid_cache_resolve(cache, uri);
+	}
+}
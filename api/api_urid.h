@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _MOONY_API_URID_H
+#define _MOONY_API_URID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/log/logger.h>
+
+#define MOONY_URID_CACHE_LEN 0x1000 // 4K, must be power of 2
+
+typedef struct _moony_urid_item_t moony_urid_item_t;
+typedef struct _moony_urid_cache_t moony_urid_cache_t;
+
+struct _moony_urid_item_t {
+	atomic_uintptr_t uri; // published last
+	uint32_t hash;
+	LV2_URID urid;
+};
+
+// insert-only hash tables, realtime readers are lock-free, writers are
+// non-realtime and serialized with a spinlock
+struct _moony_urid_cache_t {
+	moony_urid_item_t items [MOONY_URID_CACHE_LEN]; // keyed by URI hash
+	atomic_uint idx [MOONY_URID_CACHE_LEN]; // item index + 1, keyed by URID
+	atomic_flag lock;
+	uint32_t nitems;
+	atomic_bool saturated; // no further URIs are cached once set
+
+	LV2_URID_Map *map;
+	LV2_URID_Unmap *unmap;
+	LV2_Log_Logger *logger;
+};
+
+__realtime static inline uint32_t
+moony_urid_hash(const char *uri)
+{
+	uint32_t hash = 0x811c9dc5;
+
+	for(const char *ptr = uri; *ptr; ptr++)
+	{
+		hash ^= (uint8_t)*ptr;
+		hash *= 0x01000193;
+	}
+
+	return hash;
+}
+
+// lookup URID of URI, 0 if not cached
+__realtime static inline LV2_URID
+moony_urid_cache_map(moony_urid_cache_t *cache, const char *uri)
+{
+	const uint32_t mask = MOONY_URID_CACHE_LEN - 1;
+	const uint32_t hash = moony_urid_hash(uri);
+
+	for(uint32_t i = 0, pos = hash & mask; i < MOONY_URID_CACHE_LEN; i++, pos = (pos + 1) & mask)
+	{
+		moony_urid_item_t *item = &cache->items[pos];
+		const char *item_uri = (const char *)atomic_load_explicit(&item->uri, memory_order_acquire);
+
+		if(!item_uri)
+			break; // end of probe sequence
+
+		if( (item->hash == hash) && !strcmp(item_uri, uri) )
+			return item->urid;
+	}
+
+	return 0;
+}
+
+// whether cache is full, e.g. cache requests are pointless
+__realtime static inline bool
+moony_urid_cache_saturated(moony_urid_cache_t *cache)
+{
+	return atomic_load_explicit(&cache->saturated, memory_order_relaxed);
+}
+
+// lookup URI of URID, NULL if not cached
+__realtime static inline const char *
+moony_urid_cache_unmap(moony_urid_cache_t *cache, LV2_URID urid)
+{
+	const uint32_t mask = MOONY_URID_CACHE_LEN - 1;
+
+	for(uint32_t i = 0, pos = urid & mask; i < MOONY_URID_CACHE_LEN; i++, pos = (pos + 1) & mask)
+	{
+		const uint32_t idx = atomic_load_explicit(&cache->idx[pos], memory_order_acquire);
+
+		if(!idx)
+			break; // end of probe sequence
+
+		moony_urid_item_t *item = &cache->items[idx - 1];
+
+		if(item->urid == urid)
+			return (const char *)atomic_load_explicit(&item->uri, memory_order_relaxed);
+	}
+
+	return NULL;
+}
+
+void
+moony_urid_cache_init(moony_urid_cache_t *cache, LV2_URID_Map *map,
+	LV2_URID_Unmap *unmap, LV2_Log_Logger *logger);
+
+void
+moony_urid_cache_deinit(moony_urid_cache_t *cache);
+
+void
+moony_urid_cache_insert(moony_urid_cache_t *cache, const char *uri,
+	LV2_URID urid);
+
+LV2_URID
+moony_urid_cache_resolve(moony_urid_cache_t *cache, const char *uri);
+
+const char *
+moony_urid_cache_resolve_uri(moony_urid_cache_t *cache, LV2_URID urid);
+
+void
+moony_urid_cache_prefetch(moony_urid_cache_t *cache, const char *chunk);
+
+#endif
@@ -24,6 +24,7 @@
 
 #include <moony.h>
 #include <api_vm.h>
+#include <api_profile.h>
 
 #include <lualib.h>
 #include <lauxlib.h>
@@ -130,11 +131,18 @@ lua_alloc(void *ud, void *ptr, size_t osize, size_t nsize)
 	if(nsize == 0)
 	{
 		if(ptr)
+		{
+			vm->nfree++;
 			moony_rt_free(vm, ptr, osize);
+		}
 		return NULL;
 	}
 	else
 	{
+		vm->nalloc++;
+		if( (vm->allocs.report || vm->allocs.strict) && (!ptr || (nsize > osize)) )
+			moony_profile_alloc(vm, ptr ? nsize - osize : nsize);
+
 		if(ptr)
 			return moony_rt_realloc(vm, ptr, osize, nsize);
 		else
@@ -150,6 +158,7 @@ moony_vm_new(size_t mem_size, bool testing, void *data)
 		return NULL;
 
 	vm->data = data;
+	moony_vm_udata_reset(vm);
 
 	// initialize array of increasing pool sizes
 	vm->size[0] = mem_size;
@@ -260,6 +269,9 @@ moony_vm_new(size_t mem_size, bool testing, void *data)
 __non_realtime void
 moony_vm_free(moony_vm_t *vm)
 {
+	if(vm->worker)
+		moony_vm_free(vm->worker);
+
 	if(vm->L)
 		lua_close(vm->L);
 
@@ -24,11 +24,40 @@
 // from vm.c
 #define MOONY_POOL_NUM 8
 #define MOONY_MAX_TRACE_LEN		0x800 // 2KB
+#define MOONY_MAX_SITES 16
+#define MOONY_MAX_SITE_LEN 64
+#define MOONY_MAX_UNSORTED		0x10 // 16
+
+typedef enum _moony_udata_t {
+	MOONY_UDATA_ATOM,
+	MOONY_UDATA_FORGE,
+	MOONY_UDATA_STASH,
+
+	MOONY_UDATA_COUNT
+} moony_udata_t;
+
+typedef enum _moony_upclosure_t {
+	MOONY_UPCLOSURE_TUPLE_FOREACH,
+	MOONY_UPCLOSURE_VECTOR_FOREACH,
+	MOONY_UPCLOSURE_OBJECT_FOREACH,
+	MOONY_UPCLOSURE_SEQUENCE_FOREACH,
+	MOONY_UPCLOSURE_SEQUENCE_MULTIPLEX,
+
+	MOONY_UPCLOSURE_COUNT
+} moony_upclosure_t;
 
 typedef enum _moony_job_enum_t moony_job_enum_t;
+typedef struct _moony_vm_site_t moony_vm_site_t;
 typedef struct _moony_vm_t moony_vm_t;
 typedef struct _moony_job_t moony_job_t;
 
+struct _moony_vm_site_t {
+	char src [MOONY_MAX_SITE_LEN];
+	int line;
+	uint32_t count;
+	size_t bytes;
+};
+
 struct _moony_vm_t {
 	tlsf_t tlsf;
 
@@ -39,18 +68,52 @@ struct _moony_vm_t {
 	size_t space;
 	size_t used;
 
+	uint64_t nalloc; // number of Lua (re)allocations
+	uint64_t nfree; // number of Lua deallocations
+
+	struct {
+		bool report; // report allocation sites of each period
+		bool strict; // raise error upon allocation after warm-up
+		bool violated;
+		uint32_t warmup; // periods left until strict mode applies
+		uint64_t count; // allocations in current period
+		size_t bytes;
+		unsigned nsites;
+		moony_vm_site_t sites [MOONY_MAX_SITES];
+		moony_vm_site_t violation;
+	} allocs;
+
 	lua_State *L;
 	bool nrt;
 	void *data;
 
 	bool allocating;
 	bool fully_extended;
+	bool restored;
 
 	bool trace_out;
 	bool trace_overflow;
 	char trace [MOONY_MAX_TRACE_LEN];
 
 	atom_ser_t ser;
+
+	void *stash_buf;
+	uint32_t stash_size;
+
+	double display_rate; // max inline display refresh rate, 0 for default
+
+	// per VM, as worker VM flags sequences of its own forges and stashes
+	struct {
+		LV2_Atom_Forge *forge;
+		LV2_Atom_Forge_Ref ref;
+	} unsorted [MOONY_MAX_UNSORTED]; // sequences to be sorted at end of period
+	unsigned nunsorted;
+
+	// udata cache, per VM as worker VM runs concurrently to realtime VM
+	int itr [MOONY_UDATA_COUNT];
+	int upc [MOONY_UPCLOSURE_COUNT];
+
+	moony_vm_t *worker; // sandboxed VM running 'work' callback, owned by worker
 };
 
 enum _moony_job_enum_t {
@@ -58,7 +121,15 @@ enum _moony_job_enum_t {
 	MOONY_JOB_MEM_FREE,
 	MOONY_JOB_VM_ALLOC,
 	MOONY_JOB_VM_FREE,
-	MOONY_JOB_PTR_FREE
+	MOONY_JOB_PTR_FREE,
+	MOONY_JOB_URID_CACHE,
+	MOONY_JOB_CAPTURE_OPEN,
+	MOONY_JOB_CAPTURE_DRAIN,
+	MOONY_JOB_CAPTURE_CLOSE,
+	MOONY_JOB_PROFILE_OPEN,
+	MOONY_JOB_PROFILE_DRAIN,
+	MOONY_JOB_PROFILE_CLOSE,
+	MOONY_JOB_WORK
 };
 
 struct _moony_job_t {
@@ -72,6 +143,18 @@ struct _moony_job_t {
 		moony_vm_t *vm;
 		void *ptr;
 		char chunk [0];
+		struct {
+			uint32_t urid;
+			char uri [0];
+		} urid;
+		struct {
+			int count;
+			char path [0];
+		} profile;
+		struct {
+			moony_vm_t *vm;
+			LV2_Atom atom [0];
+		} work;
 	};
 };
 
@@ -85,4 +168,23 @@ int moony_vm_mem_extend(moony_vm_t *vm);
 void moony_vm_nrt_enter(moony_vm_t *vm);
 void moony_vm_nrt_leave(moony_vm_t *vm);
 
+// VM owning given Lua state, which is the userdata of its allocator
+static inline moony_vm_t *
+moony_vm_get(lua_State *L)
+{
+	void *data;
+	lua_getallocf(L, &data);
+
+	return data;
+}
+
+static inline void
+moony_vm_udata_reset(moony_vm_t *vm)
+{
+	for(unsigned i=0; i<MOONY_UDATA_COUNT; i++)
+		vm->itr[i] = 1; // reset iterator
+	for(unsigned i=0; i<MOONY_UPCLOSURE_COUNT; i++)
+		vm->upc[i] = 1; // reset iterator
+}
+
 #endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <api_worker.h>
+#include <api_atom.h>
+#include <api_forge.h>
+#include <api_vm.h>
+
+// run 'work' callback of worker VM, its forged atom is handed back to the
+// realtime thread via ringbuffer
+__non_realtime void
+moony_worker_work(moony_t *moony, const moony_job_t *job)
+{
+	moony_vm_t *vm = job->work.vm;
+	lua_State *L = vm->L;
+
+	size_t max;
+	uint8_t *buf = varchunk_write_request_max(moony->to_dsp, sizeof(LV2_Atom), &max);
+	if(!buf)
+	{
+		if(moony->log)
+			lv2_log_error(&moony->logger, "worker: response buffer overflow\n");
+		return;
+	}
+
+	LV2_Atom_Forge *forge = &moony->worker_forge;
+	lv2_atom_forge_set_buffer(forge, buf, max);
+
+	moony_vm_udata_reset(vm); // cached udata is only valid within 'work'
+
+	if(lua_getglobal(L, "work") != LUA_TNIL)
+	{
+		// push atom
+		{
+			latom_t *latom = moony_newuserdata(L, moony, MOONY_UDATA_ATOM, false);
+			latom->atom = job->work.atom;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+		}
+
+		// push forge
+		{
+			lforge_t *lforge = moony_newuserdata(L, moony, MOONY_UDATA_FORGE, false);
+			lforge->depth = 0;
+			lforge->last.frames = 0;
+			lforge->forge = forge;
+		}
+
+		if(lua_pcall(L, 2, 0, 0))
+		{
+			moony_err_async(moony, lua_tostring(L, -1));
+			lua_pop(L, 1);
+
+			_lforge_unsorted_flush(moony, vm, NULL, false);
+			return;
+		}
+
+		// sort sequences flagged by worker VM before handing them back
+		_lforge_unsorted_flush(moony, vm, NULL, true);
+	}
+	else
+	{
+		lua_pop(L, 1);
+	}
+
+	// only hand back a single complete atom
+	const LV2_Atom *atom = (const LV2_Atom *)buf;
+	if( (forge->offset >= sizeof(LV2_Atom)) && (lv2_atom_total_size(atom) <= forge->offset) )
+		varchunk_write_advance(moony->to_dsp, lv2_atom_total_size(atom));
+}
+
+// dispatch responses of worker VM to 'work_response' callback
+__realtime void
+moony_worker_drain(moony_t *moony)
+{
+	lua_State *L = moony_current(moony);
+
+	size_t sz;
+	const LV2_Atom *atom;
+	while((atom = varchunk_read_request(moony->to_dsp, &sz)))
+	{
+		if(moony_bypass(moony))
+		{
+			// drop response
+		}
+		else if(lua_getglobal(L, "work_response") != LUA_TNIL)
+		{
+			latom_t *latom = moony_newuserdata(L, moony, MOONY_UDATA_ATOM, true);
+			latom->atom = atom;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+
+			if(lua_pcall(L, 1, 0, 0))
+				moony_error(moony);
+		}
+		else
+		{
+			lua_pop(L, 1); // nil
+		}
+
+		varchunk_read_advance(moony->to_dsp);
+	}
+}
+
+// Worker:post(atom) hands atom over to worker VM
+__realtime int
+_lworker_post(lua_State *L)
+{
+	moony_t *moony = lua_touserdata(L, lua_upvalueindex(1));
+	moony_vm_t *vm = lua_touserdata(L, lua_upvalueindex(2));
+	latom_t *latom = luaL_checkudata(L, 2, "latom");
+
+	if(vm->nrt) // jobs may only be queued from rt-thread
+		return luaL_error(L, "Worker:post: not callable from non-realtime context");
+
+	if(!vm->worker)
+		return luaL_error(L, "Worker:post: script code lacks a 'work' callback");
+
+	const size_t sz = sizeof(moony_job_t) + sizeof(LV2_Atom) + latom->atom->size;
+	moony_job_t *req;
+	if((req = varchunk_write_request(moony->from_dsp, sz)))
+	{
+		req->type = MOONY_JOB_WORK;
+		req->work.vm = vm->worker;
+		req->work.atom->size = latom->atom->size;
+		req->work.atom->type = latom->atom->type;
+		memcpy(LV2_ATOM_BODY(req->work.atom), latom->body.raw, latom->atom->size);
+
+		varchunk_write_advance(moony->from_dsp, sz);
+		if(moony_wake_worker(moony->sched) != LV2_WORKER_SUCCESS)
+			moony_trace(moony, "waking worker failed");
+
+		lua_pushboolean(L, 1);
+	}
+	else
+	{
+		lua_pushboolean(L, 0);
+	}
+
+	return 1;
+}
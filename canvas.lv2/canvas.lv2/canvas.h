@@ -32,6 +32,7 @@ extern "C" {
 #define CANVAS__graph             CANVAS_PREFIX"graph"
 #define CANVAS__body              CANVAS_PREFIX"body"
 #define CANVAS__aspectRatio       CANVAS_PREFIX"aspectRatio"
+#define CANVAS__layer             CANVAS_PREFIX"layer"
 
 // Graph properties and attributes
 #define CANVAS__BeginPath         CANVAS_PREFIX"BeginPath"
@@ -60,6 +61,7 @@ extern "C" {
 #define CANVAS__Reset             CANVAS_PREFIX"Reset"
 #define CANVAS__FontSize          CANVAS_PREFIX"FontSize"
 #define CANVAS__FillText          CANVAS_PREFIX"FillText"
+#define CANVAS__Layer             CANVAS_PREFIX"Layer"
 
 #define CANVAS__lineCapButt       CANVAS_PREFIX"lineCapButt"
 #define CANVAS__lineCapRound      CANVAS_PREFIX"lineCapRound"
@@ -86,6 +88,7 @@ struct _LV2_Canvas_URID  {
 	LV2_URID Canvas_graph;
 	LV2_URID Canvas_body;
 	LV2_URID Canvas_aspectRatio;
+	LV2_URID Canvas_layer;
 
 	LV2_URID Canvas_BeginPath;
 	LV2_URID Canvas_ClosePath;
@@ -113,6 +116,7 @@ struct _LV2_Canvas_URID  {
 	LV2_URID Canvas_Reset;
 	LV2_URID Canvas_FontSize;
 	LV2_URID Canvas_FillText;
+	LV2_URID Canvas_Layer;
 
 	LV2_URID Canvas_lineCapButt;
 	LV2_URID Canvas_lineCapRound;
@@ -140,6 +144,7 @@ lv2_canvas_urid_init(LV2_Canvas_URID *urid, LV2_URID_Map *map)
 	urid->Canvas_graph = map->map(map->handle, CANVAS__graph);
 	urid->Canvas_body = map->map(map->handle, CANVAS__body);
 	urid->Canvas_aspectRatio = map->map(map->handle, CANVAS__aspectRatio);
+	urid->Canvas_layer = map->map(map->handle, CANVAS__layer);
 
 	urid->Canvas_BeginPath = map->map(map->handle, CANVAS__BeginPath);
 	urid->Canvas_ClosePath = map->map(map->handle, CANVAS__ClosePath);
@@ -167,6 +172,7 @@ lv2_canvas_urid_init(LV2_Canvas_URID *urid, LV2_URID_Map *map)
 	urid->Canvas_Reset = map->map(map->handle, CANVAS__Reset);
 	urid->Canvas_FontSize = map->map(map->handle, CANVAS__FontSize);
 	urid->Canvas_FillText = map->map(map->handle, CANVAS__FillText);
+	urid->Canvas_Layer = map->map(map->handle, CANVAS__Layer);
 
 	urid->Canvas_lineCapButt = map->map(map->handle, CANVAS__lineCapButt);
 	urid->Canvas_lineCapRound = map->map(map->handle, CANVAS__lineCapRound);
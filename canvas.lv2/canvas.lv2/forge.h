@@ -319,6 +319,25 @@ lv2_canvas_forge_fillText(LV2_Atom_Forge *forge, LV2_Canvas_URID *urid,
 	return _lv2_canvas_forge_str(forge, urid, urid->Canvas_FillText, text);
 }
 
+// begin keyed layer, its body tuple is left open and needs to be popped twice
+static inline LV2_Atom_Forge_Ref
+lv2_canvas_forge_layer_head(LV2_Atom_Forge *forge, LV2_Canvas_URID *urid,
+	LV2_Atom_Forge_Frame frame [2], int32_t key)
+{
+	LV2_Atom_Forge_Ref ref;
+
+	if(  (ref = lv2_atom_forge_object(forge, &frame[0], 0, urid->Canvas_Layer))
+		&& (ref = lv2_atom_forge_key(forge, urid->Canvas_layer))
+		&& (ref = lv2_atom_forge_int(forge, key))
+		&& (ref = lv2_atom_forge_key(forge, urid->Canvas_body))
+		&& (ref = lv2_atom_forge_tuple(forge, &frame[1])) )
+	{
+		return ref;
+	}
+
+	return 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
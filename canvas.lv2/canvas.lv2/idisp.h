@@ -25,22 +25,36 @@ extern "C" {
 #include <canvas.lv2/render_cairo.h>
 #include <canvas.lv2/lv2_extensions.h>
 
+#define LV2_CANVAS_IDISP_NUM_SURFS 4 // cached renderings at different sizes
+
+typedef struct _LV2_Canvas_Idisp_Surf LV2_Canvas_Idisp_Surf;
 typedef struct _LV2_Canvas_Idisp LV2_Canvas_Idisp;
 
-struct _LV2_Canvas_Idisp {
-	LV2_Inline_Display *queue_draw;
-	LV2_Canvas canvas;
+struct _LV2_Canvas_Idisp_Surf {
 	LV2_Inline_Display_Image_Surface image_surface;
 	struct {
 		cairo_surface_t *surface;
 		cairo_t *ctx;
+		cairo_surface_t *layers [LV2_CANVAS_NUM_LAYERS]; // cached layer renderings
 	} cairo;
+	uint32_t layer_gen [LV2_CANVAS_NUM_LAYERS]; // generation of cached layers
+	uint32_t gen; // generation of rendered layers, 0 if invalid
+	uint32_t stamp; // time of last use
+};
+
+struct _LV2_Canvas_Idisp {
+	LV2_Inline_Display *queue_draw;
+	LV2_Canvas canvas;
+	LV2_Canvas_Layers layers;
+	LV2_Canvas_Idisp_Surf surfs [LV2_CANVAS_IDISP_NUM_SURFS];
+	LV2_Canvas_Idisp_Surf *surf; // currently configured
+	uint32_t stamp;
 };
 
 static inline LV2_Inline_Display_Image_Surface *
-_lv2_canvas_idisp_surf_init(LV2_Canvas_Idisp *idisp, int w, int h)
+_lv2_canvas_idisp_surf_init(LV2_Canvas_Idisp_Surf *isurf, int w, int h)
 {
-	LV2_Inline_Display_Image_Surface *surf = &idisp->image_surface;
+	LV2_Inline_Display_Image_Surface *surf = &isurf->image_surface;
 
 	surf->width = w;
 	surf->height = h;
@@ -51,40 +65,61 @@ _lv2_canvas_idisp_surf_init(LV2_Canvas_Idisp *idisp, int w, int h)
 		return NULL;
 	}
 
-	idisp->cairo.surface = cairo_image_surface_create_for_data(
+	isurf->cairo.surface = cairo_image_surface_create_for_data(
 		surf->data, CAIRO_FORMAT_ARGB32, surf->width, surf->height, surf->stride);
 
-	if(idisp->cairo.surface)
+	if(isurf->cairo.surface)
 	{
-		cairo_surface_set_device_scale(idisp->cairo.surface, surf->width, surf->height);
+		cairo_surface_set_device_scale(isurf->cairo.surface, surf->width, surf->height);
 
-		idisp->cairo.ctx = cairo_create(idisp->cairo.surface);
-		if(idisp->cairo.ctx)
+		isurf->cairo.ctx = cairo_create(isurf->cairo.surface);
+		if(isurf->cairo.ctx)
 		{
-			cairo_select_font_face(idisp->cairo.ctx, "cairo:monospace",
+			cairo_select_font_face(isurf->cairo.ctx, "cairo:monospace",
 				CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
 		}
 	}
 
+	isurf->gen = 0;
+
 	return surf;
 }
 
 static inline void
-_lv2_canvas_idisp_surf_deinit(LV2_Canvas_Idisp *idisp)
+_lv2_canvas_idisp_layer_free(LV2_Canvas_Idisp_Surf *isurf, uint32_t slot)
+{
+	cairo_surface_t **cache = &isurf->cairo.layers[slot];
+
+	if(*cache)
+	{
+		cairo_surface_destroy(*cache);
+		*cache = NULL;
+	}
+
+	isurf->layer_gen[slot] = 0;
+}
+
+static inline void
+_lv2_canvas_idisp_surf_deinit(LV2_Canvas_Idisp_Surf *isurf)
 {
-	LV2_Inline_Display_Image_Surface *surf = &idisp->image_surface;
+	LV2_Inline_Display_Image_Surface *surf = &isurf->image_surface;
 
-	if(idisp->cairo.ctx)
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
 	{
-		cairo_destroy(idisp->cairo.ctx);
-		idisp->cairo.ctx = NULL;
+		_lv2_canvas_idisp_layer_free(isurf, i);
 	}
 
-	if(idisp->cairo.surface)
+	if(isurf->cairo.ctx)
 	{
-		cairo_surface_finish(idisp->cairo.surface);
-		cairo_surface_destroy(idisp->cairo.surface);
-		idisp->cairo.surface = NULL;
+		cairo_destroy(isurf->cairo.ctx);
+		isurf->cairo.ctx = NULL;
+	}
+
+	if(isurf->cairo.surface)
+	{
+		cairo_surface_finish(isurf->cairo.surface);
+		cairo_surface_destroy(isurf->cairo.surface);
+		isurf->cairo.surface = NULL;
 	}
 
 	if(surf->data)
@@ -92,13 +127,19 @@ _lv2_canvas_idisp_surf_deinit(LV2_Canvas_Idisp *idisp)
 		free(surf->data);
 		surf->data = NULL;
 	}
+
+	surf->width = 0;
+	surf->height = 0;
+	isurf->gen = 0;
 }
 
+// reuses the surface of matching size, otherwise replaces the least recently
+// used one
 static inline LV2_Inline_Display_Image_Surface *
 lv2_canvas_idisp_surf_configure(LV2_Canvas_Idisp *idisp, 
 	uint32_t w, uint32_t h, float aspect_ratio)
 {
-	LV2_Inline_Display_Image_Surface *surf = &idisp->image_surface;
+	LV2_Canvas_Idisp_Surf *lru = &idisp->surfs[0];
 	int W;
 	int H;
 
@@ -118,13 +159,39 @@ lv2_canvas_idisp_surf_configure(LV2_Canvas_Idisp *idisp,
 		H = h;
 	}
 
-	if( (surf->width != W) || (surf->height != H) || !surf->data)
+	idisp->stamp++;
+	idisp->surf = NULL;
+
+	for(uint32_t i = 0; i < LV2_CANVAS_IDISP_NUM_SURFS; i++)
 	{
-		_lv2_canvas_idisp_surf_deinit(idisp);
-		surf = _lv2_canvas_idisp_surf_init(idisp, W, H);
+		LV2_Canvas_Idisp_Surf *isurf = &idisp->surfs[i];
+		LV2_Inline_Display_Image_Surface *surf = &isurf->image_surface;
+
+		if( (surf->width == W) && (surf->height == H) && surf->data)
+		{
+			isurf->stamp = idisp->stamp;
+			idisp->surf = isurf;
+
+			return surf;
+		}
+
+		if(isurf->stamp < lru->stamp)
+		{
+			lru = isurf;
+		}
 	}
 
-	return surf;
+	_lv2_canvas_idisp_surf_deinit(lru);
+	lru->stamp = idisp->stamp;
+
+	if(!_lv2_canvas_idisp_surf_init(lru, W, H))
+	{
+		return NULL;
+	}
+
+	idisp->surf = lru;
+
+	return &lru->image_surface;
 }
 
 static inline void
@@ -132,13 +199,20 @@ lv2_canvas_idisp_init(LV2_Canvas_Idisp *idisp, LV2_Inline_Display *queue_draw,
 	LV2_URID_Map *map)
 {
 	lv2_canvas_init(&idisp->canvas, map);
+	lv2_canvas_layers_init(&idisp->layers);
 	idisp->queue_draw = queue_draw;
 }
 
 static inline void
 lv2_canvas_idisp_deinit(LV2_Canvas_Idisp *idisp)
 {
-	_lv2_canvas_idisp_surf_deinit(idisp);
+	for(uint32_t i = 0; i < LV2_CANVAS_IDISP_NUM_SURFS; i++)
+	{
+		_lv2_canvas_idisp_surf_deinit(&idisp->surfs[i]);
+	}
+
+	idisp->surf = NULL;
+	lv2_canvas_layers_deinit(&idisp->layers);
 }
 
 static inline void
@@ -150,14 +224,138 @@ lv2_canvas_idisp_queue_draw(LV2_Canvas_Idisp *idisp)
 	}
 }
 
+// forces next render to redraw everything
+static inline void
+lv2_canvas_idisp_invalidate(LV2_Canvas_Idisp *idisp)
+{
+	for(uint32_t i = 0; i < LV2_CANVAS_IDISP_NUM_SURFS; i++)
+	{
+		LV2_Canvas_Idisp_Surf *isurf = &idisp->surfs[i];
+
+		isurf->gen = 0;
+		memset(isurf->layer_gen, 0x0, sizeof(isurf->layer_gen));
+	}
+}
+
 static inline bool
 lv2_canvas_idisp_render_body(LV2_Canvas_Idisp *idisp, uint32_t type,
 	uint32_t size, const LV2_Atom *body)
 {
-	return lv2_canvas_render_body(&idisp->canvas, idisp->cairo.ctx,
+	if(!idisp->surf || !idisp->surf->cairo.ctx)
+	{
+		return false;
+	}
+
+	idisp->surf->gen = 0; // layers not shown anymore
+
+	return lv2_canvas_render_body(&idisp->canvas, idisp->surf->cairo.ctx,
+		type, size, body);
+}
+
+static inline bool
+lv2_canvas_idisp_update_body(LV2_Canvas_Idisp *idisp, uint32_t type,
+	uint32_t size, const LV2_Atom *body)
+{
+	return lv2_canvas_layers_update_body(&idisp->canvas, &idisp->layers,
 		type, size, body);
 }
 
+static inline void
+_lv2_canvas_idisp_layer_render(LV2_Canvas_Idisp *idisp,
+	LV2_Canvas_Idisp_Surf *isurf, uint32_t slot)
+{
+	LV2_Inline_Display_Image_Surface *surf = &isurf->image_surface;
+	LV2_Canvas_Layer *layer = &idisp->layers.layer[slot];
+	cairo_surface_t **cache = &isurf->cairo.layers[slot];
+
+	if(!*cache)
+	{
+		*cache = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			surf->width, surf->height);
+		cairo_surface_set_device_scale(*cache, surf->width, surf->height);
+		isurf->layer_gen[slot] = 0;
+	}
+
+	if(isurf->layer_gen[slot] != layer->gen)
+	{
+		cairo_t *ctx = cairo_create(*cache);
+
+		cairo_select_font_face(ctx, "cairo:monospace",
+			CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+		lv2_canvas_render_list(&idisp->canvas, ctx, &layer->list);
+		cairo_destroy(ctx);
+
+		isurf->layer_gen[slot] = layer->gen;
+	}
+}
+
+// skips rendering when layers did not change since last render at this size.
+// A single layer is rendered straight to the display surface, multiple layers
+// are cached in surfaces of their own and only re-rendered when they change
+static inline bool
+lv2_canvas_idisp_render_layers(LV2_Canvas_Idisp *idisp)
+{
+	LV2_Canvas_Layers *layers = &idisp->layers;
+	LV2_Canvas_Idisp_Surf *isurf = idisp->surf;
+	cairo_t *ctx = isurf ? isurf->cairo.ctx : NULL;
+
+	if(!ctx)
+	{
+		return false;
+	}
+
+	if(isurf->gen == layers->gen)
+	{
+		return true; // unchanged
+	}
+
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		if(!layers->layer[i].used || (layers->norder <= 1) )
+		{
+			_lv2_canvas_idisp_layer_free(isurf, i);
+		}
+	}
+
+	if(layers->norder == 0)
+	{
+		_lv2_canvas_render_begin(ctx);
+		_lv2_canvas_render_end(ctx);
+	}
+	else if(layers->norder == 1)
+	{
+		LV2_Canvas_Layer *layer = &layers->layer[layers->order[0]];
+
+		lv2_canvas_render_list(&idisp->canvas, ctx, &layer->list);
+	}
+	else
+	{
+		for(uint32_t i = 0; i < layers->norder; i++)
+		{
+			_lv2_canvas_idisp_layer_render(idisp, isurf, layers->order[i]);
+		}
+
+		// composite cached layers
+		cairo_save(ctx);
+
+		cairo_set_operator(ctx, CAIRO_OPERATOR_CLEAR);
+		cairo_paint(ctx);
+
+		cairo_set_operator(ctx, CAIRO_OPERATOR_OVER);
+		for(uint32_t i = 0; i < layers->norder; i++)
+		{
+			cairo_set_source_surface(ctx, isurf->cairo.layers[layers->order[i]], 0, 0);
+			cairo_paint(ctx);
+		}
+
+		_lv2_canvas_render_end(ctx);
+	}
+
+	isurf->gen = layers->gen;
+
+	return true;
+}
+
 #ifdef __cplusplus
 }
 #endif
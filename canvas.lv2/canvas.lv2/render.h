@@ -21,11 +21,16 @@
 // Do NOT use this header directly, use render_{nanovg,cairo}.h instead
 #include <canvas.lv2/canvas.h>
 
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define LV2_CANVAS_NUM_METHODS 26
+#define LV2_CANVAS_POLYLINE_DECIMATE 0x100 // decimate polylines with more points
 
 typedef struct _LV2_Canvas_Meth LV2_Canvas_Meth;
 typedef struct _LV2_Canvas LV2_Canvas;
@@ -75,6 +80,635 @@ _lv2_canvas_render_get_type(const LV2_Atom *body, LV2_URID type)
 		: NULL;
 }
 
+typedef void (*LV2_Canvas_Line_To)(void *data, float x, float y);
+
+// Decimates a polyline to device pixel resolution. Runs of consecutive points
+// within the same pixel column are reduced to their first, lowest, highest and
+// last point, which rasterizes to virtually the same outline. m is the user to
+// device transform {xx, yx, xy, yy, x0, y0}, v holds n > 0 points, the first
+// point is expected to be moved to already.
+static inline void
+_lv2_canvas_render_polyline_decimate(void *data, LV2_Canvas_Line_To line_to,
+	const float m [6], const float *v, uint32_t n)
+{
+	uint32_t run [4] = {0, 0, 0, 0}; // first, lowest, highest, last
+	float col = floorf(m[0]*v[0] + m[2]*v[1] + m[4]);
+	float lo = m[1]*v[0] + m[3]*v[1] + m[5];
+	float hi = lo;
+	uint32_t last = 0; // last point drawn
+
+	for(uint32_t i = 1; i <= n; i++)
+	{
+		float x = 0.f;
+		float y = 0.f;
+
+		if(i < n)
+		{
+			const float *p = &v[2*i];
+
+			x = floorf(m[0]*p[0] + m[2]*p[1] + m[4]);
+			y = m[1]*p[0] + m[3]*p[1] + m[5];
+
+			if(x == col)
+			{
+				if(y < lo)
+				{
+					lo = y;
+					run[1] = i;
+				}
+				else if(y > hi)
+				{
+					hi = y;
+					run[2] = i;
+				}
+
+				run[3] = i;
+				continue;
+			}
+		}
+
+		// draw points of finished run in their original order
+		if(run[1] > run[2])
+		{
+			const uint32_t tmp = run[1];
+			run[1] = run[2];
+			run[2] = tmp;
+		}
+
+		for(unsigned j = 0; j < 4; j++)
+		{
+			if(run[j] > last)
+			{
+				last = run[j];
+				line_to(data, v[2*last], v[2*last + 1]);
+			}
+		}
+
+		run[0] = run[1] = run[2] = run[3] = i;
+		col = x;
+		lo = hi = y;
+	}
+}
+
+static inline void
+_lv2_canvas_qsort(LV2_Canvas_Meth *A, int n)
+{
+	if(n < 2)
+		return;
+
+	LV2_Canvas_Meth *p = A;
+
+	int i = -1;
+	int j = n;
+
+	while(true)
+	{
+		do {
+			i += 1;
+		} while(A[i].command < p->command);
+
+		do {
+			j -= 1;
+		} while(A[j].command > p->command);
+
+		if(i >= j)
+			break;
+
+		const LV2_Canvas_Meth tmp = A[i];
+		A[i] = A[j];
+		A[j] = tmp;
+	}
+
+	_lv2_canvas_qsort(A, j + 1);
+	_lv2_canvas_qsort(A + j + 1, n - j - 1);
+}
+
+static inline LV2_Canvas_Meth *
+_lv2_canvas_bsearch(LV2_URID p, LV2_Canvas_Meth *a, int n)
+{
+	LV2_Canvas_Meth *base = a;
+
+	for(int N = n, half; N > 1; N -= half)
+	{
+		half = N/2;
+		LV2_Canvas_Meth *dst = &base[half];
+		base = (dst->command > p) ? base : dst;
+	}
+
+	return (base->command == p) ? base : NULL;
+}
+
+// compiled display list, a flat array of commands with their bodies inlined,
+// built once per graph update and replayed on each redraw
+typedef struct _LV2_Canvas_Cmd LV2_Canvas_Cmd;
+typedef struct _LV2_Canvas_List LV2_Canvas_List;
+
+struct _LV2_Canvas_Cmd {
+	LV2_Canvas_Func func;
+	uint32_t size; // padded size of command including body
+	uint32_t pad;
+	LV2_Atom body; // followed by body contents
+};
+
+struct _LV2_Canvas_List {
+	uint8_t *cmds;
+	uint32_t size;
+	uint32_t max;
+};
+
+static inline void
+lv2_canvas_list_init(LV2_Canvas_List *list)
+{
+	list->cmds = NULL;
+	list->size = 0;
+	list->max = 0;
+}
+
+static inline void
+lv2_canvas_list_deinit(LV2_Canvas_List *list)
+{
+	free(list->cmds);
+	lv2_canvas_list_init(list);
+}
+
+static inline LV2_Canvas_Cmd *
+_lv2_canvas_list_append(LV2_Canvas_List *list, uint32_t size)
+{
+	if(list->size + size > list->max)
+	{
+		uint32_t max = list->max ? list->max : 0x1000; // 4K
+
+		while(list->size + size > max)
+		{
+			max <<= 1;
+		}
+
+		uint8_t *cmds = realloc(list->cmds, max);
+		if(!cmds)
+		{
+			return NULL;
+		}
+
+		list->cmds = cmds;
+		list->max = max;
+	}
+
+	LV2_Canvas_Cmd *cmd = (LV2_Canvas_Cmd *)&list->cmds[list->size];
+	list->size += size;
+
+	return cmd;
+}
+
+// command of next tuple item and its body, 0 if item is no command or at end
+static inline LV2_URID
+_lv2_canvas_list_next(LV2_Canvas_URID *urid, const LV2_Atom *tup,
+	uint32_t size, const LV2_Atom **itm, const LV2_Atom **body)
+{
+	*itm = lv2_atom_tuple_next(*itm);
+	*body = NULL;
+
+	if(lv2_atom_tuple_is_end(tup, size, *itm)
+		|| !lv2_atom_forge_is_object_type(&urid->forge, (*itm)->type))
+	{
+		return 0;
+	}
+
+	const LV2_Atom_Object *obj = (const LV2_Atom_Object *)*itm;
+
+	lv2_atom_object_get(obj, urid->Canvas_body, body, 0);
+
+	return obj->body.otype;
+}
+
+// orientation of rectangle, 0 if degenerate
+static inline int
+_lv2_canvas_list_rect_sign(LV2_Canvas_URID *urid, const LV2_Atom *body)
+{
+	const float *v = body
+		? _lv2_canvas_render_get_float_vec(urid, body, 4)
+		: NULL;
+
+	if(!v)
+		return 0;
+
+	const float a = v[2]*v[3];
+
+	return (a > 0.f) - (a < 0.f);
+}
+
+// whether the fill at itm is followed by an optional beginPath, a rectangle of
+// same orientation and another fill, e.g. the bars of a bar graph
+static inline bool
+_lv2_canvas_list_fill_mergeable(LV2_Canvas_URID *urid, const LV2_Atom *tup,
+	uint32_t size, const LV2_Atom *itm, int sign, bool *begin)
+{
+	const LV2_Atom *body;
+	LV2_URID cmd = _lv2_canvas_list_next(urid, tup, size, &itm, &body);
+
+	*begin = (cmd == urid->Canvas_BeginPath);
+
+	if(*begin)
+	{
+		cmd = _lv2_canvas_list_next(urid, tup, size, &itm, &body);
+	}
+
+	if( (cmd != urid->Canvas_Rectangle)
+		|| (_lv2_canvas_list_rect_sign(urid, body) != sign) )
+	{
+		return false;
+	}
+
+	cmd = _lv2_canvas_list_next(urid, tup, size, &itm, &body);
+
+	return cmd == urid->Canvas_Fill;
+}
+
+static inline bool
+lv2_canvas_list_compile_body(LV2_Canvas *canvas, LV2_Canvas_List *list,
+	uint32_t type, uint32_t size, const LV2_Atom *body)
+{
+	LV2_Canvas_URID *urid = &canvas->urid;
+	const LV2_Atom *tup = body;
+	bool empty = false; // path has just been begun
+	int sign = 0; // orientation of rectangles making up the whole path
+	bool merged = false; // fill merged into next one, skip next beginPath
+
+	list->size = 0;
+
+	if(!body || (type != urid->forge.Tuple) )
+		return false;
+
+	LV2_ATOM_TUPLE_BODY_FOREACH(body, size, itm)
+	{
+		if(lv2_atom_forge_is_object_type(&urid->forge, itm->type))
+		{
+			const LV2_Atom_Object *obj = (const LV2_Atom_Object *)itm;
+			const LV2_Atom *body = NULL;
+
+			lv2_atom_object_get(obj, urid->Canvas_body, &body, 0);
+
+			LV2_Canvas_Meth *meth = _lv2_canvas_bsearch(obj->body.otype,
+				canvas->methods, LV2_CANVAS_NUM_METHODS);
+
+			if(!meth)
+			{
+				continue;
+			}
+
+			// batch fills of consecutive rectangles of one style into a single
+			// fill of their union, rectangles of same orientation never cancel out
+			if(obj->body.otype == urid->Canvas_BeginPath)
+			{
+				if(merged)
+				{
+					merged = false;
+					continue;
+				}
+
+				empty = true;
+				sign = 0;
+			}
+			else if(obj->body.otype == urid->Canvas_Rectangle)
+			{
+				const int s = _lv2_canvas_list_rect_sign(urid, body);
+
+				sign = (empty || (sign == s)) ? s : 0;
+				empty = false;
+				merged = false;
+			}
+			else if( (obj->body.otype == urid->Canvas_Fill) && sign
+				&& _lv2_canvas_list_fill_mergeable(urid, tup, size, itm, sign, &merged) )
+			{
+				continue;
+			}
+			else
+			{
+				empty = false;
+				sign = 0;
+				merged = false;
+			}
+
+			const uint32_t body_size = body ? body->size : 0;
+			const uint32_t cmd_size = lv2_atom_pad_size(
+				sizeof(LV2_Canvas_Cmd) + body_size);
+
+			LV2_Canvas_Cmd *cmd = _lv2_canvas_list_append(list, cmd_size);
+			if(!cmd)
+			{
+				list->size = 0;
+				return false;
+			}
+
+			cmd->func = meth->func;
+			cmd->size = cmd_size;
+			cmd->pad = 0;
+
+			if(body)
+			{
+				memcpy(&cmd->body, body, sizeof(LV2_Atom) + body_size);
+			}
+			else // methods without arguments get an empty atom
+			{
+				cmd->body.size = 0;
+				cmd->body.type = 0;
+			}
+		}
+	}
+
+	return true;
+}
+
+static inline bool
+lv2_canvas_list_compile(LV2_Canvas *canvas, LV2_Canvas_List *list,
+	const LV2_Atom_Tuple *tup)
+{
+	return lv2_canvas_list_compile_body(canvas, list, tup->atom.type,
+		tup->atom.size, LV2_ATOM_BODY_CONST(&tup->atom));
+}
+
+static inline void
+_lv2_canvas_list_replay(LV2_Canvas *canvas, const LV2_Canvas_List *list,
+	void *ctx)
+{
+	for(uint32_t offset = 0; offset < list->size; )
+	{
+		const LV2_Canvas_Cmd *cmd = (const LV2_Canvas_Cmd *)&list->cmds[offset];
+
+		cmd->func(ctx, &canvas->urid, &cmd->body);
+
+		offset += cmd->size;
+	}
+}
+
+// content hash of atom body, used to skip unchanged graph updates
+static inline uint64_t
+lv2_canvas_hash(const void *data, uint32_t size)
+{
+	const uint64_t *words = data;
+	const uint32_t nwords = size / sizeof(uint64_t);
+	uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+
+	for(uint32_t i = 0; i < nwords; i++)
+	{
+		hash = (hash ^ words[i]) * 0x100000001b3ULL;
+	}
+
+	const uint8_t *tail = (const uint8_t *)&words[nwords];
+	for(uint32_t i = 0; i < size % sizeof(uint64_t); i++)
+	{
+		hash = (hash ^ tail[i]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// keyed layers, each with its own display list, rendered in ascending key
+// order. A graph made up of Canvas:Layer objects only updates the given
+// layers and keeps all others, a layer with an empty body is removed.
+// Any other graph replaces all layers with a single layer of key 0.
+// Renderers compare generations to find out what needs to be redrawn.
+#define LV2_CANVAS_NUM_LAYERS 16
+
+typedef struct _LV2_Canvas_Layer LV2_Canvas_Layer;
+typedef struct _LV2_Canvas_Layers LV2_Canvas_Layers;
+
+struct _LV2_Canvas_Layer {
+	LV2_Canvas_List list;
+	int32_t key;
+	bool used;
+	uint64_t hash; // of layer body
+	uint32_t gen; // generation of last change
+};
+
+struct _LV2_Canvas_Layers {
+	LV2_Canvas_Layer layer [LV2_CANVAS_NUM_LAYERS]; // slots are stable
+	uint32_t norder;
+	uint32_t order [LV2_CANVAS_NUM_LAYERS]; // used slots sorted by key
+	uint32_t gen; // bumped on every change
+};
+
+static inline void
+lv2_canvas_layers_init(LV2_Canvas_Layers *layers)
+{
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		LV2_Canvas_Layer *layer = &layers->layer[i];
+
+		lv2_canvas_list_init(&layer->list);
+		layer->key = 0;
+		layer->used = false;
+		layer->hash = 0;
+		layer->gen = 0;
+	}
+
+	layers->norder = 0;
+	layers->gen = 1; // renderers start at generation 0
+}
+
+static inline void
+lv2_canvas_layers_deinit(LV2_Canvas_Layers *layers)
+{
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		lv2_canvas_list_deinit(&layers->layer[i].list);
+	}
+
+	layers->norder = 0;
+}
+
+static inline void
+_lv2_canvas_layers_remove(LV2_Canvas_Layers *layers, LV2_Canvas_Layer *layer)
+{
+	if(layer->used)
+	{
+		layer->list.size = 0;
+		layer->used = false;
+		layers->gen++;
+	}
+}
+
+static inline LV2_Canvas_Layer *
+_lv2_canvas_layers_find(LV2_Canvas_Layers *layers, int32_t key)
+{
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		LV2_Canvas_Layer *layer = &layers->layer[i];
+
+		if(layer->used && (layer->key == key) )
+		{
+			return layer;
+		}
+	}
+
+	return NULL;
+}
+
+static inline LV2_Canvas_Layer *
+_lv2_canvas_layers_alloc(LV2_Canvas_Layers *layers, int32_t key)
+{
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		LV2_Canvas_Layer *layer = &layers->layer[i];
+
+		if(!layer->used)
+		{
+			layer->key = key;
+			layer->used = true;
+
+			return layer;
+		}
+	}
+
+	return NULL;
+}
+
+static inline bool
+_lv2_canvas_layers_compile(LV2_Canvas *canvas, LV2_Canvas_Layers *layers,
+	LV2_Canvas_Layer *layer, uint32_t size, const LV2_Atom *body, uint64_t hash)
+{
+	const bool success = lv2_canvas_list_compile_body(canvas, &layer->list,
+		canvas->urid.forge.Tuple, size, body);
+
+	layer->hash = success ? hash : 0; // compile failed body again next time
+	layer->gen = ++layers->gen;
+
+	return success;
+}
+
+static inline void
+_lv2_canvas_layers_sort(LV2_Canvas_Layers *layers)
+{
+	layers->norder = 0;
+
+	for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+	{
+		if(!layers->layer[i].used)
+		{
+			continue;
+		}
+
+		// insertion sort by key
+		uint32_t j = layers->norder++;
+		for( ; (j > 0) && (layers->layer[layers->order[j-1]].key
+			> layers->layer[i].key); j--)
+		{
+			layers->order[j] = layers->order[j-1];
+		}
+
+		layers->order[j] = i;
+	}
+}
+
+static inline bool
+lv2_canvas_layers_is_delta(LV2_Canvas_URID *urid, uint32_t type,
+	uint32_t size, const LV2_Atom *body)
+{
+	bool delta = false;
+
+	if(!body || (type != urid->forge.Tuple) )
+		return false;
+
+	LV2_ATOM_TUPLE_BODY_FOREACH(body, size, itm)
+	{
+		if(  !lv2_atom_forge_is_object_type(&urid->forge, itm->type)
+			|| (((const LV2_Atom_Object *)itm)->body.otype != urid->Canvas_Layer) )
+		{
+			return false;
+		}
+
+		delta = true;
+	}
+
+	return delta;
+}
+
+static inline bool
+lv2_canvas_layers_update_body(LV2_Canvas *canvas, LV2_Canvas_Layers *layers,
+	uint32_t type, uint32_t size, const LV2_Atom *body)
+{
+	LV2_Canvas_URID *urid = &canvas->urid;
+	bool success = true;
+
+	if(!body || (type != urid->forge.Tuple) )
+		return false;
+
+	if(!lv2_canvas_layers_is_delta(urid, type, size, body))
+	{
+		const uint64_t hash = lv2_canvas_hash(body, size);
+		LV2_Canvas_Layer *layer = _lv2_canvas_layers_find(layers, 0);
+
+		if( (layers->norder == 1) && layer && (layer->hash == hash) )
+		{
+			return true; // unchanged
+		}
+
+		for(uint32_t i = 0; i < LV2_CANVAS_NUM_LAYERS; i++)
+		{
+			_lv2_canvas_layers_remove(layers, &layers->layer[i]);
+		}
+
+		layer = _lv2_canvas_layers_alloc(layers, 0);
+		success = _lv2_canvas_layers_compile(canvas, layers, layer, size, body, hash);
+
+		_lv2_canvas_layers_sort(layers);
+
+		return success;
+	}
+
+	LV2_ATOM_TUPLE_BODY_FOREACH(body, size, itm)
+	{
+		const LV2_Atom_Object *obj = (const LV2_Atom_Object *)itm;
+		const LV2_Atom_Int *key = NULL;
+		const LV2_Atom *tup = NULL;
+
+		lv2_atom_object_get(obj,
+			urid->Canvas_layer, &key,
+			urid->Canvas_body, &tup,
+			0);
+
+		if(!key || (key->atom.type != urid->forge.Int) )
+		{
+			success = false;
+			continue;
+		}
+
+		LV2_Canvas_Layer *layer = _lv2_canvas_layers_find(layers, key->body);
+
+		if(!tup || (tup->type != urid->forge.Tuple) || (tup->size == 0) )
+		{
+			if(layer)
+			{
+				_lv2_canvas_layers_remove(layers, layer);
+			}
+
+			continue;
+		}
+
+		const uint64_t hash = lv2_canvas_hash(LV2_ATOM_BODY_CONST(tup), tup->size);
+
+		if(layer && (layer->hash == hash) )
+		{
+			continue; // unchanged
+		}
+
+		if(!layer && !(layer = _lv2_canvas_layers_alloc(layers, key->body)) )
+		{
+			success = false;
+			continue;
+		}
+
+		if(!_lv2_canvas_layers_compile(canvas, layers, layer,
+			tup->size, LV2_ATOM_BODY_CONST(tup), hash))
+		{
+			success = false;
+		}
+	}
+
+	_lv2_canvas_layers_sort(layers);
+
+	return success;
+}
+
 #ifdef __cplusplus
 }
 #endif
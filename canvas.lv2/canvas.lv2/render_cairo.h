@@ -111,6 +111,13 @@ _lv2_canvas_render_rectangle(void *data,
 	}
 }
 
+static inline void
+_lv2_canvas_render_line_to(void *data, float x, float y)
+{
+	cairo_t *ctx = data;
+	cairo_line_to(ctx, x, y);
+}
+
 static inline void
 _lv2_canvas_render_polyline(void *data,
 	LV2_Canvas_URID *urid, const LV2_Atom *body)
@@ -118,17 +125,40 @@ _lv2_canvas_render_polyline(void *data,
 	cairo_t *ctx = data;
 	uint32_t N;
 	const float *v = _lv2_canvas_render_get_float_vecs(urid, body, &N);
+	const uint32_t n = N / 2; // points
 
-	if(v)
+	if(!v || !n)
 	{
-		for(uint32_t i = 0; i < 2; i += 2)
-		{
-			cairo_move_to(ctx, v[i], v[i+1]);
-		}
+		return;
+	}
+
+	cairo_move_to(ctx, v[0], v[1]);
 
-		for(uint32_t i = 2; i < N; i += 2)
+	if(n > LV2_CANVAS_POLYLINE_DECIMATE)
+	{
+		// user to device pixel transform, surfaces may be scaled to unit size
+		cairo_surface_t *surf = cairo_get_target(ctx);
+		cairo_matrix_t mat;
+		double sx, sy, ox, oy;
+
+		cairo_get_matrix(ctx, &mat);
+		cairo_surface_get_device_scale(surf, &sx, &sy);
+		cairo_surface_get_device_offset(surf, &ox, &oy);
+
+		const float m [6] = {
+			mat.xx*sx, mat.yx*sy,
+			mat.xy*sx, mat.yy*sy,
+			mat.x0*sx + ox, mat.y0*sy + oy
+		};
+
+		_lv2_canvas_render_polyline_decimate(ctx, _lv2_canvas_render_line_to,
+			m, v, n);
+	}
+	else
+	{
+		for(uint32_t i = 1; i < n; i++)
 		{
-			cairo_line_to(ctx, v[i], v[i+1]);
+			cairo_line_to(ctx, v[2*i], v[2*i + 1]);
 		}
 	}
 }
@@ -381,54 +411,6 @@ _lv2_canvas_render_fillText(void *data,
 	}
 }
 
-static inline void
-_lv2_canvas_qsort(LV2_Canvas_Meth *A, int n)
-{
-	if(n < 2)
-		return;
-
-	LV2_Canvas_Meth *p = A;
-
-	int i = -1;
-	int j = n;
-
-	while(true)
-	{
-		do {
-			i += 1;
-		} while(A[i].command < p->command);
-
-		do {
-			j -= 1;
-		} while(A[j].command > p->command);
-
-		if(i >= j)
-			break;
-
-		const LV2_Canvas_Meth tmp = A[i];
-		A[i] = A[j];
-		A[j] = tmp;
-	}
-
-	_lv2_canvas_qsort(A, j + 1);
-	_lv2_canvas_qsort(A + j + 1, n - j - 1);
-}
-
-static inline LV2_Canvas_Meth *
-_lv2_canvas_bsearch(LV2_URID p, LV2_Canvas_Meth *a, int n)
-{
-	LV2_Canvas_Meth *base = a;
-
-	for(int N = n, half; N > 1; N -= half)
-	{
-		half = N/2;
-		LV2_Canvas_Meth *dst = &base[half];
-		base = (dst->command > p) ? base : dst;
-	}
-
-	return (base->command == p) ? base : NULL;
-}
-
 static inline void
 lv2_canvas_init(LV2_Canvas *canvas, LV2_URID_Map *map)
 {
@@ -519,15 +501,19 @@ lv2_canvas_init(LV2_Canvas *canvas, LV2_URID_Map *map)
 	_lv2_canvas_qsort(canvas->methods, LV2_CANVAS_NUM_METHODS);
 }
 
-static inline bool
-lv2_canvas_render_body(LV2_Canvas *canvas, cairo_t *ctx, uint32_t type,
-	uint32_t size, const LV2_Atom *body)
+static inline void
+_lv2_canvas_render_defaults(cairo_t *ctx)
 {
-	LV2_Canvas_URID *urid = &canvas->urid;
-
-	if(!body || (type != urid->forge.Tuple) )
-		return false;
+	// default attributes
+	cairo_set_operator(ctx, CAIRO_OPERATOR_SOURCE);
+	cairo_set_font_size(ctx, 0.1);
+	cairo_set_line_width(ctx, 0.01);
+	cairo_set_source_rgba(ctx, 1.0, 1.0, 1.0, 1.0);
+}
 
+static inline void
+_lv2_canvas_render_begin(cairo_t *ctx)
+{
 	// save state
 	cairo_save(ctx);
 
@@ -535,11 +521,30 @@ lv2_canvas_render_body(LV2_Canvas *canvas, cairo_t *ctx, uint32_t type,
 	cairo_set_operator(ctx, CAIRO_OPERATOR_CLEAR);
 	cairo_paint(ctx);
 
-	// default attributes
-	cairo_set_operator(ctx, CAIRO_OPERATOR_SOURCE);
-	cairo_set_font_size(ctx, 0.1);
-	cairo_set_line_width(ctx, 0.01);
-	cairo_set_source_rgba(ctx, 1.0, 1.0, 1.0, 1.0);
+	_lv2_canvas_render_defaults(ctx);
+}
+
+static inline void
+_lv2_canvas_render_end(cairo_t *ctx)
+{
+	// save state
+	cairo_restore(ctx);
+
+	// flush
+	cairo_surface_t *surface = cairo_get_target(ctx);
+	cairo_surface_flush(surface);
+}
+
+static inline bool
+lv2_canvas_render_body(LV2_Canvas *canvas, cairo_t *ctx, uint32_t type,
+	uint32_t size, const LV2_Atom *body)
+{
+	LV2_Canvas_URID *urid = &canvas->urid;
+
+	if(!body || (type != urid->forge.Tuple) )
+		return false;
+
+	_lv2_canvas_render_begin(ctx);
 
 	LV2_ATOM_TUPLE_BODY_FOREACH(body, size, itm)
 	{
@@ -560,12 +565,18 @@ lv2_canvas_render_body(LV2_Canvas *canvas, cairo_t *ctx, uint32_t type,
 		}
 	}
 
-	// save state
-	cairo_restore(ctx);
+	_lv2_canvas_render_end(ctx);
 
-	// flush
-	cairo_surface_t *surface = cairo_get_target(ctx);
-	cairo_surface_flush(surface);
+	return true;
+}
+
+static inline bool
+lv2_canvas_render_list(LV2_Canvas *canvas, cairo_t *ctx,
+	const LV2_Canvas_List *list)
+{
+	_lv2_canvas_render_begin(ctx);
+	_lv2_canvas_list_replay(canvas, list, ctx);
+	_lv2_canvas_render_end(ctx);
 
 	return true;
 }
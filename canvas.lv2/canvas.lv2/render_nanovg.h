@@ -140,6 +140,13 @@ _lv2_canvas_render_rectangle(void *data,
 	}
 }
 
+static inline void
+_lv2_canvas_render_line_to(void *data, float x, float y)
+{
+	NVGcontext *ctx = data;
+	nvgLineTo(ctx, x, y);
+}
+
 static inline void
 _lv2_canvas_render_polyline(void *data,
 	LV2_Canvas_URID *urid, const LV2_Atom *body)
@@ -147,17 +154,29 @@ _lv2_canvas_render_polyline(void *data,
 	NVGcontext *ctx = data;
 	uint32_t N;
 	const float *v = _lv2_canvas_render_get_float_vecs(urid, body, &N);
+	const uint32_t n = N / 2; // points
 
-	if(v)
+	if(!v || !n)
 	{
-		for(uint32_t i = 0; i < 2; i += 2)
-		{
-			nvgMoveTo(ctx, v[i], v[i+1]);
-		}
+		return;
+	}
+
+	nvgMoveTo(ctx, v[0], v[1]);
 
-		for(uint32_t i = 2; i < N; i += 2)
+	if(n > LV2_CANVAS_POLYLINE_DECIMATE)
+	{
+		float m [6];
+
+		nvgCurrentTransform(ctx, m);
+
+		_lv2_canvas_render_polyline_decimate(ctx, _lv2_canvas_render_line_to,
+			m, v, n);
+	}
+	else
+	{
+		for(uint32_t i = 1; i < n; i++)
 		{
-			nvgLineTo(ctx, v[i], v[i+1]);
+			nvgLineTo(ctx, v[2*i], v[2*i + 1]);
 		}
 	}
 }
@@ -406,54 +425,6 @@ _lv2_canvas_render_fillText(void *data,
 	}
 }
 
-static inline void
-_lv2_canvas_qsort(LV2_Canvas_Meth *A, int n)
-{
-	if(n < 2)
-		return;
-
-	LV2_Canvas_Meth *p = A;
-
-	int i = -1;
-	int j = n;
-
-	while(true)
-	{
-		do {
-			i += 1;
-		} while(A[i].command < p->command);
-
-		do {
-			j -= 1;
-		} while(A[j].command > p->command);
-
-		if(i >= j)
-			break;
-
-		const LV2_Canvas_Meth tmp = A[i];
-		A[i] = A[j];
-		A[j] = tmp;
-	}
-
-	_lv2_canvas_qsort(A, j + 1);
-	_lv2_canvas_qsort(A + j + 1, n - j - 1);
-}
-
-static inline LV2_Canvas_Meth *
-_lv2_canvas_bsearch(LV2_URID p, LV2_Canvas_Meth *a, int n)
-{
-	LV2_Canvas_Meth *base = a;
-
-	for(int N = n, half; N > 1; N -= half)
-	{
-		half = N/2;
-		LV2_Canvas_Meth *dst = &base[half];
-		base = (dst->command > p) ? base : dst;
-	}
-
-	return (base->command == p) ? base : NULL;
-}
-
 static inline void
 lv2_canvas_init(LV2_Canvas *canvas, LV2_URID_Map *map)
 {
@@ -544,15 +515,19 @@ lv2_canvas_init(LV2_Canvas *canvas, LV2_URID_Map *map)
 	_lv2_canvas_qsort(canvas->methods, LV2_CANVAS_NUM_METHODS);
 }
 
-static inline bool
-lv2_canvas_render_body(LV2_Canvas *canvas, NVGcontext *ctx, uint32_t type,
-	uint32_t size, const LV2_Atom *body)
+static inline void
+_lv2_canvas_render_defaults(NVGcontext *ctx)
 {
-	LV2_Canvas_URID *urid = &canvas->urid;
-
-	if(!body || (type != urid->forge.Tuple) )
-		return false;
+	// default attributes
+	nvgFontSize(ctx, 0.1);
+	nvgStrokeWidth(ctx, 0.01);
+	nvgStrokeColor(ctx, nvgRGBA(0xff, 0xff, 0xff, 0xff));
+	nvgFillColor(ctx, nvgRGBA(0xff, 0xff, 0xff, 0xff));
+}
 
+static inline void
+_lv2_canvas_render_begin(NVGcontext *ctx)
+{
 	// save state
 	nvgSave(ctx);
 
@@ -562,10 +537,26 @@ lv2_canvas_render_body(LV2_Canvas *canvas, NVGcontext *ctx, uint32_t type,
 	nvgFillColor(ctx, nvgRGBA(0x1e, 0x1e, 0x1e, 0xff));
 	nvgFill(ctx);
 
-	nvgFontSize(ctx, 0.1);
-	nvgStrokeWidth(ctx, 0.01);
-	nvgStrokeColor(ctx, nvgRGBA(0xff, 0xff, 0xff, 0xff));
-	nvgFillColor(ctx, nvgRGBA(0xff, 0xff, 0xff, 0xff));
+	_lv2_canvas_render_defaults(ctx);
+}
+
+static inline void
+_lv2_canvas_render_end(NVGcontext *ctx)
+{
+	// save state
+	nvgRestore(ctx);
+}
+
+static inline bool
+lv2_canvas_render_body(LV2_Canvas *canvas, NVGcontext *ctx, uint32_t type,
+	uint32_t size, const LV2_Atom *body)
+{
+	LV2_Canvas_URID *urid = &canvas->urid;
+
+	if(!body || (type != urid->forge.Tuple) )
+		return false;
+
+	_lv2_canvas_render_begin(ctx);
 
 	LV2_ATOM_TUPLE_BODY_FOREACH(body, size, itm)
 	{
@@ -586,8 +577,40 @@ lv2_canvas_render_body(LV2_Canvas *canvas, NVGcontext *ctx, uint32_t type,
 		}
 	}
 
-	// save state
-	nvgRestore(ctx);
+	_lv2_canvas_render_end(ctx);
+
+	return true;
+}
+
+static inline bool
+lv2_canvas_render_list(LV2_Canvas *canvas, NVGcontext *ctx,
+	const LV2_Canvas_List *list)
+{
+	_lv2_canvas_render_begin(ctx);
+	_lv2_canvas_list_replay(canvas, list, ctx);
+	_lv2_canvas_render_end(ctx);
+
+	return true;
+}
+
+// layers are replayed on top of each other, each with default attributes
+static inline bool
+lv2_canvas_render_layers(LV2_Canvas *canvas, NVGcontext *ctx,
+	LV2_Canvas_Layers *layers)
+{
+	_lv2_canvas_render_begin(ctx);
+
+	for(uint32_t i = 0; i < layers->norder; i++)
+	{
+		LV2_Canvas_Layer *layer = &layers->layer[layers->order[i]];
+
+		nvgSave(ctx);
+		_lv2_canvas_render_defaults(ctx);
+		_lv2_canvas_list_replay(canvas, &layer->list, ctx);
+		nvgRestore(ctx);
+	}
+
+	_lv2_canvas_render_end(ctx);
 
 	return true;
 }
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdatomic.h>
+#include <time.h>
 
 #if !defined(_WIN32)
 #	include <sys/mman.h>
@@ -74,6 +75,8 @@ typedef struct _LV2_Canvas_Idisp LV2_Canvas_Idisp;
 #define __realtime __attribute__((annotate("realtime")))
 #define __non_realtime __attribute__((annotate("non-realtime")))
 
+#include <api_urid.h>
+
 #ifdef LV2_ATOM_TUPLE_FOREACH
 #	undef LV2_ATOM_TUPLE_FOREACH
 #	define LV2_ATOM_TUPLE_FOREACH(tuple, iter) \
@@ -84,15 +87,26 @@ typedef struct _LV2_Canvas_Idisp LV2_Canvas_Idisp;
 
 #define MOONY_MAX_CHUNK_LEN		0x20000 // 128KB
 #define MOONY_MAX_ERROR_LEN		0x800 // 2KB
+#define MOONY_MAX_FRAGMENT_LEN	0x800 // 2KB, code transferred per fragment
+#define MOONY_FRAGMENTS_PER_IDLE	2 // code fragments sent by UI per idle call
+#define MOONY_MAX_PROPS				0x400 // 1K, must be power of 2
+#define MOONY_PROPS_PER_PERIOD	16
+#define MOONY_MAX_GRAPHS			0x20 // 32, canvas graphs coalesced per period
+#define MOONY_DISPLAY_RATE		30.0 // default max inline display refresh rate [Hz]
+#define MOONY_UI_RATE					60.0 // default max UI refresh rate [Hz]
+#define MOONY_UI_HIDDEN_RATE	4.0 // UI event polling rate while hidden [Hz]
 
 #define MOONY_URI							"http://open-music-kontrollers.ch/lv2/moony"
 #define MOONY_PREFIX					MOONY_URI"#"
 
 #define MOONY_CODE_URI				MOONY_URI"#code"
+#define MOONY_CODE_HASH_URI		MOONY_URI"#codeHash"
 #define MOONY_ERROR_URI				MOONY_URI"#error"
 #define MOONY_TRACE_URI				MOONY_URI"#trace"
 #define MOONY_STATE_URI				MOONY_URI"#state"
 #define MOONY_PANIC_URI				MOONY_URI"#panic"
+#define MOONY_CAPTURE_URI			MOONY_URI"#capture"
+#define MOONY_PROFILE_URI			MOONY_URI"#profile"
 
 #define MOONY__color					MOONY_URI"#color"
 #define MOONY__syntax					MOONY_URI"#syntax"
@@ -141,24 +155,6 @@ extern const LV2UI_Descriptor nk_ui;
 extern const LV2UI_Descriptor simple_ui;
 extern const LV2UI_Descriptor simple_kx;
 
-typedef enum _moony_udata_t {
-	MOONY_UDATA_ATOM,
-	MOONY_UDATA_FORGE,
-	MOONY_UDATA_STASH,
-
-	MOONY_UDATA_COUNT
-} moony_udata_t;
-
-typedef enum _moony_upclosure_t {
-	MOONY_UPCLOSURE_TUPLE_FOREACH,
-	MOONY_UPCLOSURE_VECTOR_FOREACH,
-	MOONY_UPCLOSURE_OBJECT_FOREACH,
-	MOONY_UPCLOSURE_SEQUENCE_FOREACH,
-	MOONY_UPCLOSURE_SEQUENCE_MULTIPLEX,
-
-	MOONY_UPCLOSURE_COUNT
-} moony_upclosure_t;
-
 // from api_atom.c
 typedef struct _lheader_t lheader_t;
 typedef struct _latom_driver_t latom_driver_t;
@@ -178,6 +174,11 @@ struct _latom_driver_hash_t {
 
 // from moony.c
 typedef struct _patch_t patch_t;
+typedef struct _moony_stats_t moony_stats_t;
+typedef struct _moony_prop_t moony_prop_t;
+typedef struct _moony_capture_t moony_capture_t;
+typedef struct _moony_profile_t moony_profile_t;
+typedef struct _moony_xfer_t moony_xfer_t;
 typedef struct _moony_t moony_t;
 
 struct _patch_t {
@@ -206,6 +207,28 @@ struct _patch_t {
 	LV2_URID insert;
 };
 
+struct _moony_stats_t {
+	uint32_t size;
+	uint64_t nanos;
+};
+
+struct _moony_prop_t {
+	LV2_URID key;
+	LV2_URID access;
+	uint32_t hash;
+	uint32_t gen; // registration which has synced it last, 0 if orphaned
+};
+
+// chunked transfer of code, fragments of MOONY_MAX_FRAGMENT_LEN bytes are sent
+// as patch:Set of moony:code with a tuple value of [hash, sequence number,
+// size, fragment], a tuple of [hash, size] announces code without sending it
+struct _moony_xfer_t {
+	uint64_t hash; // of whole code
+	uint32_t size; // of whole code without terminating zero
+	uint32_t seq; // sequence number of next fragment
+	uint32_t nseqs; // number of fragments, 0 when idle
+};
+
 struct _moony_t {
 	LV2_URID_Map *map;
 	LV2_URID_Unmap *unmap;
@@ -224,9 +247,12 @@ struct _moony_t {
 
 	struct {
 		LV2_URID moony_code;
+		LV2_URID moony_codeHash;
 		LV2_URID moony_error;
 		LV2_URID moony_trace;
 		LV2_URID moony_panic;
+		LV2_URID moony_capture;
+		LV2_URID moony_profile;
 		LV2_URID moony_state;
 		LV2_URID moony_editorHidden;
 		LV2_URID moony_graphHidden;
@@ -291,7 +317,8 @@ struct _moony_t {
 	LV2_Canvas_URID canvas_urid;
 	LV2_Canvas_Idisp *canvas_idisp;
 	varchunk_t *to_idisp;
-	LV2_Atom *canvas_graph;
+	bool idisp_pending; // redraw to be queued once rate limit allows
+	uint64_t idisp_last; // time of last queued redraw
 
 	moony_vm_t *vm;
 	atomic_uintptr_t vm_new;
@@ -299,22 +326,38 @@ struct _moony_t {
 	bool once;
 	bool error_out;
 
-	// udata cache
-	int itr [MOONY_UDATA_COUNT];
-	int upc [MOONY_UPCLOSURE_COUNT];
-
 	atomic_flag state_lock;
 
 	LV2_Atom *state_atom;
 	atomic_uintptr_t state_atom_new;
 
+	moony_stats_t save_stats;
+	moony_stats_t restore_stats;
+
 	LV2_Atom *stash_atom;
 	uint32_t stash_size;
+	atomic_uint stash_hint;
+
+	moony_urid_cache_t urid_cache; // shared by all VMs
+
+	moony_prop_t props [MOONY_MAX_PROPS]; // properties registered to UI
+	uint32_t nprops;
+	uint32_t props_gen; // last registration
+	bool props_pending; // registrations are to be continued
+	bool props_stale; // registrations in period after code reload only send changes
+	bool props_synced; // registration has followed code reload
 
 	varchunk_t *from_dsp;
+	varchunk_t *to_dsp; // worker VM responses to realtime thread
+	LV2_Atom_Forge worker_forge; // owned by worker thread
+
+	moony_capture_t *capture; // owned by realtime thread while capturing
+	moony_profile_t *profile; // owned by realtime thread while profiling
 
 	latom_driver_hash_t atom_driver_hash [DRIVER_HASH_MAX];
 
+	double midi2cps [0x80]; // integral notes with default tuning
+
 	size_t mem_size;
 	bool testing;
 
@@ -331,8 +374,14 @@ struct _moony_t {
 	atomic_uintptr_t err_new;
 
 	char chunk [MOONY_MAX_CHUNK_LEN];
+	uint64_t chunk_hash;
 	atomic_uintptr_t chunk_new;
 	char *chunk_nrt;
+
+	moony_xfer_t code_out; // chunked transfer of chunk to UI
+	bool code_fragments; // UI has asked for chunk with moony:codeHash
+	moony_xfer_t code_in; // chunked transfer of code from UI
+	char code_in_buf [MOONY_MAX_CHUNK_LEN];
 };
 
 // in api.c
@@ -347,13 +396,24 @@ const void* extension_data(const char* uri);
 void *moony_newuserdata(lua_State *L, moony_t *moony, moony_udata_t type, bool cache);
 LV2_Worker_Status moony_wake_worker(const LV2_Worker_Schedule *work_sched);
 
+// in api_capture.c
+void moony_capture(moony_t *moony, uint32_t nsamples, const LV2_Atom_Sequence *control,
+	const float *const *vals, unsigned nvals,
+	const LV2_Atom_Sequence *const *seqs, unsigned nseqs);
+
+// in api_profile.c
+void moony_profile(moony_t *moony);
+
+// in api_forge.c
+void moony_sort(moony_t *moony);
+
+// in api_worker.c
+void moony_worker_drain(moony_t *moony);
+
 __realtime static inline void
 moony_freeuserdata(moony_t *moony)
 {
-	for(unsigned i=0; i<MOONY_UDATA_COUNT; i++)
-		moony->itr[i] = 1; // reset iterator
-	for(unsigned i=0; i<MOONY_UPCLOSURE_COUNT; i++)
-		moony->upc[i] = 1; // reset iterator
+	moony_vm_udata_reset(moony->vm);
 }
 
 __realtime static inline bool
@@ -413,6 +473,15 @@ moony_trace(moony_t *moony, const char *msg)
 		lv2_log_trace(&moony->logger, "%s\n", err);
 }
 
+__realtime static inline uint64_t
+moony_nanos(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 __realtime static inline lua_State *
 moony_current(moony_t *moony)
 {
@@ -461,6 +530,175 @@ _moony_patch(patch_t *patch, LV2_Atom_Forge *forge, LV2_URID key,
 	return 0; // overflow
 }
 
+typedef enum _moony_xfer_status_t {
+	MOONY_XFER_PENDING = 0,
+	MOONY_XFER_COMPLETE,
+	MOONY_XFER_ANNOUNCED
+} moony_xfer_status_t;
+
+// FNV-1a
+__realtime static inline uint64_t
+moony_hash(const char *str, uint32_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for(uint32_t i = 0; i < size; i++)
+	{
+		hash ^= (uint8_t)str[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+__realtime static inline void
+_moony_xfer_start(moony_xfer_t *xfer, uint32_t size, uint64_t hash)
+{
+	xfer->hash = hash;
+	xfer->size = size;
+	xfer->seq = 0;
+	xfer->nseqs = size
+		? (size + MOONY_MAX_FRAGMENT_LEN - 1) / MOONY_MAX_FRAGMENT_LEN
+		: 1; // empty code still needs a fragment
+}
+
+__realtime static inline bool
+_moony_xfer_busy(const moony_xfer_t *xfer)
+{
+	return xfer->seq < xfer->nseqs;
+}
+
+// forges tuple of next fragment of code and advances sequence number
+__realtime static inline LV2_Atom_Forge_Ref
+_moony_xfer_forge(LV2_Atom_Forge *forge, moony_xfer_t *xfer, const char *code)
+{
+	const uint32_t offset = xfer->seq * MOONY_MAX_FRAGMENT_LEN;
+	const uint32_t len = (xfer->size - offset < MOONY_MAX_FRAGMENT_LEN)
+		? xfer->size - offset
+		: MOONY_MAX_FRAGMENT_LEN;
+	LV2_Atom_Forge_Frame frame;
+
+	LV2_Atom_Forge_Ref ref = lv2_atom_forge_tuple(forge, &frame)
+		&& lv2_atom_forge_long(forge, xfer->hash)
+		&& lv2_atom_forge_int(forge, xfer->seq)
+		&& lv2_atom_forge_int(forge, xfer->size)
+		&& lv2_atom_forge_string(forge, &code[offset], len);
+
+	if(ref)
+	{
+		lv2_atom_forge_pop(forge, &frame);
+		xfer->seq++;
+		return 1; // success
+	}
+
+	return 0; // overflow
+}
+
+__realtime static inline LV2_Atom_Forge_Ref
+_moony_xfer_announce(LV2_Atom_Forge *forge, uint64_t hash, uint32_t size)
+{
+	LV2_Atom_Forge_Frame frame;
+
+	LV2_Atom_Forge_Ref ref = lv2_atom_forge_tuple(forge, &frame)
+		&& lv2_atom_forge_long(forge, hash)
+		&& lv2_atom_forge_int(forge, size);
+
+	if(ref)
+	{
+		lv2_atom_forge_pop(forge, &frame);
+		return 1; // success
+	}
+
+	return 0; // overflow
+}
+
+// assembles fragment into code of MOONY_MAX_CHUNK_LEN bytes, on announcement
+// only hash and size of xfer are set
+__realtime static inline moony_xfer_status_t
+_moony_xfer_parse(moony_xfer_t *xfer, char *code, const LV2_Atom_Forge *forge,
+	const LV2_Atom_Tuple *tup)
+{
+	const LV2_Atom *item [4] = { NULL, NULL, NULL, NULL };
+	unsigned n = 0;
+
+	for(const LV2_Atom *itm = lv2_atom_tuple_begin(tup);
+		!lv2_atom_tuple_is_end(LV2_ATOM_BODY_CONST(tup), tup->atom.size, itm);
+		itm = lv2_atom_tuple_next(itm))
+	{
+		if(n == 4)
+			return MOONY_XFER_PENDING; // too many items
+
+		item[n++] = itm;
+	}
+
+	if(  (n < 2)
+		|| (item[0]->type != forge->Long)
+		|| (item[1]->type != forge->Int) )
+	{
+		return MOONY_XFER_PENDING;
+	}
+
+	const uint64_t hash = ((const LV2_Atom_Long *)item[0])->body;
+
+	if(n == 2) // announcement
+	{
+		xfer->hash = hash;
+		xfer->size = ((const LV2_Atom_Int *)item[1])->body;
+		xfer->seq = 0;
+		xfer->nseqs = 0;
+
+		return MOONY_XFER_ANNOUNCED;
+	}
+
+	if(  (n != 4)
+		|| (item[2]->type != forge->Int)
+		|| (item[3]->type != forge->String)
+		|| (item[3]->size == 0) )
+	{
+		return MOONY_XFER_PENDING;
+	}
+
+	const uint32_t seq = ((const LV2_Atom_Int *)item[1])->body;
+	const uint32_t size = ((const LV2_Atom_Int *)item[2])->body;
+	const uint32_t len = item[3]->size - 1; // without terminating zero
+
+	if(seq == 0) // (re)start of transfer
+	{
+		_moony_xfer_start(xfer, size, hash);
+	}
+
+	if(  (hash != xfer->hash)
+		|| (seq != xfer->seq)
+		|| !_moony_xfer_busy(xfer) )
+	{
+		return MOONY_XFER_PENDING; // stray fragment
+	}
+
+	const uint32_t offset = seq * MOONY_MAX_FRAGMENT_LEN;
+
+	if(  (size >= MOONY_MAX_CHUNK_LEN)
+		|| (len > MOONY_MAX_FRAGMENT_LEN)
+		|| (offset + len > size) )
+	{
+		xfer->nseqs = 0; // drop invalid transfer
+		return MOONY_XFER_PENDING;
+	}
+
+	memcpy(&code[offset], LV2_ATOM_BODY_CONST(item[3]), len);
+
+	if(++xfer->seq < xfer->nseqs)
+	{
+		return MOONY_XFER_PENDING;
+	}
+
+	code[size] = '\0';
+	xfer->nseqs = 0;
+
+	return (moony_hash(code, size) == hash)
+		? MOONY_XFER_COMPLETE
+		: MOONY_XFER_PENDING;
+}
+
 void *
 moony_rt_alloc(moony_vm_t *vm, size_t nsize);
 
@@ -19,6 +19,7 @@
 #include <api_atom.h>
 #include <api_forge.h>
 #include <lock_stash.h>
+#include <run_slice.h>
 
 #include <lauxlib.h>
 
@@ -42,6 +43,8 @@ struct _Handle {
 	lock_stash_t stash [5];
 	bool stashed;
 	uint32_t stash_nsamples;
+
+	run_slice_t slice [5];
 };
 
 __non_realtime static LV2_Handle
@@ -77,6 +80,7 @@ instantiate(const LV2_Descriptor* descriptor, double rate, const char *bundle_pa
 	{
 		_stash_init(&handle->stash[i], handle->moony.map);
 		_stash_reset(&handle->stash[i]);
+		_slice_init(&handle->slice[i], handle->moony.map);
 	}
 
 	return handle;
@@ -134,6 +138,79 @@ _run_period(lua_State *L, const char *cmd, Handle *handle, uint32_t nsamples,
 	}
 }
 
+__realtime static inline bool
+_run_slices(lua_State *L, Handle *handle, uint32_t nsamples,
+	const LV2_Atom_Sequence **event_in, const LV2_Atom_Sequence *control)
+{
+	const int top = lua_gettop(L);
+	if(lua_getglobal(L, "runSlice") == LUA_TNIL)
+	{
+		lua_settop(L, top);
+		return false;
+	}
+
+	for(unsigned i=0; i<handle->max_val; i++)
+		_slice_begin(&handle->slice[i], event_in[i]);
+	_slice_begin(&handle->slice[handle->max_val], control);
+
+	// forges are shared by all slices, keep their time stamps increasing
+	int64_t notify_last = 0;
+	int64_t event_last [4] = { 0 };
+
+	// split period at event time stamps
+	for(int64_t from = 0, to; from < nsamples; from = to)
+	{
+		to = nsamples;
+		for(unsigned i=0; i<handle->max_val + 1; i++)
+		{
+			if(!_slice_fill(&handle->slice[i], from))
+				moony_trace(&handle->moony, "runSlice: slice buffer overflow");
+
+			to = _slice_next(&handle->slice[i], to);
+		}
+
+		lua_pushvalue(L, top + 1);
+		lua_pushinteger(L, from);
+		lua_pushinteger(L, to);
+
+		// push control / notify pair
+		lforge_t *lnotify;
+		{
+			latom_t *latom = moony_newuserdata(L, &handle->moony, MOONY_UDATA_ATOM, true);
+			latom->atom = (const LV2_Atom *)&handle->slice[handle->max_val].stash.seq;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+
+			lnotify = moony_newuserdata(L, &handle->moony, MOONY_UDATA_FORGE, true);
+			lnotify->depth = 0;
+			lnotify->last.frames = from > notify_last ? from : notify_last;
+			lnotify->forge = &handle->moony.notify_forge;
+		}
+
+		// push sequence / forge pair(s)
+		lforge_t *levent [4];
+		for(unsigned i=0; i<handle->max_val; i++)
+		{
+			latom_t *latom = moony_newuserdata(L, &handle->moony, MOONY_UDATA_ATOM, true);
+			latom->atom = (const LV2_Atom *)&handle->slice[i].stash.seq;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+
+			levent[i] = moony_newuserdata(L, &handle->moony, MOONY_UDATA_FORGE, true);
+			levent[i]->depth = 0;
+			levent[i]->last.frames = from > event_last[i] ? from : event_last[i];
+			levent[i]->forge = &handle->forge[i];
+		}
+
+		lua_call(L, 2 + 2*handle->max_val + 2, 0);
+
+		notify_last = lnotify->last.frames;
+		for(unsigned i=0; i<handle->max_val; i++)
+			event_last[i] = levent[i]->last.frames;
+	}
+
+	lua_settop(L, top);
+	return true;
+}
+
 __realtime static int
 _run(lua_State *L)
 {
@@ -150,7 +227,8 @@ _run(lua_State *L)
 		};
 		const LV2_Atom_Sequence *control = &handle->stash[handle->max_val].seq;
 
-		_run_period(L, "run", handle, handle->stash_nsamples, event_in, control);
+		if(!_run_slices(L, handle, handle->stash_nsamples, event_in, control))
+			_run_period(L, "run", handle, handle->stash_nsamples, event_in, control);
 
 		for(unsigned i=0; i<handle->max_val; i++)
 		{
@@ -167,7 +245,8 @@ _run(lua_State *L)
 		handle->once = false;
 	}
 
-	_run_period(L, "run", handle, handle->sample_count, handle->event_in, handle->control);
+	if(!_run_slices(L, handle, handle->sample_count, handle->event_in, handle->control))
+		_run_period(L, "run", handle, handle->sample_count, handle->event_in, handle->control);
 
 	return 0;
 }
@@ -179,6 +258,9 @@ run(LV2_Handle instance, uint32_t nsamples)
 
 	handle->sample_count = nsamples;
 
+	moony_capture(&handle->moony, nsamples, handle->control,
+		NULL, 0, handle->event_in, handle->max_val);
+
 	// prepare event_out sequence
 	LV2_Atom_Forge_Frame frame [4];
 
@@ -19,6 +19,7 @@
 #include <api_atom.h>
 #include <api_forge.h>
 #include <lock_stash.h>
+#include <run_slice.h>
 
 #include <lauxlib.h>
 
@@ -35,6 +36,8 @@ struct _Handle {
 	LV2_Atom_Sequence *event_out;
 	const float *val_in [4];
 	float *val_out [4];
+	float val_last [4];
+	bool val_valid;
 
 	const LV2_Atom_Sequence *control;
 	LV2_Atom_Sequence *notify;
@@ -44,6 +47,8 @@ struct _Handle {
 	lock_stash_t stash [2];
 	bool stashed;
 	uint32_t stash_nsamples;
+
+	run_slice_t slice [2];
 };
 
 __non_realtime static LV2_Handle
@@ -78,6 +83,7 @@ instantiate(const LV2_Descriptor* descriptor, double rate, const char *bundle_pa
 	{
 		_stash_init(&handle->stash[i], handle->moony.map);
 		_stash_reset(&handle->stash[i]);
+		_slice_init(&handle->slice[i], handle->moony.map);
 	}
 
 	return handle;
@@ -150,6 +156,90 @@ _run_period(lua_State *L, const char *cmd, Handle *handle, uint32_t nsamples,
 	}
 }
 
+__realtime static inline bool
+_run_slices(lua_State *L, Handle *handle, uint32_t nsamples,
+	const LV2_Atom_Sequence *event_in, const LV2_Atom_Sequence *control)
+{
+	const int top = lua_gettop(L);
+	if(lua_getglobal(L, "runSlice") == LUA_TNIL)
+	{
+		lua_settop(L, top);
+		return false;
+	}
+
+	_slice_begin(&handle->slice[0], event_in);
+	_slice_begin(&handle->slice[1], control);
+
+	// forges are shared by all slices, keep their time stamps increasing
+	int64_t notify_last = 0;
+	int64_t event_last = 0;
+
+	// split period at event time stamps
+	for(int64_t from = 0, to; from < nsamples; from = to)
+	{
+		for(unsigned i=0; i<2; i++)
+		{
+			if(!_slice_fill(&handle->slice[i], from))
+				moony_trace(&handle->moony, "runSlice: slice buffer overflow");
+		}
+
+		to = _slice_next(&handle->slice[0], nsamples);
+		to = _slice_next(&handle->slice[1], to);
+
+		lua_pushvalue(L, top + 1);
+		lua_pushinteger(L, from);
+		lua_pushinteger(L, to);
+
+		// push control / notify pair
+		lforge_t *lnotify;
+		{
+			latom_t *latom = moony_newuserdata(L, &handle->moony, MOONY_UDATA_ATOM, true);
+			latom->atom = (const LV2_Atom *)&handle->slice[1].stash.seq;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+
+			lnotify = moony_newuserdata(L, &handle->moony, MOONY_UDATA_FORGE, true);
+			lnotify->depth = 0;
+			lnotify->last.frames = from > notify_last ? from : notify_last;
+			lnotify->forge = &handle->moony.notify_forge;
+		}
+
+		// push sequence / forge pair
+		lforge_t *levent;
+		{
+			latom_t *latom = moony_newuserdata(L, &handle->moony, MOONY_UDATA_ATOM, true);
+			latom->atom = (const LV2_Atom *)&handle->slice[0].stash.seq;
+			latom->body.raw = LV2_ATOM_BODY_CONST(latom->atom);
+
+			levent = moony_newuserdata(L, &handle->moony, MOONY_UDATA_FORGE, true);
+			levent->depth = 0;
+			levent->last.frames = from > event_last ? from : event_last;
+			levent->forge = &handle->forge;
+		}
+
+		// push values interpolated at slice start
+		for(unsigned i=0; i<handle->max_val; i++)
+			lua_pushnumber(L, _slice_lerp(handle->val_last[i], *handle->val_in[i], from, nsamples));
+
+		lua_call(L, 4 + handle->max_val + 2, LUA_MULTRET);
+
+		notify_last = lnotify->last.frames;
+		event_last = levent->last.frames;
+
+		// returns of last slice end up on output ports
+		unsigned ret = lua_gettop(L) - top - 1;
+		unsigned max = ret > handle->max_val ? handle->max_val : ret; // discard superfluous returns
+		for(unsigned i=0; i<max; i++)
+			*handle->val_out[i] = luaL_optnumber(L, top + 2 + i, 0.f);
+		for(unsigned i=ret; i<handle->max_val; i++) // fill in missing returns with 0.f
+			*handle->val_out[i] = 0.f;
+
+		lua_settop(L, top + 1);
+	}
+
+	lua_settop(L, top);
+	return true;
+}
+
 __realtime static int
 _run(lua_State *L)
 {
@@ -161,7 +251,8 @@ _run(lua_State *L)
 		const LV2_Atom_Sequence *event_in = &handle->stash[0].seq;
 		const LV2_Atom_Sequence *control = &handle->stash[1].seq;
 
-		_run_period(L, "run", handle, handle->stash_nsamples, event_in, control);
+		if(!_run_slices(L, handle, handle->stash_nsamples, event_in, control))
+			_run_period(L, "run", handle, handle->stash_nsamples, event_in, control);
 
 		LV2_ATOM_SEQUENCE_FOREACH(handle->event_out, ev)
 			ev->time.frames = 0; // overwrite time stamps
@@ -175,7 +266,8 @@ _run(lua_State *L)
 		handle->once = false;
 	}
 
-	_run_period(L, "run", handle, handle->sample_count, handle->event_in, handle->control);
+	if(!_run_slices(L, handle, handle->sample_count, handle->event_in, handle->control))
+		_run_period(L, "run", handle, handle->sample_count, handle->event_in, handle->control);
 
 	return 0;
 }
@@ -187,6 +279,16 @@ run(LV2_Handle instance, uint32_t nsamples)
 
 	handle->sample_count = nsamples;
 
+	if(!handle->val_valid)
+	{
+		for(unsigned i=0; i<handle->max_val; i++)
+			handle->val_last[i] = *handle->val_in[i];
+		handle->val_valid = true;
+	}
+
+	moony_capture(&handle->moony, nsamples, handle->control,
+		handle->val_in, handle->max_val, &handle->event_in, 1);
+
 	// prepare event_out sequence
 	LV2_Atom_Forge_Frame frame;
 	uint32_t capacity = handle->event_out->atom.size;
@@ -284,6 +386,10 @@ run(LV2_Handle instance, uint32_t nsamples)
 		for(unsigned i=0; i<handle->max_val; i++)
 			*handle->val_out[i] = 0.f;
 
+	// keep control values as start of next period's ramp
+	for(unsigned i=0; i<handle->max_val; i++)
+		handle->val_last[i] = *handle->val_in[i];
+
 	// handle UI comm
 	moony_out(&handle->moony, handle->notify, nsamples - 1);
 }
@@ -21,11 +21,16 @@
 #include <math.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <utime.h>
 #include <wordexp.h>
 
+#if defined(__linux__)
+#	include <sys/inotify.h>
+#endif
+
 #include <moony.h>
 #include <props.h>
 
@@ -39,8 +44,12 @@
 #define LV2_CANVAS_RENDER_NANOVG_NO_IMPLEMENTATION
 #include <canvas.lv2/render_nanovg.h>
 
+#include <urid_cache.h>
+#include <redraw.h>
+
 #define MAX_NPROPS 16
 #define MAX_GRAPH 2048 //FIXME
+#define FILE_DEBOUNCE 100000000 // 100ms in ns
 
 #define RDF_PREFIX    "http://www.w3.org/1999/02/22-rdf-syntax-ns#"
 #define RDFS_PREFIX   "http://www.w3.org/2000/01/rdf-schema#"
@@ -73,7 +82,7 @@ union _dynvalue_t {
 
 struct _dynparam_t {
 	uint32_t prop;
-	const char *uri;
+	const char *uri; // owned by urid_cache
 
 	bool writable;
 
@@ -139,6 +148,7 @@ struct _plughandle_t {
 	LV2_URID midi_MidiEvent;
 
 	LV2_URID urid_code;
+	LV2_URID urid_codeHash;
 	LV2_URID urid_error;
 	LV2_URID urid_fontHeight;
 	LV2_URID urid_panic;
@@ -185,6 +195,16 @@ struct _plughandle_t {
 	char manual [PATH_MAX] ;
 	int fd;
 	time_t modtime;
+	uint64_t file_due; // debounced read of changed file, 0 if none
+	moony_xfer_t xfer_in; // chunked transfer of code from DSP
+	moony_xfer_t xfer_out; // chunked transfer of code to DSP
+	char xfer_in_buf [MOONY_MAX_CHUNK_LEN];
+	char xfer_out_buf [MOONY_MAX_CHUNK_LEN];
+	char *file_buf; // MOONY_MAX_CHUNK_LEN
+#if defined(__linux__)
+	int ino_fd; // inotify instance, -1 falls back to polling stat
+	int ino_wd; // watch of template, -1 while file is being replaced
+#endif
 
 	float scale;
 	d2tk_coord_t header_height;
@@ -202,12 +222,16 @@ struct _plughandle_t {
 	console_t console;
 
 	LV2_Canvas canvas;
+	LV2_Canvas_Layers graph_layers;
+	bool graph_set;
+	redraw_t redraw;
 
 	uint32_t graph_size;
 	int kid;
 
 	dynparam_t *dynparams;
 	size_t ndynparams;
+	prop_index_t dynparams_index;
 
 	wordexp_t wordexp;
 };
@@ -285,6 +309,12 @@ _intercept_graph(void *data, int64_t frames __attribute__((unused)),
 	plughandle_t *handle = data;
 
 	handle->graph_size = impl->value.size;
+	handle->graph_set = true;
+
+	// apply graph to layers once, replay on every expose
+	lv2_canvas_layers_update_body(&handle->canvas, &handle->graph_layers,
+		handle->forge.Tuple, handle->graph_size,
+		(const LV2_Atom *)handle->state.graph_body);
 }
 
 static void
@@ -394,17 +424,6 @@ static const props_def_t defs [MAX_NPROPS] = {
 	}
 };
 
-static int
-_dynparam_cmp(const void *_a, const void *_b)
-{
-	const dynparam_t *a = _a;
-	const dynparam_t *b = _b;
-
-	return strcmp(a->uri, b->uri);
-
-	return 0;
-}
-
 static void
 _dynparam_free(dynparam_t *dynparam)
 {
@@ -420,31 +439,67 @@ _dynparam_free(dynparam_t *dynparam)
 static dynparam_t *
 _dynparams_get(plughandle_t *handle, LV2_URID prop)
 {
-	const dynparam_t key = {
-		.uri = handle->unmap->unmap(handle->unmap->handle, prop)
-	};
+	const int pos = _prop_index_get(&handle->dynparams_index, prop);
 
-	return bsearch(&key, handle->dynparams, handle->ndynparams,
-		sizeof(dynparam_t), _dynparam_cmp);
+	return pos >= 0
+		? &handle->dynparams[pos]
+		: NULL;
 }
 
 static dynparam_t *
 _dynparams_add(plughandle_t *handle, LV2_URID prop)
 {
-	const size_t new_sz = sizeof(dynparam_t) * ++handle->ndynparams;
+	dynparam_t *dynparam = _dynparams_get(handle, prop);
+	if(dynparam)
+	{
+		return dynparam;
+	}
 
-	handle->dynparams = realloc(handle->dynparams, new_sz); //TODO check
+	const char *uri = _urid_cache_unmap(handle->unmap, prop);
+	if(!uri)
+	{
+		return NULL;
+	}
 
-	dynparam_t *dynparam = &handle->dynparams[handle->ndynparams - 1];
-	memset(dynparam, 0x0, sizeof(dynparam_t));
-	handle->dynparams[handle->ndynparams - 1].prop = prop;
-	handle->dynparams[handle->ndynparams - 1].uri = handle->unmap->unmap(
-		handle->unmap->handle, prop);
+	dynparam_t *dynparams = realloc(handle->dynparams,
+		sizeof(dynparam_t) * (handle->ndynparams + 1));
+	if(!dynparams)
+	{
+		return NULL;
+	}
+	handle->dynparams = dynparams;
+
+	// keep parameters sorted according to URI string comparison
+	size_t lo = 0;
+	for(size_t hi = handle->ndynparams; lo < hi; )
+	{
+		const size_t mid = (lo + hi) / 2;
+
+		if(strcmp(dynparams[mid].uri, uri) < 0)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	if(!_prop_index_insert(&handle->dynparams_index, prop, lo))
+	{
+		return NULL;
+	}
 
-	qsort(handle->dynparams, handle->ndynparams,
-		sizeof(dynparam_t), _dynparam_cmp);
+	memmove(&dynparams[lo + 1], &dynparams[lo],
+		sizeof(dynparam_t) * (handle->ndynparams - lo));
+	handle->ndynparams += 1;
 
-	return _dynparams_get(handle, prop);
+	dynparam = &dynparams[lo];
+	memset(dynparam, 0x0, sizeof(dynparam_t));
+	dynparam->prop = prop;
+	dynparam->uri = uri;
+
+	return dynparam;
 }
 
 static void
@@ -464,6 +519,7 @@ _dynparams_clr(plughandle_t *handle)
 	}
 
 	handle->ndynparams = 0;
+	_prop_index_clear(&handle->dynparams_index);
 }
 
 static void
@@ -754,6 +810,74 @@ _message_set_dynparam(plughandle_t *handle, const dynparam_t *dynparam)
 	ser_atom_deinit(&ser);
 }
 
+static void
+_message_set_fragment(plughandle_t *handle)
+{
+	ser_atom_t ser;
+
+	ser_atom_init(&ser);
+	ser_atom_reset(&ser, &handle->forge);
+
+	LV2_Atom_Forge_Frame frame;
+
+	lv2_atom_forge_object(&handle->forge, &frame, 0, handle->props.urid.patch_set);
+	lv2_atom_forge_key(&handle->forge, handle->props.urid.patch_subject);
+	lv2_atom_forge_urid(&handle->forge, handle->props.urid.subject);
+	lv2_atom_forge_key(&handle->forge, handle->props.urid.patch_property);
+	lv2_atom_forge_urid(&handle->forge, handle->urid_code);
+	lv2_atom_forge_key(&handle->forge, handle->props.urid.patch_value);
+	_moony_xfer_forge(&handle->forge, &handle->xfer_out, handle->xfer_out_buf);
+	lv2_atom_forge_pop(&handle->forge, &frame);
+
+	const LV2_Atom *atom = (const LV2_Atom *)ser_atom_get(&ser);
+	handle->writer(handle->controller, handle->control, lv2_atom_total_size(atom),
+		handle->atom_eventTransfer, atom);
+
+	ser_atom_deinit(&ser);
+}
+
+static void
+_message_get_code(plughandle_t *handle)
+{
+	ser_atom_t ser;
+
+	ser_atom_init(&ser);
+	ser_atom_reset(&ser, &handle->forge);
+
+	LV2_Atom_Forge_Frame frame;
+
+	// DSP only transfers code if it differs from ours
+	const uint64_t hash = moony_hash(handle->state.code,
+		strlen(handle->state.code));
+
+	lv2_atom_forge_object(&handle->forge, &frame, 0, handle->props.urid.patch_get);
+	lv2_atom_forge_key(&handle->forge, handle->props.urid.patch_subject);
+	lv2_atom_forge_urid(&handle->forge, handle->props.urid.subject);
+	lv2_atom_forge_key(&handle->forge, handle->props.urid.patch_property);
+	lv2_atom_forge_urid(&handle->forge, handle->urid_code);
+	lv2_atom_forge_key(&handle->forge, handle->urid_codeHash);
+	lv2_atom_forge_long(&handle->forge, hash);
+	lv2_atom_forge_pop(&handle->forge, &frame);
+
+	const LV2_Atom *atom = (const LV2_Atom *)ser_atom_get(&ser);
+	handle->writer(handle->controller, handle->control, lv2_atom_total_size(atom),
+		handle->atom_eventTransfer, atom);
+
+	ser_atom_deinit(&ser);
+}
+
+// sends some pending fragments of code per call, not to overflow host buffers
+static void
+_code_flush(plughandle_t *handle)
+{
+	for(unsigned i = 0;
+		(i < MOONY_FRAGMENTS_PER_IDLE) && _moony_xfer_busy(&handle->xfer_out);
+		i++)
+	{
+		_message_set_fragment(handle);
+	}
+}
+
 static void
 _message_get(plughandle_t *handle, LV2_URID key)
 {
@@ -1121,8 +1245,7 @@ _render_graph(void *_ctx, const d2tk_rect_t *rect, const void *data)
 	nvgTranslate(ctx, -rect->x, -rect->y);
 	nvgScale(ctx, rect->w, rect->h);
 
-	lv2_canvas_render_body(&handle->canvas, ctx, handle->forge.Tuple,
-		handle->graph_size, (const LV2_Atom *)handle->state.graph_body);
+	lv2_canvas_render_layers(&handle->canvas, ctx, &handle->graph_layers);
 
 	nvgRestore(ctx);
 }
@@ -1140,9 +1263,8 @@ _expose_canvas_graph(plughandle_t *handle, const d2tk_rect_t *_rect)
 	d2tk_rect_t rect = *_rect;
 	_aspect_correction(&rect, handle->state.aspect_ratio);
 
-	const uint64_t dhash = d2tk_hash(handle->state.graph_body, handle->graph_size);
-
-	d2tk_base_custom(base, dhash, handle, &rect, _render_graph);
+	// layers track their changes, no need to hash graph body on every expose
+	d2tk_base_custom(base, handle->graph_layers.gen, handle, &rect, _render_graph);
 
 	const d2tk_state_t state = d2tk_base_is_active_hot(base, D2TK_ID, &rect,
 		D2TK_FLAG_SCROLL);
@@ -1644,7 +1766,7 @@ _expose_slot_urid(plughandle_t *handle, dynparam_t *dynparam,
 	const d2tk_state_t state = d2tk_base_text_field(base, D2TK_ID_IDX(k), rect,
 		sizeof(uri), uri, D2TK_ALIGN_MIDDLE | D2TK_ALIGN_LEFT, NULL);
 #else
-	const char *uri = handle->unmap->unmap(handle->unmap->handle, *val);
+	const char *uri = _urid_cache_unmap(handle->unmap, *val);
 
 	const d2tk_state_t state = d2tk_base_label(base, -1, uri, 0.5f, rect,
 		D2TK_ALIGN_MIDDLE | D2TK_ALIGN_LEFT);
@@ -1914,7 +2036,16 @@ _update_code(plughandle_t *handle, const char *txt, size_t txt_len)
 
 	ser_atom_deinit(&ser);
 
-	_message_set_key(handle, handle->urid_code);
+	if(txt_len >= MOONY_MAX_CHUNK_LEN)
+	{
+		return;
+	}
+
+	memcpy(handle->xfer_out_buf, txt, txt_len);
+	handle->xfer_out_buf[txt_len] = '\0';
+
+	_moony_xfer_start(&handle->xfer_out, txt_len, moony_hash(txt, txt_len));
+	_code_flush(handle);
 }
 
 static void
@@ -2255,6 +2386,7 @@ instantiate(const LV2UI_Descriptor *descriptor,
 	}
 
 	lv2_canvas_init(&handle->canvas, handle->map);
+	lv2_canvas_layers_init(&handle->graph_layers);
 
 	handle->control = port_map->port_index(port_map->handle, "control");
 
@@ -2267,6 +2399,8 @@ instantiate(const LV2UI_Descriptor *descriptor,
 
 	handle->urid_code = handle->map->map(handle->map->handle,
 		MOONY_CODE_URI);
+	handle->urid_codeHash = handle->map->map(handle->map->handle,
+		MOONY_CODE_HASH_URI);
 	handle->urid_error = handle->map->map(handle->map->handle,
 		MOONY_ERROR_URI);
 	handle->urid_fontHeight = handle->map->map(handle->map->handle,
@@ -2356,8 +2490,13 @@ instantiate(const LV2UI_Descriptor *descriptor,
 		return NULL;
 	}
 
+	_urid_cache_ref();
+
 	const LV2_URID ui_scaleFactor = handle->map->map(handle->map->handle,
 		LV2_UI__scaleFactor);
+	const LV2_URID ui_updateRate = handle->map->map(handle->map->handle,
+		LV2_UI__updateRate);
+	float update_rate = MOONY_UI_RATE;
 
 	for(LV2_Options_Option *opt = opts;
 		opt && (opt->key != 0) && (opt->value != NULL);
@@ -2367,8 +2506,15 @@ instantiate(const LV2UI_Descriptor *descriptor,
 		{
 			handle->scale = *(float*)opt->value;
 		}
+		else if( (opt->key == ui_updateRate) && (opt->type == handle->forge.Float)
+			&& (*(float*)opt->value > 0.f) )
+		{
+			update_rate = *(float*)opt->value;
+		}
 	}
 
+	_redraw_init(&handle->redraw, update_rate, MOONY_UI_HIDDEN_RATE);
+
 	if(handle->scale == 0.f)
 	{
 		handle->scale = d2tk_frontend_get_scale(handle->dpugl);
@@ -2402,6 +2548,15 @@ instantiate(const LV2UI_Descriptor *descriptor,
 
 	lv2_log_note(&handle->logger, "template: %s\n", handle->template);
 
+#if defined(__linux__)
+	handle->ino_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(handle->ino_fd == -1)
+	{
+		lv2_log_warning(&handle->logger, "inotify_init1: %s\n", strerror(errno));
+	}
+	handle->ino_wd = -1; // added upon first idle
+#endif
+
 	static const char *fallback= "vi";
 	const char *editor = getenv("EDITOR");
 	char cmdline [PATH_MAX];
@@ -2415,7 +2570,7 @@ instantiate(const LV2UI_Descriptor *descriptor,
 		return NULL;
 	}
 
-	_message_get(handle, handle->urid_code);
+	_message_get_code(handle);
 	_message_get(handle, handle->urid_error);
 	_message_get(handle, handle->urid_fontHeight);
 	_message_get(handle, handle->urid_panic);
@@ -2433,17 +2588,84 @@ cleanup(LV2UI_Handle instance)
 	plughandle_t *handle = instance;
 
 	_dynparams_clr(handle);
+	_prop_index_deinit(&handle->dynparams_index);
+	lv2_canvas_layers_deinit(&handle->graph_layers);
 
 	d2tk_util_kill(&handle->kid);
 	d2tk_frontend_free(handle->dpugl);
 
 	wordfree(&handle->wordexp);
 
+#if defined(__linux__)
+	if(handle->ino_fd != -1)
+	{
+		close(handle->ino_fd);
+	}
+#endif
+
 	unlink(handle->template);
 	close(handle->fd);
+	free(handle->file_buf);
+	_urid_cache_unref();
 	free(handle);
 }
 
+// handles chunked transfer of code, returns true if obj has been consumed
+static bool
+_code_fragment(plughandle_t *handle, const LV2_Atom_Object *obj)
+{
+	const LV2_Atom_URID *property = NULL;
+	const LV2_Atom_Tuple *value = NULL;
+
+	if(  !lv2_atom_forge_is_object_type(&handle->forge, obj->atom.type)
+		|| (obj->body.otype != handle->props.urid.patch_set) )
+	{
+		return false;
+	}
+
+	lv2_atom_object_get(obj,
+		handle->props.urid.patch_property, &property,
+		handle->props.urid.patch_value, &value,
+		0);
+
+	if(  !property || (property->atom.type != handle->forge.URID)
+		|| (property->body != handle->urid_code)
+		|| !value || (value->atom.type != handle->forge.Tuple) )
+	{
+		return false;
+	}
+
+	switch(_moony_xfer_parse(&handle->xfer_in, handle->xfer_in_buf,
+		&handle->forge, value))
+	{
+		case MOONY_XFER_PENDING:
+		{
+			// wait for further fragments
+		} break;
+		case MOONY_XFER_ANNOUNCED:
+		{
+			const uint64_t hash = moony_hash(handle->state.code,
+				strlen(handle->state.code));
+
+			if(handle->xfer_in.hash != hash)
+			{
+				_message_get_code(handle);
+			}
+		} break;
+		case MOONY_XFER_COMPLETE:
+		{
+			props_impl_t *impl = _props_impl_get(&handle->props, handle->urid_code);
+
+			_props_impl_set(&handle->props, impl, handle->forge.String,
+				handle->xfer_in.size + 1, handle->xfer_in_buf);
+			_intercept_code(handle, 0, impl);
+			_redraw_mark(&handle->redraw);
+		} break;
+	}
+
+	return true;
+}
+
 static void
 port_event(LV2UI_Handle instance, uint32_t index __attribute__((unused)),
 	uint32_t size __attribute__((unused)), uint32_t protocol, const void *buf)
@@ -2461,52 +2683,229 @@ port_event(LV2UI_Handle instance, uint32_t index __attribute__((unused)),
 	ser_atom_init(&ser);
 	ser_atom_reset(&ser, &handle->forge);
 
+	const uint32_t gen = handle->graph_layers.gen;
+	handle->graph_set = false;
+
 	LV2_Atom_Forge_Ref ref = 0;
-	props_advance(&handle->props, &handle->forge, 0, obj, &ref);
+	if(!_code_fragment(handle, obj)) // marks redraw itself once transferred
+	{
+		props_advance(&handle->props, &handle->forge, 0, obj, &ref);
+
+		// graph updates with unchanged layers need no redraw
+		if(  !handle->graph_set || (handle->graph_layers.gen != gen)
+			|| (obj->body.otype != handle->props.urid.patch_set) )
+		{
+			_redraw_mark(&handle->redraw);
+		}
+	}
 
 	ser_atom_deinit(&ser);
+}
 
-	d2tk_frontend_redisplay(handle->dpugl);
+static uint64_t
+_file_nanos(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
 }
 
 static void
 _file_read(plughandle_t *handle)
 {
-	lseek(handle->fd, 0, SEEK_SET);
-	const size_t len = lseek(handle->fd, 0, SEEK_END);
-	lseek(handle->fd, 0, SEEK_SET);
+	if(!handle->file_buf)
+	{
+		handle->file_buf = malloc(MOONY_MAX_CHUNK_LEN);
+
+		if(!handle->file_buf)
+		{
+			lv2_log_error(&handle->logger, "malloc failed\n");
+			return;
+		}
+	}
 
-	char *txt = alloca(len + 1);
-	if(!txt)
+	// open anew, as editors may have replaced the file
+	const int fd = open(handle->template, O_RDONLY | O_CLOEXEC);
+	if(fd == -1)
 	{
-		lv2_log_error(&handle->logger, "alloca failed\n");
+		lv2_log_error(&handle->logger, "open: %s\n", strerror(errno));
 		return;
 	}
 
-	read(handle->fd, txt, len);
+	char *txt = handle->file_buf;
+	size_t len = 0;
+	ssize_t n;
+	char tail;
+
+	while( (len < MOONY_MAX_CHUNK_LEN - 1)
+		&& ( (n = read(fd, &txt[len], MOONY_MAX_CHUNK_LEN - 1 - len)) != 0) )
+	{
+		if(n == -1)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			lv2_log_error(&handle->logger, "read: %s\n", strerror(errno));
+			close(fd);
+			return;
+		}
+
+		len += n;
+	}
+
+	if( (len == MOONY_MAX_CHUNK_LEN - 1) && (read(fd, &tail, 1) == 1) )
+	{
+		lv2_log_warning(&handle->logger, "file truncated to %zu bytes\n", len);
+	}
+
+	close(fd);
 	txt[len] = '\0';
 
-	handle->hash = d2tk_hash(txt, len);
+	// e.g. triggered by our own write or by mere touch
+	const uint64_t hash = d2tk_hash(txt, len);
+	if(handle->hash == hash)
+	{
+		return;
+	}
+
+	handle->hash = hash;
 
 	_update_code(handle, txt, len);
 }
 
-static int
-_idle(LV2UI_Handle instance)
+#if defined(__linux__)
+// returns true if file has changed
+static bool
+_file_watch(plughandle_t *handle)
 {
-	plughandle_t *handle = instance;
+	bool changed = false;
 
+	if(handle->ino_fd == -1)
+	{
+		return changed;
+	}
+
+	union {
+		struct inotify_event ev;
+		char buf [sizeof(struct inotify_event) + NAME_MAX + 1];
+	} u;
+	ssize_t n;
+
+	while( (n = read(handle->ino_fd, u.buf, sizeof(u.buf))) > 0)
+	{
+		for(ssize_t off = 0; off < n; )
+		{
+			const struct inotify_event *ev = (const struct inotify_event *)&u.buf[off];
+
+			if(ev->wd == handle->ino_wd)
+			{
+				if(ev->mask & (IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB))
+				{
+					changed = true;
+				}
+
+				if(ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+				{
+					// file has been replaced, e.g. by vi
+					inotify_rm_watch(handle->ino_fd, handle->ino_wd);
+					handle->ino_wd = -1;
+					changed = true;
+				}
+			}
+
+			off += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+
+	if(handle->ino_wd == -1)
+	{
+		handle->ino_wd = inotify_add_watch(handle->ino_fd, handle->template,
+			IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+
+		if(handle->ino_wd != -1)
+		{
+			changed = true; // may have been written before watch was added
+
+			// keep writing to the file the editor sees
+			const int fd = open(handle->template, O_RDWR | O_CLOEXEC);
+
+			if(fd != -1)
+			{
+				close(handle->fd);
+				handle->fd = fd;
+			}
+		}
+	}
+
+	return changed;
+}
+#endif
+
+// returns true if file has changed
+static bool
+_file_poll(plughandle_t *handle)
+{
 	struct stat st;
 	if(stat(handle->template, &st) == -1)
 	{
 		lv2_log_error(&handle->logger, "stat: %s\n", strerror(errno));
+		return false;
 	}
 
+	// only after first code has been written to file
 	if( (st.st_mtime > handle->modtime) && (handle->modtime > 0) )
 	{
+		handle->modtime = st.st_mtime;
+		return true;
+	}
+
+	return false;
+}
+
+static int
+_idle(LV2UI_Handle instance)
+{
+	plughandle_t *handle = instance;
+
+	bool changed;
+#if defined(__linux__)
+	if(handle->ino_fd != -1)
+	{
+		changed = _file_watch(handle);
+	}
+	else
+#endif
+	{
+		changed = _file_poll(handle);
+	}
+
+	_code_flush(handle);
+
+	// only read file after first code has been written to it
+	if(changed && (handle->modtime > 0) )
+	{
+		// wait for editor to settle down
+		handle->file_due = _file_nanos() + FILE_DEBOUNCE;
+	}
+
+	if(handle->file_due && (_file_nanos() >= handle->file_due) )
+	{
+		handle->file_due = 0;
+
 		_file_read(handle);
+	}
 
-		handle->modtime = st.st_mtime;
+	// the frontend hides its view, hidden views drop redisplays themselves
+	const uint64_t now = moony_nanos();
+	const bool due = _redraw_due(&handle->redraw, true, now);
+
+	if(due)
+	{
+		d2tk_frontend_redisplay(handle->dpugl);
 	}
 
 	if(d2tk_frontend_step(handle->dpugl))
@@ -2514,6 +2913,11 @@ _idle(LV2UI_Handle instance)
 		handle->done = 1;
 	}
 
+	if(due)
+	{
+		_redraw_cost(&handle->redraw, now, moony_nanos());
+	}
+
 	return handle->done;
 }
 
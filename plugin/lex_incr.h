@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _LEX_INCR_H
+#define _LEX_INCR_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+// needs struct nk_token from nuklear.h
+
+#define LEX_INCR_WINDOW 0x40 // 64 bytes lexed past the edit at first
+#define LEX_INCR_BLOCK 0x400 // 1K bytes compared at once
+
+typedef struct _lex_incr_t lex_incr_t;
+
+// Incremental lexer, relexes the edited part of the code only. Lexing resumes
+// at the last token boundary before the line of the first edit and stops at
+// the first token boundary after the edit that coincides with an old one,
+// from there on old and new tokens are the same. Only the relexed window is
+// handed to the lexer, which thus must not look behind token boundaries.
+struct _lex_incr_t {
+	lua_State *L; // with global 'lexer' and 'moony' lexer
+	char *code; // code of last pass
+	int code_sz;
+	int code_max;
+	struct nk_token *tokens; // tokens of last pass, terminated by INT32_MAX
+	int ntokens;
+	int max_tokens;
+	int relexed; // bytes relexed in last pass
+};
+
+static inline void
+_lex_incr_init(lex_incr_t *lex, lua_State *L)
+{
+	memset(lex, 0x0, sizeof(lex_incr_t));
+	lex->L = L;
+}
+
+static inline void
+_lex_incr_deinit(lex_incr_t *lex)
+{
+	free(lex->code);
+	free(lex->tokens);
+	memset(lex, 0x0, sizeof(lex_incr_t));
+}
+
+// only grows buffers, returns false if out of memory
+static inline bool
+_lex_incr_reserve(lex_incr_t *lex, int ntokens, int code_sz)
+{
+	if(ntokens + 1 > lex->max_tokens) // plus terminator
+	{
+		int max_tokens = lex->max_tokens ? lex->max_tokens : 0x400;
+		while(max_tokens < ntokens + 1)
+			max_tokens <<= 1;
+
+		struct nk_token *tokens = realloc(lex->tokens,
+			max_tokens * sizeof(struct nk_token));
+		if(!tokens)
+			return false;
+
+		lex->tokens = tokens;
+		lex->max_tokens = max_tokens;
+	}
+
+	if(code_sz > lex->code_max)
+	{
+		int code_max = lex->code_max ? lex->code_max : 0x1000;
+		while(code_max < code_sz)
+			code_max <<= 1;
+
+		char *code = realloc(lex->code, code_max);
+		if(!code)
+			return false;
+
+		lex->code = code;
+		lex->code_max = code_max;
+	}
+
+	return true;
+}
+
+// end offset of i-th token of lexer.lex result table at top of stack
+static inline int
+_lex_incr_offset(lua_State *L, int i)
+{
+	lua_rawgeti(L, -1, 2*i + 2);
+	const int offset = lua_tointeger(L, -1) - 1;
+	lua_pop(L, 1);
+
+	return offset;
+}
+
+static inline struct nk_color
+_lex_incr_color(lua_State *L, int i)
+{
+	lua_rawgeti(L, -1, 2*i + 1);
+	const uint32_t col = (lua_type(L, -1) == LUA_TNUMBER)
+		? lua_tointeger(L, -1)
+		: 0xdddddd;
+	lua_pop(L, 1);
+
+	const struct nk_color color = {
+		.r = (col >> 16) & 0xff,
+		.g = (col >>  8) & 0xff,
+		.b = (col >>  0) & 0xff,
+		.a = 0xff
+	};
+
+	return color;
+}
+
+static int
+_lex_incr_protected(lua_State *L)
+{
+	lex_incr_t *lex = lua_touserdata(L, 1);
+	const char *code = lua_touserdata(L, 2);
+	const int code_sz = lua_tointeger(L, 3);
+
+	// common prefix and suffix of old and new code, compare blockwise first
+	const int min_sz = code_sz < lex->code_sz ? code_sz : lex->code_sz;
+	int p = 0;
+	while( (p + LEX_INCR_BLOCK <= min_sz)
+		&& !memcmp(&code[p], &lex->code[p], LEX_INCR_BLOCK) )
+	{
+		p += LEX_INCR_BLOCK;
+	}
+	while( (p < min_sz) && (code[p] == lex->code[p]) )
+		p++;
+
+	if( (p == code_sz) && (p == lex->code_sz) && lex->tokens)
+	{
+		lex->relexed = 0;
+		lua_pushlightuserdata(L, lex->tokens); // unchanged
+		return 1;
+	}
+
+	int s = 0;
+	while( (s + LEX_INCR_BLOCK <= min_sz - p)
+		&& !memcmp(&code[code_sz - s - LEX_INCR_BLOCK],
+			&lex->code[lex->code_sz - s - LEX_INCR_BLOCK], LEX_INCR_BLOCK) )
+	{
+		s += LEX_INCR_BLOCK;
+	}
+	while( (s < min_sz - p) && (code[code_sz - 1 - s] == lex->code[lex->code_sz - 1 - s]) )
+		s++;
+
+	const int delta = code_sz - lex->code_sz;
+	const int edit_end = code_sz - s; // end of edit in new code
+
+	// restart at last token boundary before start of edited line
+	int line = p;
+	while( (line > 0) && (code[line - 1] != '\n') )
+		line--;
+
+	const int bound = line < p ? line : p - 1;
+	int i0 = 0; // number of old tokens kept in front
+	for(int hi = lex->ntokens; i0 < hi; )
+	{
+		const int mid = (i0 + hi) / 2;
+
+		if(lex->tokens[mid].offset <= bound)
+			i0 = mid + 1;
+		else
+			hi = mid;
+	}
+	const int r = i0 ? lex->tokens[i0 - 1].offset : 0;
+
+	// lex growing windows until old and new token boundaries coincide again
+	int w = (edit_end > r ? edit_end : r) + LEX_INCR_WINDOW;
+	int nwin; // number of relexed tokens
+	int m; // number of old tokens dropped
+	bool resync = false;
+
+	for( ; ; w = r + 2*(w - r))
+	{
+		if(w > code_sz)
+			w = code_sz;
+
+		lua_settop(L, 3);
+		lua_getglobal(L, "lexer");
+		lua_getfield(L, -1, "lex");
+		lua_getglobal(L, "moony");
+		lua_pushlstring(L, code + r, w - r);
+		lua_call(L, 2, 1);
+
+		if(lua_type(L, -1) != LUA_TTABLE)
+			return 0;
+
+		const int n = luaL_len(L, -1) / 2;
+		int old = i0;
+
+		nwin = n;
+		m = lex->ntokens - i0;
+
+		for(int j = 0; j < n; j++)
+		{
+			const int e = r + _lex_incr_offset(L, j);
+
+			if( (e >= w) && (w < code_sz) )
+			{
+				break; // may be truncated by window
+			}
+
+			if(e < edit_end)
+			{
+				continue;
+			}
+
+			while( (old < lex->ntokens) && (lex->tokens[old].offset + delta < e) )
+				old++;
+
+			if( (old < lex->ntokens) && (lex->tokens[old].offset + delta == e) )
+			{
+				nwin = j + 1;
+				m = old + 1 - i0;
+				resync = true;
+				break;
+			}
+		}
+
+		if(resync || (w == code_sz) )
+			break;
+	}
+
+	const int ntokens = lex->ntokens - m + nwin;
+
+	if(!_lex_incr_reserve(lex, ntokens, code_sz))
+		return 0;
+
+	// move and shift tail of old tokens
+	const int tail = lex->ntokens - i0 - m;
+
+	memmove(&lex->tokens[i0 + nwin], &lex->tokens[i0 + m],
+		tail * sizeof(struct nk_token));
+
+	for(int i = i0 + nwin; i < ntokens; i++)
+		lex->tokens[i].offset += delta;
+
+	for(int j = 0; j < nwin; j++)
+	{
+		struct nk_token *token = &lex->tokens[i0 + j];
+
+		token->color = _lex_incr_color(L, j);
+		token->offset = r + _lex_incr_offset(L, j);
+	}
+
+	lex->tokens[ntokens].offset = INT32_MAX;
+	lex->ntokens = ntokens;
+
+	if(code_sz > p)
+		memcpy(&lex->code[p], &code[p], code_sz - p); // prefix is unchanged
+	lex->code_sz = code_sz;
+	lex->relexed = w - r;
+
+	lua_pushlightuserdata(L, lex->tokens);
+	return 1;
+}
+
+// returns tokens of code, owned by lex, NULL upon error
+static inline struct nk_token *
+_lex_incr_update(lex_incr_t *lex, const char *code, int code_sz)
+{
+	lua_State *L = lex->L;
+	const int top = lua_gettop(L);
+
+	struct nk_token *tokens = NULL;
+
+	lua_pushcclosure(L, _lex_incr_protected, 0);
+	lua_pushlightuserdata(L, lex);
+	lua_pushlightuserdata(L, (void *)code);
+	lua_pushinteger(L, code_sz);
+	if(lua_pcall(L, 3, 1, 0))
+	{
+		fprintf(stderr, "err: %s\n", lua_tostring(L, -1));
+	}
+	else if(lua_type(L, -1) == LUA_TLIGHTUSERDATA)
+	{
+		tokens = lua_touserdata(L, -1);
+	}
+
+	lua_settop(L, top);
+	return tokens;
+}
+
+#endif
@@ -127,6 +127,9 @@ local func = token(T.FUNCTION, word_match(ord{
 	-- moony basic
 	'run',
 	'once',
+	'runSlice',
+	'work',
+	'work_response',
 	'save',
 	'restore',
 	'stash',
@@ -139,6 +142,9 @@ local func = token(T.FUNCTION, word_match(ord{
 	'StateResponder',
 	'Blank',
 	'Stash',
+	'Scheduler',
+	'Worker',
+	'Tuning',
 	'Mapper',
 	'Parameter',
 }))
@@ -689,6 +695,7 @@ local canvas_lib = lib_const('Canvas', {
 	'graph',
 	'aspectRatio',
 	'body',
+	'layer',
 	'BeginPath',
 	'ClosePath',
 	'Arc',
@@ -714,6 +721,7 @@ local canvas_lib = lib_const('Canvas', {
 	'Reset',
 	'FontSize',
 	'FillText',
+	'Layer',
 	'lineCapButt',
 	'lineCapRound',
 	'lineCapSquare',
@@ -825,6 +833,7 @@ local field_func = token(T.OPERATOR, S('.:')) * token(T.FUNCTION, word_match(ord
 	'reset',
 	'fontSize',
 	'fillText',
+	'layer',
 	-- moony container
 	'foreach',
 	'unpack',
@@ -835,7 +844,12 @@ local field_func = token(T.OPERATOR, S('.:')) * token(T.FUNCTION, word_match(ord
 	'register',
 	-- moony stash
 	'write',
-	'read'
+	'read',
+	-- moony worker
+	'post',
+	-- moony tuning
+	'midi2cps',
+	'cps2midi'
 }))
 
 -- Constants.
@@ -29,6 +29,10 @@
 #define NK_PUGL_IMPLEMENTATION
 #include "nk_pugl/nk_pugl.h"
 
+#include <lex_incr.h>
+#include <urid_cache.h>
+#include <redraw.h>
+
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -103,7 +107,12 @@ struct _chunk_t {
 struct _vec_t {
 	uint32_t child_num;
 	uint32_t child_type;
+	uint32_t size; // allocated size of body
 	uint8_t *body;
+	uint32_t nbins; // number of min/max pairs in peaks
+	uint32_t max_bins; // allocated min/max pairs in peaks
+	float *peaks; // decimated body
+	bool stale; // peaks need to be recomputed
 };
 
 union _body_t {
@@ -119,17 +128,20 @@ union _body_t {
 
 struct _prop_t {
 	LV2_URID key;
+	const char *uri; // owned by urid_cache
 	uint32_t index; // for control ports only
 	LV2_URID range;
 	char *unit;
 	char *label;
 	char *comment;
 	body_t value;
+	uint64_t value_hash; // of last received value, 0 if unknown
 	body_t minimum;
 	body_t maximum;
 	LV2_Atom_Tuple *points;
 	struct nk_color color;
 	bool dirty;
+	lex_incr_t *lex; // for Lua string properties
 };
 
 enum _browser_type_t {
@@ -189,6 +201,7 @@ struct _plughandle_t {
 
 	nk_pugl_window_t win;
 	struct nk_style_button bst;
+	redraw_t redraw;
 
 #if defined(BUILD_INLINE_DISP)
 	LV2_Canvas_URID canvas_urid;
@@ -197,7 +210,6 @@ struct _plughandle_t {
 	unsigned canvas_w;
 	unsigned canvas_h;
 	bool canvas_redraw;
-	LV2_Atom *canvas_value;
 #endif
 
 	LV2UI_Controller *controller;
@@ -225,6 +237,7 @@ struct _plughandle_t {
 	LV2_URID patch_subject;
 	LV2_URID patch_sequenceNumber;
 	LV2_URID moony_code;
+	LV2_URID moony_codeHash;
 	LV2_URID moony_error;
 	LV2_URID moony_trace;
 	LV2_URID moony_panic;
@@ -278,8 +291,14 @@ struct _plughandle_t {
 
 	char code [MOONY_MAX_CHUNK_LEN];
 	struct nk_text_edit editor;
+	lex_incr_t lex;
 	bool dirty;
 
+	moony_xfer_t xfer_in; // chunked transfer of code from DSP
+	moony_xfer_t xfer_out; // chunked transfer of code to DSP
+	char xfer_in_buf [MOONY_MAX_CHUNK_LEN];
+	char xfer_out_buf [MOONY_MAX_CHUNK_LEN];
+
 	bool has_control_a;
 
 	char error [MOONY_MAX_ERROR_LEN];
@@ -290,8 +309,10 @@ struct _plughandle_t {
 
 	int n_writable;
 	prop_t *writables;
+	prop_index_t writables_index;
 	int n_readable;
 	prop_t *readables;
+	prop_index_t readables_index;
 
 	prop_t controls_in [4];
 	prop_t controls_out [4];
@@ -757,68 +778,58 @@ file_browser_run(browser_t *browser, struct nk_context *ctx, float dy,
 	return ret;
 }
 
-static inline void
-_qsort(prop_t *a, unsigned n, LV2_URID_Unmap *unmap)
+static prop_t *
+_prop_get(prop_t **properties, prop_index_t *index, LV2_URID key)
 {
-	if(n < 2)
-		return;
-
-	const prop_t *p = &a[n/2];
-
-	unsigned i, j;
-	for(i=0, j=n-1; ; i++, j--)
-	{
-		while(strcmp(unmap->unmap(unmap->handle, a[i].key), unmap->unmap(unmap->handle, p->key)) < 0)
-			i++;
-
-		while(strcmp(unmap->unmap(unmap->handle, p->key), unmap->unmap(unmap->handle, a[j].key)) < 0)
-			j--;
+	const int pos = _prop_index_get(index, key);
 
-		if(i >= j)
-			break;
-
-		const prop_t t = a[i];
-		a[i] = a[j];
-		a[j] = t;
-	}
-
-	_qsort(a, i, unmap);
-	_qsort(&a[i], n - i, unmap);
+	return pos >= 0
+		? &(*properties)[pos]
+		: NULL;
 }
 
 static prop_t *
-_prop_get(prop_t **properties, int *n_properties, LV2_URID key)
+_prop_get_or_add(plughandle_t *handle, prop_t **properties, int *n_properties,
+	prop_index_t *index, LV2_URID key)
 {
-	// we cannot easily speed this up, as properties are ordered according to URI, not URID
-	for(int i = 0; i < *n_properties; i++)
+	prop_t *prop = _prop_get(properties, index, key);
+	if(prop)
+		return prop;
+
+	const char *uri = _urid_cache_unmap(handle->unmap, key);
+	if(!uri)
+		return NULL;
+
+	prop_t *props = realloc(*properties, (*n_properties + 1)*sizeof(prop_t));
+	if(!props)
+		return NULL;
+	*properties = props;
+
+	// keep properties sorted according to URI string comparison
+	int lo = 0;
+	for(int hi = *n_properties; lo < hi; )
 	{
-		prop_t *prop = &(*properties)[i];
+		const int mid = (lo + hi) / 2;
 
-		if(prop->key == key)
-			return prop;
+		if(strcmp(props[mid].uri, uri) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	return NULL;
-}
+	if(!_prop_index_insert(index, key, lo))
+		return NULL;
 
-static prop_t *
-_prop_get_or_add(plughandle_t *handle, prop_t **properties, int *n_properties, LV2_URID key)
-{
-	prop_t *prop = _prop_get(properties, n_properties, key);
-	if(prop)
-		return prop;
+	memmove(&props[lo + 1], &props[lo], (*n_properties - lo)*sizeof(prop_t));
+	*n_properties += 1;
 
-	*properties = realloc(*properties, (*n_properties + 1)*sizeof(prop_t));
-	prop = &(*properties)[*n_properties];
+	prop = &props[lo];
 	memset(prop, 0x0, sizeof(prop_t));
 	prop->key = key;
+	prop->uri = uri;
 	prop->color = nk_white;
-	*n_properties += 1;
-
-	// sort properties according to URI string comparison
-	_qsort(*properties, *n_properties, handle->unmap);
 
-	return _prop_get(properties, n_properties, key);
+	return prop;
 }
 
 static struct nk_image
@@ -920,11 +931,21 @@ _prop_free(plughandle_t *handle, prop_t *prop)
 	{
 		if(prop->value.vec.body)
 			free(prop->value.vec.body);
+
+		if(prop->value.vec.peaks)
+			free(prop->value.vec.peaks);
 	}
 
 	if(prop->points)
 		free(prop->points);
 
+	if(prop->lex)
+	{
+		_lex_incr_deinit(prop->lex);
+		free(prop->lex);
+		prop->lex = NULL;
+	}
+
 	prop->key = 0;
 }
 
@@ -1018,6 +1039,14 @@ _patch_error(plughandle_t *handle, int32_t sequence_number)
 	handle->writer(handle->controller, handle->control, sz, handle->atom_eventTransfer, ser->atom);
 }
 
+static uint64_t
+_code_hash(plughandle_t *handle)
+{
+	struct nk_str *str = &handle->editor.string;
+
+	return moony_hash(nk_str_get_const(str), nk_str_len_char(str));
+}
+
 static void
 _patch_get(plughandle_t *handle, LV2_URID property)
 {
@@ -1039,6 +1068,13 @@ _patch_get(plughandle_t *handle, LV2_URID property)
 
 		lv2_atom_forge_key(forge, handle->patch_property);
 		lv2_atom_forge_urid(forge, property);
+
+		if(property == handle->moony_code)
+		{
+			// DSP only transfers code if it differs from ours
+			lv2_atom_forge_key(forge, handle->moony_codeHash);
+			lv2_atom_forge_long(forge, _code_hash(handle));
+		}
 	}
 	lv2_atom_forge_pop(forge, &frame);
 
@@ -1053,6 +1089,11 @@ _patch_set(plughandle_t *handle, LV2_URID property, uint32_t size, LV2_URID type
 	LV2_Atom_Forge *forge = &handle->forge;
 	atom_ser_t *ser = &handle->ser;
 
+	// edited locally, thus next received value is to be applied in any case
+	prop_t *prop = _prop_get(&handle->writables, &handle->writables_index, property);
+	if(prop)
+		prop->value_hash = 0;
+
 	ser->offset = 0;
 	lv2_atom_forge_set_sink(forge, _sink_non_rt, _deref, ser);
 
@@ -1085,6 +1126,61 @@ _patch_set(plughandle_t *handle, LV2_URID property, uint32_t size, LV2_URID type
 	handle->writer(handle->controller, handle->control, sz, handle->atom_eventTransfer, ser->atom);
 }
 
+static void
+_patch_set_fragment(plughandle_t *handle)
+{
+	LV2_Atom_Forge *forge = &handle->forge;
+	atom_ser_t *ser = &handle->ser;
+
+	ser->offset = 0;
+	lv2_atom_forge_set_sink(forge, _sink_non_rt, _deref, ser);
+
+	LV2_Atom_Forge_Frame frame;
+	lv2_atom_forge_object(forge, &frame, 0, handle->patch_Set);
+
+	lv2_atom_forge_key(forge, handle->patch_subject);
+	lv2_atom_forge_urid(forge, handle->patch_self);
+
+	lv2_atom_forge_key(forge, handle->patch_sequenceNumber);
+	lv2_atom_forge_int(forge, 0);
+
+	lv2_atom_forge_key(forge, handle->patch_property);
+	lv2_atom_forge_urid(forge, handle->moony_code);
+
+	lv2_atom_forge_key(forge, handle->patch_value);
+	_moony_xfer_forge(forge, &handle->xfer_out, handle->xfer_out_buf);
+
+	lv2_atom_forge_pop(forge, &frame);
+
+	const uint32_t sz = lv2_atom_total_size(ser->atom);
+	handle->writer(handle->controller, handle->control, sz, handle->atom_eventTransfer, ser->atom);
+}
+
+// sends some pending fragments of code per call, not to overflow host buffers
+static void
+_code_flush(plughandle_t *handle)
+{
+	for(unsigned i = 0;
+		(i < MOONY_FRAGMENTS_PER_IDLE) && _moony_xfer_busy(&handle->xfer_out);
+		i++)
+	{
+		_patch_set_fragment(handle);
+	}
+}
+
+static void
+_code_submit(plughandle_t *handle, uint32_t size, const char *body)
+{
+	if(size >= MOONY_MAX_CHUNK_LEN)
+		return;
+
+	memcpy(handle->xfer_out_buf, body, size);
+	handle->xfer_out_buf[size] = '\0';
+
+	_moony_xfer_start(&handle->xfer_out, size, moony_hash(body, size));
+	_code_flush(handle);
+}
+
 static void
 _control_set(plughandle_t *handle, uint32_t index, const float *value)
 {
@@ -1108,7 +1204,7 @@ _clear_log(plughandle_t *handle)
 	handle->n_trace = 0;
 	handle->traces = NULL;
 
-	nk_pugl_post_redisplay(&handle->win);
+	_redraw_mark(&handle->redraw);
 }
 
 static void
@@ -1117,8 +1213,7 @@ _submit_all(plughandle_t *handle)
 	_clear_error(handle);
 
 	struct nk_str *str = &handle->editor.string;
-	_patch_set(handle, handle->moony_code,
-		nk_str_len_char(str), handle->forge.String, nk_str_get_const(str));
+	_code_submit(handle, nk_str_len_char(str), nk_str_get_const(str));
 
 	handle->dirty = false;
 
@@ -1438,77 +1533,12 @@ _dial_int(struct nk_context *ctx, int32_t min, int32_t *val, int32_t max, float
 	return res;
 }
 
-static int
-_lex_protected(lua_State *L)
-{
-	struct nk_token *tokens = NULL;
-
-	lua_getglobal(L, "lexer");
-	lua_getfield(L, -1, "lex");
-	lua_getglobal(L, "moony");
-	lua_pushvalue(L, 1); // code
-	lua_call(L, 2, 1);
-
-	if(lua_type(L, -1) == LUA_TTABLE)
-	{
-		const int len = luaL_len(L, -1);
-
-		tokens = calloc(len/2 + 1, sizeof(struct nk_token)); //FIXME use realloc
-		if(tokens)
-		{
-			for(int i = 0; i < len; i += 2)
-			{
-				struct nk_token *token = &tokens[i/2];
-
-				lua_rawgeti(L, -1, i + 1);
-				const nk_uint token_col = (lua_type(L, -1) == LUA_TNUMBER)
-					? luaL_checkinteger(L, -1)
-					: 0xdddddd;
-				token->color = nk_rgb(
-					(token_col >> 16) & 0xff,
-					(token_col >>  8) & 0xff,
-					(token_col >>  0) & 0xff);
-				lua_pop(L, 1);
-
-				lua_rawgeti(L, -1, i + 2);
-				const int token_offset = (lua_type(L, -1) == LUA_TNUMBER)
-					? lua_tointeger(L, -1)
-					: token->offset + 1;
-				lua_pop(L, 1);
-
-				token->offset = token_offset - 1;
-			}
-
-			struct nk_token *token = &tokens[len/2];
-			token->offset = INT32_MAX;
-		}
-	}
-
-	lua_pushlightuserdata(L, tokens);
-	return 1;
-}
-
 static struct nk_token *
 _lex(void *data, const char *code, int code_sz)
 {
-	lua_State *L = data;
-	const int top = lua_gettop(L);
+	lex_incr_t *lex = data;
 
-	struct nk_token *tokens = NULL;
-
-	lua_pushcclosure(L, _lex_protected, 0);
-	lua_pushlstring(L, code, code_sz);
-	if(lua_pcall(L, 1, 1, 0))
-	{
-		fprintf(stderr, "err: %s\n", lua_tostring(L, -1));
-	}
-	else if(lua_type(L, -1) == LUA_TLIGHTUSERDATA)
-	{
-		tokens = lua_touserdata(L, -1);
-	}
-
-	lua_settop(L, top);
-	return tokens;
+	return _lex_incr_update(lex, code, code_sz);
 }
 
 static bool
@@ -1931,14 +1961,135 @@ _parameter_widget_chunk(plughandle_t *handle, struct nk_context *ctx, prop_t *pr
 	}
 }
 
+// min/max reduction of consecutive elements into bins, the independent lanes
+// of the inner loop map well to SIMD registers
+#define PEAKS_KERNEL(NAME, TYPE) \
+static void \
+NAME(const TYPE *v, uint32_t n, float *peaks, uint32_t nbins) \
+{ \
+	for(uint32_t b = 0, from = 0; b < nbins; b++) \
+	{ \
+		const uint32_t to = (uint64_t)(b + 1) * n / nbins; \
+		TYPE mn [4] = { v[from], v[from], v[from], v[from] }; \
+		TYPE mx [4] = { v[from], v[from], v[from], v[from] }; \
+		uint32_t i = from; \
+\
+		for( ; i + 4 <= to; i += 4) \
+		{ \
+			for(unsigned l = 0; l < 4; l++) \
+			{ \
+				mn[l] = v[i+l] < mn[l] ? v[i+l] : mn[l]; \
+				mx[l] = v[i+l] > mx[l] ? v[i+l] : mx[l]; \
+			} \
+		} \
+\
+		for( ; i < to; i++) \
+		{ \
+			mn[0] = v[i] < mn[0] ? v[i] : mn[0]; \
+			mx[0] = v[i] > mx[0] ? v[i] : mx[0]; \
+		} \
+\
+		for(unsigned l = 1; l < 4; l++) \
+		{ \
+			mn[0] = mn[l] < mn[0] ? mn[l] : mn[0]; \
+			mx[0] = mx[l] > mx[0] ? mx[l] : mx[0]; \
+		} \
+\
+		peaks[2*b + 0] = mn[0]; \
+		peaks[2*b + 1] = mx[0]; \
+		from = to; \
+	} \
+}
+
+PEAKS_KERNEL(_peaks_i32, int32_t)
+PEAKS_KERNEL(_peaks_i64, int64_t)
+PEAKS_KERNEL(_peaks_f32, float)
+PEAKS_KERNEL(_peaks_f64, double)
+
+#undef PEAKS_KERNEL
+
+// number of min/max bins to decimate vector to, 0 if all elements fit the plot
+static uint32_t
+_plot_bins(struct nk_context *ctx, vec_t *vec)
+{
+	const float width = nk_widget_width(ctx);
+	const uint32_t nbins = width >= 1.f ? width : 1;
+
+	if(vec->child_num <= 2*nbins) // two points per bin
+	{
+		return 0;
+	}
+
+	if(nbins > vec->max_bins)
+	{
+		float *peaks = realloc(vec->peaks, 2*nbins*sizeof(float));
+
+		if(!peaks)
+		{
+			return 0;
+		}
+
+		vec->peaks = peaks;
+		vec->max_bins = nbins;
+	}
+
+	if(nbins != vec->nbins)
+	{
+		vec->nbins = nbins;
+		vec->stale = true;
+	}
+
+	return nbins;
+}
+
+static void
+_plot_peaks(struct nk_context *ctx, prop_t *prop, float min, float max)
+{
+	const vec_t *vec = &prop->value.vec;
+	const unsigned n = 2*vec->nbins;
+
+	if(nk_chart_begin(ctx, NK_CHART_LINES, n, min, max))
+	{
+		for(unsigned i = 0; i < n; i++)
+		{
+			const nk_flags ret = nk_chart_push(ctx, vec->peaks[i]);
+			if(ret & NK_CHART_HOVERING)
+			{
+				const unsigned b = i / 2;
+				const uint32_t from = (uint64_t)b * vec->child_num / vec->nbins;
+				const uint32_t to = (uint64_t)(b + 1) * vec->child_num / vec->nbins;
+				char label [64];
+				snprintf(label, sizeof(label), "%"PRIu32"-%"PRIu32": %f..%f",
+					from, to - 1, vec->peaks[2*b + 0], vec->peaks[2*b + 1]);
+				nk_tooltip(ctx, label);
+			}
+		}
+	}
+	nk_chart_end(ctx);
+}
+
 static inline void
 _plot_i32(struct nk_context *ctx, prop_t *prop)
 {
-	const unsigned n = prop->value.vec.child_num;
+	vec_t *vec = &prop->value.vec;
+	const unsigned n = vec->child_num;
+	const uint32_t nbins = _plot_bins(ctx, vec);
+
+	if(nbins)
+	{
+		if(vec->stale)
+		{
+			_peaks_i32((int32_t *)vec->body, n, vec->peaks, nbins);
+			vec->stale = false;
+		}
+
+		_plot_peaks(ctx, prop, prop->minimum.i, prop->maximum.i);
+		return;
+	}
 
 	if(nk_chart_begin(ctx, NK_CHART_LINES, n, prop->minimum.i, prop->maximum.i))
 	{
-		const int32_t *i32 = (int32_t *)prop->value.vec.body;
+		const int32_t *i32 = (int32_t *)vec->body;
 
 		for(unsigned i = 0; i < n; i++)
 		{
@@ -1957,11 +2108,25 @@ _plot_i32(struct nk_context *ctx, prop_t *prop)
 static inline void
 _plot_i64(struct nk_context *ctx, prop_t *prop)
 {
-	const unsigned n = prop->value.vec.child_num;
+	vec_t *vec = &prop->value.vec;
+	const unsigned n = vec->child_num;
+	const uint32_t nbins = _plot_bins(ctx, vec);
+
+	if(nbins)
+	{
+		if(vec->stale)
+		{
+			_peaks_i64((int64_t *)vec->body, n, vec->peaks, nbins);
+			vec->stale = false;
+		}
+
+		_plot_peaks(ctx, prop, prop->minimum.h, prop->maximum.h);
+		return;
+	}
 
 	if(nk_chart_begin(ctx, NK_CHART_LINES, n, prop->minimum.h, prop->maximum.h))
 	{
-		const int64_t *i64 = (int64_t *)prop->value.vec.body;
+		const int64_t *i64 = (int64_t *)vec->body;
 
 		for(unsigned i = 0; i < n; i++)
 		{
@@ -1980,11 +2145,25 @@ _plot_i64(struct nk_context *ctx, prop_t *prop)
 static inline void
 _plot_f32(struct nk_context *ctx, prop_t *prop)
 {
-	const unsigned n = prop->value.vec.child_num;
+	vec_t *vec = &prop->value.vec;
+	const unsigned n = vec->child_num;
+	const uint32_t nbins = _plot_bins(ctx, vec);
+
+	if(nbins)
+	{
+		if(vec->stale)
+		{
+			_peaks_f32((float *)vec->body, n, vec->peaks, nbins);
+			vec->stale = false;
+		}
+
+		_plot_peaks(ctx, prop, prop->minimum.f, prop->maximum.f);
+		return;
+	}
 
 	if(nk_chart_begin(ctx, NK_CHART_LINES, n, prop->minimum.f, prop->maximum.f))
 	{
-		const float *f32 = (float *)prop->value.vec.body;
+		const float *f32 = (float *)vec->body;
 
 		for(unsigned i = 0; i < n; i++)
 		{
@@ -2003,11 +2182,25 @@ _plot_f32(struct nk_context *ctx, prop_t *prop)
 static inline void
 _plot_f64(struct nk_context *ctx, prop_t *prop)
 {
-	const unsigned n = prop->value.vec.child_num;
+	vec_t *vec = &prop->value.vec;
+	const unsigned n = vec->child_num;
+	const uint32_t nbins = _plot_bins(ctx, vec);
+
+	if(nbins)
+	{
+		if(vec->stale)
+		{
+			_peaks_f64((double *)vec->body, n, vec->peaks, nbins);
+			vec->stale = false;
+		}
+
+		_plot_peaks(ctx, prop, prop->minimum.d, prop->maximum.d);
+		return;
+	}
 
 	if(nk_chart_begin(ctx, NK_CHART_LINES, n, prop->minimum.d, prop->maximum.d))
 	{
-		const double *f64 = (double *)prop->value.vec.body;
+		const double *f64 = (double *)vec->body;
 
 		for(unsigned i = 0; i < n; i++)
 		{
@@ -2082,20 +2275,7 @@ _parameter_widget_tuple(plughandle_t *handle, struct nk_context *ctx, prop_t *pr
 			LV2_Inline_Display_Image_Surface *surf =
 				lv2_canvas_idisp_surf_configure(&handle->canvas_idisp, w, h, aspect_ratio);
 
-			const LV2_Atom *value = handle->canvas_value;
-
-			const LV2_Atom fake = {
-				.size = 0,
-				.type = handle->forge.Tuple
-			};
-
-			if(!value)
-			{
-				value = &fake;
-			}
-
-			lv2_canvas_idisp_render_body(&handle->canvas_idisp, value->type,
-				value->size, (const LV2_Atom *)LV2_ATOM_BODY_CONST(value));
+			lv2_canvas_idisp_render_layers(&handle->canvas_idisp);
 
 			_image_free(handle, &handle->canvas_img, false);
 			handle->canvas_img = _image_new(handle, surf->width, surf->height,
@@ -2241,7 +2421,7 @@ _patch_set_string(plughandle_t *handle, prop_t *prop, uint32_t size, const char
 	if(prop->value.editor.lexer.lex)
 		prop->value.editor.lexer.needs_refresh = 1;
 
-	nk_pugl_post_redisplay(&handle->win);
+	_redraw_mark(&handle->redraw);
 }
 
 static void
@@ -2950,6 +3130,8 @@ instantiate(const LV2UI_Descriptor *descriptor, const char *plugin_uri,
 	if(handle->log)
 		lv2_log_logger_init(&handle->logger, handle->map, handle->log);
 
+	_urid_cache_ref();
+
 	lv2_atom_forge_init(&handle->forge, handle->map);
 
 	handle->atom_eventTransfer = handle->map->map(handle->map->handle, LV2_ATOM__eventTransfer);
@@ -2973,6 +3155,7 @@ instantiate(const LV2UI_Descriptor *descriptor, const char *plugin_uri,
 	handle->patch_subject = handle->map->map(handle->map->handle, LV2_PATCH__subject);
 	handle->patch_sequenceNumber = handle->map->map(handle->map->handle, LV2_PATCH__sequenceNumber);
 	handle->moony_code = handle->map->map(handle->map->handle, MOONY_CODE_URI);
+	handle->moony_codeHash = handle->map->map(handle->map->handle, MOONY_CODE_HASH_URI);
 	handle->moony_error = handle->map->map(handle->map->handle, MOONY_ERROR_URI);
 	handle->moony_trace = handle->map->map(handle->map->handle, MOONY_TRACE_URI);
 	handle->moony_panic = handle->map->map(handle->map->handle, MOONY_PANIC_URI);
@@ -3070,6 +3253,9 @@ instantiate(const LV2UI_Descriptor *descriptor, const char *plugin_uri,
 
 	const LV2_URID ui_scaleFactor = handle->map->map(handle->map->handle,
 		LV2_UI__scaleFactor);
+	const LV2_URID ui_updateRate = handle->map->map(handle->map->handle,
+		LV2_UI__updateRate);
+	float update_rate = MOONY_UI_RATE;
 
 	for(LV2_Options_Option *opt = opts;
 		opt && (opt->key != 0) && (opt->value != NULL);
@@ -3079,8 +3265,15 @@ instantiate(const LV2UI_Descriptor *descriptor, const char *plugin_uri,
 		{
 			handle->scale = *(float*)opt->value;
 		}
+		else if( (opt->key == ui_updateRate) && (opt->type == handle->forge.Float)
+			&& (*(float*)opt->value > 0.f) )
+		{
+			update_rate = *(float*)opt->value;
+		}
 	}
 
+	_redraw_init(&handle->redraw, update_rate, MOONY_UI_HIDDEN_RATE);
+
 	if(handle->scale == 0.f)
 	{
 		handle->scale = nk_pugl_get_scale();
@@ -3190,8 +3383,9 @@ instantiate(const LV2UI_Descriptor *descriptor, const char *plugin_uri,
 		lua_pop(handle->L, 1); // lexer
 	}
 
+	_lex_incr_init(&handle->lex, handle->L);
 	handle->editor.lexer.lex = _lex;
-	handle->editor.lexer.data = handle->L;
+	handle->editor.lexer.data = &handle->lex;
 
 	file_browser_init(&handle->browser, 0, 1, _icon_load, handle);
 
@@ -3233,7 +3427,6 @@ cleanup(LV2UI_Handle instance)
 	plughandle_t *handle = instance;
 
 #if defined(BUILD_INLINE_DISP)
-	free(handle->canvas_value);
 	_image_free(handle, &handle->canvas_img, true);
 	lv2_canvas_idisp_deinit(&handle->canvas_idisp);
 #endif
@@ -3245,8 +3438,7 @@ cleanup(LV2UI_Handle instance)
 
 	nk_textedit_free(&handle->editor);
 
-	if(handle->editor.lexer.tokens)
-		free(handle->editor.lexer.tokens);
+	_lex_incr_deinit(&handle->lex);
 
 	_clear_log(handle);
 
@@ -3254,11 +3446,13 @@ cleanup(LV2UI_Handle instance)
 		_prop_free(handle, &handle->writables[p]);
 	if(handle->writables)
 		free(handle->writables);
+	_prop_index_deinit(&handle->writables_index);
 
 	for(int p = 0; p < handle->n_readable; p++)
 		_prop_free(handle, &handle->readables[p]);
 	if(handle->readables)
 		free(handle->readables);
+	_prop_index_deinit(&handle->readables_index);
 
 	for(int p = 0; p < 4; p++)
 	{
@@ -3275,6 +3469,8 @@ cleanup(LV2UI_Handle instance)
 	nk_pugl_hide(&handle->win);
 	nk_pugl_shutdown(&handle->win);
 
+	_urid_cache_unref();
+
 	free(handle);
 }
 
@@ -3282,11 +3478,23 @@ static void
 _patch_set_parameter_value(plughandle_t *handle, LV2_URID property,
 	const LV2_Atom *value)
 {
-	prop_t *prop = _prop_get(&handle->readables, &handle->n_readable, property);
+	prop_t *prop = _prop_get(&handle->readables, &handle->readables_index, property);
 	if(!prop)
-		prop = _prop_get(&handle->writables, &handle->n_writable, property);
+		prop = _prop_get(&handle->writables, &handle->writables_index, property);
 	if(prop && (prop->range == value->type) )
 	{
+		// graphs track their changes by layer generation instead
+		if(prop->range != handle->forge.Tuple)
+		{
+			const uint64_t value_hash = moony_hash((const char *)value,
+				lv2_atom_total_size(value));
+
+			if(value_hash == prop->value_hash)
+				return; // unchanged, no redraw
+
+			prop->value_hash = value_hash;
+		}
+
 		if(prop->range == handle->forge.Int)
 		{
 			prop->value.i = ((const LV2_Atom_Int *)value)->body;
@@ -3316,11 +3524,12 @@ _patch_set_parameter_value(plughandle_t *handle, LV2_URID property,
 		else if(prop->range == handle->forge.URID)
 		{
 			const LV2_URID urid = ((const LV2_Atom_URID *)value)->body;
-			const char *uri = handle->unmap->unmap(handle->unmap->handle, urid);
+			const char *uri = _urid_cache_unmap(handle->unmap, urid);
 
 			struct nk_str *str = &prop->value.editor.string;
 			nk_str_clear(str);
-			nk_str_append_text_utf8(str, uri, strlen(uri));
+			if(uri)
+				nk_str_append_text_utf8(str, uri, strlen(uri));
 		}
 		else if(prop->range == handle->forge.String)
 		{
@@ -3349,13 +3558,15 @@ _patch_set_parameter_value(plughandle_t *handle, LV2_URID property,
 #if defined(BUILD_INLINE_DISP)
 			if(prop->key == handle->canvas_idisp.canvas.urid.Canvas_graph)
 			{
-				const size_t total_sz = lv2_atom_total_size(value);
+				const uint32_t gen = handle->canvas_idisp.layers.gen;
+
+				// apply graph atom tuple to layers
+				lv2_canvas_idisp_update_body(&handle->canvas_idisp, value->type,
+					value->size, LV2_ATOM_BODY_CONST(value));
 
-				// copy graph atom tuple
-				handle->canvas_value = realloc(handle->canvas_value, total_sz);
-				memcpy(handle->canvas_value, value, total_sz);
+				if(handle->canvas_idisp.layers.gen == gen)
+					return; // no layer changed, no redraw
 
-				// force redraw
 				handle->canvas_redraw = true;
 			}
 #endif
@@ -3370,14 +3581,27 @@ _patch_set_parameter_value(plughandle_t *handle, LV2_URID property,
 				? vec_body_size / vec->body.child_size
 				: 0;
 			prop->value.vec.child_type = vec->body.child_type;
-			prop->value.vec.body = realloc(prop->value.vec.body, vec_body_size);
-			if(prop->value.vec.body)
+			prop->value.vec.stale = true;
+
+			// only grow buffer, vectors mostly keep their size
+			if(vec_body_size > prop->value.vec.size)
+			{
+				uint8_t *body = realloc(prop->value.vec.body, vec_body_size);
+
+				if(body)
+				{
+					prop->value.vec.body = body;
+					prop->value.vec.size = vec_body_size;
+				}
+			}
+
+			if(prop->value.vec.body && (vec_body_size <= prop->value.vec.size) )
 			{
 				memcpy(prop->value.vec.body, vec_body, vec_body_size);
 			}
 			else
 			{
-				//TODO handle error
+				prop->value.vec.child_num = 0; //TODO handle error
 			}
 		}
 		else
@@ -3385,7 +3609,7 @@ _patch_set_parameter_value(plughandle_t *handle, LV2_URID property,
 			//FIXME
 		}
 
-		nk_pugl_post_redisplay(&handle->win);
+		_redraw_mark(&handle->redraw);
 	}
 }
 
@@ -3393,11 +3617,13 @@ static void
 _patch_set_parameter_property(plughandle_t *handle, LV2_URID subject, LV2_URID property,
 	const LV2_Atom *value)
 {
-	prop_t *prop = _prop_get(&handle->readables, &handle->n_readable, subject);
+	prop_t *prop = _prop_get(&handle->readables, &handle->readables_index, subject);
 	if(!prop)
-		prop = _prop_get(&handle->writables, &handle->n_writable, subject);
+		prop = _prop_get(&handle->writables, &handle->writables_index, subject);
 	if(prop)
 	{
+		prop->value_hash = 0; // value may be clamped differently
+
 		if(  (property == handle->rdfs_range)
 			&& (value->type == handle->forge.URID) )
 		{
@@ -3498,10 +3724,17 @@ _patch_set_parameter_property(plughandle_t *handle, LV2_URID subject, LV2_URID p
 		{
 			const LV2_Atom_URID *syntax = (const LV2_Atom_URID *)value;
 
-			if(syntax->body == handle->lua_lang)
+			if( (syntax->body == handle->lua_lang) && !prop->lex)
+			{
+				prop->lex = calloc(1, sizeof(lex_incr_t));
+				if(prop->lex)
+					_lex_incr_init(prop->lex, handle->L);
+			}
+
+			if( (syntax->body == handle->lua_lang) && prop->lex)
 			{
 				prop->value.editor.lexer.lex = _lex;
-				prop->value.editor.lexer.data = handle->L;
+				prop->value.editor.lexer.data = prop->lex;
 			}
 		}
 		else if( (property == handle->lv2_minimum)
@@ -3549,7 +3782,7 @@ _patch_set_parameter_property(plughandle_t *handle, LV2_URID subject, LV2_URID p
 				memcpy(prop->points, points, sz);
 		}
 
-		nk_pugl_post_redisplay(&handle->win);
+		_redraw_mark(&handle->redraw);
 	}
 }
 
@@ -3567,7 +3800,7 @@ _patch_set_code(plughandle_t *handle, uint32_t size, const char *body, bool user
 		if(user)
 			handle->dirty = true; // user needs to resend
 
-		nk_pugl_post_redisplay(&handle->win);
+		_redraw_mark(&handle->redraw);
 	}
 }
 
@@ -3578,8 +3811,37 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 
 	if(property == handle->moony_code)
 	{
-		_clear_error(handle); // is safe, as moony:code is always received before a moony:error
-		_patch_set_code(handle, value->size, body, false);
+		if(value->type == handle->forge.Tuple)
+		{
+			switch(_moony_xfer_parse(&handle->xfer_in, handle->xfer_in_buf,
+				&handle->forge, (const LV2_Atom_Tuple *)value))
+			{
+				case MOONY_XFER_PENDING:
+				{
+					return; // wait for further fragments
+				}
+				case MOONY_XFER_ANNOUNCED:
+				{
+					if(handle->xfer_in.hash != _code_hash(handle))
+					{
+						_patch_get(handle, handle->moony_code);
+						return; // wait for fragments
+					}
+
+					_clear_error(handle); // we already hold this code
+				} break;
+				case MOONY_XFER_COMPLETE:
+				{
+					_clear_error(handle); // is safe, as moony:code is always received before a moony:error
+					_patch_set_code(handle, handle->xfer_in.size + 1, handle->xfer_in_buf, false);
+				} break;
+			}
+		}
+		else
+		{
+			_clear_error(handle); // is safe, as moony:code is always received before a moony:error
+			_patch_set_code(handle, value->size, body, false);
+		}
 
 		// new state may have these differently, so request them
 		_patch_get(handle, handle->moony_editorHidden);
@@ -3611,7 +3873,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 				}
 			}
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_error)
@@ -3626,7 +3888,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 				if(handle->error_sz)
 					handle->dirty = true; // user needs to resend
 
-				nk_pugl_post_redisplay(&handle->win);
+				_redraw_mark(&handle->redraw);
 			}
 		}
 	}
@@ -3636,7 +3898,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->editor_hidden = ((const LV2_Atom_Bool *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_logHidden)
@@ -3645,7 +3907,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->log_hidden = ((const LV2_Atom_Bool *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_logFollow)
@@ -3654,7 +3916,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->log_follow = ((const LV2_Atom_Bool *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_logReset)
@@ -3663,7 +3925,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->log_reset = ((const LV2_Atom_Bool *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_paramHidden)
@@ -3672,7 +3934,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->param_hidden = ((const LV2_Atom_Bool *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_paramCols)
@@ -3681,7 +3943,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->param_cols = ((const LV2_Atom_Int *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else if(property == handle->moony_paramRows)
@@ -3690,7 +3952,7 @@ _patch_set_self(plughandle_t *handle, LV2_URID property, const LV2_Atom *value)
 		{
 			handle->param_rows = ((const LV2_Atom_Int *)value)->body;
 
-			nk_pugl_post_redisplay(&handle->win);
+			_redraw_mark(&handle->redraw);
 		}
 	}
 	else
@@ -3831,8 +4093,9 @@ port_event(LV2UI_Handle instance, uint32_t index, uint32_t size,
 
 								handle->writables = NULL;
 								handle->n_writable = 0;
+								_prop_index_clear(&handle->writables_index);
 
-								nk_pugl_post_redisplay(&handle->win);
+								_redraw_mark(&handle->redraw);
 							}
 							else if( (pro->key == handle->patch_readable)
 								&& (property->body == handle->patch_wildcard) )
@@ -3846,8 +4109,9 @@ port_event(LV2UI_Handle instance, uint32_t index, uint32_t size,
 
 								handle->readables = NULL;
 								handle->n_readable = 0;
+								_prop_index_clear(&handle->readables_index);
 
-								nk_pugl_post_redisplay(&handle->win);
+								_redraw_mark(&handle->redraw);
 							}
 						}
 					}
@@ -3860,12 +4124,14 @@ port_event(LV2UI_Handle instance, uint32_t index, uint32_t size,
 
 							if(pro->key == handle->patch_writable)
 							{
-								prop_t *prop = _prop_get_or_add(handle, &handle->writables, &handle->n_writable, property->body);
+								prop_t *prop = _prop_get_or_add(handle, &handle->writables, &handle->n_writable,
+									&handle->writables_index, property->body);
 								(void)prop;
 							}
 							else if(pro->key == handle->patch_readable)
 							{
-								prop_t *prop = _prop_get_or_add(handle, &handle->readables, &handle->n_readable, property->body);
+								prop_t *prop = _prop_get_or_add(handle, &handle->readables, &handle->n_readable,
+									&handle->readables_index, property->body);
 								(void)prop;
 							}
 						}
@@ -3893,7 +4159,7 @@ port_event(LV2UI_Handle instance, uint32_t index, uint32_t size,
 				prop_t *prop = &handle->controls_in[p];
 				prop->value.f = *(const float *)buf;
 
-				nk_pugl_post_redisplay(&handle->win);
+				_redraw_mark(&handle->redraw);
 				break;
 			}
 			else if(index == handle->controls_out[p].index)
@@ -3908,7 +4174,7 @@ port_event(LV2UI_Handle instance, uint32_t index, uint32_t size,
 				if(prop->value.f > prop->maximum.f)
 					prop->maximum.f = prop->value.f;
 
-				nk_pugl_post_redisplay(&handle->win);
+				_redraw_mark(&handle->redraw);
 				break;
 			}
 		}
@@ -3920,7 +4186,24 @@ _idle(LV2UI_Handle instance)
 {
 	plughandle_t *handle = instance;
 
-	return nk_pugl_process_events(&handle->win);
+	const uint64_t now = moony_nanos();
+	const bool visible = handle->win.view && puglGetVisible(handle->win.view);
+
+	_code_flush(handle);
+
+	// poll rarely while hidden, notifications are collected nevertheless
+	if(!_redraw_poll(&handle->redraw, visible, now))
+		return handle->win.quit;
+
+	if(!_redraw_due(&handle->redraw, visible, now))
+		return nk_pugl_process_events(&handle->win);
+
+	nk_pugl_post_redisplay(&handle->win);
+
+	const int quit = nk_pugl_process_events(&handle->win);
+	_redraw_cost(&handle->redraw, now, moony_nanos());
+
+	return quit;
 }
 
 static const LV2UI_Idle_Interface idle_ext = {
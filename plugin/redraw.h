@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _REDRAW_H
+#define _REDRAW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct _redraw_t redraw_t;
+
+// Redraw scheduler of UI, notifications only mark the UI dirty, idle callback
+// asks whether a frame is due. Frames are limited to the update rate and to
+// half of the time it took to draw the last frames, so slow exposes cannot
+// keep the event loop busy.
+struct _redraw_t {
+	uint64_t period; // minimal time between frames [ns]
+	uint64_t hidden; // minimal time between polls while hidden [ns]
+	uint64_t last; // time of last frame [ns]
+	uint64_t polled; // time of last poll [ns]
+	uint64_t cost; // smoothed duration of expose [ns]
+	bool dirty;
+};
+
+static inline void
+_redraw_init(redraw_t *redraw, float rate, float hidden_rate)
+{
+	memset(redraw, 0x0, sizeof(redraw_t));
+
+	redraw->period = 1e9 / rate;
+	redraw->hidden = 1e9 / hidden_rate;
+	redraw->dirty = true; // draw first frame
+}
+
+static inline void
+_redraw_mark(redraw_t *redraw)
+{
+	redraw->dirty = true;
+}
+
+// returns true if dirty frame is due and clears dirty flag
+static inline bool
+_redraw_due(redraw_t *redraw, bool visible, uint64_t now)
+{
+	const uint64_t min = 2*redraw->cost > redraw->period
+		? 2*redraw->cost
+		: redraw->period;
+
+	if(!redraw->dirty || !visible || (now - redraw->last < min) )
+		return false;
+
+	redraw->dirty = false;
+	redraw->last = now;
+
+	return true;
+}
+
+// returns true if events should be polled, throttled while hidden
+static inline bool
+_redraw_poll(redraw_t *redraw, bool visible, uint64_t now)
+{
+	if(!visible && (now - redraw->polled < redraw->hidden) )
+		return false;
+
+	redraw->polled = now;
+
+	return true;
+}
+
+// updates smoothed expose duration with duration of last expose
+static inline void
+_redraw_cost(redraw_t *redraw, uint64_t t0, uint64_t t1)
+{
+	redraw->cost = (3*redraw->cost + (t1 - t0)) / 4;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _RUN_SLICE_H
+#define _RUN_SLICE_H
+
+#include <lock_stash.h>
+
+typedef struct _run_slice_t run_slice_t;
+
+struct _run_slice_t {
+	lock_stash_t stash; // events of current slice
+	const LV2_Atom_Sequence *seq;
+	const LV2_Atom_Event *ev; // next event not yet sliced
+};
+
+static inline void
+_slice_init(run_slice_t *slice, LV2_URID_Map *map)
+{
+	_stash_init(&slice->stash, map);
+	_stash_reset(&slice->stash);
+}
+
+static inline void
+_slice_begin(run_slice_t *slice, const LV2_Atom_Sequence *seq)
+{
+	slice->seq = seq;
+	slice->ev = lv2_atom_sequence_begin(&seq->body);
+}
+
+// copy all events up to and including frame time 'from' into slice sequence,
+// returns false if some of them did not fit
+static inline bool
+_slice_fill(run_slice_t *slice, int64_t from)
+{
+	lock_stash_t *stash = &slice->stash;
+	bool overflow = false;
+
+	_stash_reset(stash);
+
+	while(!lv2_atom_sequence_is_end(&slice->seq->body, slice->seq->atom.size, slice->ev)
+		&& (slice->ev->time.frames <= from) )
+	{
+		const LV2_Atom_Event *ev = slice->ev;
+
+		if(stash->ref)
+			stash->ref = lv2_atom_forge_frame_time(&stash->forge, ev->time.frames);
+		if(stash->ref)
+			stash->ref = lv2_atom_forge_write(&stash->forge, &ev->body, lv2_atom_total_size(&ev->body));
+		if(!stash->ref)
+			overflow = true;
+
+		slice->ev = lv2_atom_sequence_next(ev);
+	}
+
+	return !overflow;
+}
+
+// frame time of next pending event, clipped to 'to'
+static inline int64_t
+_slice_next(const run_slice_t *slice, int64_t to)
+{
+	if(!lv2_atom_sequence_is_end(&slice->seq->body, slice->seq->atom.size, slice->ev)
+		&& (slice->ev->time.frames < to) )
+	{
+		return slice->ev->time.frames;
+	}
+
+	return to;
+}
+
+// linear ramp of control value from previous to current period
+static inline float
+_slice_lerp(float last, float curr, int64_t from, uint32_t nsamples)
+{
+	return last + (curr - last) * from / nsamples;
+}
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#ifndef _URID_CACHE_H
+#define _URID_CACHE_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+
+#define URID_CACHE_MIN 0x100 // initial number of cache slots
+#define PROP_INDEX_MIN 0x40 // initial number of index slots
+
+typedef struct _urid_cache_entry_t urid_cache_entry_t;
+typedef struct _urid_cache_t urid_cache_t;
+typedef struct _prop_index_slot_t prop_index_slot_t;
+typedef struct _prop_index_t prop_index_t;
+
+struct _urid_cache_entry_t {
+	LV2_URID_Unmap_Handle handle; // of host unmap feature
+	LV2_URID urid;
+	char *uri; // NULL if empty
+};
+
+// Cache of unmapped URIs shared by all UI instances of the loaded UI binary.
+// Entries live as long as any instance holds a reference, thus returned URI
+// strings stay valid during the lifetime of the instance.
+struct _urid_cache_t {
+	pthread_mutex_t lock;
+	unsigned refs;
+	urid_cache_entry_t *entries;
+	uint32_t mask; // number of slots - 1
+	uint32_t n;
+};
+
+static urid_cache_t urid_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static inline uint32_t
+_urid_cache_hash(LV2_URID_Unmap_Handle handle, LV2_URID urid)
+{
+	return (urid * 2654435761U) ^ (uint32_t)((uintptr_t)handle >> 4);
+}
+
+static inline void
+_urid_cache_ref(void)
+{
+	pthread_mutex_lock(&urid_cache.lock);
+	urid_cache.refs += 1;
+	pthread_mutex_unlock(&urid_cache.lock);
+}
+
+static inline void
+_urid_cache_unref(void)
+{
+	pthread_mutex_lock(&urid_cache.lock);
+
+	if(--urid_cache.refs == 0)
+	{
+		if(urid_cache.entries)
+		{
+			for(uint32_t i = 0; i <= urid_cache.mask; i++)
+			{
+				free(urid_cache.entries[i].uri);
+			}
+
+			free(urid_cache.entries);
+		}
+
+		urid_cache.entries = NULL;
+		urid_cache.mask = 0;
+		urid_cache.n = 0;
+	}
+
+	pthread_mutex_unlock(&urid_cache.lock);
+}
+
+// keeps cache at most half full, returns false if out of memory
+static inline bool
+_urid_cache_grow(void)
+{
+	if(urid_cache.entries && (2*(urid_cache.n + 1) <= urid_cache.mask + 1) )
+		return true;
+
+	const uint32_t nslots = urid_cache.entries
+		? 2*(urid_cache.mask + 1)
+		: URID_CACHE_MIN;
+	urid_cache_entry_t *entries = calloc(nslots, sizeof(urid_cache_entry_t));
+	if(!entries)
+		return false;
+
+	if(urid_cache.entries)
+	{
+		for(uint32_t i = 0; i <= urid_cache.mask; i++)
+		{
+			const urid_cache_entry_t *entry = &urid_cache.entries[i];
+
+			if(!entry->uri)
+				continue;
+
+			uint32_t j = _urid_cache_hash(entry->handle, entry->urid) & (nslots - 1);
+			while(entries[j].uri)
+				j = (j + 1) & (nslots - 1);
+
+			entries[j] = *entry;
+		}
+
+		free(urid_cache.entries);
+	}
+
+	urid_cache.entries = entries;
+	urid_cache.mask = nslots - 1;
+
+	return true;
+}
+
+// unmaps urid via cache, asks host upon first request only
+static inline const char *
+_urid_cache_unmap(LV2_URID_Unmap *unmap, LV2_URID urid)
+{
+	const char *uri = NULL;
+
+	pthread_mutex_lock(&urid_cache.lock);
+
+	if(urid && _urid_cache_grow())
+	{
+		uint32_t i = _urid_cache_hash(unmap->handle, urid) & urid_cache.mask;
+		urid_cache_entry_t *entry;
+
+		for(entry = &urid_cache.entries[i];
+			entry->uri;
+			i = (i + 1) & urid_cache.mask, entry = &urid_cache.entries[i])
+		{
+			if( (entry->handle == unmap->handle) && (entry->urid == urid) )
+			{
+				uri = entry->uri;
+				break;
+			}
+		}
+
+		if(!uri)
+		{
+			const char *host_uri = unmap->unmap(unmap->handle, urid);
+
+			if(host_uri)
+			{
+				entry->uri = strdup(host_uri);
+
+				if(entry->uri)
+				{
+					entry->handle = unmap->handle;
+					entry->urid = urid;
+					urid_cache.n += 1;
+
+					uri = entry->uri;
+				}
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&urid_cache.lock);
+
+	return uri;
+}
+
+struct _prop_index_slot_t {
+	LV2_URID key; // 0 if empty
+	uint32_t pos;
+};
+
+// Hash index of property URIDs to positions in a property array, which itself
+// is kept sorted by URI for display.
+struct _prop_index_t {
+	prop_index_slot_t *slots;
+	uint32_t mask; // number of slots - 1
+	uint32_t n;
+};
+
+static inline void
+_prop_index_init(prop_index_t *index)
+{
+	memset(index, 0x0, sizeof(prop_index_t));
+}
+
+static inline void
+_prop_index_deinit(prop_index_t *index)
+{
+	free(index->slots);
+	_prop_index_init(index);
+}
+
+static inline void
+_prop_index_clear(prop_index_t *index)
+{
+	if(index->slots)
+		memset(index->slots, 0x0, (index->mask + 1) * sizeof(prop_index_slot_t));
+
+	index->n = 0;
+}
+
+// returns position of key, -1 if not indexed
+static inline int
+_prop_index_get(const prop_index_t *index, LV2_URID key)
+{
+	if(!index->slots)
+		return -1;
+
+	for(uint32_t i = (key * 2654435761U) & index->mask;
+		index->slots[i].key;
+		i = (i + 1) & index->mask)
+	{
+		if(index->slots[i].key == key)
+			return index->slots[i].pos;
+	}
+
+	return -1;
+}
+
+// indexes key at pos and shifts following positions, returns false if out of
+// memory
+static inline bool
+_prop_index_insert(prop_index_t *index, LV2_URID key, uint32_t pos)
+{
+	if(!index->slots || (2*(index->n + 1) > index->mask + 1) )
+	{
+		const uint32_t nslots = index->slots
+			? 2*(index->mask + 1)
+			: PROP_INDEX_MIN;
+		prop_index_slot_t *slots = calloc(nslots, sizeof(prop_index_slot_t));
+		if(!slots)
+			return false;
+
+		for(uint32_t i = 0; index->slots && (i <= index->mask); i++)
+		{
+			const prop_index_slot_t *slot = &index->slots[i];
+
+			if(!slot->key)
+				continue;
+
+			uint32_t j = (slot->key * 2654435761U) & (nslots - 1);
+			while(slots[j].key)
+				j = (j + 1) & (nslots - 1);
+
+			slots[j] = *slot;
+		}
+
+		free(index->slots);
+		index->slots = slots;
+		index->mask = nslots - 1;
+	}
+
+	for(uint32_t i = 0; i <= index->mask; i++)
+	{
+		prop_index_slot_t *slot = &index->slots[i];
+
+		if(slot->key && (slot->pos >= pos) )
+			slot->pos += 1;
+	}
+
+	uint32_t i = (key * 2654435761U) & index->mask;
+	while(index->slots[i].key)
+		i = (i + 1) & index->mask;
+
+	index->slots[i].key = key;
+	index->slots[i].pos = pos;
+	index->n += 1;
+
+	return true;
+}
+
+#endif
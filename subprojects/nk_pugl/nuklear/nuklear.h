@@ -16967,9 +16967,7 @@ nk_edit_refresh_lex(struct nk_text_edit *edit)
 {
 	if(edit->lexer.needs_refresh || !edit->lexer.tokens)
 	{
-		if(edit->lexer.tokens)
-			free(edit->lexer.tokens);
-
+		/* tokens are owned by lexer, which may reuse them */
 		edit->lexer.tokens = edit->lexer.lex(edit->lexer.data,
 			nk_str_get_const(&edit->string), nk_str_len_char(&edit->string));
 
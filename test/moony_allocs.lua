@@ -0,0 +1,49 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+-- forward events without allocating after warm-up, e.g. via moony_run
+local periods = 0
+local events = {}
+
+Moony.allocs(true)
+Moony.strict(8)
+
+local function alloc()
+	return {}
+end
+
+function run(n, control, notify, seq, forge)
+	periods = periods + 1
+
+	-- allocations during warm-up are fine
+	if periods <= 8 then
+		events[periods] = {}
+	end
+
+	for frames, atom in seq:foreach() do
+		forge:time(frames):atom(atom)
+	end
+
+	-- first allocation after warm-up raises an error
+	if periods == 16 then
+		Moony.allocs(false)
+
+		local succ, err = pcall(alloc)
+		assert(not succ)
+		assert(string.find(err, 'strict: %d+ bytes allocated after warm%-up'))
+	end
+end
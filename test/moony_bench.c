@@ -0,0 +1,846 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <moony.h>
+#include <api_capture.h>
+
+#include <lauxlib.h>
+
+#define BUF_SIZE 0x10000 // 64K
+#define MAX_URIDS 2048
+#define MAX_JOBS 64
+#define MAX_PORTS 4
+
+typedef struct _urid_t urid_t;
+typedef struct _job_t job_t;
+typedef struct _bench_t bench_t;
+
+struct _urid_t {
+	LV2_URID urid;
+	char *uri;
+};
+
+struct _job_t {
+	uint32_t size;
+	void *body;
+};
+
+struct _bench_t {
+	urid_t urids [MAX_URIDS];
+	LV2_URID urid;
+
+	const LV2_Descriptor *desc;
+	LV2_Handle instance;
+	const LV2_Worker_Interface *iface;
+
+	unsigned nvals;
+	unsigned nseqs;
+
+	float val_in [MAX_PORTS];
+	float val_out [MAX_PORTS];
+
+	uint8_t seq_in [MAX_PORTS][BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t seq_out [MAX_PORTS][BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t control [BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t notify [BUF_SIZE] __attribute__((aligned(8)));
+
+	job_t jobs [MAX_JOBS];
+	unsigned njobs;
+
+	LV2_Atom_Forge forge;
+
+	struct {
+		LV2_URID midi_event;
+		LV2_URID patch_set;
+		LV2_URID patch_property;
+		LV2_URID patch_value;
+		LV2_URID moony_code;
+		LV2_URID moony_capture;
+	} uris;
+
+	struct {
+		uint8_t *buf;
+		LV2_URID *urids; // captured URID -> mapped URID
+		size_t nurids;
+		const moony_capture_period_t **periods;
+		uint64_t nperiods;
+		const char *uri;
+		const char *code;
+		double sample_rate;
+	} replay;
+};
+
+__non_realtime static LV2_URID
+_map(LV2_URID_Map_Handle instance, const char *uri)
+{
+	bench_t *bench = instance;
+
+	urid_t *itm;
+	for(itm=bench->urids; itm->urid; itm++)
+	{
+		if(!strcmp(itm->uri, uri))
+			return itm->urid;
+	}
+
+	if(bench->urid + 1 >= MAX_URIDS)
+		return 0;
+
+	// create new
+	itm->urid = ++bench->urid;
+	itm->uri = strdup(uri);
+
+	return itm->urid;
+}
+
+__non_realtime static const char *
+_unmap(LV2_URID_Unmap_Handle instance, LV2_URID urid)
+{
+	bench_t *bench = instance;
+
+	for(urid_t *itm=bench->urids; itm->urid; itm++)
+	{
+		if(itm->urid == urid)
+			return itm->uri;
+	}
+
+	// not found
+	return NULL;
+}
+
+__non_realtime static LV2_Worker_Status
+_respond(LV2_Worker_Respond_Handle instance, uint32_t size, const void *data)
+{
+	bench_t *bench = instance;
+
+	return bench->iface->work_response(bench->instance, size, data);
+}
+
+// queue jobs and run them in between periods, outside of measurements
+__non_realtime static LV2_Worker_Status
+_sched(LV2_Worker_Schedule_Handle instance, uint32_t size, const void *data)
+{
+	bench_t *bench = instance;
+
+	if(bench->njobs >= MAX_JOBS)
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	job_t *job = &bench->jobs[bench->njobs];
+	job->body = malloc(size);
+	if(!job->body)
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	memcpy(job->body, data, size);
+	job->size = size;
+	bench->njobs++;
+
+	return LV2_WORKER_SUCCESS;
+}
+
+__non_realtime static void
+_work(bench_t *bench)
+{
+	for(unsigned i = 0; i < bench->njobs; i++)
+	{
+		job_t *job = &bench->jobs[i];
+
+		bench->iface->work(bench->instance, _respond, bench, job->size, job->body);
+		free(job->body);
+	}
+	bench->njobs = 0;
+
+	if(bench->iface->end_run)
+		bench->iface->end_run(bench->instance);
+}
+
+__non_realtime static int
+_vprintf(void *data, LV2_URID type, const char *fmt, va_list args)
+{
+	vfprintf(stderr, fmt, args);
+
+	return 0;
+}
+
+__non_realtime static int
+_printf(void *data, LV2_URID type, const char *fmt, ...)
+{
+  va_list args;
+	int ret;
+
+  va_start (args, fmt);
+	ret = _vprintf(data, type, fmt, args);
+  va_end(args);
+
+	return ret;
+}
+
+__non_realtime static const LV2_Descriptor *
+_descriptor(const char *name)
+{
+	char *end;
+	const unsigned long idx = strtoul(name, &end, 10);
+
+	if(*end == '\0')
+		return lv2_descriptor(idx);
+
+	const LV2_Descriptor *desc;
+	for(uint32_t i = 0; (desc = lv2_descriptor(i)); i++)
+	{
+		const char *frag = strchr(desc->URI, '#');
+
+		if(!strcmp(desc->URI, name) || (frag && !strcmp(frag + 1, name)) )
+			return desc;
+	}
+
+	return NULL;
+}
+
+// derive port layout from descriptor URI, e.g. c1xc1, a2xa2, c4a1xc4a1
+__non_realtime static int
+_layout(bench_t *bench)
+{
+	const char *frag = strchr(bench->desc->URI, '#');
+	unsigned n;
+	unsigned m;
+	int len = 0;
+
+	if(!frag)
+		return -1;
+	frag++;
+
+	if( (sscanf(frag, "c%ua1xc%ua1%n", &n, &m, &len) == 2) && !frag[len] )
+	{
+		bench->nvals = n;
+		bench->nseqs = 1;
+	}
+	else if( (sscanf(frag, "a%uxa%u%n", &n, &m, &len) == 2) && !frag[len] )
+	{
+		bench->nvals = 0;
+		bench->nseqs = n;
+	}
+	else if( (sscanf(frag, "c%uxc%u%n", &n, &m, &len) == 2) && !frag[len] )
+	{
+		bench->nvals = n;
+		bench->nseqs = 0;
+	}
+	else
+	{
+		return -1;
+	}
+
+	return ( (n == m) && (n <= MAX_PORTS) ) ? 0 : -1;
+}
+
+__non_realtime static void
+_connect(bench_t *bench)
+{
+	uint32_t port = 0;
+
+	for(unsigned i = 0; i < bench->nseqs; i++)
+		bench->desc->connect_port(bench->instance, port++, bench->seq_in[i]);
+	for(unsigned i = 0; i < bench->nseqs; i++)
+		bench->desc->connect_port(bench->instance, port++, bench->seq_out[i]);
+	for(unsigned i = 0; i < bench->nvals; i++)
+		bench->desc->connect_port(bench->instance, port++, &bench->val_in[i]);
+	for(unsigned i = 0; i < bench->nvals; i++)
+		bench->desc->connect_port(bench->instance, port++, &bench->val_out[i]);
+	bench->desc->connect_port(bench->instance, port++, bench->control);
+	bench->desc->connect_port(bench->instance, port++, bench->notify);
+}
+
+__non_realtime static void
+_prepare_outputs(bench_t *bench)
+{
+	for(unsigned i = 0; i < bench->nseqs; i++)
+	{
+		LV2_Atom *atom = (LV2_Atom *)bench->seq_out[i];
+
+		atom->size = BUF_SIZE - sizeof(LV2_Atom);
+		atom->type = 0;
+	}
+	{
+		LV2_Atom *atom = (LV2_Atom *)bench->notify;
+
+		atom->size = BUF_SIZE - sizeof(LV2_Atom);
+		atom->type = 0;
+	}
+}
+
+__non_realtime static void
+_patch_set(bench_t *bench, LV2_URID property, LV2_URID type, const char *str)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Atom_Forge_Frame obj_frame;
+
+	lv2_atom_forge_frame_time(forge, 0);
+	lv2_atom_forge_object(forge, &obj_frame, 0, bench->uris.patch_set);
+	lv2_atom_forge_key(forge, bench->uris.patch_property);
+	lv2_atom_forge_urid(forge, property);
+	lv2_atom_forge_key(forge, bench->uris.patch_value);
+	lv2_atom_forge_typed_string(forge, type, str, strlen(str));
+	lv2_atom_forge_pop(forge, &obj_frame);
+}
+
+__non_realtime static void
+_prepare(bench_t *bench, uint64_t period, uint32_t nsamples, uint32_t nevents,
+	const char *code, const char *capture)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Atom_Forge_Frame frame;
+
+	// control input, with code update and capture request if any
+	lv2_atom_forge_set_buffer(forge, bench->control, BUF_SIZE);
+	lv2_atom_forge_sequence_head(forge, &frame, 0);
+	if(code)
+		_patch_set(bench, bench->uris.moony_code, forge->String, code);
+	if(capture)
+		_patch_set(bench, bench->uris.moony_capture, forge->Path, capture);
+	lv2_atom_forge_pop(forge, &frame);
+
+	// synthetic event input, alternating note on/off spread over period
+	for(unsigned i = 0; i < bench->nseqs; i++)
+	{
+		lv2_atom_forge_set_buffer(forge, bench->seq_in[i], BUF_SIZE);
+		lv2_atom_forge_sequence_head(forge, &frame, 0);
+		for(uint32_t j = 0; j < nevents; j++)
+		{
+			const uint8_t note = (period + j) & 0x7f;
+			const uint8_t msg [3] = {
+				(j & 1) ? LV2_MIDI_MSG_NOTE_OFF : LV2_MIDI_MSG_NOTE_ON,
+				note,
+				0x7f
+			};
+
+			lv2_atom_forge_frame_time(forge, (uint64_t)j * nsamples / nevents);
+			lv2_atom_forge_atom(forge, sizeof(msg), bench->uris.midi_event);
+			lv2_atom_forge_write(forge, msg, sizeof(msg));
+		}
+		lv2_atom_forge_pop(forge, &frame);
+	}
+
+	// synthetic control input
+	for(unsigned i = 0; i < bench->nvals; i++)
+		bench->val_in[i] = sinf(period * 0.01f + i);
+
+	_prepare_outputs(bench);
+}
+
+__non_realtime static void *
+_load(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char *buf = len >= 0 ? malloc(len + 1) : NULL;
+	if(buf)
+	{
+		if(fread(buf, 1, len, f) != (size_t)len)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		else
+		{
+			buf[len] = '\0';
+			*size = len;
+		}
+	}
+
+	fclose(f);
+
+	return buf;
+}
+
+// feed captured period, returns number of input events
+__non_realtime static uint32_t
+_prepare_replay(bench_t *bench, const moony_capture_period_t *period)
+{
+	const float *vals = (const float *)&period[1];
+	const uint8_t *ptr = (const uint8_t *)&period[1]
+		+ lv2_atom_pad_size(period->nvals * sizeof(float));
+	uint32_t nevents = 0;
+
+	for(unsigned i = 0; i < period->nvals; i++)
+		bench->val_in[i] = vals[i];
+
+	for(unsigned i = 0; i <= period->nseqs; i++)
+	{
+		const LV2_Atom_Sequence *seq = (const LV2_Atom_Sequence *)ptr;
+		const uint32_t sz = lv2_atom_total_size(&seq->atom);
+
+		memcpy(i == 0 ? bench->control : bench->seq_in[i - 1], seq,
+			sz <= BUF_SIZE ? sz : 0);
+		ptr += lv2_atom_pad_size(sz);
+
+		if(i == 0)
+			continue;
+
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+			nevents++;
+	}
+
+	_prepare_outputs(bench);
+
+	return nevents;
+}
+
+__non_realtime static void
+_replay_urid(void *data, LV2_URID *urid)
+{
+	bench_t *bench = data;
+
+	*urid = (*urid < bench->replay.nurids)
+		? bench->replay.urids[*urid]
+		: 0;
+}
+
+// parse capture file and remap its URIDs in place
+__non_realtime static int
+_replay_load(bench_t *bench, const char *path)
+{
+	size_t size;
+	uint8_t *buf = _load(path, &size);
+	const size_t magic_len = strlen(MOONY_CAPTURE_MAGIC);
+
+	if(!buf)
+		return -1;
+
+	bench->replay.buf = buf;
+
+	if( (size < magic_len) || memcmp(buf, MOONY_CAPTURE_MAGIC, magic_len) )
+		return -1;
+
+	for(size_t offset = magic_len; offset + sizeof(moony_capture_rec_t) <= size; )
+	{
+		const moony_capture_rec_t *rec = (const moony_capture_rec_t *)&buf[offset];
+		uint8_t *body = (uint8_t *)&rec[1];
+
+		offset += sizeof(moony_capture_rec_t) + lv2_atom_pad_size(rec->size);
+		if(offset > size)
+			return -1; // truncated
+
+		switch((moony_capture_type_t)rec->type)
+		{
+			case MOONY_CAPTURE_HEADER:
+			{
+				const moony_capture_header_t *header = (const moony_capture_header_t *)body;
+
+				if(header->version != MOONY_CAPTURE_VERSION)
+					return -1;
+
+				bench->replay.sample_rate = header->sample_rate;
+				bench->replay.uri = header->uri;
+			} break;
+			case MOONY_CAPTURE_URID:
+			{
+				const LV2_URID urid = *(const LV2_URID *)body;
+				const char *uri = (const char *)(body + sizeof(LV2_URID));
+
+				if(urid >= bench->replay.nurids)
+				{
+					const size_t nurids = urid + 0x100;
+					LV2_URID *urids = realloc(bench->replay.urids, nurids * sizeof(LV2_URID));
+					if(!urids)
+						return -1;
+
+					memset(&urids[bench->replay.nurids], 0x0,
+						(nurids - bench->replay.nurids) * sizeof(LV2_URID));
+					bench->replay.urids = urids;
+					bench->replay.nurids = nurids;
+				}
+
+				bench->replay.urids[urid] = _map(bench, uri);
+			} break;
+			case MOONY_CAPTURE_CODE:
+			{
+				if(!bench->replay.code)
+					bench->replay.code = (const char *)body;
+			} break;
+			case MOONY_CAPTURE_PERIOD:
+			{
+				moony_capture_period_t *period = (moony_capture_period_t *)body;
+				uint8_t *ptr = (uint8_t *)&period[1]
+					+ lv2_atom_pad_size(period->nvals * sizeof(float));
+
+				for(unsigned i = 0; i <= period->nseqs; i++)
+				{
+					LV2_Atom *atom = (LV2_Atom *)ptr;
+
+					moony_capture_walk(atom, &bench->forge, _replay_urid, bench);
+					ptr += lv2_atom_pad_size(lv2_atom_total_size(atom));
+				}
+
+				const moony_capture_period_t **periods = realloc(bench->replay.periods,
+					(bench->replay.nperiods + 1) * sizeof(moony_capture_period_t *));
+				if(!periods)
+					return -1;
+
+				periods[bench->replay.nperiods++] = period;
+				bench->replay.periods = periods;
+			} break;
+			case MOONY_CAPTURE_EVENT:
+			{
+				// not part of captures
+			} break;
+		}
+	}
+
+	return bench->replay.nperiods ? 0 : -1;
+}
+
+
+__non_realtime static void
+_usage(const char *cmd)
+{
+	fprintf(stderr,
+		"usage: %s [OPTIONS] [SCRIPT]\n"
+		"\n"
+		"  -d DESCRIPTOR  plugin index, URI or URI fragment (default: c1xc1)\n"
+		"  -b FRAMES      block size (default: 64)\n"
+		"  -r RATE        sample rate (default: 48000)\n"
+		"  -n PERIODS     number of measured periods (default: 10000)\n"
+		"  -w PERIODS     number of warm-up periods (default: 100)\n"
+		"  -e EVENTS      synthetic MIDI events per period and port (default: 0)\n"
+		"  -i CAPTURE     replay captured input instead of synthetic input,\n"
+		"                 defaults to captured plugin, sample rate and script\n"
+		"  -o CAPTURE     capture input of measured periods to file\n"
+		"  -G             do not measure garbage collection\n"
+		"  -h             print this help\n", cmd);
+}
+
+__non_realtime int
+main(int argc, char **argv)
+{
+	static bench_t bench;
+
+	const char *name = NULL;
+	const char *input = NULL;
+	const char *output = NULL;
+	uint32_t nsamples = 64;
+	double srate = 0.0;
+	uint64_t nperiods = 0;
+	uint64_t nwarmups = 100;
+	uint32_t nevents = 0;
+	bool gc = true;
+
+	int c;
+	while( (c = getopt(argc, argv, "d:b:r:n:w:e:i:o:Gh")) != -1)
+	{
+		switch(c)
+		{
+			case 'd':
+				name = optarg;
+				break;
+			case 'b':
+				nsamples = strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				srate = strtod(optarg, NULL);
+				break;
+			case 'n':
+				nperiods = strtoull(optarg, NULL, 10);
+				break;
+			case 'w':
+				nwarmups = strtoull(optarg, NULL, 10);
+				break;
+			case 'e':
+				nevents = strtoul(optarg, NULL, 10);
+				break;
+			case 'i':
+				input = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 'G':
+				gc = false;
+				break;
+			case 'h':
+			default:
+				_usage(argv[0]);
+				return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if( (optind < argc - 1) || !nsamples || (srate < 0.0) )
+	{
+		_usage(argv[0]);
+		return -1;
+	}
+
+	LV2_URID_Map map = {
+		.handle = &bench,
+		.map = _map
+	};
+	LV2_URID_Unmap unmap = {
+		.handle = &bench,
+		.unmap = _unmap
+	};
+	LV2_Worker_Schedule sched = {
+		.handle = &bench,
+		.schedule_work = _sched
+	};
+	LV2_Log_Log log = {
+		.handle = &bench,
+		.printf = _printf,
+		.vprintf = _vprintf
+	};
+	LV2_Options_Option opts [] = {
+		{
+			.key = 0,
+			.value =NULL
+		}
+	};
+
+	const LV2_Feature feat_map = {
+		.URI = LV2_URID__map,
+		.data = &map
+	};
+	const LV2_Feature feat_unmap = {
+		.URI = LV2_URID__unmap,
+		.data = &unmap
+	};
+	const LV2_Feature feat_sched = {
+		.URI = LV2_WORKER__schedule,
+		.data = &sched
+	};
+	const LV2_Feature feat_log = {
+		.URI = LV2_LOG__log,
+		.data = &log
+	};
+	const LV2_Feature feat_opts = {
+		.URI = LV2_OPTIONS__options,
+		.data = opts
+	};
+
+	const LV2_Feature *const features [] = {
+		&feat_map,
+		&feat_unmap,
+		&feat_sched,
+		&feat_log,
+		&feat_opts,
+		NULL
+	};
+
+	bench.uris.midi_event = _map(&bench, LV2_MIDI__MidiEvent);
+	bench.uris.patch_set = _map(&bench, LV2_PATCH__Set);
+	bench.uris.patch_property = _map(&bench, LV2_PATCH__property);
+	bench.uris.patch_value = _map(&bench, LV2_PATCH__value);
+	bench.uris.moony_code = _map(&bench, MOONY_CODE_URI);
+	bench.uris.moony_capture = _map(&bench, MOONY_CAPTURE_URI);
+	lv2_atom_forge_init(&bench.forge, &map);
+
+	int ret = -1;
+	char *code = NULL;
+	const char *script = NULL;
+
+	if(input)
+	{
+		if(_replay_load(&bench, input))
+		{
+			fprintf(stderr, "err: invalid capture '%s'\n", input);
+			goto fail;
+		}
+
+		if(!name)
+			name = bench.replay.uri;
+		if(srate == 0.0)
+			srate = bench.replay.sample_rate;
+		if(nperiods == 0)
+			nperiods = bench.replay.nperiods;
+		script = bench.replay.code;
+	}
+
+	if(!name)
+		name = "c1xc1";
+	if(srate == 0.0)
+		srate = 48000.0;
+	if(nperiods == 0)
+		nperiods = 10000;
+
+	if(optind == argc - 1)
+	{
+		size_t size;
+
+		code = _load(argv[optind], &size);
+		if(!code)
+		{
+			fprintf(stderr, "err: cannot load '%s'\n", argv[optind]);
+			goto fail;
+		}
+
+		script = code;
+	}
+
+	if(!script)
+	{
+		_usage(argv[0]);
+		goto fail;
+	}
+
+	bench.desc = _descriptor(name);
+	if(!bench.desc || _layout(&bench))
+	{
+		fprintf(stderr, "err: invalid descriptor '%s'\n", name);
+		goto fail;
+	}
+
+	if(input)
+	{
+		const moony_capture_period_t *period = bench.replay.periods[0];
+
+		if( (period->nvals != bench.nvals) || (period->nseqs != bench.nseqs) )
+		{
+			fprintf(stderr, "err: capture does not match ports of '%s'\n", name);
+			goto fail;
+		}
+	}
+
+	if(!bench.nseqs)
+		nevents = 0;
+
+	bench.instance = bench.desc->instantiate(bench.desc, srate, NULL, features);
+	if(!bench.instance)
+	{
+		fprintf(stderr, "err: instantiation failed\n");
+		goto fail;
+	}
+
+	// every plugin handle starts with its moony_t
+	moony_t *moony = bench.instance;
+
+	bench.iface = bench.desc->extension_data(LV2_WORKER__interface);
+	_connect(&bench);
+
+	if(bench.desc->activate)
+		bench.desc->activate(bench.instance);
+
+	// upload script and warm up
+	uint64_t period = 0;
+	for(uint64_t i = 0; i <= nwarmups; i++, period++)
+	{
+		_prepare(&bench, period, nsamples, input ? 0 : nevents,
+			i == 0 ? script : NULL,
+			(i == nwarmups) ? output : NULL);
+		bench.desc->run(bench.instance, nsamples);
+		_work(&bench);
+	}
+
+	if(moony_bypass(moony))
+	{
+		fprintf(stderr, "err: script failed to load or run\n");
+	}
+	else
+	{
+		moony_vm_t *vm = moony->vm;
+		lua_State *L = moony_current(moony);
+		const uint64_t nalloc = vm->nalloc;
+		const uint64_t nfree = vm->nfree;
+		uint64_t run_sum = 0;
+		uint64_t run_max = 0;
+		uint64_t gc_sum = 0;
+		uint64_t gc_max = 0;
+		uint64_t frames = 0;
+		uint64_t nev = 0;
+
+		for(uint64_t i = 0; i < nperiods; i++, period++)
+		{
+			if(input)
+			{
+				const moony_capture_period_t *rec = bench.replay.periods[i % bench.replay.nperiods];
+
+				nev += _prepare_replay(&bench, rec);
+				nsamples = rec->nsamples;
+			}
+			else
+			{
+				_prepare(&bench, period, nsamples, nevents, NULL, NULL);
+				nev += nevents * bench.nseqs;
+			}
+			frames += nsamples;
+
+			const uint64_t t0 = moony_nanos();
+			bench.desc->run(bench.instance, nsamples);
+			const uint64_t t1 = moony_nanos();
+
+			run_sum += t1 - t0;
+			if(t1 - t0 > run_max)
+				run_max = t1 - t0;
+
+			// collect garbage of this period on its own
+			if(gc)
+			{
+				const uint64_t t2 = moony_nanos();
+				lua_gc(L, LUA_GCSTEP, 0);
+				const uint64_t t3 = moony_nanos();
+
+				gc_sum += t3 - t2;
+				if(t3 - t2 > gc_max)
+					gc_max = t3 - t2;
+			}
+
+			_work(&bench);
+		}
+
+		if(moony_bypass(moony) || (!input && (moony->vm != vm)) )
+			fprintf(stderr, "err: script failed while running\n");
+		else
+			ret = 0;
+
+		const double run_mean = (double)run_sum / nperiods;
+		const double load = 100.0 * run_sum * srate / (frames * 1e9);
+
+		printf("moony_bench: %s, %.0f Hz, %.0f frames/period, %.1f events/period, %"PRIu64" periods%s\n",
+			bench.desc->URI, srate, (double)frames / nperiods, (double)nev / nperiods, nperiods,
+			input ? " (replayed)" : "");
+		printf("  run   : %10.0f ns/period (max %"PRIu64"), %.2f%% DSP load\n",
+			run_mean, run_max, load);
+		if(nev)
+			printf("  event : %10.1f ns/event\n", (double)run_sum / nev);
+		printf("  alloc : %10.2f allocations/period, %.2f frees/period, %zu KiB in use\n",
+			(double)(moony->vm->nalloc - nalloc) / nperiods, (double)(moony->vm->nfree - nfree) / nperiods,
+			moony->vm->used >> 10);
+		if(gc)
+			printf("  gc    : %10.0f ns/period (max %"PRIu64")\n",
+				(double)gc_sum / nperiods, gc_max);
+	}
+
+	if(bench.desc->deactivate)
+		bench.desc->deactivate(bench.instance);
+	bench.desc->cleanup(bench.instance);
+
+	for(unsigned i = 0; i < bench.njobs; i++)
+		free(bench.jobs[i].body);
+
+fail:
+	for(urid_t *itm=bench.urids; itm->urid; itm++)
+		free(itm->uri);
+	free(bench.replay.periods);
+	free(bench.replay.urids);
+	free(bench.replay.buf);
+	free(code);
+
+	return ret;
+}
@@ -0,0 +1,50 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+-- transpose notes on every event port, pass through everything else
+local transp = 12
+local count = 0
+
+local midiR = MIDIResponder({
+	[MIDI.NoteOn] = function(self, frames, forge, chan, note, vel)
+		count = count + 1
+		forge:time(frames):midi(MIDI.NoteOn | chan, (note + transp) & 0x7f, vel)
+	end,
+	[MIDI.NoteOff] = function(self, frames, forge, chan, note, vel)
+		forge:time(frames):midi(MIDI.NoteOff | chan, (note + transp) & 0x7f, vel)
+	end
+}, true)
+
+function once(n, control, notify, ...)
+	count = 0
+end
+
+local function process(n, control, notify, seq, forge, ...)
+	if type(seq) == 'userdata' then
+		for frames, atom in seq:foreach() do
+			midiR(frames, forge, atom)
+		end
+
+		return process(n, control, notify, ...)
+	end
+
+	return seq, forge, ...
+end
+
+function run(n, control, notify, ...)
+	return process(n, control, notify, ...)
+end
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <canvas.lv2/forge.h>
+#include <canvas.lv2/idisp.h>
+
+#define MAX_URIDS 256
+
+typedef struct _urid_t urid_t;
+typedef struct _bench_t bench_t;
+
+struct _urid_t {
+	LV2_URID urid;
+	char *uri;
+};
+
+struct _bench_t {
+	urid_t urids [MAX_URIDS];
+	LV2_URID urid;
+
+	LV2_Atom_Forge forge;
+	LV2_Canvas_Idisp idisp;
+
+	uint8_t *graph;
+	uint32_t graph_size;
+};
+
+static LV2_URID
+_map(LV2_URID_Map_Handle instance, const char *uri)
+{
+	bench_t *bench = instance;
+
+	urid_t *itm;
+	for(itm=bench->urids; itm->urid; itm++)
+	{
+		if(!strcmp(itm->uri, uri))
+			return itm->urid;
+	}
+
+	if(bench->urid + 1 >= MAX_URIDS)
+		return 0;
+
+	// create new
+	itm->urid = ++bench->urid;
+	itm->uri = strdup(uri);
+
+	return itm->urid;
+}
+
+static uint64_t
+_nanos(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+typedef enum _graph_t {
+	GRAPH_RECTS,
+	GRAPH_LINE,
+	GRAPH_AREA,
+	GRAPH_BARS
+} graph_t;
+
+static const char *graph_names [] = {
+	[GRAPH_RECTS] = "rects",
+	[GRAPH_LINE] = "line",
+	[GRAPH_AREA] = "area",
+	[GRAPH_BARS] = "bars"
+};
+
+static inline float
+_trace(unsigned i, unsigned nelements)
+{
+	const float x = (float)i / nelements;
+
+	return 0.5f + 0.4f*sinf(x*20.f);
+}
+
+// scope-like graph: small stroked rectangles along a sine trace
+static LV2_Atom_Forge_Ref
+_graph_forge_rects(bench_t *bench, unsigned nelements)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Canvas_URID *urid = &bench->idisp.canvas.urid;
+	LV2_Atom_Forge_Ref ref = 1;
+
+	for(unsigned i = 0; ref && (i < nelements); i += 4)
+	{
+		const float x = (float)i / nelements;
+		const float y = _trace(i, nelements);
+
+		if(ref)
+			ref = lv2_canvas_forge_style(forge, urid, 0xff00ff00 | i);
+		if(ref)
+			ref = lv2_canvas_forge_rectangle(forge, urid, x, y, 0.01f, 0.01f);
+		if(ref)
+			ref = lv2_canvas_forge_lineWidth(forge, urid, 0.002f);
+		if(ref)
+			ref = lv2_canvas_forge_stroke(forge, urid);
+	}
+
+	return ref;
+}
+
+// sine trace as single polyline, optionally closed to a filled area
+static LV2_Atom_Forge_Ref
+_graph_forge_line(bench_t *bench, unsigned nelements, bool area)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Canvas_URID *urid = &bench->idisp.canvas.urid;
+	LV2_Atom_Forge_Ref ref;
+	float *vec = malloc(2*nelements * sizeof(float));
+
+	if(!vec)
+		return 0;
+
+	for(unsigned i = 0; i < nelements; i++)
+	{
+		vec[2*i + 0] = (float)i / nelements;
+		vec[2*i + 1] = _trace(i, nelements);
+	}
+
+	ref = lv2_canvas_forge_beginPath(forge, urid);
+	if(ref && area)
+		ref = lv2_canvas_forge_moveTo(forge, urid, 0.f, 1.f);
+	if(ref)
+		ref = lv2_canvas_forge_polyLine(forge, urid, 2*nelements, vec);
+	if(ref && area)
+		ref = lv2_canvas_forge_lineTo(forge, urid, 1.f, 1.f);
+	if(ref && area)
+		ref = lv2_canvas_forge_closePath(forge, urid);
+	if(ref)
+		ref = lv2_canvas_forge_style(forge, urid, 0xff00ff00);
+	if(ref)
+		ref = area
+			? lv2_canvas_forge_fill(forge, urid)
+			: lv2_canvas_forge_stroke(forge, urid);
+
+	free(vec);
+
+	return ref;
+}
+
+// bar graph: filled rectangles of one style
+static LV2_Atom_Forge_Ref
+_graph_forge_bars(bench_t *bench, unsigned nelements)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Canvas_URID *urid = &bench->idisp.canvas.urid;
+	LV2_Atom_Forge_Ref ref = lv2_canvas_forge_style(forge, urid, 0xff00ff00);
+	const float w = 1.f / nelements;
+
+	for(unsigned i = 0; ref && (i < nelements); i++)
+	{
+		const float y = _trace(i, nelements);
+
+		if(ref)
+			ref = lv2_canvas_forge_beginPath(forge, urid);
+		if(ref)
+			ref = lv2_canvas_forge_rectangle(forge, urid, i*w, y, w, 1.f - y);
+		if(ref)
+			ref = lv2_canvas_forge_fill(forge, urid);
+	}
+
+	return ref;
+}
+
+static bool
+_graph_forge(bench_t *bench, graph_t kind, unsigned nelements)
+{
+	LV2_Atom_Forge *forge = &bench->forge;
+	LV2_Atom_Forge_Frame frame;
+	const size_t size = (size_t)nelements * 0x80;
+
+	bench->graph = realloc(bench->graph, size);
+	if(!bench->graph)
+		return false;
+
+	lv2_atom_forge_set_buffer(forge, bench->graph, size);
+
+	LV2_Atom_Forge_Ref ref = lv2_atom_forge_tuple(forge, &frame);
+
+	if(ref)
+	{
+		switch(kind)
+		{
+			case GRAPH_RECTS:
+				ref = _graph_forge_rects(bench, nelements);
+				break;
+			case GRAPH_LINE:
+				ref = _graph_forge_line(bench, nelements, false);
+				break;
+			case GRAPH_AREA:
+				ref = _graph_forge_line(bench, nelements, true);
+				break;
+			case GRAPH_BARS:
+				ref = _graph_forge_bars(bench, nelements);
+				break;
+		}
+	}
+
+	if(ref)
+		lv2_atom_forge_pop(forge, &frame);
+
+	if(!ref)
+		return false;
+
+	bench->graph_size = lv2_atom_total_size((const LV2_Atom *)bench->graph);
+
+	return true;
+}
+
+static void
+_usage(const char *cmd)
+{
+	fprintf(stderr,
+		"usage: %s [OPTIONS]\n"
+		"\n"
+		"  -g GRAPH       graph kind: rects, line, area, bars (default: rects)\n"
+		"  -e ELEMENTS    number of graph elements (default: 10000)\n"
+		"  -s PIXELS      inline display size (default: 256)\n"
+		"  -n RENDERS     number of measured renders (default: 100)\n"
+		"  -h             print this help\n", cmd);
+}
+
+int
+main(int argc, char **argv)
+{
+	static bench_t bench;
+
+	graph_t kind = GRAPH_RECTS;
+	unsigned nelements = 10000;
+	unsigned npixels = 256;
+	unsigned nrenders = 100;
+
+	int c;
+	while( (c = getopt(argc, argv, "g:e:s:n:h")) != -1)
+	{
+		switch(c)
+		{
+			case 'g':
+				for(kind = GRAPH_RECTS; kind <= GRAPH_BARS; kind++)
+				{
+					if(!strcmp(optarg, graph_names[kind]))
+						break;
+				}
+				break;
+			case 'e':
+				nelements = atoi(optarg);
+				break;
+			case 's':
+				npixels = atoi(optarg);
+				break;
+			case 'n':
+				nrenders = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				_usage(argv[0]);
+				return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if(!nelements || !npixels || !nrenders || (kind > GRAPH_BARS) )
+	{
+		_usage(argv[0]);
+		return -1;
+	}
+
+	LV2_URID_Map map = {
+		.handle = &bench,
+		.map = _map
+	};
+
+	lv2_atom_forge_init(&bench.forge, &map);
+	lv2_canvas_idisp_init(&bench.idisp, NULL, &map);
+
+	if(!lv2_canvas_idisp_surf_configure(&bench.idisp, npixels, npixels, 1.f)
+		|| !bench.idisp.surf->cairo.ctx)
+	{
+		fprintf(stderr, "failed to create surface\n");
+		return -1;
+	}
+
+	if(!_graph_forge(&bench, kind, nelements))
+	{
+		fprintf(stderr, "failed to forge graph\n");
+		return -1;
+	}
+
+	const LV2_Atom *graph = (const LV2_Atom *)bench.graph;
+	uint64_t walk_sum = 0;
+	uint64_t list_sum = 0;
+	uint64_t skip_sum = 0;
+
+	// decode graph tuple on every render
+	for(unsigned i = 0; i < nrenders; i++)
+	{
+		const uint64_t t0 = _nanos();
+		lv2_canvas_idisp_render_body(&bench.idisp, graph->type, graph->size,
+			LV2_ATOM_BODY_CONST(graph));
+		const uint64_t t1 = _nanos();
+
+		walk_sum += t1 - t0;
+	}
+
+	// compile graph once, replay display list on every render
+	const uint64_t t0 = _nanos();
+	lv2_canvas_idisp_update_body(&bench.idisp, graph->type, graph->size,
+		LV2_ATOM_BODY_CONST(graph));
+	const uint64_t t1 = _nanos();
+
+	for(unsigned i = 0; i < nrenders; i++)
+	{
+		lv2_canvas_idisp_invalidate(&bench.idisp);
+
+		const uint64_t t2 = _nanos();
+		lv2_canvas_idisp_render_layers(&bench.idisp);
+		const uint64_t t3 = _nanos();
+
+		list_sum += t3 - t2;
+	}
+
+	// unchanged graph, rendering is skipped
+	for(unsigned i = 0; i < nrenders; i++)
+	{
+		lv2_canvas_idisp_update_body(&bench.idisp, graph->type, graph->size,
+			LV2_ATOM_BODY_CONST(graph));
+
+		const uint64_t t4 = _nanos();
+		lv2_canvas_idisp_render_layers(&bench.idisp);
+		const uint64_t t5 = _nanos();
+
+		skip_sum += t5 - t4;
+	}
+
+	printf("moony_canvas_bench: %s, %u elements, %u bytes, %ux%u pixels, %u renders\n",
+		graph_names[kind], nelements, bench.graph_size, npixels, npixels, nrenders);
+	printf("  walk    : %10.0f ns/render\n", (double)walk_sum / nrenders);
+	printf("  compile : %10.0f ns (%u bytes)\n", (double)(t1 - t0),
+		bench.idisp.layers.layer[bench.idisp.layers.order[0]].list.size);
+	printf("  replay  : %10.0f ns/render\n", (double)list_sum / nrenders);
+	printf("  skip    : %10.0f ns/render\n", (double)skip_sum / nrenders);
+
+	lv2_canvas_idisp_deinit(&bench.idisp);
+	free(bench.graph);
+
+	for(urid_t *itm=bench.urids; itm->urid; itm++)
+		free(itm->uri);
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+local function folds(code)
+	local _, n = fold(code)
+	return n
+end
+
+-- Folding
+print('[test] Folding')
+do
+	local code, n = fold("return Atom.Int, MIDI.NoteOn, Patch.Set, Param.sampleRate, Map['http://test.org#foo']")
+	assert(n == 5)
+	assert(not code:find('Atom'))
+
+	local a, b, c, d, e = load(code)()
+	assert(a == Atom.Int)
+	assert(b == MIDI.NoteOn)
+	assert(c == Patch.Set)
+	assert(d == Param.sampleRate)
+	assert(e == Map['http://test.org#foo'])
+
+	-- white space, comments and strings
+	assert(folds("return Atom . Int --[[ Atom.Long ]] .. 'Atom.Float'") == 1)
+	assert(load(fold("return Atom.Int..''"))() == tostring(Atom.Int))
+	assert(load(fold("return Map[\"urn:x\"]and 1"))() == 1)
+
+	-- lines are preserved for error messages
+	assert(select(2, fold("local a = Atom.Int\n\nerror('x')")) == 1)
+	local _, err = pcall(load(fold("local a = Atom.Int\n\nerror('x')"), 'chunk'))
+	assert(err:find('chunk"]:3:'))
+end
+
+-- Not folding
+print('[test] Not folding')
+do
+	-- dynamic and unknown keys
+	assert(folds("local k = 'Int'; return Atom[k], Atom.Foo, Map['a\\tb']") == 0)
+
+	-- rebinding, aliasing and writing
+	assert(folds("local Atom = {Int = 1}; return Atom.Int") == 0)
+	assert(folds("return Atom.Int, function(Atom) return Atom.Int end") == 0)
+	assert(folds("Atom.Int = 1; return MIDI.NoteOn") == 1)
+	assert(folds("Atom.Int, b = 1, 2; return MIDI.NoteOn") == 1)
+	assert(folds("Atom[Atom.Int] = 1") == 0)
+	assert(folds("local t = Atom; return Atom.Int") == 0)
+	assert(folds("function Atom.foo() end; return Atom.Int") == 0)
+	assert(folds("Atom = nil; return Atom.Int") == 0)
+
+	-- fields of other tables
+	assert(folds("local t = {}; t.Atom = {}; return t.Atom.Int, Atom.Int") == 1)
+	assert(folds("local t = {Atom.Int, Atom.Long}; return t") == 2)
+	assert(folds("local a, b = Atom.Int, Atom.Long; c = 2") == 2)
+
+	-- globals may be rebound behind our back
+	assert(folds("_ENV.Atom = {}; return Atom.Int") == 0)
+	assert(folds("load('Atom = {}')(); return Atom.Int") == 0)
+
+	-- calls and indexing of looked-up values
+	assert(folds("return Atom.Int(), Atom.Int.x, Map('urn:x')") == 0)
+end
+
+-- Benchmark
+print('[bench] Folding')
+do
+	local code = [[
+		local n = ...
+
+		local function producer(forge)
+			for i = 1, n do
+				forge:time(0):int(Atom.Int)
+				forge:time(0):midi(MIDI.NoteOn, 0x20, 0x7f)
+				forge:time(0):object(Patch.Set, Map['http://test.org#obj'])
+					:key(Patch.property):urid(Param.sampleRate)
+					:key(Patch.value):float(48000.0)
+					:pop()
+			end
+		end
+
+		local function consumer(seq)
+			local count = 0
+			for frames, atom in seq:foreach() do
+				if atom.type == Atom.Int then
+					count = count + 1
+				elseif atom.type == MIDI.MidiEvent and atom[1] == MIDI.NoteOn then
+					count = count + 1
+				elseif atom.type == Atom.Object and atom.otype == Patch.Set
+					and atom[Patch.property].body == Param.sampleRate
+					and atom.id == Map['http://test.org#obj'] then
+					count = count + 1
+				end
+			end
+			assert(count == 3*n)
+		end
+
+		return producer, consumer
+	]]
+
+	local function bench(chunk, iters)
+		local producer, consumer = load(chunk)(32)
+		local t0 = nanos()
+		for i = 1, iters do
+			test(producer, consumer)
+		end
+		return (nanos() - t0) / iters
+	end
+
+	local folded, n = fold(code)
+	assert(n > 0)
+
+	bench(code, 100) -- warm up
+	local plain_ns = bench(code, 2000)
+	local folded_ns = bench(folded, 2000)
+
+	print(string.format('[bench] plain %.0f ns/iter, folded %.0f ns/iter (%d folds)',
+		plain_ns, folded_ns, n))
+end
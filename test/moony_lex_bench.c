@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include <nuklear/nuklear.h>
+#include <lex_incr.h>
+
+extern int luaopen_lpeg(lua_State *L);
+
+static const char *snippet =
+	"-- Scope\n"
+	"local urid = Map['http://open-music-kontrollers.ch/lv2/moony#scope']\n"
+	"local state = { gain = 0.5, phase = 0 }\n"
+	"\n"
+	"--[[ multi-line\n"
+	"     comment ]]\n"
+	"function run(n, control, notify, seq, forge)\n"
+	"\tfor frames, atom in seq:foreach() do\n"
+	"\t\tif atom.type == MIDI.MidiEvent and atom[1] & 0xf0 == MIDI.NoteOn then\n"
+	"\t\t\tstate.phase = (state.phase + 1.5e-3 * atom[2]) % 1.0\n"
+	"\t\t\tforge:time(frames):midi(atom[1], atom[2], 0x7f) -- velocity\n"
+	"\t\tend\n"
+	"\tend\n"
+	"\tlocal s = [[long\n"
+	"string]] .. 'single' .. \"double\"\n"
+	"end\n";
+
+// typing this at the middle of the script opens and closes long strings
+static const char *typed = "x = [[ y ]] --[[ z ]] 'a' .. \"b\" 0x1f\n";
+
+static uint64_t
+_nanos(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static lua_State *
+_lua_new(const char *path)
+{
+	lua_State *L = luaL_newstate();
+	if(!L)
+		return NULL;
+
+	luaL_requiref(L, "base", luaopen_base, 0);
+	luaL_requiref(L, "table", luaopen_table, 1);
+	luaL_requiref(L, "string", luaopen_string, 1);
+	luaL_requiref(L, "math", luaopen_math, 1);
+	luaL_requiref(L, "package", luaopen_package, 1);
+	luaL_requiref(L, "lpeg", luaopen_lpeg, 1);
+	lua_pop(L, 6);
+
+	lua_getglobal(L, "package");
+	lua_pushfstring(L, "%s?.lua", path);
+	lua_setfield(L, -2, "path");
+	lua_pop(L, 1); // package
+
+	lua_pushfstring(L, "%slexer.lua", path);
+	if(luaL_dofile(L, lua_tostring(L, -1)))
+	{
+		fprintf(stderr, "err: %s\n", lua_tostring(L, -1));
+		lua_close(L);
+		return NULL;
+	}
+	lua_setglobal(L, "lexer");
+	lua_pop(L, 1); // path
+
+	lua_getglobal(L, "lexer");
+	lua_getfield(L, -1, "load");
+	lua_pushstring(L, "moony");
+	if(lua_pcall(L, 1, 1, 0))
+	{
+		fprintf(stderr, "err: %s\n", lua_tostring(L, -1));
+		lua_close(L);
+		return NULL;
+	}
+	lua_setglobal(L, "moony");
+	lua_pop(L, 1); // lexer
+
+	return L;
+}
+
+static bool
+_tokens_equal(const lex_incr_t *a, const lex_incr_t *b)
+{
+	if(a->ntokens != b->ntokens)
+		return false;
+
+	for(int i = 0; i < a->ntokens; i++)
+	{
+		const struct nk_token *ta = &a->tokens[i];
+		const struct nk_token *tb = &b->tokens[i];
+
+		if(  (ta->offset != tb->offset)
+			|| (ta->color.r != tb->color.r)
+			|| (ta->color.g != tb->color.g)
+			|| (ta->color.b != tb->color.b) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// type first half of keystrokes, delete them again with second half
+static void
+_keystroke(char *code, int *code_sz, int *cursor, unsigned i, unsigned nkeys)
+{
+	if(i < nkeys / 2)
+	{
+		memmove(&code[*cursor + 1], &code[*cursor], *code_sz - *cursor);
+		code[(*cursor)++] = typed[i % strlen(typed)];
+		(*code_sz)++;
+	}
+	else if(*cursor > 0)
+	{
+		memmove(&code[*cursor - 1], &code[*cursor], *code_sz - *cursor);
+		(*cursor)--;
+		(*code_sz)--;
+	}
+}
+
+static void
+_usage(const char *cmd)
+{
+	fprintf(stderr,
+		"usage: %s [OPTIONS]\n"
+		"\n"
+		"  -p PATH        directory of lexer.lua and moony.lua (default: ./)\n"
+		"  -l LINES       number of script lines (default: 3000)\n"
+		"  -n KEYSTROKES  number of measured keystrokes (default: 200)\n"
+		"  -h             print this help\n", cmd);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *path = "./";
+	unsigned nlines = 3000;
+	unsigned nkeys = 200;
+
+	int c;
+	while( (c = getopt(argc, argv, "p:l:n:h")) != -1)
+	{
+		switch(c)
+		{
+			case 'p':
+				path = optarg;
+				break;
+			case 'l':
+				nlines = atoi(optarg);
+				break;
+			case 'n':
+				nkeys = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				_usage(argv[0]);
+				return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if(!nlines || !nkeys)
+	{
+		_usage(argv[0]);
+		return -1;
+	}
+
+	lua_State *L = _lua_new(path);
+	if(!L)
+	{
+		fprintf(stderr, "failed to load lexer\n");
+		return -1;
+	}
+
+	// script of given number of lines plus room for typed keystrokes
+	const size_t snippet_len = strlen(snippet);
+	const unsigned snippet_lines = 16;
+	const unsigned nsnippets = (nlines + snippet_lines - 1) / snippet_lines;
+	char *code = malloc(nsnippets*snippet_len + nkeys);
+	int code_sz = 0;
+
+	if(!code)
+	{
+		lua_close(L);
+		return -1;
+	}
+
+	for(unsigned i = 0; i < nsnippets; i++)
+	{
+		memcpy(&code[code_sz], snippet, snippet_len);
+		code_sz += snippet_len;
+	}
+
+	const int orig_sz = code_sz;
+	lex_incr_t incr;
+	lex_incr_t full;
+	uint64_t incr_sum = 0;
+	uint64_t full_sum = 0;
+	uint64_t relexed_sum = 0;
+	int cursor;
+	int ret = 0;
+
+	// incremental lexing of keystrokes
+	_lex_incr_init(&incr, L);
+	_lex_incr_update(&incr, code, code_sz);
+	lua_gc(L, LUA_GCCOLLECT);
+
+	cursor = code_sz / 2;
+	for(unsigned i = 0; i < nkeys; i++)
+	{
+		_keystroke(code, &code_sz, &cursor, i, nkeys);
+
+		const uint64_t t0 = _nanos();
+		_lex_incr_update(&incr, code, code_sz);
+		const uint64_t t1 = _nanos();
+
+		incr_sum += t1 - t0;
+		relexed_sum += incr.relexed;
+	}
+
+	// full lexing of same keystrokes, compared to incremental lexing
+	_lex_incr_deinit(&incr);
+	_lex_incr_init(&incr, L);
+	code_sz = orig_sz;
+	_lex_incr_update(&incr, code, code_sz);
+	lua_gc(L, LUA_GCCOLLECT);
+
+	cursor = code_sz / 2;
+	for(unsigned i = 0; i < nkeys; i++)
+	{
+		_keystroke(code, &code_sz, &cursor, i, nkeys);
+
+		_lex_incr_init(&full, L);
+		const uint64_t t0 = _nanos();
+		_lex_incr_update(&full, code, code_sz);
+		const uint64_t t1 = _nanos();
+
+		full_sum += t1 - t0;
+
+		_lex_incr_update(&incr, code, code_sz);
+		const bool equal = _tokens_equal(&incr, &full);
+		_lex_incr_deinit(&full);
+
+		if(!equal)
+		{
+			fprintf(stderr, "token mismatch after keystroke %u\n", i);
+			ret = -1;
+			break;
+		}
+	}
+
+	printf("moony_lex_bench: %u lines, %i bytes, %i tokens, %u keystrokes\n",
+		nlines, code_sz, incr.ntokens, nkeys);
+	printf("  full        : %10.0f ns/keystroke\n", (double)full_sum / nkeys);
+	printf("  incremental : %10.0f ns/keystroke (%.0f bytes relexed)\n",
+		(double)incr_sum / nkeys, (double)relexed_sum / nkeys);
+
+	_lex_incr_deinit(&incr);
+	free(code);
+	lua_close(L);
+
+	return ret;
+}
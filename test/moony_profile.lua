@@ -0,0 +1,53 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+-- profile a busy script for a number of periods, e.g. via moony_run
+local periods = 0
+
+assert(not pcall(Moony.profile, 'moony_profile.folded'))
+
+local function fib(n)
+	if n < 2 then
+		return n
+	end
+
+	return fib(n - 1) + fib(n - 2)
+end
+
+local function busy(n)
+	local sum = 0
+
+	for i = 1, n do
+		sum = sum + math.sin(i)
+	end
+
+	return sum
+end
+
+function once(n, control, notify, seq, forge)
+	Moony.profile('moony_profile.folded', 1000)
+end
+
+function run(n, control, notify, seq, forge)
+	fib(16)
+	busy(2000)
+
+	periods = periods + 1
+	if periods == 32 then
+		Moony.profile()
+	end
+end
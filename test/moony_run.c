@@ -0,0 +1,1138 @@
+/*
+ * Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+ *
+ * This is free software: you can redistribute it and/or modify
+ * it under the terms of the Artistic License 2.0 as published by
+ * The Perl Foundation.
+ *
+ * This source is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * Artistic License 2.0 for more details.
+ *
+ * You should have received a copy of the Artistic License 2.0
+ * along the source as a COPYING file. If not, obtain it from
+ * http://www.perlfoundation.org/artistic_license_2_0.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <strings.h>
+
+#include <moony.h>
+#include <api_capture.h>
+
+#include <lauxlib.h>
+
+#define BUF_SIZE 0x100000 // 1M
+#define MAX_URIDS 2048
+#define MAX_JOBS 64
+#define MAX_PORTS 4
+
+#define SMF_DIVISION 960
+#define SMF_TEMPO 500000 // us per quarter note
+
+typedef struct _urid_t urid_t;
+typedef struct _job_t job_t;
+typedef struct _event_t event_t;
+typedef struct _tempo_t tempo_t;
+typedef struct _runner_t runner_t;
+
+struct _urid_t {
+	LV2_URID urid;
+	char *uri;
+};
+
+struct _job_t {
+	uint32_t size;
+	void *body;
+};
+
+struct _event_t {
+	int64_t frames; // ticks while parsing SMF
+	uint32_t port;
+	uint32_t order; // keeps sort stable
+	LV2_Atom *atom;
+};
+
+struct _tempo_t {
+	int64_t ticks;
+	uint32_t order;
+	uint32_t tempo;
+};
+
+struct _runner_t {
+	urid_t urids [MAX_URIDS];
+	LV2_URID urid;
+
+	const LV2_Descriptor *desc;
+	LV2_Handle instance;
+	const LV2_Worker_Interface *iface;
+
+	unsigned nvals;
+	unsigned nseqs;
+
+	float val_in [MAX_PORTS];
+	float val_out [MAX_PORTS];
+
+	uint8_t seq_in [MAX_PORTS][BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t seq_out [MAX_PORTS][BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t control [BUF_SIZE] __attribute__((aligned(8)));
+	uint8_t notify [BUF_SIZE] __attribute__((aligned(8)));
+
+	job_t jobs [MAX_JOBS];
+	unsigned njobs;
+
+	LV2_Atom_Forge forge;
+
+	struct {
+		LV2_URID midi_event;
+		LV2_URID patch_set;
+		LV2_URID patch_property;
+		LV2_URID patch_value;
+		LV2_URID moony_code;
+	} uris;
+
+	event_t *events;
+	size_t nevents;
+	size_t mevents;
+
+	LV2_URID *remap; // file URID -> mapped URID
+	size_t nremap;
+
+	FILE *file;
+	bool smf;
+	uint8_t written [MAX_URIDS]; // URIDs already written to event file
+	int64_t ticks; // of last event written to SMF
+};
+
+__non_realtime static LV2_URID
+_map(LV2_URID_Map_Handle instance, const char *uri)
+{
+	runner_t *runner = instance;
+
+	urid_t *itm;
+	for(itm=runner->urids; itm->urid; itm++)
+	{
+		if(!strcmp(itm->uri, uri))
+			return itm->urid;
+	}
+
+	if(runner->urid + 1 >= MAX_URIDS)
+		return 0;
+
+	// create new
+	itm->urid = ++runner->urid;
+	itm->uri = strdup(uri);
+
+	return itm->urid;
+}
+
+__non_realtime static const char *
+_unmap(LV2_URID_Unmap_Handle instance, LV2_URID urid)
+{
+	runner_t *runner = instance;
+
+	for(urid_t *itm=runner->urids; itm->urid; itm++)
+	{
+		if(itm->urid == urid)
+			return itm->uri;
+	}
+
+	// not found
+	return NULL;
+}
+
+__non_realtime static LV2_Worker_Status
+_respond(LV2_Worker_Respond_Handle instance, uint32_t size, const void *data)
+{
+	runner_t *runner = instance;
+
+	return runner->iface->work_response(runner->instance, size, data);
+}
+
+// queue jobs and run them in between blocks, which keeps runs deterministic
+__non_realtime static LV2_Worker_Status
+_sched(LV2_Worker_Schedule_Handle instance, uint32_t size, const void *data)
+{
+	runner_t *runner = instance;
+
+	if(runner->njobs >= MAX_JOBS)
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	job_t *job = &runner->jobs[runner->njobs];
+	job->body = malloc(size);
+	if(!job->body)
+		return LV2_WORKER_ERR_NO_SPACE;
+
+	memcpy(job->body, data, size);
+	job->size = size;
+	runner->njobs++;
+
+	return LV2_WORKER_SUCCESS;
+}
+
+__non_realtime static void
+_work(runner_t *runner)
+{
+	for(unsigned i = 0; i < runner->njobs; i++)
+	{
+		job_t *job = &runner->jobs[i];
+
+		runner->iface->work(runner->instance, _respond, runner, job->size, job->body);
+		free(job->body);
+	}
+	runner->njobs = 0;
+
+	if(runner->iface->end_run)
+		runner->iface->end_run(runner->instance);
+}
+
+__non_realtime static int
+_vprintf(void *data, LV2_URID type, const char *fmt, va_list args)
+{
+	vfprintf(stderr, fmt, args);
+
+	return 0;
+}
+
+__non_realtime static int
+_printf(void *data, LV2_URID type, const char *fmt, ...)
+{
+  va_list args;
+	int ret;
+
+  va_start (args, fmt);
+	ret = _vprintf(data, type, fmt, args);
+  va_end(args);
+
+	return ret;
+}
+
+__non_realtime static const LV2_Descriptor *
+_descriptor(const char *name)
+{
+	char *end;
+	const unsigned long idx = strtoul(name, &end, 10);
+
+	if(*end == '\0')
+		return lv2_descriptor(idx);
+
+	const LV2_Descriptor *desc;
+	for(uint32_t i = 0; (desc = lv2_descriptor(i)); i++)
+	{
+		const char *frag = strchr(desc->URI, '#');
+
+		if(!strcmp(desc->URI, name) || (frag && !strcmp(frag + 1, name)) )
+			return desc;
+	}
+
+	return NULL;
+}
+
+// derive port layout from descriptor URI, e.g. a1xa1, c4a1xc4a1
+__non_realtime static int
+_layout(runner_t *runner)
+{
+	const char *frag = strchr(runner->desc->URI, '#');
+	unsigned n;
+	unsigned m;
+	int len = 0;
+
+	if(!frag)
+		return -1;
+	frag++;
+
+	if( (sscanf(frag, "c%ua1xc%ua1%n", &n, &m, &len) == 2) && !frag[len] )
+	{
+		runner->nvals = n;
+		runner->nseqs = 1;
+	}
+	else if( (sscanf(frag, "a%uxa%u%n", &n, &m, &len) == 2) && !frag[len] )
+	{
+		runner->nvals = 0;
+		runner->nseqs = n;
+	}
+	else
+	{
+		return -1; // no event ports to stream through
+	}
+
+	return ( (n == m) && (n <= MAX_PORTS) ) ? 0 : -1;
+}
+
+__non_realtime static void
+_connect(runner_t *runner)
+{
+	uint32_t port = 0;
+
+	for(unsigned i = 0; i < runner->nseqs; i++)
+		runner->desc->connect_port(runner->instance, port++, runner->seq_in[i]);
+	for(unsigned i = 0; i < runner->nseqs; i++)
+		runner->desc->connect_port(runner->instance, port++, runner->seq_out[i]);
+	for(unsigned i = 0; i < runner->nvals; i++)
+		runner->desc->connect_port(runner->instance, port++, &runner->val_in[i]);
+	for(unsigned i = 0; i < runner->nvals; i++)
+		runner->desc->connect_port(runner->instance, port++, &runner->val_out[i]);
+	runner->desc->connect_port(runner->instance, port++, runner->control);
+	runner->desc->connect_port(runner->instance, port++, runner->notify);
+}
+
+__non_realtime static void *
+_load(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if(!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	char *buf = len >= 0 ? malloc(len + 1) : NULL;
+	if(buf)
+	{
+		if(fread(buf, 1, len, f) != (size_t)len)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		else
+		{
+			buf[len] = '\0';
+			*size = len;
+		}
+	}
+
+	fclose(f);
+
+	return buf;
+}
+
+__non_realtime static event_t *
+_event_add(runner_t *runner, int64_t frames, uint32_t port, LV2_URID type,
+	const void *a, uint32_t asz, const void *b, uint32_t bsz)
+{
+	if(runner->nevents >= runner->mevents)
+	{
+		const size_t mevents = runner->mevents ? runner->mevents << 1 : 0x400;
+		event_t *events = realloc(runner->events, mevents * sizeof(event_t));
+		if(!events)
+			return NULL;
+
+		runner->events = events;
+		runner->mevents = mevents;
+	}
+
+	LV2_Atom *atom = malloc(sizeof(LV2_Atom) + asz + bsz);
+	if(!atom)
+		return NULL;
+
+	atom->size = asz + bsz;
+	atom->type = type;
+	if(asz)
+		memcpy(LV2_ATOM_BODY(atom), a, asz);
+	if(bsz)
+		memcpy((uint8_t *)LV2_ATOM_BODY(atom) + asz, b, bsz);
+
+	event_t *ev = &runner->events[runner->nevents];
+	ev->frames = frames;
+	ev->port = port;
+	ev->order = runner->nevents++;
+	ev->atom = atom;
+
+	return ev;
+}
+
+__non_realtime static int
+_event_cmp(const void *a, const void *b)
+{
+	const event_t *ev_a = a;
+	const event_t *ev_b = b;
+
+	if(ev_a->frames != ev_b->frames)
+		return ev_a->frames < ev_b->frames ? -1 : 1;
+
+	return ev_a->order < ev_b->order ? -1 : 1;
+}
+
+__non_realtime static int
+_tempo_cmp(const void *a, const void *b)
+{
+	const tempo_t *tempo_a = a;
+	const tempo_t *tempo_b = b;
+
+	if(tempo_a->ticks != tempo_b->ticks)
+		return tempo_a->ticks < tempo_b->ticks ? -1 : 1;
+
+	return tempo_a->order < tempo_b->order ? -1 : 1;
+}
+
+__non_realtime static uint32_t
+_smf_uint(const uint8_t *ptr, unsigned n)
+{
+	uint32_t val = 0;
+
+	for(unsigned i = 0; i < n; i++)
+		val = (val << 8) | ptr[i];
+
+	return val;
+}
+
+__non_realtime static int
+_smf_varlen(const uint8_t **ptr, const uint8_t *end, uint32_t *val)
+{
+	*val = 0;
+
+	for(unsigned i = 0; i < 4; i++)
+	{
+		if(*ptr >= end)
+			return -1;
+
+		const uint8_t byte = *(*ptr)++;
+
+		*val = (*val << 7) | (byte & 0x7f);
+		if( !(byte & 0x80) )
+			return 0;
+	}
+
+	return -1;
+}
+
+// parse all tracks of a standard MIDI file and convert ticks to frames
+__non_realtime static int
+_smf_load(runner_t *runner, const uint8_t *buf, size_t size, double srate)
+{
+	const uint8_t *end = buf + size;
+	tempo_t *tempos = NULL;
+	size_t ntempos = 0;
+	int ret = -1;
+
+	if( (size < 14) || memcmp(buf, "MThd", 4) || (_smf_uint(buf + 4, 4) < 6) )
+		return -1;
+
+	const uint32_t ntracks = _smf_uint(buf + 10, 2);
+	const uint32_t division = _smf_uint(buf + 12, 2);
+	const uint8_t *ptr = buf + 8 + _smf_uint(buf + 4, 4);
+
+	for(uint32_t track = 0; track < ntracks; track++)
+	{
+		if( (ptr + 8 > end) || memcmp(ptr, "MTrk", 4) )
+			goto fail;
+
+		const uint8_t *trk_end = ptr + 8 + _smf_uint(ptr + 4, 4);
+		int64_t ticks = 0;
+		uint8_t status = 0;
+
+		if(trk_end > end)
+			goto fail;
+
+		for(ptr += 8; ptr < trk_end; )
+		{
+			uint32_t delta;
+			uint32_t len;
+
+			if(_smf_varlen(&ptr, trk_end, &delta) || (ptr >= trk_end) )
+				goto fail;
+			ticks += delta;
+
+			if(*ptr == 0xff) // meta event
+			{
+				if(ptr + 2 > trk_end)
+					goto fail;
+
+				const uint8_t type = ptr[1];
+				ptr += 2;
+				if(_smf_varlen(&ptr, trk_end, &len) || (ptr + len > trk_end) )
+					goto fail;
+
+				if( (type == 0x51) && (len == 3) ) // set tempo
+				{
+					tempo_t *tmp = realloc(tempos, (ntempos + 1) * sizeof(tempo_t));
+					if(!tmp)
+						goto fail;
+
+					tempos = tmp;
+					tempos[ntempos].ticks = ticks;
+					tempos[ntempos].order = ntempos;
+					tempos[ntempos].tempo = _smf_uint(ptr, 3);
+					ntempos++;
+				}
+
+				ptr += len;
+				status = 0;
+			}
+			else if( (*ptr == 0xf0) || (*ptr == 0xf7) ) // system exclusive, escape
+			{
+				const uint8_t type = *ptr++;
+				if(_smf_varlen(&ptr, trk_end, &len) || (ptr + len > trk_end) )
+					goto fail;
+
+				if( (type == 0xf7) && !len )
+					continue;
+
+				if(!_event_add(runner, ticks, 1, runner->uris.midi_event,
+						&type, type == 0xf0 ? 1 : 0, ptr, len))
+					goto fail;
+
+				ptr += len;
+				status = 0;
+			}
+			else // channel message
+			{
+				if(*ptr & 0x80)
+					status = *ptr++;
+				else if(!status)
+					goto fail; // running status without status
+
+				len = ( (status & 0xe0) == 0xc0 ) ? 1 : 2;
+				if(ptr + len > trk_end)
+					goto fail;
+
+				if(!_event_add(runner, ticks, 1, runner->uris.midi_event,
+						&status, 1, ptr, len))
+					goto fail;
+
+				ptr += len;
+			}
+		}
+	}
+
+	qsort(runner->events, runner->nevents, sizeof(event_t), _event_cmp);
+	qsort(tempos, ntempos, sizeof(tempo_t), _tempo_cmp);
+
+	// walk tempo map
+	if(division & 0x8000) // SMPTE
+	{
+		const int fps = -(int8_t)(division >> 8);
+		const double spt = 1.0 / ( (fps == 29 ? 29.97 : fps) * (division & 0xff) );
+
+		for(size_t i = 0; i < runner->nevents; i++)
+			runner->events[i].frames = llround(runner->events[i].frames * spt * srate);
+	}
+	else if(division)
+	{
+		int64_t pos_ticks = 0;
+		double pos_secs = 0.0;
+		double spt = SMF_TEMPO * 1e-6 / division;
+		size_t j = 0;
+
+		for(size_t i = 0; i < runner->nevents; i++)
+		{
+			event_t *ev = &runner->events[i];
+
+			for( ; (j < ntempos) && (tempos[j].ticks <= ev->frames); j++)
+			{
+				pos_secs += (tempos[j].ticks - pos_ticks) * spt;
+				pos_ticks = tempos[j].ticks;
+				spt = tempos[j].tempo * 1e-6 / division;
+			}
+
+			ev->frames = llround( (pos_secs + (ev->frames - pos_ticks) * spt) * srate);
+		}
+	}
+	else
+	{
+		goto fail;
+	}
+
+	ret = 0;
+
+fail:
+	free(tempos);
+
+	return ret;
+}
+
+__non_realtime static void
+_seq_remap(void *data, LV2_URID *urid)
+{
+	runner_t *runner = data;
+
+	*urid = (*urid < runner->nremap)
+		? runner->remap[*urid]
+		: 0;
+}
+
+// parse event file and remap its URIDs
+__non_realtime static int
+_seq_load(runner_t *runner, uint8_t *buf, size_t size)
+{
+	const size_t magic_len = strlen(MOONY_SEQUENCE_MAGIC);
+
+	if( (size < magic_len) || memcmp(buf, MOONY_SEQUENCE_MAGIC, magic_len) )
+		return -1;
+
+	for(size_t offset = magic_len; offset + sizeof(moony_capture_rec_t) <= size; )
+	{
+		const moony_capture_rec_t *rec = (const moony_capture_rec_t *)&buf[offset];
+		uint8_t *body = (uint8_t *)&rec[1];
+
+		offset += sizeof(moony_capture_rec_t) + lv2_atom_pad_size(rec->size);
+		if(offset > size)
+			return -1; // truncated
+
+		if(rec->type == MOONY_CAPTURE_URID)
+		{
+			const LV2_URID urid = *(const LV2_URID *)body;
+			const char *uri = (const char *)(body + sizeof(LV2_URID));
+
+			if(urid >= runner->nremap)
+			{
+				const size_t nremap = urid + 0x100;
+				LV2_URID *remap = realloc(runner->remap, nremap * sizeof(LV2_URID));
+				if(!remap)
+					return -1;
+
+				memset(&remap[runner->nremap], 0x0,
+					(nremap - runner->nremap) * sizeof(LV2_URID));
+				runner->remap = remap;
+				runner->nremap = nremap;
+			}
+
+			runner->remap[urid] = _map(runner, uri);
+		}
+		else if(rec->type == MOONY_CAPTURE_EVENT)
+		{
+			const moony_capture_event_t *cev = (const moony_capture_event_t *)body;
+			LV2_Atom *atom = (LV2_Atom *)&cev[1];
+
+			if( (cev->frames < 0) || (cev->port > runner->nseqs) )
+				continue; // not routable
+
+			moony_capture_walk(atom, &runner->forge, _seq_remap, runner);
+
+			if(!_event_add(runner, cev->frames, cev->port, atom->type,
+					LV2_ATOM_BODY(atom), atom->size, NULL, 0))
+				return -1;
+		}
+	}
+
+	qsort(runner->events, runner->nevents, sizeof(event_t), _event_cmp);
+
+	return 0;
+}
+
+__non_realtime static void
+_rec_write(FILE *file, moony_capture_type_t type,
+	const void *a, size_t asz, const void *b, size_t bsz)
+{
+	static const uint8_t pad [8] = { 0 };
+	const moony_capture_rec_t rec = {
+		.type = type,
+		.size = asz + bsz
+	};
+
+	fwrite(&rec, sizeof(rec), 1, file);
+	if(asz)
+		fwrite(a, asz, 1, file);
+	if(bsz)
+		fwrite(b, bsz, 1, file);
+	fwrite(pad, lv2_atom_pad_size(rec.size) - rec.size, 1, file);
+}
+
+// write URI of each URID once, ahead of the first event referencing it
+__non_realtime static void
+_seq_urid(void *data, LV2_URID *urid)
+{
+	runner_t *runner = data;
+
+	if( (*urid == 0) || (*urid >= MAX_URIDS) || runner->written[*urid])
+		return;
+
+	const char *uri = _unmap(runner, *urid);
+	if(!uri)
+		return;
+
+	_rec_write(runner->file, MOONY_CAPTURE_URID, urid, sizeof(LV2_URID),
+		uri, strlen(uri) + 1);
+	runner->written[*urid] = 1;
+}
+
+__non_realtime static void
+_smf_write_varlen(FILE *file, uint32_t val)
+{
+	uint8_t buf [5];
+	unsigned n = 0;
+
+	buf[sizeof(buf) - ++n] = val & 0x7f;
+	while(val >>= 7)
+		buf[sizeof(buf) - ++n] = (val & 0x7f) | 0x80;
+
+	fwrite(&buf[sizeof(buf) - n], n, 1, file);
+}
+
+__non_realtime static void
+_smf_write_event(runner_t *runner, int64_t ticks, const uint8_t *msg, uint32_t len)
+{
+	FILE *file = runner->file;
+
+	_smf_write_varlen(file, ticks - runner->ticks);
+	runner->ticks = ticks;
+
+	if(msg[0] == 0xf0)
+	{
+		fputc(0xf0, file);
+		_smf_write_varlen(file, len - 1);
+		fwrite(&msg[1], len - 1, 1, file);
+	}
+	else if(msg[0] >= 0xf0) // wrap system messages in escape sequence
+	{
+		fputc(0xf7, file);
+		_smf_write_varlen(file, len);
+		fwrite(msg, len, 1, file);
+	}
+	else
+	{
+		fwrite(msg, len, 1, file);
+	}
+}
+
+__non_realtime static int
+_output_open(runner_t *runner, const char *path)
+{
+	const char *ext = strrchr(path, '.');
+
+	runner->smf = ext && (!strcasecmp(ext, ".mid") || !strcasecmp(ext, ".smf"));
+	runner->file = fopen(path, "wb");
+	if(!runner->file)
+		return -1;
+
+	if(runner->smf)
+	{
+		static const uint8_t header [] = {
+			'M', 'T', 'h', 'd', 0x00, 0x00, 0x00, 0x06,
+			0x00, 0x00, // format 0
+			0x00, 0x01, // one track
+			SMF_DIVISION >> 8, SMF_DIVISION & 0xff,
+			'M', 'T', 'r', 'k', 0x00, 0x00, 0x00, 0x00, // length patched on close
+			0x00, 0xff, 0x51, 0x03, // set tempo
+			(SMF_TEMPO >> 16) & 0xff, (SMF_TEMPO >> 8) & 0xff, SMF_TEMPO & 0xff
+		};
+
+		fwrite(header, sizeof(header), 1, runner->file);
+	}
+	else
+	{
+		fwrite(MOONY_SEQUENCE_MAGIC, strlen(MOONY_SEQUENCE_MAGIC), 1, runner->file);
+	}
+
+	return 0;
+}
+
+__non_realtime static void
+_output_close(runner_t *runner)
+{
+	if(runner->smf)
+	{
+		static const uint8_t eot [] = {
+			0x00, 0xff, 0x2f, 0x00 // end of track
+		};
+
+		fwrite(eot, sizeof(eot), 1, runner->file);
+
+		const long len = ftell(runner->file) - 22;
+		const uint8_t trk_len [4] = {
+			len >> 24, len >> 16, len >> 8, len
+		};
+
+		fseek(runner->file, 18, SEEK_SET);
+		fwrite(trk_len, sizeof(trk_len), 1, runner->file);
+	}
+
+	fclose(runner->file);
+}
+
+// write output events of block, returns number of events
+__non_realtime static uint64_t
+_output(runner_t *runner, int64_t offset, double srate)
+{
+	uint64_t nevents = 0;
+
+	for(unsigned i = 0; i <= runner->nseqs; i++)
+	{
+		LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)(i == 0
+			? runner->notify
+			: runner->seq_out[i - 1]);
+
+		LV2_ATOM_SEQUENCE_FOREACH(seq, ev)
+		{
+			const int64_t frames = offset + ev->time.frames;
+
+			nevents++;
+
+			if(!runner->file)
+				continue;
+
+			if(runner->smf)
+			{
+				if( (i == 0) || (ev->body.type != runner->uris.midi_event) || !ev->body.size)
+					continue; // only MIDI is representable
+
+				const int64_t ticks = llround(frames * SMF_DIVISION * 1e6 / (SMF_TEMPO * srate));
+				_smf_write_event(runner, ticks > runner->ticks ? ticks : runner->ticks,
+					LV2_ATOM_BODY_CONST(&ev->body), ev->body.size);
+			}
+			else
+			{
+				const moony_capture_event_t cev = {
+					.frames = frames,
+					.port = i
+				};
+
+				moony_capture_walk(&ev->body, &runner->forge, _seq_urid, runner);
+				_rec_write(runner->file, MOONY_CAPTURE_EVENT, &cev, sizeof(cev),
+					&ev->body, lv2_atom_total_size(&ev->body));
+			}
+		}
+	}
+
+	return nevents;
+}
+
+__non_realtime static void
+_prepare_outputs(runner_t *runner)
+{
+	for(unsigned i = 0; i < runner->nseqs; i++)
+	{
+		LV2_Atom *atom = (LV2_Atom *)runner->seq_out[i];
+
+		atom->size = BUF_SIZE - sizeof(LV2_Atom);
+		atom->type = 0;
+	}
+	{
+		LV2_Atom *atom = (LV2_Atom *)runner->notify;
+
+		atom->size = BUF_SIZE - sizeof(LV2_Atom);
+		atom->type = 0;
+	}
+}
+
+// feed events of block [offset, offset + nsamples), returns next event index
+__non_realtime static ssize_t
+_prepare(runner_t *runner, size_t idx, int64_t offset, uint32_t nsamples,
+	const char *code)
+{
+	LV2_Atom_Forge *forge = &runner->forge;
+
+	for(unsigned i = 0; i <= runner->nseqs; i++)
+	{
+		LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)(i == 0
+			? runner->control
+			: runner->seq_in[i - 1]);
+
+		seq->atom.size = sizeof(LV2_Atom_Sequence_Body);
+		seq->atom.type = forge->Sequence;
+		seq->body.unit = 0;
+		seq->body.pad = 0;
+	}
+
+	// code update
+	if(code)
+	{
+		LV2_Atom_Forge_Frame frame;
+		LV2_Atom_Forge_Frame obj_frame;
+
+		lv2_atom_forge_set_buffer(forge, runner->control, BUF_SIZE);
+		lv2_atom_forge_sequence_head(forge, &frame, 0);
+		lv2_atom_forge_frame_time(forge, 0);
+		lv2_atom_forge_object(forge, &obj_frame, 0, runner->uris.patch_set);
+		lv2_atom_forge_key(forge, runner->uris.patch_property);
+		lv2_atom_forge_urid(forge, runner->uris.moony_code);
+		lv2_atom_forge_key(forge, runner->uris.patch_value);
+		lv2_atom_forge_string(forge, code, strlen(code));
+		lv2_atom_forge_pop(forge, &obj_frame);
+		lv2_atom_forge_pop(forge, &frame);
+	}
+
+	// append events to their port's sequence in place
+	for( ; idx < runner->nevents; idx++)
+	{
+		const event_t *ev = &runner->events[idx];
+
+		if(ev->frames >= offset + nsamples)
+			break;
+
+		LV2_Atom_Sequence *seq = (LV2_Atom_Sequence *)(ev->port == 0
+			? runner->control
+			: runner->seq_in[ev->port - 1]);
+		const uint32_t sz = lv2_atom_total_size(ev->atom);
+		const uint32_t seq_sz = lv2_atom_total_size(&seq->atom);
+		const uint32_t ev_sz = sizeof(int64_t) + lv2_atom_pad_size(sz); // time stamp + atom
+
+		if(seq_sz + ev_sz > BUF_SIZE)
+			return -1; // overflow
+
+		LV2_Atom_Event *dst = (LV2_Atom_Event *)((uint8_t *)seq + seq_sz);
+		dst->time.frames = ev->frames - offset;
+		memcpy(&dst->body, ev->atom, sz);
+		seq->atom.size += ev_sz;
+	}
+
+	// control values at rest
+	for(unsigned i = 0; i < runner->nvals; i++)
+		runner->val_in[i] = 0.f;
+
+	_prepare_outputs(runner);
+
+	return idx;
+}
+
+__non_realtime static void
+_usage(const char *cmd)
+{
+	fprintf(stderr,
+		"usage: %s [OPTIONS] SCRIPT\n"
+		"\n"
+		"  -d DESCRIPTOR  plugin index, URI or URI fragment with event ports (default: a1xa1)\n"
+		"  -b FRAMES      block size (default: 8192)\n"
+		"  -r RATE        sample rate (default: 48000)\n"
+		"  -i INPUT       input events, standard MIDI file or moony event file\n"
+		"  -o OUTPUT      output events, standard MIDI file if ending in .mid or .smf,\n"
+		"                 moony event file otherwise\n"
+		"  -t FRAMES      run for additional frames after last input event (default: 0)\n"
+		"  -h             print this help\n", cmd);
+}
+
+__non_realtime int
+main(int argc, char **argv)
+{
+	static runner_t runner;
+
+	const char *name = "a1xa1";
+	const char *input = NULL;
+	const char *output = NULL;
+	uint32_t nsamples = 8192;
+	double srate = 48000.0;
+	uint64_t tail = 0;
+
+	int c;
+	while( (c = getopt(argc, argv, "d:b:r:i:o:t:h")) != -1)
+	{
+		switch(c)
+		{
+			case 'd':
+				name = optarg;
+				break;
+			case 'b':
+				nsamples = strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				srate = strtod(optarg, NULL);
+				break;
+			case 'i':
+				input = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 't':
+				tail = strtoull(optarg, NULL, 10);
+				break;
+			case 'h':
+			default:
+				_usage(argv[0]);
+				return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if( (optind != argc - 1) || !nsamples || (srate <= 0.0) )
+	{
+		_usage(argv[0]);
+		return -1;
+	}
+
+	LV2_URID_Map map = {
+		.handle = &runner,
+		.map = _map
+	};
+	LV2_URID_Unmap unmap = {
+		.handle = &runner,
+		.unmap = _unmap
+	};
+	LV2_Worker_Schedule sched = {
+		.handle = &runner,
+		.schedule_work = _sched
+	};
+	LV2_Log_Log log = {
+		.handle = &runner,
+		.printf = _printf,
+		.vprintf = _vprintf
+	};
+	LV2_Options_Option opts [] = {
+		{
+			.key = 0,
+			.value =NULL
+		}
+	};
+
+	const LV2_Feature feat_map = {
+		.URI = LV2_URID__map,
+		.data = &map
+	};
+	const LV2_Feature feat_unmap = {
+		.URI = LV2_URID__unmap,
+		.data = &unmap
+	};
+	const LV2_Feature feat_sched = {
+		.URI = LV2_WORKER__schedule,
+		.data = &sched
+	};
+	const LV2_Feature feat_log = {
+		.URI = LV2_LOG__log,
+		.data = &log
+	};
+	const LV2_Feature feat_opts = {
+		.URI = LV2_OPTIONS__options,
+		.data = opts
+	};
+
+	const LV2_Feature *const features [] = {
+		&feat_map,
+		&feat_unmap,
+		&feat_sched,
+		&feat_log,
+		&feat_opts,
+		NULL
+	};
+
+	runner.uris.midi_event = _map(&runner, LV2_MIDI__MidiEvent);
+	runner.uris.patch_set = _map(&runner, LV2_PATCH__Set);
+	runner.uris.patch_property = _map(&runner, LV2_PATCH__property);
+	runner.uris.patch_value = _map(&runner, LV2_PATCH__value);
+	runner.uris.moony_code = _map(&runner, MOONY_CODE_URI);
+	lv2_atom_forge_init(&runner.forge, &map);
+
+	int ret = -1;
+	uint8_t *buf = NULL;
+	size_t size;
+
+	char *code = _load(argv[optind], &size);
+	if(!code)
+	{
+		fprintf(stderr, "err: cannot load '%s'\n", argv[optind]);
+		goto fail;
+	}
+
+	runner.desc = _descriptor(name);
+	if(!runner.desc || _layout(&runner))
+	{
+		fprintf(stderr, "err: invalid descriptor '%s'\n", name);
+		goto fail;
+	}
+
+	if(input)
+	{
+		buf = _load(input, &size);
+		if(!buf || ( (size >= 4) && !memcmp(buf, "MThd", 4)
+				? _smf_load(&runner, buf, size, srate)
+				: _seq_load(&runner, buf, size) ) )
+		{
+			fprintf(stderr, "err: invalid input '%s'\n", input);
+			goto fail;
+		}
+	}
+
+	if(output && _output_open(&runner, output))
+	{
+		fprintf(stderr, "err: cannot open '%s'\n", output);
+		goto fail;
+	}
+
+	runner.instance = runner.desc->instantiate(runner.desc, srate, NULL, features);
+	if(!runner.instance)
+	{
+		fprintf(stderr, "err: instantiation failed\n");
+		goto fail;
+	}
+
+	// every plugin handle starts with its moony_t
+	moony_t *moony = runner.instance;
+
+	runner.iface = runner.desc->extension_data(LV2_WORKER__interface);
+	_connect(&runner);
+
+	if(runner.desc->activate)
+		runner.desc->activate(runner.instance);
+
+	// upload script in a block of its own, ahead of the input timeline
+	_prepare(&runner, runner.nevents, 0, nsamples, code);
+	runner.desc->run(runner.instance, nsamples);
+	_work(&runner);
+
+	if(moony_bypass(moony))
+	{
+		fprintf(stderr, "err: script failed to load or run\n");
+	}
+	else
+	{
+		const int64_t length = (runner.nevents ? runner.events[runner.nevents - 1].frames + 1 : 0)
+			+ tail;
+		uint64_t nblocks = 0;
+		uint64_t nout = 0;
+		size_t idx = 0;
+		bool failed = false;
+
+		const uint64_t t0 = moony_nanos();
+		for(int64_t offset = 0; offset < length; offset += nsamples, nblocks++)
+		{
+			const ssize_t next = _prepare(&runner, idx, offset, nsamples, NULL);
+			if(next < 0)
+			{
+				fprintf(stderr, "err: input overflow at frame %"PRIi64", reduce block size\n",
+					offset);
+				failed = true;
+				break;
+			}
+			idx = next;
+
+			runner.desc->run(runner.instance, nsamples);
+			_work(&runner);
+
+			if(moony_bypass(moony))
+			{
+				fprintf(stderr, "err: script failed at frame %"PRIi64"\n", offset);
+				failed = true;
+				break;
+			}
+
+			nout += _output(&runner, offset, srate);
+		}
+		const uint64_t t1 = moony_nanos();
+
+		if(!failed)
+			ret = 0;
+
+		const double secs = (t1 - t0) * 1e-9;
+		const double audio = nblocks * nsamples / srate;
+
+		printf("moony_run: %s, %.0f Hz, %"PRIu32" frames/block, %"PRIu64" blocks\n",
+			runner.desc->URI, srate, nsamples, nblocks);
+		printf("  events: %zu in, %"PRIu64" out\n", runner.nevents, nout);
+		printf("  time  : %.3f s for %.3f s, %.1fx realtime, %.0f events/s\n",
+			secs, audio, secs > 0.0 ? audio / secs : 0.0,
+			secs > 0.0 ? (runner.nevents + nout) / secs : 0.0);
+	}
+
+	if(runner.desc->deactivate)
+		runner.desc->deactivate(runner.instance);
+	runner.desc->cleanup(runner.instance);
+
+	for(unsigned i = 0; i < runner.njobs; i++)
+		free(runner.jobs[i].body);
+
+fail:
+	if(runner.file)
+		_output_close(&runner);
+	for(size_t i = 0; i < runner.nevents; i++)
+		free(runner.events[i].atom);
+	free(runner.events);
+	free(runner.remap);
+	for(urid_t *itm=runner.urids; itm->urid; itm++)
+		free(itm->uri);
+	free(buf);
+	free(code);
+
+	return ret;
+}
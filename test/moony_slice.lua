@@ -0,0 +1,64 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+-- forward events slice by slice with 256 frames/block, e.g. via moony_run
+local nsamples = 256
+local last = nsamples
+local slices = 0
+local events = 0
+local ahead = 0
+
+function run()
+	error('run must not be called in presence of runSlice')
+end
+
+function runSlice(from, to, control, notify, seq, forge, a)
+	-- slices cover whole period without gaps
+	if from == 0 then
+		assert(last == nsamples)
+	else
+		assert(from == last)
+	end
+	assert(to > from and to <= nsamples)
+	last = to
+	slices = slices + 1
+
+	-- slices start at event time stamps
+	for frames, atom in seq:foreach() do
+		assert(frames == from)
+		forge:time(frames):atom(atom)
+		events = events + 1
+	end
+
+	-- forge rejects time stamps before slice start
+	assert(not pcall(forge.time, forge, from - 1))
+
+	-- forges are shared by all slices, an event forged past the end of previous
+	-- slice rejects time stamps before it at the start of this slice
+	if from == 0 then
+		ahead = 0
+	elseif ahead > from then
+		assert(not pcall(notify.time, notify, from))
+	end
+
+	if to + 1 < nsamples then
+		ahead = to + 1
+		notify:time(ahead):int(slices)
+	end
+
+	return a
+end
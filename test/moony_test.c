@@ -18,6 +18,7 @@
 #include <moony.h>
 #include <api_atom.h>
 #include <api_forge.h>
+#include <api_fold.h>
 
 #include <lauxlib.h>
 
@@ -78,6 +79,7 @@ _test(lua_State *L)
 		fprintf(stderr, "forge frame mismatch\n");
 	else
 		lv2_atom_forge_pop(forge, &frame);
+	moony_sort(&handle->moony); // as done at end of period
 
 	// consume events
 	lv2_atom_forge_set_buffer(forge, handle->buf2, buf_size);
@@ -104,6 +106,14 @@ _test(lua_State *L)
 	return 0;
 }
 
+__non_realtime static int
+_nanos(lua_State *L)
+{
+	lua_pushinteger(L, moony_nanos());
+
+	return 1;
+}
+
 __non_realtime static LV2_URID
 _map(LV2_URID_Map_Handle instance, const char *uri)
 {
@@ -297,6 +307,13 @@ main(int argc, char **argv)
 	lua_pushcclosure(L, _test, 2);
 	lua_setglobal(L, "test");
 
+	// register constant folding pass and clock for benchmarks
+	lua_pushcfunction(L, moony_fold);
+	lua_setglobal(L, "fold");
+
+	lua_pushcfunction(L, _nanos);
+	lua_setglobal(L, "nanos");
+
 	const int ret = luaL_dofile(L, argv[1]); // wraps around lua_pcall
 
 	if(ret)
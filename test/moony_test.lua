@@ -1224,6 +1224,181 @@ do
 	test(producer, consumer)
 end
 
+-- Unsorted
+print('[test] Unsorted')
+do
+	local function producer(forge)
+		assert(forge:unsorted() == forge)
+		assert(forge:unsorted() == forge) -- flagging twice is fine
+
+		forge:frameTime(30):int(3)
+		forge:frameTime(10):int(1)
+		forge:frameTime(20):int(2)
+		forge:frameTime(10):long(1) -- keeps order of simultaneous events
+
+		local subseq = forge:frameTime(40):sequence(Atom.beatTime):unsorted()
+		subseq:beatTime(2.5):int(5)
+		subseq:beatTime(0.5):int(4)
+		subseq:pop()
+
+		-- nested sequences are sorted, too
+		local sorted = forge:frameTime(50):sequence()
+		assert(not pcall(sorted.frameTime, sorted, -1))
+		sorted:pop()
+
+		local stash = Stash()
+		assert(not pcall(stash.unsorted, stash)) -- not a sequence
+
+		-- stashes are sorted when switched to reading mode
+		local stash_seq = stash:sequence():unsorted()
+		stash_seq:frameTime(5):int(2)
+		stash_seq:frameTime(1):int(1)
+		stash_seq:pop()
+		stash:read()
+		assert(stash[1].body == 1)
+		assert(stash[2].body == 2)
+	end
+
+	local function consumer(seq)
+		assert(#seq == 6)
+
+		local expected = {
+			{10, Atom.Int},
+			{10, Atom.Long},
+			{20, Atom.Int},
+			{30, Atom.Int},
+			{40, Atom.Sequence},
+			{50, Atom.Sequence}
+		}
+		local i = 1
+		for frames, atom in seq:foreach() do
+			assert(frames == expected[i][1])
+			assert(atom.type == expected[i][2])
+			i = i + 1
+		end
+
+		local beats = {0.5, 2.5}
+		i = 1
+		for time, atom in seq[5]:foreach() do
+			assert(time == beats[i])
+			assert(atom.body == 3 + i)
+			i = i + 1
+		end
+		assert(i == 3)
+	end
+
+	test(producer, consumer)
+end
+
+-- Scheduler
+print('[test] Scheduler')
+do
+	local sched = Scheduler(4, 32)
+	assert(type(sched) == 'userdata')
+	assert(sched:now() == 0)
+	assert(#sched == 0)
+
+	local time_responder = TimeResponder()
+	local beat_sched = Scheduler(nil, nil, time_responder)
+
+	local function producer(forge)
+		sched:frameTime(300):midi(MIDI.NoteOff, 60, 0x0)
+		sched:frameTime(100):midi(MIDI.NoteOn, 60, 0x7f)
+		sched:time(100):midi(MIDI.NoteOn, 61, 0x7f)
+		sched:frameTime(-5):int(1) -- late
+		assert(#sched == 4)
+		assert(not pcall(sched.frameTime, sched, 400))
+		assert(not pcall(sched.beatTime, sched, 1.0))
+
+		-- first period
+		local subseq = forge:frameTime(0):sequence()
+		sched:flush(256, subseq)
+		subseq:pop()
+		assert(#sched == 1)
+		assert(sched:now() == 256)
+
+		-- second period
+		subseq = forge:frameTime(1):sequence()
+		sched:flush(256, subseq)
+		subseq:pop()
+		assert(#sched == 0)
+		assert(sched:now() == 512)
+
+		-- discard unwritten and cleared events
+		sched:frameTime(512)
+		sched:frameTime(513):int(2)
+		assert(#sched == 1)
+		assert(sched:clear() == sched)
+		assert(#sched == 0)
+
+		-- beat time relative to end of period
+		local stash = Stash()
+		stash:object(Time.Position)
+			:key(Time.barBeat):float(0.0)
+			:key(Time.bar):long(0)
+			:key(Time.beatUnit):int(4)
+			:key(Time.beatsPerBar):float(4.0)
+			:key(Time.beatsPerMinute):float(120.0)
+			:key(Time.framesPerSecond):float(48000.0)
+			:key(Time.speed):float(1.0)
+			:pop()
+		stash:read()
+		time_responder:apply(stash)
+
+		beat_sched:beatTime(0.25):int(3)
+		beat_sched:beatTime(-0.005):int(4)
+		beat_sched:frameTime(10):int(5)
+
+		subseq = forge:frameTime(2):sequence()
+		beat_sched:flush(256, subseq)
+		subseq:pop()
+		assert(#beat_sched == 1)
+	end
+
+	local function consumer(seq)
+		assert(#seq == 3)
+
+		local expected = {
+			{0, Atom.Int},
+			{100, MIDI.NoteOn, 60},
+			{100, MIDI.NoteOn, 61}
+		}
+		local i = 1
+		for frames, atom in seq[1]:foreach() do
+			assert(frames == expected[i][1])
+			if atom.type == MIDI.MidiEvent then
+				assert(atom[1] == expected[i][2])
+				assert(atom[2] == expected[i][3])
+			else
+				assert(atom.type == expected[i][2])
+			end
+			i = i + 1
+		end
+		assert(i == 4)
+
+		assert(#seq[2] == 1)
+		for frames, atom in seq[2]:foreach() do
+			assert(frames == 300 - 256)
+			assert(atom.type == MIDI.MidiEvent)
+			assert(atom[1] == MIDI.NoteOff)
+		end
+
+		expected = {
+			{10, 5},
+			{256 - 120, 4}
+		}
+		i = 1
+		for frames, atom in seq[3]:foreach() do
+			assert(frames == expected[i][1])
+			assert(atom.body == expected[i][2])
+			i = i + 1
+		end
+		assert(i == 3)
+	end
+
+	test(producer, consumer)
+end
+
 -- Sequence
 print('[test] Sequence')
 do
@@ -1838,6 +2013,9 @@ do
 	assert(Note['C+4'] == 60)
 	assert(Note[60] == 'C+4')
 
+	assert(Note['C-0'] == 12) -- alternative spelling
+	assert(Note[60.5] == nil)
+
 	assert(Note[-1] == nil)
 	assert(Note(0x80) == nil)
 	assert(Note.foo == nil)
@@ -2018,6 +2196,62 @@ do
 	assert(400.0 == midi2cps(60.0, base, noct, fref))
 end
 
+-- Tuning
+print('[test] Tuning')
+do
+	-- equal temperament matches midi2cps/cps2midi
+	local et = Tuning()
+	assert(#et == 12)
+	for note = 0, 127 do
+		assert(et:midi2cps(note) == midi2cps(note))
+		assert(midi2cps(note) == midi2cps(note, 69, 12, 440))
+	end
+	for note = -24.0, 151.0, 0.1 do
+		assert(math.abs(et:midi2cps(note) - midi2cps(note)) < 1e-9 * midi2cps(note))
+		assert(math.abs(et:cps2midi(et:midi2cps(note)) - note) < 1e-9)
+	end
+	assert(et:cps2midi(440.0) == 69.0)
+
+	local et32 = Tuning(32, 60, 400.0)
+	for note = 0.0, 127.0, 0.1 do
+		assert(math.abs(et32:midi2cps(note) - midi2cps(note, 60, 32, 400.0)) < 1e-9 * et32:midi2cps(note))
+	end
+	assert(et32:midi2cps(60) == 400.0)
+
+	-- just intonation scale in cents with octave as period
+	local just = Tuning({111.73, 203.91, 315.64, 386.31, 498.04, 590.22,
+		701.96, 813.69, 884.36, 1017.60, 1088.27, 1200.0}, 60, 261.63)
+	assert(#just == 12)
+	assert(just:midi2cps(60) == 261.63)
+	assert(math.abs(just:midi2cps(67) - 261.63 * 2^(701.96/1200)) < 1e-9)
+	assert(math.abs(just:midi2cps(48) - 261.63 / 2) < 1e-9)
+	assert(math.abs(just:midi2cps(79) - 261.63 * 2^((1200 + 701.96)/1200)) < 1e-9)
+
+	-- fractional notes are interpolated between scale degrees in cents
+	assert(math.abs(just:midi2cps(60.5) - 261.63 * 2^(111.73/2/1200)) < 1e-9)
+	for note = 0.0, 127.0, 0.25 do
+		assert(math.abs(just:cps2midi(just:midi2cps(note)) - note) < 1e-9)
+	end
+
+	-- bulk conversion in-place
+	local tab = {60, 67, 72}
+	assert(just:midi2cps(tab) == tab)
+	assert(tab[1] == just:midi2cps(60))
+	assert(tab[2] == just:midi2cps(67))
+	assert(tab[3] == just:midi2cps(72))
+	assert(just:cps2midi(tab) == tab)
+	assert(math.abs(tab[1] - 60) < 1e-9)
+	assert(math.abs(tab[2] - 67) < 1e-9)
+	assert(math.abs(tab[3] - 72) < 1e-9)
+
+	-- invalid scales
+	assert(not pcall(Tuning, 0))
+	assert(not pcall(Tuning, {}))
+	assert(not pcall(Tuning, {100, 50, 1200}))
+	assert(not pcall(Tuning, 12, 128))
+	assert(not pcall(Tuning, 12, 69, 0.0))
+end
+
 -- Mapper
 print('[test] Mapper')
 do
@@ -2321,6 +2555,86 @@ do
 	test(producer, consumer)
 end
 
+-- Canvas layer
+print('[test] Canvas layer')
+do
+	local function producer(forge)
+		local graph = forge:time(0):tuple()
+		assert(graph:layer(2):rectangle(0.0, 0.0, 1.0, 1.0):fill():pop() == graph)
+		assert(graph:layer(-1):pop() == graph)
+		assert(graph:pop() == forge)
+	end
+
+	local function consumer(seq)
+		assert(#seq == 1)
+
+		local graph = seq[1]
+		assert(graph.type == Atom.Tuple)
+		assert(#graph == 2)
+
+		local layer = graph[1]
+		assert(layer.type == Atom.Object)
+		assert(layer.otype == Canvas.Layer)
+		assert(layer[Canvas.layer].type == Atom.Int)
+		assert(layer[Canvas.layer].body == 2)
+
+		local body = layer[Canvas.body]
+		assert(body.type == Atom.Tuple)
+		assert(#body == 2)
+		assert(body[1].otype == Canvas.Rectangle)
+		assert(body[2].otype == Canvas.Fill)
+
+		layer = graph[2]
+		assert(layer.otype == Canvas.Layer)
+		assert(layer[Canvas.layer].body == -1)
+		assert(layer[Canvas.body].type == Atom.Tuple)
+		assert(#layer[Canvas.body] == 0)
+	end
+
+	test(producer, consumer)
+end
+
+-- Canvas polyLine from vector
+print('[test] Canvas polyLine from vector')
+do
+	local xy = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6}
+	local vec = Stash()
+	vec:vector(Atom.Float, xy)
+	vec:read()
+
+	local ints = Stash()
+	ints:vector(Atom.Int, {1, 2})
+	ints:read()
+
+	local function producer(forge)
+		local graph = forge:time(0):tuple()
+		assert(graph:polyLine(vec) == graph)
+		assert(pcall(graph.polyLine, graph, ints) == false)
+		assert(graph:pop() == forge)
+	end
+
+	local function consumer(seq)
+		assert(#seq == 1)
+
+		local graph = seq[1]
+		assert(graph.type == Atom.Tuple)
+		assert(#graph == 1)
+
+		local itm = graph[1]
+		assert(itm.otype == Canvas.PolyLine)
+
+		local body = itm[Canvas.body]
+		assert(body.type == Atom.Vector)
+		assert(body.childType == Atom.Float)
+		assert(#body == #xy)
+		for i = 1, #xy do
+			assert(body[i].body == vec[i].body)
+		end
+	end
+
+	test(producer, consumer)
+end
+
 -- disabled routines
 print('[test] Disabled routines')
 do
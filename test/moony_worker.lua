@@ -0,0 +1,80 @@
+--[[
+	Copyright (c) 2015-2021 Hanspeter Portner (dev@open-music-kontrollers.ch)
+
+	This is free software: you can redistribute it and/or modify
+	it under the terms of the Artistic License 2.0 as published by
+	The Perl Foundation.
+
+	This source is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+	Artistic License 2.0 for more details.
+
+	You should have received a copy of the Artistic License 2.0
+	along the source as a COPYING file. If not, obtain it from
+	http://www.perlfoundation.org/artistic_license_2_0.
+--]]
+
+-- hand events over to worker VM and check its responses, e.g. via moony_run
+local posted = 0
+local received = 0
+
+-- runs in worker VM
+function work(atom, forge)
+	assert(atom.type == MIDI.MidiEvent)
+
+	-- worker VM cannot post itself
+	assert(not pcall(Worker.post, Worker, atom))
+
+	-- worker VM sorts its own unsorted sequences
+	local stash = Stash()
+	local seq = stash:sequence():unsorted()
+	seq:frameTime(2):int(2)
+	seq:frameTime(1):int(1)
+	seq:pop()
+	stash:read()
+	assert(stash[1].body == 1)
+	assert(stash[2].body == 2)
+
+	-- worker VM keeps its own udata cache, nested iterators stay apart
+	local tup = Stash()
+	tup:tuple():int(10):int(20):pop()
+	tup:read()
+	local count = 0
+	for _, a in stash:foreach() do
+		local body = a.body
+		for _, b in tup:foreach() do
+			count = count + body * b.body
+		end
+		assert(a.body == body)
+	end
+	assert(count == 90)
+
+	-- heavy computation, off the realtime thread
+	local sum = 0
+	for i = 1, 10000 do
+		sum = sum + i
+	end
+
+	forge:tuple():int(atom[1]):long(sum):pop()
+end
+
+-- runs in realtime VM
+function work_response(atom)
+	assert(atom.type == Atom.Tuple)
+	assert(atom[2].body == 50005000)
+
+	received = received + 1
+end
+
+function run(n, control, notify, seq, forge)
+	-- moony_run works off jobs in between periods
+	assert(received == posted)
+
+	for frames, atom in seq:foreach() do
+		assert(Worker:post(atom))
+		posted = posted + 1
+
+		forge:time(frames):atom(atom)
+	end
+end